@@ -154,6 +154,8 @@ int         nb_output_files   = 0;
 FilterGraph **filtergraphs;
 int        nb_filtergraphs;
 
+AVFramePool *frame_pool;
+
 #if HAVE_TERMIOS_H
 
 /* init terminal so that we can grab keys */
@@ -163,6 +165,7 @@ static int restore_tty;
 
 #if HAVE_PTHREADS
 static void free_input_threads(void);
+static void free_encoder_threads(void);
 #endif
 
 /* sub2video hack:
@@ -480,7 +483,7 @@ static void ffmpeg_cleanup(int ret)
                 AVFrame *frame;
                 av_fifo_generic_read(fg->inputs[j]->frame_queue, &frame,
                                      sizeof(frame), NULL);
-                av_frame_free(&frame);
+                av_frame_pool_release(&frame);
             }
             av_fifo_freep(&fg->inputs[j]->frame_queue);
             if (fg->inputs[j]->ist->sub2video.sub_queue) {
@@ -513,6 +516,10 @@ static void ffmpeg_cleanup(int ret)
 
     av_freep(&subtitle_out);
 
+#if HAVE_PTHREADS
+    free_encoder_threads();
+#endif
+
     /* close files */
     for (i = 0; i < nb_output_files; i++) {
         OutputFile *of = output_files[i];
@@ -538,7 +545,7 @@ static void ffmpeg_cleanup(int ret)
         av_freep(&ost->bsf_ctx);
 
         av_frame_free(&ost->filtered_frame);
-        av_frame_free(&ost->last_frame);
+        av_frame_pool_release(&ost->last_frame);
         av_dict_free(&ost->encoder_opts);
 
         av_parser_close(ost->parser);
@@ -573,6 +580,7 @@ static void ffmpeg_cleanup(int ret)
 #endif
     for (i = 0; i < nb_input_files; i++) {
         avformat_close_input(&input_files[i]->ctx);
+        av_packet_pool_free(&input_files[i]->pkt_pool);
         av_freep(&input_files[i]);
     }
     for (i = 0; i < nb_input_streams; i++) {
@@ -599,11 +607,13 @@ static void ffmpeg_cleanup(int ret)
                    av_err2str(AVERROR(errno)));
     }
     av_freep(&vstats_filename);
+    av_freep(&filter_thread_type);
 
     av_freep(&input_streams);
     av_freep(&input_files);
     av_freep(&output_streams);
     av_freep(&output_files);
+    av_frame_pool_free(&frame_pool);
 
     uninit_opts();
 
@@ -876,6 +886,247 @@ finish:
     }
 }
 
+#if HAVE_PTHREADS
+/* message sent from the encoder thread to the main thread */
+typedef struct EncoderThreadMessage {
+    AVPacket pkt;
+    int64_t enc_time;   /* time spent in the encoder since the previous packet, for -benchmark_all */
+    int flush;          /* pkt was produced after the encoder was sent a NULL frame */
+    int wakeup;         /* no packet; a frame was taken off enc_frame_queue */
+} EncoderThreadMessage;
+
+static void free_encoder_frame(void *msg)
+{
+    av_frame_pool_release((AVFrame **)msg);
+}
+
+static void free_encoder_message(void *msg)
+{
+    av_packet_unref(&((EncoderThreadMessage *)msg)->pkt);
+}
+
+/*
+ * Encoder worker used with -threaded_encoding. Frames (or NULL to flush) are
+ * received on enc_frame_queue, the resulting packets are sent back to the
+ * main thread on enc_pkt_queue, which keeps muxing on the main thread.
+ */
+static void *encoder_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    AVCodecContext *enc = ost->enc_ctx;
+    int64_t enc_time = 0;
+    int flush = 0;
+    int ret;
+
+    while (1) {
+        EncoderThreadMessage msg = { { 0 } };
+        AVFrame *frame;
+        int64_t frame_pts = AV_NOPTS_VALUE;
+        int64_t t;
+
+        ret = av_thread_message_queue_recv(ost->enc_frame_queue, &frame, 0);
+        if (ret < 0)
+            break;
+
+        /* the main thread blocks on enc_pkt_queue until there is room for its frame */
+        if (atomic_exchange(&ost->enc_waiting, 0)) {
+            msg.wakeup = 1;
+            if ((ret = av_thread_message_queue_send(ost->enc_pkt_queue, &msg, 0)) < 0) {
+                av_frame_pool_release(&frame);
+                break;
+            }
+            msg.wakeup = 0;
+        }
+
+        if (frame)
+            frame_pts = frame->pts;
+        else
+            flush = 1;
+        t = getutime();
+        ret = avcodec_send_frame(enc, frame);
+        enc_time += getutime() - t;
+        av_frame_pool_release(&frame);
+        if (ret < 0)
+            break;
+
+        while (1) {
+            av_init_packet(&msg.pkt);
+            msg.pkt.data = NULL;
+            msg.pkt.size = 0;
+
+            t = getutime();
+            ret = avcodec_receive_packet(enc, &msg.pkt);
+            enc_time += getutime() - t;
+            if (ret < 0)
+                break;
+
+            if (enc->codec_type == AVMEDIA_TYPE_VIDEO &&
+                msg.pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+                msg.pkt.pts = frame_pts;
+
+            msg.enc_time = enc_time;
+            msg.flush    = flush;
+            enc_time     = 0;
+            ret = av_thread_message_queue_send(ost->enc_pkt_queue, &msg, 0);
+            if (ret < 0) {
+                av_packet_unref(&msg.pkt);
+                break;
+            }
+        }
+        if (ret != AVERROR(EAGAIN))
+            break;
+    }
+
+    av_thread_message_queue_set_err_send(ost->enc_frame_queue, ret);
+    av_thread_message_queue_set_err_recv(ost->enc_pkt_queue, ret);
+    return NULL;
+}
+
+static int init_encoder_thread(OutputStream *ost)
+{
+    int ret;
+
+    if (!threaded_encoding || ost->logfile || vstats_filename ||
+        (ost->enc_ctx->codec_type != AVMEDIA_TYPE_VIDEO &&
+         ost->enc_ctx->codec_type != AVMEDIA_TYPE_AUDIO))
+        return 0;
+
+    ret = av_thread_message_queue_alloc(&ost->enc_frame_queue, 8, sizeof(AVFrame *));
+    if (ret < 0)
+        return ret;
+    ret = av_thread_message_queue_alloc(&ost->enc_pkt_queue, 64, sizeof(EncoderThreadMessage));
+    if (ret < 0) {
+        av_thread_message_queue_free(&ost->enc_frame_queue);
+        return ret;
+    }
+    av_thread_message_queue_set_free_func(ost->enc_frame_queue, free_encoder_frame);
+    av_thread_message_queue_set_free_func(ost->enc_pkt_queue, free_encoder_message);
+    atomic_init(&ost->enc_waiting, 0);
+
+    if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        av_thread_message_queue_free(&ost->enc_pkt_queue);
+        av_thread_message_queue_free(&ost->enc_frame_queue);
+        return AVERROR(ret);
+    }
+    return 0;
+}
+
+static void free_encoder_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+        if (!ost || !ost->enc_frame_queue)
+            continue;
+        av_thread_message_queue_set_err_recv(ost->enc_frame_queue, AVERROR_EOF);
+        av_thread_message_flush(ost->enc_frame_queue);
+        av_thread_message_queue_set_err_send(ost->enc_pkt_queue, AVERROR_EOF);
+        pthread_join(ost->enc_thread, NULL);
+        av_thread_message_queue_free(&ost->enc_frame_queue);
+        av_thread_message_queue_free(&ost->enc_pkt_queue);
+    }
+}
+
+/*
+ * Mux the packets the encoder thread of ost has produced so far. If flush is
+ * set, wait for the encoder to be drained. If wait is set, block until at
+ * least one message arrives.
+ *
+ * @return AVERROR_EOF once the encoder has been fully flushed, 0 otherwise
+ */
+static int receive_encoder_thread_packets(OutputStream *ost, int flush, int wait)
+{
+    OutputFile *of = output_files[ost->file_index];
+    const char *type = av_get_media_type_string(ost->enc_ctx->codec_type);
+    EncoderThreadMessage msg;
+    int ret;
+
+    while (1) {
+        ret = av_thread_message_queue_recv(ost->enc_pkt_queue, &msg,
+                                           flush || wait ? 0 : AV_THREAD_MESSAGE_NONBLOCK);
+        if (ret == AVERROR(EAGAIN))
+            return 0;
+        if (ret == AVERROR_EOF)
+            return ret;
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
+                   type, av_err2str(ret));
+            exit_program(1);
+        }
+        wait = 0;
+        if (msg.wakeup)
+            continue;
+
+        if (do_benchmark_all)
+            av_log(NULL, AV_LOG_INFO, "bench: %8"PRIu64" %s_%s %d.%d \n", msg.enc_time,
+                   msg.flush ? "flush" : "encode", type, ost->file_index, ost->index);
+
+        if (ost->finished & MUXER_FINISHED) {
+            av_packet_unref(&msg.pkt);
+            continue;
+        }
+
+        av_packet_rescale_ts(&msg.pkt, ost->enc_ctx->time_base, ost->mux_timebase);
+
+        if (debug_ts) {
+            av_log(NULL, AV_LOG_INFO, "encoder -> type:%s "
+                   "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n", type,
+                   av_ts2str(msg.pkt.pts), av_ts2timestr(msg.pkt.pts, &ost->mux_timebase),
+                   av_ts2str(msg.pkt.dts), av_ts2timestr(msg.pkt.dts, &ost->mux_timebase));
+        }
+
+        output_packet(of, &msg.pkt, ost, 0);
+    }
+}
+
+/*
+ * Queue a reference to frame for the encoder thread of ost, muxing any
+ * packets it has produced in the meantime.
+ */
+static void send_frame_to_encoder_thread(OutputStream *ost, AVFrame *frame)
+{
+    AVFrame *ref = NULL;
+    int ret;
+
+    if (frame && !(ref = av_frame_pool_clone(frame_pool, frame))) {
+        av_log(NULL, AV_LOG_FATAL, "Error cloning a frame for encoding\n");
+        exit_program(1);
+    }
+
+    while ((ret = av_thread_message_queue_send(ost->enc_frame_queue, &ref,
+                                               AV_THREAD_MESSAGE_NONBLOCK)) == AVERROR(EAGAIN)) {
+        /*
+         * The encoder is behind. Ask it to signal when it takes the next
+         * frame, then retry once, since it may have done so before seeing
+         * the request. If the queue is still full, sleep on enc_pkt_queue
+         * (muxing what arrives) until the wakeup comes.
+         */
+        atomic_store(&ost->enc_waiting, 1);
+        ret = av_thread_message_queue_send(ost->enc_frame_queue, &ref,
+                                           AV_THREAD_MESSAGE_NONBLOCK);
+        if (ret != AVERROR(EAGAIN))
+            break;
+        if ((ret = receive_encoder_thread_packets(ost, 0, 1)) < 0)
+            break;
+    }
+    if (ret < 0) {
+        av_frame_pool_release(&ref);
+        receive_encoder_thread_packets(ost, 1, 0);
+        av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
+               av_get_media_type_string(ost->enc_ctx->codec_type),
+               av_err2str(ret));
+        exit_program(1);
+    }
+
+    receive_encoder_thread_packets(ost, 0, 0);
+    /* the encoder's own time is reported with each packet */
+    update_benchmark(NULL);
+}
+#endif
+
 static int check_recording_time(OutputStream *ost)
 {
     OutputFile *of = output_files[ost->file_index];
@@ -918,6 +1169,13 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
                enc->time_base.num, enc->time_base.den);
     }
 
+#if HAVE_PTHREADS
+    if (ost->enc_frame_queue) {
+        send_frame_to_encoder_thread(ost, frame);
+        return;
+    }
+#endif
+
     ret = avcodec_send_frame(enc, frame);
     if (ret < 0)
         goto error;
@@ -1285,6 +1543,13 @@ static void do_video_out(OutputFile *of,
 
         ost->frames_encoded++;
 
+#if HAVE_PTHREADS
+        if (ost->enc_frame_queue) {
+            send_frame_to_encoder_thread(ost, in_picture);
+            goto next_frame;
+        }
+#endif
+
         ret = avcodec_send_frame(enc, in_picture);
         if (ret < 0)
             goto error;
@@ -1325,6 +1590,9 @@ static void do_video_out(OutputFile *of,
             }
         }
     }
+#if HAVE_PTHREADS
+next_frame:
+#endif
     ost->sync_opts++;
     /*
      * For video, number of frames in == number of packets out.
@@ -1337,13 +1605,9 @@ static void do_video_out(OutputFile *of,
         do_video_stats(ost, frame_size);
   }
 
-    if (!ost->last_frame)
-        ost->last_frame = av_frame_alloc();
-    av_frame_unref(ost->last_frame);
-    if (next_picture && ost->last_frame)
-        av_frame_ref(ost->last_frame, next_picture);
-    else
-        av_frame_free(&ost->last_frame);
+    av_frame_pool_release(&ost->last_frame);
+    if (next_picture)
+        ost->last_frame = av_frame_pool_clone(frame_pool, next_picture);
 
     return;
 error:
@@ -1895,6 +2159,19 @@ static void flush_encoders(void)
             }
         }
 
+#if HAVE_PTHREADS
+        if (ost->enc_frame_queue) {
+            AVPacket pkt = { 0 };
+
+            send_frame_to_encoder_thread(ost, NULL);
+            ret = receive_encoder_thread_packets(ost, 1, 0);
+            av_assert0(ret == AVERROR_EOF);
+            if (!(enc->codec_type == AVMEDIA_TYPE_AUDIO && enc->frame_size <= 1))
+                output_packet(of, &pkt, ost, 1);
+            continue;
+        }
+#endif
+
         if (enc->codec_type == AVMEDIA_TYPE_AUDIO && enc->frame_size <= 1)
             continue;
 #if FF_API_LAVF_FMT_RAWPICTURE
@@ -2180,7 +2457,7 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame)
     if (need_reinit || !fg->graph) {
         for (i = 0; i < fg->nb_inputs; i++) {
             if (!ifilter_has_all_input_formats(fg)) {
-                AVFrame *tmp = av_frame_clone(frame);
+                AVFrame *tmp = av_frame_pool_clone(frame_pool, frame);
                 if (!tmp)
                     return AVERROR(ENOMEM);
                 av_frame_unref(frame);
@@ -2188,7 +2465,7 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame)
                 if (!av_fifo_space(ifilter->frame_queue)) {
                     ret = av_fifo_realloc2(ifilter->frame_queue, 2 * av_fifo_size(ifilter->frame_queue));
                     if (ret < 0) {
-                        av_frame_free(&tmp);
+                        av_frame_pool_release(&tmp);
                         return ret;
                     }
                 }
@@ -3540,6 +3817,15 @@ static int init_output_stream(OutputStream *ost, char *error, int error_len)
             ost->st->duration = av_rescale_q(ist->st->duration, ist->st->time_base, ost->st->time_base);
 
         ost->st->codec->codec= ost->enc_ctx->codec;
+
+#if HAVE_PTHREADS
+        ret = init_encoder_thread(ost);
+        if (ret < 0) {
+            snprintf(error, error_len, "Could not start the encoder thread "
+                     "for output stream #%d:%d", ost->file_index, ost->index);
+            return ret;
+        }
+#endif
     } else if (ost->stream_copy) {
         ret = init_output_stream_streamcopy(ost);
         if (ret < 0)
@@ -3625,6 +3911,10 @@ static int transcode_init(void)
     InputStream *ist;
     char error[1024] = {0};
 
+    frame_pool = av_frame_pool_alloc();
+    if (!frame_pool)
+        return AVERROR(ENOMEM);
+
     for (i = 0; i < nb_filtergraphs; i++) {
         FilterGraph *fg = filtergraphs[i];
         for (j = 0; j < fg->nb_outputs; j++) {
@@ -3978,14 +4268,20 @@ static void *input_thread(void *arg)
     int ret = 0;
 
     while (1) {
-        AVPacket pkt;
-        ret = av_read_frame(f->ctx, &pkt);
+        AVPacket *pkt = av_packet_pool_get(f->pkt_pool);
+        if (!pkt) {
+            av_thread_message_queue_set_err_recv(f->in_thread_queue, AVERROR(ENOMEM));
+            break;
+        }
+        ret = av_read_frame(f->ctx, pkt);
 
         if (ret == AVERROR(EAGAIN)) {
+            av_packet_pool_release(&pkt);
             av_usleep(10000);
             continue;
         }
         if (ret < 0) {
+            av_packet_pool_release(&pkt);
             av_thread_message_queue_set_err_recv(f->in_thread_queue, ret);
             break;
         }
@@ -4003,7 +4299,7 @@ static void *input_thread(void *arg)
                 av_log(f->ctx, AV_LOG_ERROR,
                        "Unable to send packet to main thread: %s\n",
                        av_err2str(ret));
-            av_packet_unref(&pkt);
+            av_packet_pool_release(&pkt);
             av_thread_message_queue_set_err_recv(f->in_thread_queue, ret);
             break;
         }
@@ -4018,13 +4314,13 @@ static void free_input_threads(void)
 
     for (i = 0; i < nb_input_files; i++) {
         InputFile *f = input_files[i];
-        AVPacket pkt;
+        AVPacket *pkt;
 
         if (!f || !f->in_thread_queue)
             continue;
         av_thread_message_queue_set_err_send(f->in_thread_queue, AVERROR_EOF);
         while (av_thread_message_queue_recv(f->in_thread_queue, &pkt, 0) >= 0)
-            av_packet_unref(&pkt);
+            av_packet_pool_release(&pkt);
 
         pthread_join(f->thread, NULL);
         f->joined = 1;
@@ -4036,7 +4332,7 @@ static int init_input_threads(void)
 {
     int i, ret;
 
-    if (nb_input_files == 1)
+    if (nb_input_files == 1 && !threaded_encoding)
         return 0;
 
     for (i = 0; i < nb_input_files; i++) {
@@ -4046,7 +4342,7 @@ static int init_input_threads(void)
             strcmp(f->ctx->iformat->name, "lavfi"))
             f->non_blocking = 1;
         ret = av_thread_message_queue_alloc(&f->in_thread_queue,
-                                            f->thread_queue_size, sizeof(AVPacket));
+                                            f->thread_queue_size, sizeof(AVPacket *));
         if (ret < 0)
             return ret;
 
@@ -4059,7 +4355,7 @@ static int init_input_threads(void)
     return 0;
 }
 
-static int get_input_packet_mt(InputFile *f, AVPacket *pkt)
+static int get_input_packet_mt(InputFile *f, AVPacket **pkt)
 {
     return av_thread_message_queue_recv(f->in_thread_queue, pkt,
                                         f->non_blocking ?
@@ -4067,8 +4363,14 @@ static int get_input_packet_mt(InputFile *f, AVPacket *pkt)
 }
 #endif
 
-static int get_input_packet(InputFile *f, AVPacket *pkt)
+/*
+ * Get the next packet of f. It is taken from f->pkt_pool and must be
+ * returned to it with av_packet_pool_release().
+ */
+static int get_input_packet(InputFile *f, AVPacket **pkt)
 {
+    int ret;
+
     if (f->rate_emu) {
         int i;
         for (i = 0; i < f->nb_streams; i++) {
@@ -4081,10 +4383,15 @@ static int get_input_packet(InputFile *f, AVPacket *pkt)
     }
 
 #if HAVE_PTHREADS
-    if (nb_input_files > 1)
+    if (nb_input_files > 1 || threaded_encoding)
         return get_input_packet_mt(f, pkt);
 #endif
-    return av_read_frame(f->ctx, pkt);
+    if (!(*pkt = av_packet_pool_get(f->pkt_pool)))
+        return AVERROR(ENOMEM);
+    ret = av_read_frame(f->ctx, *pkt);
+    if (ret < 0)
+        av_packet_pool_release(pkt);
+    return ret;
 }
 
 static int got_eagain(void)
@@ -4198,7 +4505,7 @@ static int process_input(int file_index)
     InputFile *ifile = input_files[file_index];
     AVFormatContext *is;
     InputStream *ist;
-    AVPacket pkt;
+    AVPacket *pkt;
     int ret, i, j;
     int64_t duration;
     int64_t pkt_dts;
@@ -4251,37 +4558,37 @@ static int process_input(int file_index)
     reset_eagain();
 
     if (do_pkt_dump) {
-        av_pkt_dump_log2(NULL, AV_LOG_INFO, &pkt, do_hex_dump,
-                         is->streams[pkt.stream_index]);
+        av_pkt_dump_log2(NULL, AV_LOG_INFO, pkt, do_hex_dump,
+                         is->streams[pkt->stream_index]);
     }
     /* the following test is needed in case new streams appear
        dynamically in stream : we ignore them */
-    if (pkt.stream_index >= ifile->nb_streams) {
-        report_new_stream(file_index, &pkt);
+    if (pkt->stream_index >= ifile->nb_streams) {
+        report_new_stream(file_index, pkt);
         goto discard_packet;
     }
 
-    ist = input_streams[ifile->ist_index + pkt.stream_index];
+    ist = input_streams[ifile->ist_index + pkt->stream_index];
 
-    ist->data_size += pkt.size;
+    ist->data_size += pkt->size;
     ist->nb_packets++;
 
     if (ist->discard)
         goto discard_packet;
 
-    if (exit_on_error && (pkt.flags & AV_PKT_FLAG_CORRUPT)) {
-        av_log(NULL, AV_LOG_FATAL, "%s: corrupt input packet in stream %d\n", is->filename, pkt.stream_index);
+    if (exit_on_error && (pkt->flags & AV_PKT_FLAG_CORRUPT)) {
+        av_log(NULL, AV_LOG_FATAL, "%s: corrupt input packet in stream %d\n", is->filename, pkt->stream_index);
         exit_program(1);
     }
 
     if (debug_ts) {
         av_log(NULL, AV_LOG_INFO, "demuxer -> ist_index:%d type:%s "
                "next_dts:%s next_dts_time:%s next_pts:%s next_pts_time:%s pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s off:%s off_time:%s\n",
-               ifile->ist_index + pkt.stream_index, av_get_media_type_string(ist->dec_ctx->codec_type),
+               ifile->ist_index + pkt->stream_index, av_get_media_type_string(ist->dec_ctx->codec_type),
                av_ts2str(ist->next_dts), av_ts2timestr(ist->next_dts, &AV_TIME_BASE_Q),
                av_ts2str(ist->next_pts), av_ts2timestr(ist->next_pts, &AV_TIME_BASE_Q),
-               av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ist->st->time_base),
-               av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ist->st->time_base),
+               av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &ist->st->time_base),
+               av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &ist->st->time_base),
                av_ts2str(input_files[ist->file_index]->ts_offset),
                av_ts2timestr(input_files[ist->file_index]->ts_offset, &AV_TIME_BASE_Q));
     }
@@ -4311,12 +4618,12 @@ static int process_input(int file_index)
         stime2= stime + (1ULL<<ist->st->pts_wrap_bits);
         ist->wrap_correction_done = 1;
 
-        if(stime2 > stime && pkt.dts != AV_NOPTS_VALUE && pkt.dts > stime + (1LL<<(ist->st->pts_wrap_bits-1))) {
-            pkt.dts -= 1ULL<<ist->st->pts_wrap_bits;
+        if(stime2 > stime && pkt->dts != AV_NOPTS_VALUE && pkt->dts > stime + (1LL<<(ist->st->pts_wrap_bits-1))) {
+            pkt->dts -= 1ULL<<ist->st->pts_wrap_bits;
             ist->wrap_correction_done = 0;
         }
-        if(stime2 > stime && pkt.pts != AV_NOPTS_VALUE && pkt.pts > stime + (1LL<<(ist->st->pts_wrap_bits-1))) {
-            pkt.pts -= 1ULL<<ist->st->pts_wrap_bits;
+        if(stime2 > stime && pkt->pts != AV_NOPTS_VALUE && pkt->pts > stime + (1LL<<(ist->st->pts_wrap_bits-1))) {
+            pkt->pts -= 1ULL<<ist->st->pts_wrap_bits;
             ist->wrap_correction_done = 0;
         }
     }
@@ -4330,10 +4637,10 @@ static int process_input(int file_index)
             if (src_sd->type == AV_PKT_DATA_DISPLAYMATRIX)
                 continue;
 
-            if (av_packet_get_side_data(&pkt, src_sd->type, NULL))
+            if (av_packet_get_side_data(pkt, src_sd->type, NULL))
                 continue;
 
-            dst_data = av_packet_new_side_data(&pkt, src_sd->type, src_sd->size);
+            dst_data = av_packet_new_side_data(pkt, src_sd->type, src_sd->size);
             if (!dst_data)
                 exit_program(1);
 
@@ -4341,17 +4648,17 @@ static int process_input(int file_index)
         }
     }
 
-    if (pkt.dts != AV_NOPTS_VALUE)
-        pkt.dts += av_rescale_q(ifile->ts_offset, AV_TIME_BASE_Q, ist->st->time_base);
-    if (pkt.pts != AV_NOPTS_VALUE)
-        pkt.pts += av_rescale_q(ifile->ts_offset, AV_TIME_BASE_Q, ist->st->time_base);
+    if (pkt->dts != AV_NOPTS_VALUE)
+        pkt->dts += av_rescale_q(ifile->ts_offset, AV_TIME_BASE_Q, ist->st->time_base);
+    if (pkt->pts != AV_NOPTS_VALUE)
+        pkt->pts += av_rescale_q(ifile->ts_offset, AV_TIME_BASE_Q, ist->st->time_base);
 
-    if (pkt.pts != AV_NOPTS_VALUE)
-        pkt.pts *= ist->ts_scale;
-    if (pkt.dts != AV_NOPTS_VALUE)
-        pkt.dts *= ist->ts_scale;
+    if (pkt->pts != AV_NOPTS_VALUE)
+        pkt->pts *= ist->ts_scale;
+    if (pkt->dts != AV_NOPTS_VALUE)
+        pkt->dts *= ist->ts_scale;
 
-    pkt_dts = av_rescale_q_rnd(pkt.dts, ist->st->time_base, AV_TIME_BASE_Q, AV_ROUND_NEAR_INF|AV_ROUND_PASS_MINMAX);
+    pkt_dts = av_rescale_q_rnd(pkt->dts, ist->st->time_base, AV_TIME_BASE_Q, AV_ROUND_NEAR_INF|AV_ROUND_PASS_MINMAX);
     if ((ist->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO ||
          ist->dec_ctx->codec_type == AVMEDIA_TYPE_AUDIO) &&
         pkt_dts != AV_NOPTS_VALUE && ist->next_dts == AV_NOPTS_VALUE && !copy_ts
@@ -4363,23 +4670,23 @@ static int process_input(int file_index)
             av_log(NULL, AV_LOG_DEBUG,
                    "Inter stream timestamp discontinuity %"PRId64", new offset= %"PRId64"\n",
                    delta, ifile->ts_offset);
-            pkt.dts -= av_rescale_q(delta, AV_TIME_BASE_Q, ist->st->time_base);
-            if (pkt.pts != AV_NOPTS_VALUE)
-                pkt.pts -= av_rescale_q(delta, AV_TIME_BASE_Q, ist->st->time_base);
+            pkt->dts -= av_rescale_q(delta, AV_TIME_BASE_Q, ist->st->time_base);
+            if (pkt->pts != AV_NOPTS_VALUE)
+                pkt->pts -= av_rescale_q(delta, AV_TIME_BASE_Q, ist->st->time_base);
         }
     }
 
     duration = av_rescale_q(ifile->duration, ifile->time_base, ist->st->time_base);
-    if (pkt.pts != AV_NOPTS_VALUE) {
-        pkt.pts += duration;
-        ist->max_pts = FFMAX(pkt.pts, ist->max_pts);
-        ist->min_pts = FFMIN(pkt.pts, ist->min_pts);
+    if (pkt->pts != AV_NOPTS_VALUE) {
+        pkt->pts += duration;
+        ist->max_pts = FFMAX(pkt->pts, ist->max_pts);
+        ist->min_pts = FFMIN(pkt->pts, ist->min_pts);
     }
 
-    if (pkt.dts != AV_NOPTS_VALUE)
-        pkt.dts += duration;
+    if (pkt->dts != AV_NOPTS_VALUE)
+        pkt->dts += duration;
 
-    pkt_dts = av_rescale_q_rnd(pkt.dts, ist->st->time_base, AV_TIME_BASE_Q, AV_ROUND_NEAR_INF|AV_ROUND_PASS_MINMAX);
+    pkt_dts = av_rescale_q_rnd(pkt->dts, ist->st->time_base, AV_TIME_BASE_Q, AV_ROUND_NEAR_INF|AV_ROUND_PASS_MINMAX);
     if ((ist->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO ||
          ist->dec_ctx->codec_type == AVMEDIA_TYPE_AUDIO) &&
          pkt_dts != AV_NOPTS_VALUE && ist->next_dts != AV_NOPTS_VALUE &&
@@ -4393,46 +4700,46 @@ static int process_input(int file_index)
                 av_log(NULL, AV_LOG_DEBUG,
                        "timestamp discontinuity %"PRId64", new offset= %"PRId64"\n",
                        delta, ifile->ts_offset);
-                pkt.dts -= av_rescale_q(delta, AV_TIME_BASE_Q, ist->st->time_base);
-                if (pkt.pts != AV_NOPTS_VALUE)
-                    pkt.pts -= av_rescale_q(delta, AV_TIME_BASE_Q, ist->st->time_base);
+                pkt->dts -= av_rescale_q(delta, AV_TIME_BASE_Q, ist->st->time_base);
+                if (pkt->pts != AV_NOPTS_VALUE)
+                    pkt->pts -= av_rescale_q(delta, AV_TIME_BASE_Q, ist->st->time_base);
             }
         } else {
             if ( delta < -1LL*dts_error_threshold*AV_TIME_BASE ||
                  delta >  1LL*dts_error_threshold*AV_TIME_BASE) {
-                av_log(NULL, AV_LOG_WARNING, "DTS %"PRId64", next:%"PRId64" st:%d invalid dropping\n", pkt.dts, ist->next_dts, pkt.stream_index);
-                pkt.dts = AV_NOPTS_VALUE;
+                av_log(NULL, AV_LOG_WARNING, "DTS %"PRId64", next:%"PRId64" st:%d invalid dropping\n", pkt->dts, ist->next_dts, pkt->stream_index);
+                pkt->dts = AV_NOPTS_VALUE;
             }
-            if (pkt.pts != AV_NOPTS_VALUE){
-                int64_t pkt_pts = av_rescale_q(pkt.pts, ist->st->time_base, AV_TIME_BASE_Q);
+            if (pkt->pts != AV_NOPTS_VALUE){
+                int64_t pkt_pts = av_rescale_q(pkt->pts, ist->st->time_base, AV_TIME_BASE_Q);
                 delta   = pkt_pts - ist->next_dts;
                 if ( delta < -1LL*dts_error_threshold*AV_TIME_BASE ||
                      delta >  1LL*dts_error_threshold*AV_TIME_BASE) {
-                    av_log(NULL, AV_LOG_WARNING, "PTS %"PRId64", next:%"PRId64" invalid dropping st:%d\n", pkt.pts, ist->next_dts, pkt.stream_index);
-                    pkt.pts = AV_NOPTS_VALUE;
+                    av_log(NULL, AV_LOG_WARNING, "PTS %"PRId64", next:%"PRId64" invalid dropping st:%d\n", pkt->pts, ist->next_dts, pkt->stream_index);
+                    pkt->pts = AV_NOPTS_VALUE;
                 }
             }
         }
     }
 
-    if (pkt.dts != AV_NOPTS_VALUE)
-        ifile->last_ts = av_rescale_q(pkt.dts, ist->st->time_base, AV_TIME_BASE_Q);
+    if (pkt->dts != AV_NOPTS_VALUE)
+        ifile->last_ts = av_rescale_q(pkt->dts, ist->st->time_base, AV_TIME_BASE_Q);
 
     if (debug_ts) {
         av_log(NULL, AV_LOG_INFO, "demuxer+ffmpeg -> ist_index:%d type:%s pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s off:%s off_time:%s\n",
-               ifile->ist_index + pkt.stream_index, av_get_media_type_string(ist->dec_ctx->codec_type),
-               av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ist->st->time_base),
-               av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ist->st->time_base),
+               ifile->ist_index + pkt->stream_index, av_get_media_type_string(ist->dec_ctx->codec_type),
+               av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &ist->st->time_base),
+               av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &ist->st->time_base),
                av_ts2str(input_files[ist->file_index]->ts_offset),
                av_ts2timestr(input_files[ist->file_index]->ts_offset, &AV_TIME_BASE_Q));
     }
 
-    sub2video_heartbeat(ist, pkt.pts);
+    sub2video_heartbeat(ist, pkt->pts);
 
-    process_input_packet(ist, &pkt, 0);
+    process_input_packet(ist, pkt, 0);
 
 discard_packet:
-    av_packet_unref(&pkt);
+    av_packet_pool_release(&pkt);
 
     return 0;
 }
@@ -24,6 +24,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <signal.h>
+#include <stdatomic.h>
 
 #if HAVE_PTHREADS
 #include <pthread.h>
@@ -419,6 +420,8 @@ typedef struct InputFile {
     int rate_emu;
     int accurate_seek;
 
+    AVPacketPool *pkt_pool;     /* packets read from this file */
+
 #if HAVE_PTHREADS
     AVThreadMessageQueue *in_thread_queue;
     pthread_t thread;           /* thread reading from this file */
@@ -558,6 +561,13 @@ typedef struct OutputStream {
 
     /* frame encode sum of squared error values */
     int64_t error[4];
+
+#if HAVE_PTHREADS
+    AVThreadMessageQueue *enc_frame_queue; /* frames sent to the encoder thread */
+    AVThreadMessageQueue *enc_pkt_queue;   /* packets returned by the encoder thread */
+    pthread_t enc_thread;                  /* thread running the encoder, with -threaded_encoding */
+    atomic_int enc_waiting;                /* main thread is waiting for room in enc_frame_queue */
+#endif
 } OutputStream;
 
 typedef struct OutputFile {
@@ -586,6 +596,9 @@ extern int         nb_output_files;
 extern FilterGraph **filtergraphs;
 extern int        nb_filtergraphs;
 
+/* frames queued by ffmpeg itself, e.g. for the filters or encoder threads */
+extern AVFramePool *frame_pool;
+
 extern char *vstats_filename;
 extern char *sdp_filename;
 
@@ -618,6 +631,8 @@ extern char *videotoolbox_pixfmt;
 
 extern int filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern char *filter_thread_type;
+extern int threaded_encoding;
 extern int vstats_version;
 
 extern const AVIOInterruptCB int_cb;
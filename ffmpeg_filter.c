@@ -1043,6 +1043,13 @@ int configure_filtergraph(FilterGraph *fg)
         fg->graph->nb_threads = filter_complex_nbthreads;
     }
 
+    if (filter_thread_type &&
+        (ret = av_opt_set(fg->graph, "thread_type", filter_thread_type, 0)) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Invalid filter thread type '%s'\n",
+               filter_thread_type);
+        goto fail;
+    }
+
     if ((ret = avfilter_graph_parse2(fg->graph, graph_desc, &inputs, &outputs)) < 0)
         goto fail;
 
@@ -1137,7 +1144,7 @@ int configure_filtergraph(FilterGraph *fg)
             AVFrame *tmp;
             av_fifo_generic_read(fg->inputs[i]->frame_queue, &tmp, sizeof(tmp), NULL);
             ret = av_buffersrc_add_frame(fg->inputs[i]->filter, tmp);
-            av_frame_free(&tmp);
+            av_frame_pool_release(&tmp);
             if (ret < 0)
                 goto fail;
         }
@@ -133,6 +133,8 @@ int frame_bits_per_raw_sample = 0;
 float max_error_rate  = 2.0/3;
 int filter_nbthreads = 0;
 int filter_complex_nbthreads = 0;
+char *filter_thread_type = NULL;
+int threaded_encoding = 0;
 int vstats_version = 2;
 
 
@@ -1132,6 +1134,9 @@ static int open_input_file(OptionsContext *o, const char *filename)
     f->loop = o->loop;
     f->duration = 0;
     f->time_base = (AVRational){ 1, 1 };
+    f->pkt_pool = av_packet_pool_alloc();
+    if (!f->pkt_pool)
+        exit_program(1);
 #if HAVE_PTHREADS
     f->thread_queue_size = o->thread_queue_size > 0 ? o->thread_queue_size : 8;
 #endif
@@ -3494,6 +3499,10 @@ const OptionDef options[] = {
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_threads", HAS_ARG | OPT_INT,                   { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "filter_thread_type", HAS_ARG | OPT_STRING | OPT_EXPERT,       { &filter_thread_type },
+        "set the thread types allowed in filtergraphs (slice, graph)", "flags" },
+    { "threaded_encoding", OPT_BOOL | OPT_EXPERT,                   { &threaded_encoding },
+        "run each audio/video encoder and the demuxers in their own threads" },
     { "lavfi",          HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
@@ -506,6 +506,118 @@ static void copy_input_samples(AACEncContext *s, const AVFrame *frame)
     }
 }
 
+/**
+ * Search the coding parameters of one channel element, after the psy
+ * model has analyzed it. Without threads, the element is searched in the
+ * encoder context right after its analysis. With slice threading the
+ * elements are searched in parallel, each in a scratch copy of the encoder
+ * context. Either way, the PNS noise state and the psy cutoff an element
+ * uses are only those it left in the previous frame, so the output does not
+ * depend on the number of threads.
+ */
+static int search_element(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    AACEncContext *s = avctx->priv_data;
+    AACEncContext *t = s->nb_thread_ctx ? s->thread_ctx[threadnr] : s;
+    AACEncElement *el = &s->elem[jobnr];
+    FFPsyWindowInfo *wi = (FFPsyWindowInfo *)arg + el->start_ch;
+    ChannelElement *cpe = &s->cpe[jobnr];
+    SingleChannelElement *sce;
+    int tag   = s->chan_map[jobnr + 1];
+    int chans = tag == TYPE_CPE ? 2 : 1;
+    int ch, w;
+
+    if (t != s) {
+        t->lambda = s->lambda;
+        t->psy    = s->psy;
+    }
+    t->psy.cutoff       = el->cutoff;
+    t->psy.bitres.alloc = el->alloc;
+    t->random_state     = el->random_state;
+    t->cur_type         = tag;
+    el->is_mode = el->tns_mode = el->pred_mode = 0;
+
+    for (ch = 0; ch < chans; ch++) {
+        t->cur_channel = el->start_ch + ch;
+        if (t->options.pns && t->coder->mark_pns)
+            t->coder->mark_pns(t, avctx, &cpe->ch[ch]);
+        t->coder->search_for_quantizers(avctx, t, &cpe->ch[ch], t->lambda);
+    }
+    if (chans > 1
+        && wi[0].window_type[0] == wi[1].window_type[0]
+        && wi[0].window_shape   == wi[1].window_shape) {
+
+        cpe->common_window = 1;
+        for (w = 0; w < wi[0].num_windows; w++) {
+            if (wi[0].grouping[w] != wi[1].grouping[w]) {
+                cpe->common_window = 0;
+                break;
+            }
+        }
+    }
+    for (ch = 0; ch < chans; ch++) { /* TNS and PNS */
+        sce = &cpe->ch[ch];
+        t->cur_channel = el->start_ch + ch;
+        if (t->options.tns && t->coder->search_for_tns)
+            t->coder->search_for_tns(t, sce);
+        if (t->options.tns && t->coder->apply_tns_filt)
+            t->coder->apply_tns_filt(t, sce);
+        if (sce->tns.present)
+            el->tns_mode = 1;
+        if (t->options.pns && t->coder->search_for_pns)
+            t->coder->search_for_pns(t, avctx, sce);
+    }
+    t->cur_channel = el->start_ch;
+    if (t->options.intensity_stereo) { /* Intensity Stereo */
+        if (t->coder->search_for_is)
+            t->coder->search_for_is(t, avctx, cpe);
+        if (cpe->is_mode) el->is_mode = 1;
+        apply_intensity_stereo(cpe);
+    }
+    if (t->options.pred) { /* Prediction */
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            t->cur_channel = el->start_ch + ch;
+            if (t->options.pred && t->coder->search_for_pred)
+                t->coder->search_for_pred(t, sce);
+            if (cpe->ch[ch].ics.predictor_present) el->pred_mode = 1;
+        }
+        if (t->coder->adjust_common_pred)
+            t->coder->adjust_common_pred(t, cpe);
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            t->cur_channel = el->start_ch + ch;
+            if (t->options.pred && t->coder->apply_main_pred)
+                t->coder->apply_main_pred(t, sce);
+        }
+        t->cur_channel = el->start_ch;
+    }
+    if (t->options.mid_side) { /* Mid/Side stereo */
+        if (t->options.mid_side == -1 && t->coder->search_for_ms)
+            t->coder->search_for_ms(t, cpe);
+        else if (cpe->common_window)
+            memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
+        apply_mid_side_stereo(cpe);
+    }
+    adjust_frame_information(cpe, chans);
+    if (t->options.ltp) { /* LTP */
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            t->cur_channel = el->start_ch + ch;
+            if (t->coder->search_for_ltp)
+                t->coder->search_for_ltp(t, sce, cpe->common_window);
+            if (sce->ics.ltp.present) el->pred_mode = 1;
+        }
+        t->cur_channel = el->start_ch;
+        if (t->coder->adjust_common_ltp)
+            t->coder->adjust_common_ltp(t, cpe);
+    }
+
+    el->random_state = t->random_state;
+    el->cutoff       = t->psy.cutoff;
+    return 0;
+}
+
 static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                             const AVFrame *frame, int *got_packet_ptr)
 {
@@ -641,7 +753,6 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             put_bitstream_info(s, LIBAVCODEC_IDENT);
         start_ch = 0;
         target_bits = 0;
-        memset(chan_el_counter, 0, sizeof(chan_el_counter));
         for (i = 0; i < s->chan_map[0]; i++) {
             FFPsyWindowInfo* wi = windows + start_ch;
             const float *coeffs[2];
@@ -651,8 +762,6 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             cpe->common_window = 0;
             memset(cpe->is_mask, 0, sizeof(cpe->is_mask));
             memset(cpe->ms_mask, 0, sizeof(cpe->ms_mask));
-            put_bits(&s->pb, 3, tag);
-            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             for (ch = 0; ch < chans; ch++) {
                 sce = &cpe->ch[ch];
                 coeffs[ch] = sce->coeffs;
@@ -667,6 +776,7 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             }
             s->psy.bitres.alloc = -1;
             s->psy.bitres.bits = s->last_frame_pb_count / s->channels;
+            s->psy.cutoff = s->elem[i].cutoff;
             s->psy.model->analyze(&s->psy, start_ch, coeffs, wi);
             if (s->psy.bitres.alloc > 0) {
                 /* Lambda unused here on purpose, we need to take psy's unscaled allocation */
@@ -674,82 +784,27 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                     * (s->lambda / (avctx->global_quality ? avctx->global_quality : 120));
                 s->psy.bitres.alloc /= chans;
             }
-            s->cur_type = tag;
-            for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
-                if (s->options.pns && s->coder->mark_pns)
-                    s->coder->mark_pns(s, avctx, &cpe->ch[ch]);
-                s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
-            }
-            if (chans > 1
-                && wi[0].window_type[0] == wi[1].window_type[0]
-                && wi[0].window_shape   == wi[1].window_shape) {
-
-                cpe->common_window = 1;
-                for (w = 0; w < wi[0].num_windows; w++) {
-                    if (wi[0].grouping[w] != wi[1].grouping[w]) {
-                        cpe->common_window = 0;
-                        break;
-                    }
-                }
-            }
-            for (ch = 0; ch < chans; ch++) { /* TNS and PNS */
-                sce = &cpe->ch[ch];
-                s->cur_channel = start_ch + ch;
-                if (s->options.tns && s->coder->search_for_tns)
-                    s->coder->search_for_tns(s, sce);
-                if (s->options.tns && s->coder->apply_tns_filt)
-                    s->coder->apply_tns_filt(s, sce);
-                if (sce->tns.present)
-                    tns_mode = 1;
-                if (s->options.pns && s->coder->search_for_pns)
-                    s->coder->search_for_pns(s, avctx, sce);
-            }
-            s->cur_channel = start_ch;
-            if (s->options.intensity_stereo) { /* Intensity Stereo */
-                if (s->coder->search_for_is)
-                    s->coder->search_for_is(s, avctx, cpe);
-                if (cpe->is_mode) is_mode = 1;
-                apply_intensity_stereo(cpe);
-            }
-            if (s->options.pred) { /* Prediction */
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->options.pred && s->coder->search_for_pred)
-                        s->coder->search_for_pred(s, sce);
-                    if (cpe->ch[ch].ics.predictor_present) pred_mode = 1;
-                }
-                if (s->coder->adjust_common_pred)
-                    s->coder->adjust_common_pred(s, cpe);
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->options.pred && s->coder->apply_main_pred)
-                        s->coder->apply_main_pred(s, sce);
-                }
-                s->cur_channel = start_ch;
-            }
-            if (s->options.mid_side) { /* Mid/Side stereo */
-                if (s->options.mid_side == -1 && s->coder->search_for_ms)
-                    s->coder->search_for_ms(s, cpe);
-                else if (cpe->common_window)
-                    memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
-                apply_mid_side_stereo(cpe);
-            }
-            adjust_frame_information(cpe, chans);
-            if (s->options.ltp) { /* LTP */
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->coder->search_for_ltp)
-                        s->coder->search_for_ltp(s, sce, cpe->common_window);
-                    if (sce->ics.ltp.present) pred_mode = 1;
-                }
-                s->cur_channel = start_ch;
-                if (s->coder->adjust_common_ltp)
-                    s->coder->adjust_common_ltp(s, cpe);
-            }
+            s->elem[i].start_ch = start_ch;
+            s->elem[i].alloc    = s->psy.bitres.alloc;
+            if (!s->nb_thread_ctx)
+                search_element(avctx, windows, i, 0);
+            start_ch += chans;
+        }
+
+        if (s->nb_thread_ctx)
+            avctx->execute2(avctx, search_element, windows, NULL, s->chan_map[0]);
+
+        start_ch = 0;
+        memset(chan_el_counter, 0, sizeof(chan_el_counter));
+        for (i = 0; i < s->chan_map[0]; i++) {
+            tag      = s->chan_map[i+1];
+            chans    = tag == TYPE_CPE ? 2 : 1;
+            cpe      = &s->cpe[i];
+            is_mode   |= s->elem[i].is_mode;
+            tns_mode  |= s->elem[i].tns_mode;
+            pred_mode |= s->elem[i].pred_mode;
+            put_bits(&s->pb, 3, tag);
+            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             if (chans == 2) {
                 put_bits(&s->pb, 1, cpe->common_window);
                 if (cpe->common_window) {
@@ -852,9 +907,15 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 static av_cold int aac_encode_end(AVCodecContext *avctx)
 {
     AACEncContext *s = avctx->priv_data;
+    int i;
 
     av_log(avctx, AV_LOG_INFO, "Qavg: %.3f\n", s->lambda_sum / s->lambda_count);
 
+    for (i = 0; i < s->nb_thread_ctx; i++) {
+        ff_lpc_end(&s->thread_ctx[i]->lpc);
+        av_freep(&s->thread_ctx[i]);
+    }
+    av_freep(&s->thread_ctx);
     ff_mdct_end(&s->mdct1024);
     ff_mdct_end(&s->mdct128);
     ff_psy_end(&s->psy);
@@ -863,6 +924,7 @@ static av_cold int aac_encode_end(AVCodecContext *avctx)
         ff_psy_preprocess_end(s->psypp);
     av_freep(&s->buffer.samples);
     av_freep(&s->cpe);
+    av_freep(&s->elem);
     av_freep(&s->fdsp);
     ff_af_queue_close(&s->afq);
     return 0;
@@ -895,6 +957,7 @@ static av_cold int alloc_buffers(AVCodecContext *avctx, AACEncContext *s)
     int ch;
     FF_ALLOCZ_ARRAY_OR_GOTO(avctx, s->buffer.samples, s->channels, 3 * 1024 * sizeof(s->buffer.samples[0]), alloc_fail);
     FF_ALLOCZ_ARRAY_OR_GOTO(avctx, s->cpe, s->chan_map[0], sizeof(ChannelElement), alloc_fail);
+    FF_ALLOCZ_ARRAY_OR_GOTO(avctx, s->elem, s->chan_map[0], sizeof(AACEncElement), alloc_fail);
     FF_ALLOCZ_OR_GOTO(avctx, avctx->extradata, 5 + AV_INPUT_BUFFER_PADDING_SIZE, alloc_fail);
 
     for(ch = 0; ch < s->channels; ch++)
@@ -1029,6 +1092,10 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
     s->psypp = ff_psy_preprocess_init(avctx);
     ff_lpc_init(&s->lpc, 2*avctx->frame_size, TNS_MAX_ORDER, FF_LPC_TYPE_LEVINSON);
     s->random_state = 0x1f2e3d4c;
+    for (i = 0; i < s->chan_map[0]; i++) {
+        s->elem[i].random_state = s->random_state + i;
+        s->elem[i].cutoff       = s->psy.cutoff;
+    }
 
     s->abs_pow34   = abs_pow34_v;
     s->quant_bands = quantize_bands;
@@ -1042,6 +1109,29 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
     if ((ret = ff_thread_once(&aac_table_init, &aac_encode_init_tables)) != 0)
         return AVERROR_UNKNOWN;
 
+    if (avctx->active_thread_type & FF_THREAD_SLICE && avctx->thread_count > 1 &&
+        s->chan_map[0] > 1) {
+        s->thread_ctx = av_mallocz_array(avctx->thread_count, sizeof(*s->thread_ctx));
+        if (!s->thread_ctx) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        for (i = 0; i < avctx->thread_count; i++) {
+            AACEncContext *t = av_malloc(sizeof(*t));
+            if (!t) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+            *t = *s;
+            t->thread_ctx    = NULL;
+            t->nb_thread_ctx = 0;
+            s->thread_ctx[s->nb_thread_ctx++] = t;
+            if ((ret = ff_lpc_init(&t->lpc, 2*avctx->frame_size, TNS_MAX_ORDER,
+                                   FF_LPC_TYPE_LEVINSON)) < 0)
+                goto fail;
+        }
+    }
+
     ff_af_queue_init(avctx, &s->afq);
 
     return 0;
@@ -1089,7 +1179,8 @@ AVCodec ff_aac_encoder = {
     .defaults       = aac_encode_defaults,
     .supported_samplerates = mpeg4audio_sample_rates,
     .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE,
-    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY,
+    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .sample_fmts    = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_FLTP,
                                                      AV_SAMPLE_FMT_NONE },
     .priv_class     = &aacenc_class,
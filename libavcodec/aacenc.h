@@ -89,6 +89,20 @@ typedef struct AACQuantizeBandCostCacheEntry {
     uint16_t generation;
 } AACQuantizeBandCostCacheEntry;
 
+/**
+ * Per channel element state of the coefficient search. With slice threading
+ * the elements of a frame are searched independently, in parallel, so
+ * nothing that one element changes may be seen by another before the search
+ * ends.
+ */
+typedef struct AACEncElement {
+    int start_ch;                                ///< index of the first channel of the element
+    int alloc;                                   ///< psy bit allocation per channel, -1 if none
+    int random_state;                            ///< PNS noise generator state of the element
+    int cutoff;                                  ///< psy cutoff left by the last search of the element
+    int is_mode, tns_mode, pred_mode;            ///< coding tools used by the element
+} AACEncElement;
+
 /**
  * AAC encoder context
  */
@@ -108,6 +122,7 @@ typedef struct AACEncContext {
     const uint8_t *chan_map;                     ///< channel configuration map
 
     ChannelElement *cpe;                         ///< channel elements
+    AACEncElement *elem;                         ///< coefficient search state of the channel elements
     FFPsyContext psy;
     struct FFPsyPreprocessContext* psypp;
     AACCoefficientsEncoder *coder;
@@ -134,6 +149,9 @@ typedef struct AACEncContext {
     struct {
         float *samples;
     } buffer;
+
+    struct AACEncContext **thread_ctx;           ///< scratch contexts for slice threaded coefficient search
+    int nb_thread_ctx;
 } AACEncContext;
 
 void ff_aac_dsp_init_x86(AACEncContext *s);
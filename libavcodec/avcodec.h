@@ -4536,6 +4536,55 @@ AVPacket *av_packet_clone(const AVPacket *src);
  */
 void av_packet_free(AVPacket **pkt);
 
+/**
+ * A pool of AVPacket structs. Packets taken from the pool are recycled when
+ * released, together with the AVBufferRef struct and the side data array
+ * attached to them, so that a steady stream of packets going through the
+ * pool does not allocate them again.
+ *
+ * A pool may be used from several threads at once, and packets may be
+ * released from a different thread than the one that got them.
+ */
+typedef struct AVPacketPool AVPacketPool;
+
+/**
+ * Allocate a new packet pool.
+ *
+ * @return the new pool or NULL on failure
+ */
+AVPacketPool *av_packet_pool_alloc(void);
+
+/**
+ * Free the pool and set *pool to NULL. Packets still taken from the pool stay
+ * valid; the pool is freed once they have all been released.
+ */
+void av_packet_pool_free(AVPacketPool **pool);
+
+/**
+ * Get a packet from the pool, set to default values like a packet returned
+ * by av_packet_alloc().
+ *
+ * The packet can be used like any other packet, but must be released with
+ * av_packet_pool_release() instead of av_packet_free().
+ *
+ * @return a packet or NULL on failure
+ */
+AVPacket *av_packet_pool_get(AVPacketPool *pool);
+
+/**
+ * Get a packet from the pool that references the same data as src, like
+ * av_packet_clone().
+ *
+ * @return a packet or NULL on failure
+ */
+AVPacket *av_packet_pool_clone(AVPacketPool *pool, const AVPacket *src);
+
+/**
+ * Unreference a packet obtained from av_packet_pool_get() or
+ * av_packet_pool_clone() and return it to its pool. *pkt is set to NULL.
+ */
+void av_packet_pool_release(AVPacket **pkt);
+
 /**
  * Initialize optional fields of a packet with default values.
  *
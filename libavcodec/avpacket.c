@@ -26,10 +26,41 @@
 #include "libavutil/internal.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/mem.h"
+#include "libavutil/thread.h"
 #include "avcodec.h"
 #include "bytestream.h"
 #include "internal.h"
 
+typedef struct PacketPoolEntry {
+    /* must be the first field, packets returned to the caller point to it */
+    AVPacket pkt;
+
+    AVPacketPool *pool;
+    struct PacketPoolEntry *next;
+
+    /* AVBufferRef struct kept from an earlier use of the packet */
+    AVBufferRef *spare_ref;
+
+    /*
+     * Side data array kept from earlier uses of the packet and the number of
+     * elements allocated in it. side_data_array is NULL while the array is
+     * owned by the packet.
+     */
+    AVPacketSideData *side_data_array;
+    int               side_data_array_size;
+} PacketPoolEntry;
+
+struct AVPacketPool {
+    AVMutex mutex;
+    PacketPoolEntry *entries;
+
+    /*
+     * One reference for the caller and one per packet currently handed out,
+     * the pool is freed when it drops to zero.
+     */
+    int refcount;
+};
+
 void av_init_packet(AVPacket *pkt)
 {
     pkt->pts                  = AV_NOPTS_VALUE;
@@ -267,15 +298,26 @@ int av_copy_packet(AVPacket *dst, const AVPacket *src)
     return copy_packet_data(dst, src, 0);
 }
 
-void av_packet_free_side_data(AVPacket *pkt)
+static void packet_free_side_data(PacketPoolEntry *e, AVPacket *pkt)
 {
     int i;
     for (i = 0; i < pkt->side_data_elems; i++)
         av_freep(&pkt->side_data[i].data);
+    if (e && pkt->side_data && !e->side_data_array) {
+        /* the array holds at least as many elements as were in use */
+        e->side_data_array      = pkt->side_data;
+        e->side_data_array_size = pkt->side_data_elems;
+        pkt->side_data          = NULL;
+    }
     av_freep(&pkt->side_data);
     pkt->side_data_elems = 0;
 }
 
+void av_packet_free_side_data(AVPacket *pkt)
+{
+    packet_free_side_data(NULL, pkt);
+}
+
 #if FF_API_AVPACKET_OLD_API
 FF_DISABLE_DEPRECATION_WARNINGS
 void av_free_packet(AVPacket *pkt)
@@ -582,7 +624,7 @@ int av_packet_shrink_side_data(AVPacket *pkt, enum AVPacketSideDataType type,
     return AVERROR(ENOENT);
 }
 
-int av_packet_copy_props(AVPacket *dst, const AVPacket *src)
+static int packet_copy_props(PacketPoolEntry *e, AVPacket *dst, const AVPacket *src)
 {
     int i;
 
@@ -598,14 +640,41 @@ FF_ENABLE_DEPRECATION_WARNINGS
     dst->flags                = src->flags;
     dst->stream_index         = src->stream_index;
 
+    if (e && src->side_data_elems && !dst->side_data) {
+        /* hand the side data array kept by the entry over to the packet */
+        if (!e->side_data_array || e->side_data_array_size < src->side_data_elems) {
+            AVPacketSideData *tmp = av_realloc_array(e->side_data_array,
+                                                     src->side_data_elems,
+                                                     sizeof(*tmp));
+            if (!tmp)
+                return AVERROR(ENOMEM);
+            e->side_data_array      = tmp;
+            e->side_data_array_size = src->side_data_elems;
+        }
+        dst->side_data     = e->side_data_array;
+        e->side_data_array = NULL;
+    }
+
     for (i = 0; i < src->side_data_elems; i++) {
          enum AVPacketSideDataType type = src->side_data[i].type;
          int size          = src->side_data[i].size;
          uint8_t *src_data = src->side_data[i].data;
-         uint8_t *dst_data = av_packet_new_side_data(dst, type, size);
+         uint8_t *dst_data;
+
+        if (e && dst->side_data_elems < e->side_data_array_size) {
+            /* the array was sized above, only allocate the payload */
+            dst_data = av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
+            if (dst_data) {
+                dst->side_data[dst->side_data_elems].data = dst_data;
+                dst->side_data[dst->side_data_elems].size = size;
+                dst->side_data[dst->side_data_elems].type = type;
+                dst->side_data_elems++;
+            }
+        } else
+            dst_data = av_packet_new_side_data(dst, type, size);
 
         if (!dst_data) {
-            av_packet_free_side_data(dst);
+            packet_free_side_data(e, dst);
             return AVERROR(ENOMEM);
         }
         memcpy(dst_data, src_data, size);
@@ -614,20 +683,35 @@ FF_ENABLE_DEPRECATION_WARNINGS
     return 0;
 }
 
-void av_packet_unref(AVPacket *pkt)
+int av_packet_copy_props(AVPacket *dst, const AVPacket *src)
 {
-    av_packet_free_side_data(pkt);
+    return packet_copy_props(NULL, dst, src);
+}
+
+static void packet_unref(PacketPoolEntry *e, AVPacket *pkt)
+{
+    packet_free_side_data(e, pkt);
+    if (e && pkt->buf && !e->spare_ref) {
+        avpriv_buffer_unref_keep(pkt->buf);
+        e->spare_ref = pkt->buf;
+        pkt->buf     = NULL;
+    }
     av_buffer_unref(&pkt->buf);
     av_init_packet(pkt);
     pkt->data = NULL;
     pkt->size = 0;
 }
 
-int av_packet_ref(AVPacket *dst, const AVPacket *src)
+void av_packet_unref(AVPacket *pkt)
+{
+    packet_unref(NULL, pkt);
+}
+
+static int packet_ref(PacketPoolEntry *e, AVPacket *dst, const AVPacket *src)
 {
     int ret;
 
-    ret = av_packet_copy_props(dst, src);
+    ret = packet_copy_props(e, dst, src);
     if (ret < 0)
         return ret;
 
@@ -639,6 +723,11 @@ int av_packet_ref(AVPacket *dst, const AVPacket *src)
             memcpy(dst->buf->data, src->data, src->size);
 
         dst->data = dst->buf->data;
+    } else if (e && e->spare_ref) {
+        avpriv_buffer_ref_into(e->spare_ref, src->buf);
+        dst->buf     = e->spare_ref;
+        e->spare_ref = NULL;
+        dst->data    = src->data;
     } else {
         dst->buf = av_buffer_ref(src->buf);
         if (!dst->buf) {
@@ -652,10 +741,15 @@ int av_packet_ref(AVPacket *dst, const AVPacket *src)
 
     return 0;
 fail:
-    av_packet_free_side_data(dst);
+    packet_free_side_data(e, dst);
     return ret;
 }
 
+int av_packet_ref(AVPacket *dst, const AVPacket *src)
+{
+    return packet_ref(NULL, dst, src);
+}
+
 AVPacket *av_packet_clone(const AVPacket *src)
 {
     AVPacket *ret = av_packet_alloc();
@@ -669,6 +763,107 @@ AVPacket *av_packet_clone(const AVPacket *src)
     return ret;
 }
 
+AVPacketPool *av_packet_pool_alloc(void)
+{
+    AVPacketPool *pool = av_mallocz(sizeof(*pool));
+    if (!pool)
+        return NULL;
+
+    ff_mutex_init(&pool->mutex, NULL);
+    pool->refcount = 1;
+
+    return pool;
+}
+
+/* drop one reference to the pool, pushing e to its free list if set */
+static void packet_pool_unref(AVPacketPool *pool, PacketPoolEntry *e)
+{
+    int refcount;
+
+    ff_mutex_lock(&pool->mutex);
+    if (e) {
+        e->next       = pool->entries;
+        pool->entries = e;
+    }
+    refcount = --pool->refcount;
+    ff_mutex_unlock(&pool->mutex);
+
+    if (refcount)
+        return;
+
+    while (pool->entries) {
+        e             = pool->entries;
+        pool->entries = e->next;
+        av_freep(&e->spare_ref);
+        av_freep(&e->side_data_array);
+        av_free(e);
+    }
+    ff_mutex_destroy(&pool->mutex);
+    av_free(pool);
+}
+
+void av_packet_pool_free(AVPacketPool **pool)
+{
+    if (!pool || !*pool)
+        return;
+
+    packet_pool_unref(*pool, NULL);
+    *pool = NULL;
+}
+
+AVPacket *av_packet_pool_get(AVPacketPool *pool)
+{
+    PacketPoolEntry *e;
+
+    ff_mutex_lock(&pool->mutex);
+    e = pool->entries;
+    if (e)
+        pool->entries = e->next;
+    pool->refcount++;
+    ff_mutex_unlock(&pool->mutex);
+
+    if (!e) {
+        e = av_mallocz(sizeof(*e));
+        if (!e) {
+            packet_pool_unref(pool, NULL);
+            return NULL;
+        }
+        packet_unref(NULL, &e->pkt);
+    }
+
+    e->pool = pool;
+    e->next = NULL;
+
+    return &e->pkt;
+}
+
+AVPacket *av_packet_pool_clone(AVPacketPool *pool, const AVPacket *src)
+{
+    AVPacket *ret = av_packet_pool_get(pool);
+
+    if (!ret)
+        return NULL;
+
+    if (packet_ref((PacketPoolEntry *)ret, ret, src) < 0)
+        av_packet_pool_release(&ret);
+
+    return ret;
+}
+
+void av_packet_pool_release(AVPacket **pkt)
+{
+    PacketPoolEntry *e;
+
+    if (!pkt || !*pkt)
+        return;
+
+    e = (PacketPoolEntry *)*pkt;
+    packet_unref(e, &e->pkt);
+    *pkt = NULL;
+
+    packet_pool_unref(e->pool, e);
+}
+
 void av_packet_move_ref(AVPacket *dst, AVPacket *src)
 {
     *dst = *src;
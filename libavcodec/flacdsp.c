@@ -85,6 +85,19 @@ static void flac_lpc_32_c(int32_t *decoded, const int coeffs[32],
 
 }
 
+static void flac_rice_sums_c(uint64_t *sums, const uint32_t *udata, int psize,
+                             int parts, int k)
+{
+    int i, j;
+
+    for (i = 0; i < parts; i++) {
+        uint64_t sum = 0;
+        for (j = 0; j < psize; j++)
+            sum += *udata++ >> k;
+        sums[i] = sum;
+    }
+}
+
 av_cold void ff_flacdsp_init(FLACDSPContext *c, enum AVSampleFormat fmt, int channels,
                              int bps)
 {
@@ -92,6 +105,7 @@ av_cold void ff_flacdsp_init(FLACDSPContext *c, enum AVSampleFormat fmt, int cha
     c->lpc32        = flac_lpc_32_c;
     c->lpc16_encode = flac_lpc_encode_c_16;
     c->lpc32_encode = flac_lpc_encode_c_32;
+    c->rice_sums    = flac_rice_sums_c;
 
     switch (fmt) {
     case AV_SAMPLE_FMT_S32:
@@ -34,6 +34,12 @@ typedef struct FLACDSPContext {
                          const int32_t coefs[32], int shift);
     void (*lpc32_encode)(int32_t *res, const int32_t *smp, int len, int order,
                          const int32_t coefs[32], int shift);
+    /**
+     * Sum the residuals shifted right by k of each of parts consecutive
+     * partitions of psize samples.
+     */
+    void (*rice_sums)(uint64_t *sums, const uint32_t *udata, int psize,
+                      int parts, int k);
 } FLACDSPContext;
 
 void ff_flacdsp_init(FLACDSPContext *c, enum AVSampleFormat fmt, int channels, int bps);
@@ -126,6 +126,23 @@ typedef struct FlacEncodeContext {
 
     int flushed;
     int64_t next_pts;
+
+    /* frame-parallel encoding: each queued frame is encoded in its own copy
+     * of the context, the stream state is only updated in the main context */
+    int frame_batch;
+    struct FlacEncodeContext **thread_ctx;
+    int nb_thread_ctx;
+    int nb_queued;               ///< frames waiting to be encoded
+    int nb_pending;              ///< encoded frames not returned yet
+    int next_pending;
+
+    /* per-frame state of the thread contexts */
+    int64_t job_pts;
+    int job_samples;
+    uint8_t *job_buf;
+    unsigned int job_buf_size;
+    int job_bytes;
+    int job_ret;
 } FlacEncodeContext;
 
 
@@ -456,6 +473,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
     ret = ff_lpc_init(&s->lpc_ctx, avctx->frame_size,
                       s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+    if (ret < 0)
+        return ret;
 
     ff_bswapdsp_init(&s->bdsp);
     ff_flacdsp_init(&s->flac_dsp, avctx->sample_fmt, channels,
@@ -463,7 +482,33 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
     dprint_compression_options(s);
 
-    return ret;
+    if (s->frame_batch && avctx->active_thread_type & FF_THREAD_SLICE &&
+        avctx->thread_count > 1) {
+        s->thread_ctx = av_mallocz_array(avctx->thread_count, sizeof(*s->thread_ctx));
+        if (!s->thread_ctx)
+            return AVERROR(ENOMEM);
+        for (i = 0; i < avctx->thread_count; i++) {
+            FlacEncodeContext *t = av_malloc(sizeof(*t));
+            if (!t)
+                return AVERROR(ENOMEM);
+            *t = *s;
+            t->thread_ctx    = NULL;
+            t->nb_thread_ctx = 0;
+            t->md5ctx        = NULL;
+            t->md5_buffer    = NULL;
+            t->job_buf       = NULL;
+            t->job_buf_size  = 0;
+            memset(&t->lpc_ctx, 0, sizeof(t->lpc_ctx));
+            s->thread_ctx[s->nb_thread_ctx++] = t;
+
+            ret = ff_lpc_init(&t->lpc_ctx, avctx->frame_size,
+                              s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    return 0;
 }
 
 
@@ -662,32 +707,24 @@ static uint64_t calc_optimal_rice_params(RiceContext *rc, int porder,
 }
 
 
-static void calc_sum_top(int pmax, int kmax, const uint32_t *data, int n, int pred_order,
+/**
+ * Compute the sums for the highest partition order.
+ * The first pred_order entries of data must be zero.
+ */
+static void calc_sum_top(FLACDSPContext *dsp, int pmax, int kmax,
+                         const uint32_t *data, int n, int pred_order,
                          uint64_t sums[32][MAX_PARTITIONS])
 {
     int i, k;
-    int parts;
-    const uint32_t *res, *res_end;
-
-    /* sums for highest level */
-    parts   = (1 << pmax);
+    int parts = 1 << pmax;
+    int psize = n >> pmax;
 
     for (k = 0; k <= kmax; k++) {
-        res     = &data[pred_order];
-        res_end = &data[n >> pmax];
-        for (i = 0; i < parts; i++) {
-            if (kmax) {
-                uint64_t sum = (1LL + k) * (res_end - res);
-                while (res < res_end)
-                    sum += *(res++) >> k;
-                sums[k][i] = sum;
-            } else {
-                uint64_t sum = 0;
-                while (res < res_end)
-                    sum += *(res++);
-                sums[k][i] = sum;
-            }
-            res_end += n >> pmax;
+        dsp->rice_sums(sums[k], data, psize, parts, k);
+        if (kmax) {
+            sums[k][0] += (1LL + k) * (psize - pred_order);
+            for (i = 1; i < parts; i++)
+                sums[k][i] += (1LL + k) * psize;
         }
     }
 }
@@ -702,7 +739,7 @@ static void calc_sum_next(int level, uint64_t sums[32][MAX_PARTITIONS], int kmax
     }
 }
 
-static uint64_t calc_rice_params(RiceContext *rc,
+static uint64_t calc_rice_params(FLACDSPContext *dsp, RiceContext *rc,
                                  uint32_t udata[FLAC_MAX_BLOCKSIZE],
                                  uint64_t sums[32][MAX_PARTITIONS],
                                  int pmin, int pmax,
@@ -720,10 +757,11 @@ static uint64_t calc_rice_params(RiceContext *rc,
 
     tmp_rc.coding_mode = rc->coding_mode;
 
-    for (i = 0; i < n; i++)
+    memset(udata, 0, pred_order * sizeof(*udata));
+    for (i = pred_order; i < n; i++)
         udata[i] = (2 * data[i]) ^ (data[i] >> 31);
 
-    calc_sum_top(pmax, exact ? kmax : 0, udata, n, pred_order, sums);
+    calc_sum_top(dsp, pmax, exact ? kmax : 0, udata, n, pred_order, sums);
 
     opt_porder = pmin;
     bits[pmin] = UINT32_MAX;
@@ -762,7 +800,7 @@ static uint64_t find_subframe_rice_params(FlacEncodeContext *s,
     uint64_t bits = 8 + pred_order * sub->obits + 2 + sub->rc.coding_mode;
     if (sub->type == FLAC_SUBFRAME_LPC)
         bits += 4 + 5 + pred_order * s->options.lpc_coeff_precision;
-    bits += calc_rice_params(&sub->rc, sub->rc_udata, sub->rc_sums, pmin, pmax, sub->residual,
+    bits += calc_rice_params(&s->flac_dsp, &sub->rc, sub->rc_udata, sub->rc_sums, pmin, pmax, sub->residual,
                              s->frame.blocksize, pred_order, s->options.exact_rice_parameters);
     return bits;
 }
@@ -1310,9 +1348,9 @@ static void write_frame_footer(FlacEncodeContext *s)
 }
 
 
-static int write_frame(FlacEncodeContext *s, AVPacket *avpkt)
+static int write_frame(FlacEncodeContext *s, uint8_t *buf, int buf_size)
 {
-    init_put_bits(&s->pb, avpkt->data, avpkt->size);
+    init_put_bits(&s->pb, buf, buf_size);
     write_frame_header(s);
     write_subframes(s);
     write_frame_footer(s);
@@ -1320,10 +1358,11 @@ static int write_frame(FlacEncodeContext *s, AVPacket *avpkt)
 }
 
 
-static int update_md5_sum(FlacEncodeContext *s, const void *samples)
+static int update_md5_sum(FlacEncodeContext *s, const void *samples,
+                          int nb_samples)
 {
     const uint8_t *buf;
-    int buf_size = s->frame.blocksize * s->channels *
+    int buf_size = nb_samples * s->channels *
                    ((s->avctx->bits_per_raw_sample + 7) / 8);
 
     if (s->avctx->bits_per_raw_sample > 16 || HAVE_BIGENDIAN) {
@@ -1344,7 +1383,7 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
         const int32_t *samples0 = samples;
         uint8_t *tmp            = s->md5_buffer;
 
-        for (i = 0; i < s->frame.blocksize * s->channels; i++) {
+        for (i = 0; i < nb_samples * s->channels; i++) {
             int32_t v = samples0[i] >> 8;
             AV_WL24(tmp + 3*i, v);
         }
@@ -1356,6 +1395,128 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
 }
 
 
+/**
+ * Encode the samples loaded in s->frame.
+ * @return the size of the frame in bytes or a negative error code
+ */
+static int encode_block(FlacEncodeContext *s)
+{
+    int frame_bytes;
+
+    channel_decorrelation(s);
+
+    remove_wasted_bits(s);
+
+    frame_bytes = encode_frame(s);
+
+    /* Fall back on verbatim mode if the compressed frame is larger than it
+       would be if encoded uncompressed. */
+    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
+        s->frame.verbatim_only = 1;
+        frame_bytes = encode_frame(s);
+        if (frame_bytes < 0)
+            av_log(s->avctx, AV_LOG_ERROR, "Bad frame count\n");
+    }
+    return frame_bytes;
+}
+
+
+static void update_frame_stats(FlacEncodeContext *s, AVPacket *avpkt,
+                               int out_bytes, int64_t pts, int nb_samples)
+{
+    if (out_bytes > s->max_encoded_framesize)
+        s->max_encoded_framesize = out_bytes;
+    if (out_bytes < s->min_framesize)
+        s->min_framesize = out_bytes;
+
+    avpkt->pts      = pts;
+    avpkt->duration = ff_samples_to_time_base(s->avctx, nb_samples);
+    avpkt->size     = out_bytes;
+
+    s->next_pts = avpkt->pts + avpkt->duration;
+}
+
+
+static int encode_frame_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    FlacEncodeContext *t = s->thread_ctx[jobnr];
+    int frame_bytes;
+
+    frame_bytes = encode_block(t);
+    if (frame_bytes < 0)
+        return t->job_ret = frame_bytes;
+
+    av_fast_malloc(&t->job_buf, &t->job_buf_size, frame_bytes);
+    if (!t->job_buf)
+        return t->job_ret = AVERROR(ENOMEM);
+    t->job_bytes = write_frame(t, t->job_buf, frame_bytes);
+
+    return t->job_ret = 0;
+}
+
+
+/**
+ * Queue up to one frame per thread and encode them in parallel. The frame
+ * numbers, the MD5 sum and the frame sizes are updated in the main context
+ * in input order, so the output is the same as with a single thread.
+ */
+static int encode_frame_threaded(AVCodecContext *avctx, AVPacket *avpkt,
+                                 const AVFrame *frame, int *got_packet_ptr)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    FlacEncodeContext *t;
+    int ret;
+
+    if (frame) {
+        t = s->thread_ctx[s->nb_queued++];
+
+        /* maximum encoded frame size in verbatim mode */
+        t->max_framesize = frame->nb_samples < s->max_blocksize ?
+                           ff_flac_get_max_frame_size(frame->nb_samples,
+                                                      s->channels,
+                                                      avctx->bits_per_raw_sample) :
+                           s->max_framesize;
+        t->frame_count   = s->frame_count;
+        t->job_pts       = frame->pts;
+        t->job_samples   = frame->nb_samples;
+        init_frame(t, frame->nb_samples);
+        copy_samples(t, frame->data[0]);
+
+        s->frame_count++;
+        s->sample_count += frame->nb_samples;
+        if ((ret = update_md5_sum(s, frame->data[0], frame->nb_samples)) < 0) {
+            av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
+            return ret;
+        }
+    }
+
+    if (!s->nb_pending && s->nb_queued &&
+        (s->nb_queued == s->nb_thread_ctx || !frame)) {
+        avctx->execute2(avctx, encode_frame_job, NULL, NULL, s->nb_queued);
+        s->nb_pending   = s->nb_queued;
+        s->next_pending = 0;
+        s->nb_queued    = 0;
+    }
+
+    if (!s->nb_pending)
+        return 0;
+
+    t = s->thread_ctx[s->next_pending++];
+    s->nb_pending--;
+    if (t->job_ret < 0)
+        return t->job_ret;
+
+    if ((ret = ff_alloc_packet2(avctx, avpkt, t->job_bytes, 0)) < 0)
+        return ret;
+    memcpy(avpkt->data, t->job_buf, t->job_bytes);
+    update_frame_stats(s, avpkt, t->job_bytes, t->job_pts, t->job_samples);
+
+    *got_packet_ptr = 1;
+    return 0;
+}
+
+
 static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                              const AVFrame *frame, int *got_packet_ptr)
 {
@@ -1364,6 +1525,9 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 
     s = avctx->priv_data;
 
+    if (s->nb_thread_ctx && (frame || s->nb_queued || s->nb_pending))
+        return encode_frame_threaded(avctx, avpkt, frame, got_packet_ptr);
+
     /* when the last block is reached, update the header in extradata */
     if (!frame) {
         s->max_framesize = s->max_encoded_framesize;
@@ -1403,44 +1567,22 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
     copy_samples(s, frame->data[0]);
 
-    channel_decorrelation(s);
-
-    remove_wasted_bits(s);
-
-    frame_bytes = encode_frame(s);
-
-    /* Fall back on verbatim mode if the compressed frame is larger than it
-       would be if encoded uncompressed. */
-    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
-        s->frame.verbatim_only = 1;
-        frame_bytes = encode_frame(s);
-        if (frame_bytes < 0) {
-            av_log(avctx, AV_LOG_ERROR, "Bad frame count\n");
-            return frame_bytes;
-        }
-    }
+    frame_bytes = encode_block(s);
+    if (frame_bytes < 0)
+        return frame_bytes;
 
     if ((ret = ff_alloc_packet2(avctx, avpkt, frame_bytes, 0)) < 0)
         return ret;
 
-    out_bytes = write_frame(s, avpkt);
+    out_bytes = write_frame(s, avpkt->data, avpkt->size);
 
     s->frame_count++;
     s->sample_count += frame->nb_samples;
-    if ((ret = update_md5_sum(s, frame->data[0])) < 0) {
+    if ((ret = update_md5_sum(s, frame->data[0], frame->nb_samples)) < 0) {
         av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
         return ret;
     }
-    if (out_bytes > s->max_encoded_framesize)
-        s->max_encoded_framesize = out_bytes;
-    if (out_bytes < s->min_framesize)
-        s->min_framesize = out_bytes;
-
-    avpkt->pts      = frame->pts;
-    avpkt->duration = ff_samples_to_time_base(avctx, frame->nb_samples);
-    avpkt->size     = out_bytes;
-
-    s->next_pts = avpkt->pts + avpkt->duration;
+    update_frame_stats(s, avpkt, out_bytes, frame->pts, frame->nb_samples);
 
     *got_packet_ptr = 1;
     return 0;
@@ -1451,6 +1593,13 @@ static av_cold int flac_encode_close(AVCodecContext *avctx)
 {
     if (avctx->priv_data) {
         FlacEncodeContext *s = avctx->priv_data;
+        int i;
+        for (i = 0; i < s->nb_thread_ctx; i++) {
+            ff_lpc_end(&s->thread_ctx[i]->lpc_ctx);
+            av_freep(&s->thread_ctx[i]->job_buf);
+            av_freep(&s->thread_ctx[i]);
+        }
+        av_freep(&s->thread_ctx);
         av_freep(&s->md5ctx);
         av_freep(&s->md5_buffer);
         ff_lpc_end(&s->lpc_ctx);
@@ -1488,6 +1637,7 @@ static const AVOption options[] = {
 { "multi_dim_quant",       "Multi-dimensional quantization",    offsetof(FlacEncodeContext, options.multi_dim_quant),       AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
 { "min_prediction_order", NULL, offsetof(FlacEncodeContext, options.min_prediction_order), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, MAX_LPC_ORDER, FLAGS },
 { "max_prediction_order", NULL, offsetof(FlacEncodeContext, options.max_prediction_order), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, MAX_LPC_ORDER, FLAGS },
+{ "frame_batch", "Encode one frame per slice thread in parallel, delaying the output by as many frames", offsetof(FlacEncodeContext, frame_batch), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
 
 { NULL },
 };
@@ -1508,7 +1658,8 @@ AVCodec ff_flac_encoder = {
     .init           = flac_encode_init,
     .encode2        = flac_encode_frame,
     .close          = flac_encode_close,
-    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY | AV_CODEC_CAP_LOSSLESS,
+    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY | AV_CODEC_CAP_LOSSLESS |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .sample_fmts    = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_S16,
                                                      AV_SAMPLE_FMT_S32,
                                                      AV_SAMPLE_FMT_NONE },
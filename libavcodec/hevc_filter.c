@@ -725,12 +725,15 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
     int boundary_upper, boundary_left;
     int i, j, bs;
 
+    /* With parallel tiles the neighbouring tile may still be decoding, the
+     * tile edges are set by ff_hevc_tile_boundary_strengths() instead. */
     boundary_upper = y0 > 0 && !(y0 & 7);
     if (boundary_upper &&
         ((!s->sh.slice_loop_filter_across_slices_enabled_flag &&
           lc->boundary_flags & BOUNDARY_UPPER_SLICE &&
           (y0 % (1 << s->ps.sps->log2_ctb_size)) == 0) ||
-         (!s->ps.pps->loop_filter_across_tiles_enabled_flag &&
+         ((!s->ps.pps->loop_filter_across_tiles_enabled_flag ||
+           s->enable_parallel_tiles) &&
           lc->boundary_flags & BOUNDARY_UPPER_TILE &&
           (y0 % (1 << s->ps.sps->log2_ctb_size)) == 0)))
         boundary_upper = 0;
@@ -768,7 +771,8 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
         ((!s->sh.slice_loop_filter_across_slices_enabled_flag &&
           lc->boundary_flags & BOUNDARY_LEFT_SLICE &&
           (x0 % (1 << s->ps.sps->log2_ctb_size)) == 0) ||
-         (!s->ps.pps->loop_filter_across_tiles_enabled_flag &&
+         ((!s->ps.pps->loop_filter_across_tiles_enabled_flag ||
+           s->enable_parallel_tiles) &&
           lc->boundary_flags & BOUNDARY_LEFT_TILE &&
           (x0 % (1 << s->ps.sps->log2_ctb_size)) == 0)))
         boundary_left = 0;
@@ -835,6 +839,97 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
     }
 }
 
+/**
+ * Set the boundary strengths of the upper and left edges of the CTB at
+ * x0, y0 where they are tile boundaries. Used once all the tiles of a
+ * slice segment have been decoded in parallel.
+ */
+void ff_hevc_tile_boundary_strengths(HEVCContext *s, int x0, int y0)
+{
+    MvField *tab_mvf     = s->ref->tab_mvf;
+    int log2_min_pu_size = s->ps.sps->log2_min_pu_size;
+    int log2_min_tu_size = s->ps.sps->log2_min_tb_size;
+    int min_pu_width     = s->ps.sps->min_pu_width;
+    int min_tu_width     = s->ps.sps->min_tb_width;
+    int ctb_width        = s->ps.sps->ctb_width;
+    int ctb_addr_rs      = (y0 >> s->ps.sps->log2_ctb_size) * ctb_width +
+                           (x0 >> s->ps.sps->log2_ctb_size);
+    int tile_id          = s->ps.pps->tile_id[s->ps.pps->ctb_addr_rs_to_ts[ctb_addr_rs]];
+    int x_end            = FFMIN(x0 + (1 << s->ps.sps->log2_ctb_size), s->ps.sps->width);
+    int y_end            = FFMIN(y0 + (1 << s->ps.sps->log2_ctb_size), s->ps.sps->height);
+    int x, y, bs;
+
+    if (s->sh.disable_deblocking_filter_flag ||
+        !s->ps.pps->loop_filter_across_tiles_enabled_flag)
+        return;
+
+    if (y0 > 0 &&
+        s->ps.pps->tile_id[s->ps.pps->ctb_addr_rs_to_ts[ctb_addr_rs - ctb_width]] != tile_id) {
+        int upper_slice = s->tab_slice_address[ctb_addr_rs] !=
+                          s->tab_slice_address[ctb_addr_rs - ctb_width];
+
+        if (!upper_slice || s->sh.slice_loop_filter_across_slices_enabled_flag) {
+            RefPicList *rpl_top = upper_slice ?
+                                  ff_hevc_get_ref_list(s, s->ref, x0, y0 - 1) :
+                                  s->ref->refPicList;
+            int yp_pu = (y0 - 1) >> log2_min_pu_size;
+            int yq_pu =  y0      >> log2_min_pu_size;
+            int yp_tu = (y0 - 1) >> log2_min_tu_size;
+            int yq_tu =  y0      >> log2_min_tu_size;
+
+            for (x = x0; x < x_end; x += 4) {
+                int x_pu = x >> log2_min_pu_size;
+                int x_tu = x >> log2_min_tu_size;
+                MvField *top  = &tab_mvf[yp_pu * min_pu_width + x_pu];
+                MvField *curr = &tab_mvf[yq_pu * min_pu_width + x_pu];
+                uint8_t top_cbf_luma  = s->cbf_luma[yp_tu * min_tu_width + x_tu];
+                uint8_t curr_cbf_luma = s->cbf_luma[yq_tu * min_tu_width + x_tu];
+
+                if (curr->pred_flag == PF_INTRA || top->pred_flag == PF_INTRA)
+                    bs = 2;
+                else if (curr_cbf_luma || top_cbf_luma)
+                    bs = 1;
+                else
+                    bs = boundary_strength(s, curr, top, rpl_top);
+                s->horizontal_bs[(x + y0 * s->bs_width) >> 2] = bs;
+            }
+        }
+    }
+
+    if (x0 > 0 &&
+        s->ps.pps->tile_id[s->ps.pps->ctb_addr_rs_to_ts[ctb_addr_rs - 1]] != tile_id) {
+        int left_slice = s->tab_slice_address[ctb_addr_rs] !=
+                         s->tab_slice_address[ctb_addr_rs - 1];
+
+        if (!left_slice || s->sh.slice_loop_filter_across_slices_enabled_flag) {
+            RefPicList *rpl_left = left_slice ?
+                                   ff_hevc_get_ref_list(s, s->ref, x0 - 1, y0) :
+                                   s->ref->refPicList;
+            int xp_pu = (x0 - 1) >> log2_min_pu_size;
+            int xq_pu =  x0      >> log2_min_pu_size;
+            int xp_tu = (x0 - 1) >> log2_min_tu_size;
+            int xq_tu =  x0      >> log2_min_tu_size;
+
+            for (y = y0; y < y_end; y += 4) {
+                int y_pu = y >> log2_min_pu_size;
+                int y_tu = y >> log2_min_tu_size;
+                MvField *left = &tab_mvf[y_pu * min_pu_width + xp_pu];
+                MvField *curr = &tab_mvf[y_pu * min_pu_width + xq_pu];
+                uint8_t left_cbf_luma = s->cbf_luma[y_tu * min_tu_width + xp_tu];
+                uint8_t curr_cbf_luma = s->cbf_luma[y_tu * min_tu_width + xq_tu];
+
+                if (curr->pred_flag == PF_INTRA || left->pred_flag == PF_INTRA)
+                    bs = 2;
+                else if (curr_cbf_luma || left_cbf_luma)
+                    bs = 1;
+                else
+                    bs = boundary_strength(s, curr, left, rpl_left);
+                s->vertical_bs[(x0 + y * s->bs_width) >> 2] = bs;
+            }
+        }
+    }
+}
+
 #undef LUMA
 #undef CB
 #undef CR
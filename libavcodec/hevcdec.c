@@ -25,6 +25,7 @@
 
 #include "libavutil/attributes.h"
 #include "libavutil/common.h"
+#include "libavutil/cpu.h"
 #include "libavutil/display.h"
 #include "libavutil/internal.h"
 #include "libavutil/mastering_display_metadata.h"
@@ -780,6 +781,7 @@ static int hls_slice_header(HEVCContext *s)
     }
 
     sh->num_entry_point_offsets = 0;
+    s->enable_parallel_tiles    = 0;
     if (s->ps.pps->tiles_enabled_flag || s->ps.pps->entropy_coding_sync_enabled_flag) {
         unsigned num_entry_point_offsets = get_ue_golomb_long(gb);
         // It would be possible to bound this tighter but this here is simpler
@@ -814,12 +816,12 @@ static int hls_slice_header(HEVCContext *s)
                 sh->entry_point_offset[i] = val + 1; // +1; // +1 to get the size
             }
             if (s->threads_number > 1 && (s->ps.pps->num_tile_rows > 1 || s->ps.pps->num_tile_columns > 1)) {
-                s->enable_parallel_tiles = 0; // TODO: you can enable tiles in parallel here
-                s->threads_number = 1;
-            } else
-                s->enable_parallel_tiles = 0;
-        } else
-            s->enable_parallel_tiles = 0;
+                // tiles combined with WPP are decoded serially
+                s->enable_parallel_tiles = !s->ps.pps->entropy_coding_sync_enabled_flag;
+                if (!s->enable_parallel_tiles)
+                    s->threads_number = 1;
+            }
+        }
     }
 
     if (s->ps.pps->slice_header_extension_present_flag) {
@@ -2305,7 +2307,9 @@ static void hls_decode_neighbour(HEVCContext *s, int x_ctb, int y_ctb,
     int ctb_addr_rs       = s->ps.pps->ctb_addr_ts_to_rs[ctb_addr_ts];
     int ctb_addr_in_slice = ctb_addr_rs - s->sh.slice_addr;
 
-    s->tab_slice_address[ctb_addr_rs] = s->sh.slice_addr;
+    // set for the whole slice segment before decoding tiles in parallel
+    if (!s->enable_parallel_tiles)
+        s->tab_slice_address[ctb_addr_rs] = s->sh.slice_addr;
 
     if (s->ps.pps->entropy_coding_sync_enabled_flag) {
         if (x_ctb == 0 && (y_ctb & (ctb_size - 1)) == 0)
@@ -2418,6 +2422,99 @@ static int hls_slice_data(HEVCContext *s)
     s->avctx->execute(s->avctx, hls_decode_entry, arg, ret , 1, sizeof(int));
     return ret[0];
 }
+
+static void entry_worker(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    HEVCContext *s = priv;
+
+    s->entry_ret[jobnr] = s->entry_func(s->avctx, s->entry_arg, jobnr, threadnr);
+}
+
+static int entry_threads_init(HEVCContext *s)
+{
+#if HAVE_THREADS
+    int i;
+
+    if (s->entry_progress_init)
+        return 0;
+
+    // frame threads get their own pool, slice threads use the codec's
+    if (s->threads_type == FF_THREAD_FRAME) {
+        int ret = avpriv_slicethread_create(&s->entry_thread, s, entry_worker,
+                                            NULL, s->threads_number);
+        if (ret < 0)
+            return ret;
+    }
+
+    for (i = 0; i < MAX_NB_THREADS; i++) {
+        pthread_mutex_init(&s->entry_progress_mutex[i], NULL);
+        pthread_cond_init(&s->entry_progress_cond[i], NULL);
+    }
+    s->entry_progress_init = 1;
+#endif
+    return 0;
+}
+
+static void entry_threads_free(HEVCContext *s)
+{
+#if HAVE_THREADS
+    int i;
+
+    avpriv_slicethread_free(&s->entry_thread);
+
+    if (s->entry_progress_init) {
+        for (i = 0; i < MAX_NB_THREADS; i++) {
+            pthread_mutex_destroy(&s->entry_progress_mutex[i]);
+            pthread_cond_destroy(&s->entry_progress_cond[i]);
+        }
+        s->entry_progress_init = 0;
+    }
+#endif
+    av_freep(&s->entry_progress);
+    s->entry_progress_size = 0;
+}
+
+static void entry_execute(HEVCContext *s,
+                          int (*func)(AVCodecContext *avctx, void *arg, int jobnr, int threadnr),
+                          int *arg, int *ret, int nb_jobs)
+{
+    if (s->entry_thread) {
+        s->entry_func = func;
+        s->entry_arg  = arg;
+        s->entry_ret  = ret;
+        avpriv_slicethread_execute(s->entry_thread, nb_jobs, 0);
+    } else {
+        s->avctx->execute2(s->avctx, func, arg, ret, nb_jobs);
+    }
+}
+
+static void entry_report_progress(HEVCContext *s, int ctb_row, int n)
+{
+#if HAVE_THREADS
+    int thread = ctb_row % MAX_NB_THREADS;
+
+    pthread_mutex_lock(&s->entry_progress_mutex[thread]);
+    s->entry_progress[ctb_row] += n;
+    pthread_cond_broadcast(&s->entry_progress_cond[thread]);
+    pthread_mutex_unlock(&s->entry_progress_mutex[thread]);
+#endif
+}
+
+static void entry_await_progress(HEVCContext *s, int ctb_row, int shift)
+{
+#if HAVE_THREADS
+    int thread = (ctb_row - 1) % MAX_NB_THREADS;
+
+    if (!ctb_row)
+        return;
+
+    pthread_mutex_lock(&s->entry_progress_mutex[thread]);
+    while (s->entry_progress[ctb_row - 1] - s->entry_progress[ctb_row] < shift)
+        pthread_cond_wait(&s->entry_progress_cond[thread], &s->entry_progress_mutex[thread]);
+    pthread_mutex_unlock(&s->entry_progress_mutex[thread]);
+#endif
+}
+
 static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int job, int self_id)
 {
     HEVCContext *s1  = avctxt->priv_data, *s;
@@ -2428,7 +2525,6 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int
     int ctb_row = ctb_row_p[job];
     int ctb_addr_rs = s1->sh.slice_ctb_addr_rs + ctb_row * ((s1->ps.sps->width + ctb_size - 1) >> s1->ps.sps->log2_ctb_size);
     int ctb_addr_ts = s1->ps.pps->ctb_addr_rs_to_ts[ctb_addr_rs];
-    int thread = ctb_row % s1->threads_number;
     int ret;
 
     s = s1->sList[self_id];
@@ -2447,10 +2543,10 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int
 
         hls_decode_neighbour(s, x_ctb, y_ctb, ctb_addr_ts);
 
-        ff_thread_await_progress2(s->avctx, ctb_row, thread, SHIFT_CTB_WPP);
+        entry_await_progress(s1, ctb_row, SHIFT_CTB_WPP);
 
         if (atomic_load(&s1->wpp_err)) {
-            ff_thread_report_progress2(s->avctx, ctb_row , thread, SHIFT_CTB_WPP);
+            entry_report_progress(s1, ctb_row, SHIFT_CTB_WPP);
             return 0;
         }
 
@@ -2458,6 +2554,11 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int
         if (ret < 0)
             goto error;
         hls_sao_param(s, x_ctb >> s->ps.sps->log2_ctb_size, y_ctb >> s->ps.sps->log2_ctb_size);
+
+        s->deblock[ctb_addr_rs].beta_offset = s->sh.beta_offset;
+        s->deblock[ctb_addr_rs].tc_offset   = s->sh.tc_offset;
+        s->filter_slice_edges[ctb_addr_rs]  = s->sh.slice_loop_filter_across_slices_enabled_flag;
+
         more_data = hls_coding_quadtree(s, x_ctb, y_ctb, s->ps.sps->log2_ctb_size, 0);
 
         if (more_data < 0) {
@@ -2468,18 +2569,18 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int
         ctb_addr_ts++;
 
         ff_hevc_save_states(s, ctb_addr_ts);
-        ff_thread_report_progress2(s->avctx, ctb_row, thread, 1);
+        entry_report_progress(s1, ctb_row, 1);
         ff_hevc_hls_filters(s, x_ctb, y_ctb, ctb_size);
 
         if (!more_data && (x_ctb+ctb_size) < s->ps.sps->width && ctb_row != s->sh.num_entry_point_offsets) {
             atomic_store(&s1->wpp_err, 1);
-            ff_thread_report_progress2(s->avctx, ctb_row ,thread, SHIFT_CTB_WPP);
+            entry_report_progress(s1, ctb_row, SHIFT_CTB_WPP);
             return 0;
         }
 
         if ((x_ctb+ctb_size) >= s->ps.sps->width && (y_ctb+ctb_size) >= s->ps.sps->height ) {
             ff_hevc_hls_filter(s, x_ctb, y_ctb, ctb_size);
-            ff_thread_report_progress2(s->avctx, ctb_row , thread, SHIFT_CTB_WPP);
+            entry_report_progress(s1, ctb_row, SHIFT_CTB_WPP);
             return ctb_addr_ts;
         }
         ctb_addr_rs       = s->ps.pps->ctb_addr_ts_to_rs[ctb_addr_ts];
@@ -2489,16 +2590,119 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int
             break;
         }
     }
-    ff_thread_report_progress2(s->avctx, ctb_row ,thread, SHIFT_CTB_WPP);
+    entry_report_progress(s1, ctb_row, SHIFT_CTB_WPP);
 
     return 0;
 error:
     s->tab_slice_address[ctb_addr_rs] = -1;
     atomic_store(&s1->wpp_err, 1);
-    ff_thread_report_progress2(s->avctx, ctb_row ,thread, SHIFT_CTB_WPP);
+    entry_report_progress(s1, ctb_row, SHIFT_CTB_WPP);
     return ret;
 }
 
+/**
+ * Decode one tile of a slice segment. The in-loop filters are not applied
+ * here since they cross into the neighbouring tiles, see hls_filter_tiles().
+ */
+static int hls_decode_entry_tile(AVCodecContext *avctxt, void *input_tile, int job, int self_id)
+{
+    HEVCContext *s1 = avctxt->priv_data, *s;
+    HEVCLocalContext *lc;
+    int more_data   = 1;
+    int *tile_p     = input_tile;
+    int tile        = tile_p[job];
+    int ctb_addr_rs = s1->ps.pps->tile_pos_rs[tile];
+    int ctb_addr_ts = s1->ps.pps->ctb_addr_rs_to_ts[ctb_addr_rs];
+    int ret;
+
+    s = s1->sList[self_id];
+    lc = s->HEVClc;
+
+    if (job) {
+        ret = init_get_bits8(&lc->gb, s->data + s->sh.offset[job - 1], s->sh.size[job - 1]);
+        if (ret < 0)
+            goto error;
+        ff_init_cabac_decoder(&lc->cc, s->data + s->sh.offset[job - 1], s->sh.size[job - 1]);
+    }
+
+    while (more_data && ctb_addr_ts < s->ps.sps->ctb_size &&
+           s->ps.pps->tile_id[ctb_addr_ts] == tile) {
+        int x_ctb, y_ctb;
+
+        ctb_addr_rs = s->ps.pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+        x_ctb = (ctb_addr_rs % s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        y_ctb = (ctb_addr_rs / s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+
+        if (atomic_load(&s1->wpp_err))
+            return 0;
+
+        hls_decode_neighbour(s, x_ctb, y_ctb, ctb_addr_ts);
+
+        ret = ff_hevc_cabac_init(s, ctb_addr_ts);
+        if (ret < 0)
+            goto error;
+
+        hls_sao_param(s, x_ctb >> s->ps.sps->log2_ctb_size, y_ctb >> s->ps.sps->log2_ctb_size);
+
+        s->deblock[ctb_addr_rs].beta_offset = s->sh.beta_offset;
+        s->deblock[ctb_addr_rs].tc_offset   = s->sh.tc_offset;
+        s->filter_slice_edges[ctb_addr_rs]  = s->sh.slice_loop_filter_across_slices_enabled_flag;
+
+        more_data = hls_coding_quadtree(s, x_ctb, y_ctb, s->ps.sps->log2_ctb_size, 0);
+        if (more_data < 0) {
+            ret = more_data;
+            goto error;
+        }
+
+        ctb_addr_ts++;
+    }
+
+    // only the last tile of the slice segment ends it
+    if (more_data != (job < s->sh.num_entry_point_offsets)) {
+        av_log(s->avctx, AV_LOG_ERROR, "Tile %d ends at the wrong position\n", tile);
+        ret = AVERROR_INVALIDDATA;
+        goto error;
+    }
+
+    return ctb_addr_ts >= s->ps.sps->ctb_size ? ctb_addr_ts : 0;
+error:
+    s->tab_slice_address[ctb_addr_rs] = -1;
+    atomic_store(&s1->wpp_err, 1);
+    return ret;
+}
+
+/**
+ * Apply the in-loop filters to the slice segment from ctb_addr_ts to end_ts
+ * once all its tiles are decoded, in the same order as a serial decode.
+ */
+static void hls_filter_tiles(HEVCContext *s, int ctb_addr_ts, int end_ts)
+{
+    int ctb_size = 1 << s->ps.sps->log2_ctb_size;
+    int x_ctb    = 0;
+    int y_ctb    = 0;
+    int i;
+
+    for (i = ctb_addr_ts; i < end_ts; i++) {
+        int ctb_addr_rs = s->ps.pps->ctb_addr_ts_to_rs[i];
+
+        x_ctb = (ctb_addr_rs % s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        y_ctb = (ctb_addr_rs / s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        ff_hevc_tile_boundary_strengths(s, x_ctb, y_ctb);
+    }
+
+    for (i = ctb_addr_ts; i < end_ts; i++) {
+        int ctb_addr_rs = s->ps.pps->ctb_addr_ts_to_rs[i];
+
+        x_ctb = (ctb_addr_rs % s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        y_ctb = (ctb_addr_rs / s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        ff_hevc_hls_filters(s, x_ctb, y_ctb, ctb_size);
+    }
+
+    if (x_ctb + ctb_size >= s->ps.sps->width &&
+        y_ctb + ctb_size >= s->ps.sps->height)
+        ff_hevc_hls_filter(s, x_ctb, y_ctb, ctb_size);
+}
+
 static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
 {
     const uint8_t *data = nal->data;
@@ -2508,6 +2712,7 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     int *arg = av_malloc_array(s->sh.num_entry_point_offsets + 1, sizeof(int));
     int64_t offset;
     int64_t startheader, cmpt = 0;
+    int first_tile = 0, start_ts = 0, end_ts = 0;
     int i, j, res = 0;
 
     if (!ret || !arg) {
@@ -2516,7 +2721,28 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         return AVERROR(ENOMEM);
     }
 
-    if (s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * s->ps.sps->ctb_width >= s->ps.sps->ctb_width * s->ps.sps->ctb_height) {
+    if (s->enable_parallel_tiles) {
+        int nb_tiles = s->ps.pps->num_tile_columns * s->ps.pps->num_tile_rows;
+
+        start_ts   = s->ps.pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs];
+        first_tile = s->ps.pps->tile_id[start_ts];
+        if (s->ps.pps->tile_pos_rs[first_tile] != s->sh.slice_ctb_addr_rs ||
+            first_tile + s->sh.num_entry_point_offsets >= nb_tiles) {
+            av_log(s->avctx, AV_LOG_ERROR, "Tile entry points are wrong (%d %d %d)\n",
+                   s->sh.slice_ctb_addr_rs, s->sh.num_entry_point_offsets, nb_tiles);
+            res = AVERROR_INVALIDDATA;
+            goto error;
+        }
+        if (s->sh.dependent_slice_segment_flag &&
+            (!start_ts || s->tab_slice_address[s->ps.pps->ctb_addr_ts_to_rs[start_ts - 1]] != s->sh.slice_addr)) {
+            av_log(s->avctx, AV_LOG_ERROR, "Previous slice segment missing\n");
+            res = AVERROR_INVALIDDATA;
+            goto error;
+        }
+        j      = first_tile + s->sh.num_entry_point_offsets + 1;
+        end_ts = j < nb_tiles ? s->ps.pps->ctb_addr_rs_to_ts[s->ps.pps->tile_pos_rs[j]] :
+                                s->ps.sps->ctb_size;
+    } else if (s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * s->ps.sps->ctb_width >= s->ps.sps->ctb_width * s->ps.sps->ctb_height) {
         av_log(s->avctx, AV_LOG_ERROR, "WPP ctb addresses are wrong (%d %d %d %d)\n",
             s->sh.slice_ctb_addr_rs, s->sh.num_entry_point_offsets,
             s->ps.sps->ctb_width, s->ps.sps->ctb_height
@@ -2525,7 +2751,16 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         goto error;
     }
 
-    ff_alloc_entries(s->avctx, s->sh.num_entry_point_offsets + 1);
+    res = entry_threads_init(s);
+    if (res < 0)
+        goto error;
+
+    av_fast_malloc(&s->entry_progress, &s->entry_progress_size,
+                   (s->sh.num_entry_point_offsets + 1) * sizeof(*s->entry_progress));
+    if (!s->entry_progress) {
+        res = AVERROR(ENOMEM);
+        goto error;
+    }
 
     if (!s->sList[1]) {
         for (i = 1; i < s->threads_number; i++) {
@@ -2579,18 +2814,26 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     }
 
     atomic_store(&s->wpp_err, 0);
-    ff_reset_entries(s->avctx);
+    memset(s->entry_progress, 0, (s->sh.num_entry_point_offsets + 1) * sizeof(*s->entry_progress));
 
     for (i = 0; i <= s->sh.num_entry_point_offsets; i++) {
-        arg[i] = i;
+        arg[i] = first_tile + i;
         ret[i] = 0;
     }
 
-    if (s->ps.pps->entropy_coding_sync_enabled_flag)
-        s->avctx->execute2(s->avctx, hls_decode_entry_wpp, arg, ret, s->sh.num_entry_point_offsets + 1);
+    if (s->enable_parallel_tiles) {
+        for (i = start_ts; i < end_ts; i++)
+            s->tab_slice_address[s->ps.pps->ctb_addr_ts_to_rs[i]] = s->sh.slice_addr;
+        entry_execute(s, hls_decode_entry_tile, arg, ret, s->sh.num_entry_point_offsets + 1);
+    } else if (s->ps.pps->entropy_coding_sync_enabled_flag) {
+        entry_execute(s, hls_decode_entry_wpp, arg, ret, s->sh.num_entry_point_offsets + 1);
+    }
 
     for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
         res += ret[i];
+
+    if (s->enable_parallel_tiles && !atomic_load(&s->wpp_err))
+        hls_filter_tiles(s, start_ts, end_ts);
 error:
     av_free(ret);
     av_free(arg);
@@ -3218,7 +3461,10 @@ static av_cold int hevc_decode_free(AVCodecContext *avctx)
     av_freep(&s->sh.offset);
     av_freep(&s->sh.size);
 
-    for (i = 1; i < s->threads_number; i++) {
+    entry_threads_free(s);
+
+    // threads_number may have been lowered after allocating the contexts
+    for (i = 1; i < MAX_NB_THREADS; i++) {
         HEVCLocalContext *lc = s->HEVClcList[i];
         if (lc) {
             av_freep(&s->HEVClcList[i]);
@@ -3383,6 +3629,10 @@ static av_cold int hevc_decode_init(AVCodecContext *avctx)
 
     if(avctx->active_thread_type & FF_THREAD_SLICE)
         s->threads_number = avctx->thread_count;
+    else if ((avctx->active_thread_type & FF_THREAD_FRAME) &&
+             (avctx->thread_type & FF_THREAD_SLICE))
+        s->threads_number = s->entry_threads ? s->entry_threads :
+                            av_clip(av_cpu_count() / avctx->thread_count, 1, MAX_NB_THREADS);
     else
         s->threads_number = 1;
 
@@ -3432,6 +3682,8 @@ static const AVOption options[] = {
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
     { "strict-displaywin", "stricly apply default display window size", OFFSET(apply_defdispwin),
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
+    { "entry_threads", "Number of threads decoding WPP rows or tiles in each frame thread", OFFSET(entry_threads),
+        AV_OPT_TYPE_INT, {.i64 = 0}, 0, MAX_NB_THREADS, PAR },
     { NULL },
 };
 
@@ -25,7 +25,11 @@
 
 #include <stdatomic.h>
 
+#include "config.h"
+
 #include "libavutil/buffer.h"
+#include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
 
 #include "avcodec.h"
 #include "bswapdsp.h"
@@ -467,6 +471,25 @@ typedef struct HEVCContext {
     int enable_parallel_tiles;
     atomic_int wpp_err;
 
+    /**
+     * Entry point (WPP row or tile) threading. With frame threading every
+     * frame thread owns a pool of entry_threads threads, otherwise the
+     * slice threads of the codec context are used.
+     */
+    int entry_threads;
+    AVSliceThread *entry_thread;
+    int (*entry_func)(AVCodecContext *avctx, void *arg, int jobnr, int threadnr);
+    void *entry_arg;
+    int  *entry_ret;
+
+    int         *entry_progress;
+    unsigned int entry_progress_size;
+    int          entry_progress_init;
+#if HAVE_THREADS
+    pthread_mutex_t entry_progress_mutex[MAX_NB_THREADS];
+    pthread_cond_t  entry_progress_cond[MAX_NB_THREADS];
+#endif
+
     const uint8_t *data;
 
     H2645Packet pkt;
@@ -574,6 +597,7 @@ int ff_hevc_cu_qp_delta_sign_flag(HEVCContext *s);
 int ff_hevc_cu_qp_delta_abs(HEVCContext *s);
 int ff_hevc_cu_chroma_qp_offset_flag(HEVCContext *s);
 int ff_hevc_cu_chroma_qp_offset_idx(HEVCContext *s);
+void ff_hevc_tile_boundary_strengths(HEVCContext *s, int x0, int y0);
 void ff_hevc_hls_filter(HEVCContext *s, int x, int y, int ctb_size);
 void ff_hevc_hls_filters(HEVCContext *s, int x_ctb, int y_ctb, int ctb_size);
 void ff_hevc_hls_residual_coding(HEVCContext *s, int x0, int y0,
@@ -33,6 +33,14 @@ typedef struct LLVidEncDSPContext {
     void (*sub_median_pred)(uint8_t *dst, const uint8_t *src1,
                             const uint8_t *src2, intptr_t w,
                             int *left, int *left_top);
+    /**
+     * Subtract the PNG Paeth predictor of each byte, computed from the byte
+     * bpp positions to the left (src[-bpp]), the byte above (top[0]) and
+     * the byte above-left (top[-bpp]).
+     * Reads src[-bpp] and top[-bpp]; w must be a multiple of 8.
+     */
+    void (*sub_paeth_pred)(uint8_t *dst, const uint8_t *src,
+                           const uint8_t *top, intptr_t w, int bpp);
 } LLVidEncDSPContext;
 
 void ff_llvidencdsp_init(LLVidEncDSPContext *c);
@@ -37,6 +37,10 @@
 
 #define IOBUF_SIZE 4096
 
+#define MAX_SLICES      64
+#define MIN_SLICE_ROWS  16
+#define DEFLATE_WINDOW  32768
+
 typedef struct APNGFctlChunk {
     uint32_t sequence_number;
     uint32_t width, height;
@@ -45,6 +49,24 @@ typedef struct APNGFctlChunk {
     uint8_t dispose_op, blend_op;
 } APNGFctlChunk;
 
+typedef struct PNGEncSlice {
+    z_stream zstream;
+    int zstream_inited;
+
+    uint8_t *crow_base;
+    unsigned int crow_base_size;
+    uint8_t *dict;               ///< filtered rows preceding the slice
+    unsigned int dict_size;
+
+    uint8_t *out;                ///< compressed data, inside PNGEncContext.slice_buf
+    size_t out_size;
+    size_t out_len;
+    uLong adler;                 ///< Adler-32 of the filtered rows of the slice
+    uLong in_len;
+    int y_start, y_end;
+    int ret;
+} PNGEncSlice;
+
 typedef struct PNGEncContext {
     AVClass *class;
     LLVidEncDSPContext llvidencdsp;
@@ -56,6 +78,7 @@ typedef struct PNGEncContext {
     int filter_type;
 
     z_stream zstream;
+    int compression_level;
     uint8_t buf[IOBUF_SIZE];
     int dpi;                     ///< Physical pixel density, in dots per inch, if set
     int dpm;                     ///< Physical pixel density, in dots per meter, if set
@@ -77,6 +100,14 @@ typedef struct PNGEncContext {
     APNGFctlChunk last_frame_fctl;
     uint8_t *last_frame_packet;
     size_t last_frame_packet_size;
+
+    // slice mode
+    int nb_slices;
+    PNGEncSlice *slices;
+    const AVFrame *slice_frame;
+    int slice_row_size;
+    uint8_t *slice_buf;
+    unsigned int slice_buf_size;
 } PNGEncContext;
 
 static void png_get_interlaced_row(uint8_t *dst, int row_size,
@@ -186,6 +217,11 @@ static void png_filter_row(PNGEncContext *c, uint8_t *dst, int filter_type,
     case PNG_FILTER_VALUE_PAETH:
         for (i = 0; i < bpp; i++)
             dst[i] = src[i] - top[i];
+        if (size - i >= 8) {
+            int w = (size - i) & ~7;
+            c->llvidencdsp.sub_paeth_pred(dst + i, src + i, top + i, w, bpp);
+            i += w;
+        }
         sub_png_paeth_prediction(dst + i, src + i, top + i, size - i, bpp);
         break;
     }
@@ -428,6 +464,152 @@ static int encode_headers(AVCodecContext *avctx, const AVFrame *pict)
     return 0;
 }
 
+/**
+ * Filter and compress the rows of one slice into an independent raw deflate
+ * stream. All but the last stream end with a sync flush, so that the streams
+ * can be concatenated into a single zlib stream. The rows preceding the slice
+ * are filtered again and used as the preset dictionary, so that matches
+ * across the slice boundary are not lost.
+ */
+static int encode_slice(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    PNGEncContext *s       = avctx->priv_data;
+    PNGEncSlice *sl        = &s->slices[jobnr];
+    const AVFrame *const p = s->slice_frame;
+    int row_size           = s->slice_row_size;
+    int bpp                = s->bits_per_pixel >> 3;
+    int last               = sl->y_end == p->height;
+    uint8_t *crow_buf      = sl->crow_base + 15;
+    uint8_t *ptr, *top, *crow;
+    int y, ret;
+
+    sl->adler = adler32(0, NULL, 0);
+    sl->ret   = AVERROR_EXTERNAL;
+
+    if (sl->y_start) {
+        int nb_rows = FFMIN(sl->y_start, (DEFLATE_WINDOW + row_size) / (row_size + 1));
+        int len     = 0;
+
+        for (y = sl->y_start - nb_rows; y < sl->y_start; y++) {
+            ptr  = p->data[0] + y * p->linesize[0];
+            top  = y ? ptr - p->linesize[0] : NULL;
+            crow = png_choose_filter(s, crow_buf, ptr, top, row_size, bpp);
+            memcpy(sl->dict + len, crow, row_size + 1);
+            len += row_size + 1;
+        }
+        ret = deflateSetDictionary(&sl->zstream,
+                                   sl->dict + FFMAX(len - DEFLATE_WINDOW, 0),
+                                   FFMIN(len, DEFLATE_WINDOW));
+        if (ret != Z_OK)
+            return sl->ret;
+    }
+
+    sl->zstream.next_out  = sl->out;
+    sl->zstream.avail_out = sl->out_size;
+    top = sl->y_start ? p->data[0] + (sl->y_start - 1) * p->linesize[0] : NULL;
+    for (y = sl->y_start; y < sl->y_end; y++) {
+        int flush = y < sl->y_end - 1 ? Z_NO_FLUSH :
+                    last              ? Z_FINISH   : Z_SYNC_FLUSH;
+
+        ptr  = p->data[0] + y * p->linesize[0];
+        crow = png_choose_filter(s, crow_buf, ptr, top, row_size, bpp);
+        sl->adler = adler32(sl->adler, crow, row_size + 1);
+
+        sl->zstream.next_in  = crow;
+        sl->zstream.avail_in = row_size + 1;
+        ret = deflate(&sl->zstream, flush);
+        /* the output buffer is sized with deflateBound(), running out of it
+         * means the stream is broken */
+        if ((ret != Z_OK && ret != Z_STREAM_END) || sl->zstream.avail_in ||
+            (flush == Z_FINISH && ret != Z_STREAM_END) ||
+            (flush == Z_SYNC_FLUSH && !sl->zstream.avail_out))
+            return sl->ret;
+        top = ptr;
+    }
+    sl->out_len = sl->out_size - sl->zstream.avail_out;
+    sl->in_len  = (sl->y_end - sl->y_start) * (row_size + 1);
+
+    return sl->ret = 0;
+}
+
+static int encode_frame_slices(AVCodecContext *avctx, const AVFrame *pict,
+                               int nb_slices)
+{
+    PNGEncContext *s = avctx->priv_data;
+    int row_size     = (pict->width * s->bits_per_pixel + 7) >> 3;
+    int dict_rows    = (DEFLATE_WINDOW + row_size) / (row_size + 1);
+    int level_flags, header;
+    size_t total = 2 + 4, len, pos;
+    uLong adler = 0;
+    uint8_t *out;
+    int i, ret = 0;
+
+    for (i = 0; i < nb_slices; i++) {
+        PNGEncSlice *sl = &s->slices[i];
+
+        sl->y_start  = pict->height *  i      / nb_slices;
+        sl->y_end    = pict->height * (i + 1) / nb_slices;
+        sl->out_size = deflateBound(&sl->zstream,
+                                    (sl->y_end - sl->y_start) * (row_size + 1)) + 16;
+        total       += sl->out_size;
+
+        av_fast_malloc(&sl->crow_base, &sl->crow_base_size,
+                       (row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
+        av_fast_malloc(&sl->dict, &sl->dict_size, dict_rows * (row_size + 1));
+        if (!sl->crow_base || !sl->dict)
+            return AVERROR(ENOMEM);
+    }
+    if (total > INT_MAX)
+        return AVERROR(ENOMEM);
+    av_fast_malloc(&s->slice_buf, &s->slice_buf_size, total);
+    if (!s->slice_buf)
+        return AVERROR(ENOMEM);
+
+    out = s->slice_buf + 2;
+    for (i = 0; i < nb_slices; i++) {
+        s->slices[i].out = out;
+        out += s->slices[i].out_size;
+    }
+
+    s->slice_frame    = pict;
+    s->slice_row_size = row_size;
+    avctx->execute2(avctx, encode_slice, NULL, NULL, nb_slices);
+
+    /* zlib header, the same as deflate() would write for this level */
+    level_flags = s->compression_level < 2 ? 0 :
+                  s->compression_level < 6 ? 1 :
+                  s->compression_level == 6 ? 2 : 3;
+    header  = (Z_DEFLATED + (7 << 4)) << 8 | level_flags << 6;
+    header += 31 - header % 31;
+    AV_WB16(s->slice_buf, header);
+
+    len = 2;
+    for (i = 0; i < nb_slices; i++) {
+        PNGEncSlice *sl = &s->slices[i];
+
+        if (sl->ret < 0) {
+            ret = sl->ret;
+            goto the_end;
+        }
+        memmove(s->slice_buf + len, sl->out, sl->out_len);
+        len  += sl->out_len;
+        adler = i ? adler32_combine(adler, sl->adler, sl->in_len) : sl->adler;
+    }
+    AV_WB32(s->slice_buf + len, adler);
+    len += 4;
+
+    for (pos = 0; pos < len; pos += IOBUF_SIZE) {
+        int size = FFMIN(IOBUF_SIZE, len - pos);
+        if (s->bytestream_end - s->bytestream > size + 100)
+            png_write_image_data(avctx, s->slice_buf + pos, size);
+    }
+
+the_end:
+    for (i = 0; i < nb_slices; i++)
+        deflateReset(&s->slices[i].zstream);
+    return ret;
+}
+
 static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
 {
     PNGEncContext *s       = avctx->priv_data;
@@ -438,6 +620,10 @@ static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
     uint8_t *crow_base       = NULL;
     uint8_t *progressive_buf = NULL;
     uint8_t *top_buf         = NULL;
+    int nb_slices = FFMIN(s->nb_slices, pict->height / MIN_SLICE_ROWS);
+
+    if (nb_slices > 1)
+        return encode_frame_slices(avctx, pict, nb_slices);
 
     row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
 
@@ -1091,6 +1277,34 @@ FF_ENABLE_DEPRECATION_WARNINGS
                       : av_clip(avctx->compression_level, 0, 9);
     if (deflateInit2(&s->zstream, compression_level, Z_DEFLATED, 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
         return -1;
+    s->compression_level = compression_level == Z_DEFAULT_COMPRESSION ? 6 : compression_level;
+
+    /* Interlaced images are always compressed as a single stream. */
+    if (!s->is_progressive) {
+        if (avctx->slices > 0)
+            s->nb_slices = avctx->slices;
+        else if (avctx->active_thread_type & FF_THREAD_SLICE)
+            s->nb_slices = avctx->thread_count;
+        s->nb_slices = FFMIN(s->nb_slices, MAX_SLICES);
+    }
+    if (s->nb_slices > 1) {
+        int i;
+
+        s->slices = av_mallocz_array(s->nb_slices, sizeof(*s->slices));
+        if (!s->slices)
+            return AVERROR(ENOMEM);
+        for (i = 0; i < s->nb_slices; i++) {
+            z_stream *zstream = &s->slices[i].zstream;
+
+            zstream->zalloc = ff_png_zalloc;
+            zstream->zfree  = ff_png_zfree;
+            zstream->opaque = NULL;
+            if (deflateInit2(zstream, compression_level, Z_DEFLATED, -15, 8,
+                             Z_DEFAULT_STRATEGY) != Z_OK)
+                return -1;
+            s->slices[i].zstream_inited = 1;
+        }
+    }
 
     return 0;
 }
@@ -1100,6 +1314,20 @@ static av_cold int png_enc_close(AVCodecContext *avctx)
     PNGEncContext *s = avctx->priv_data;
 
     deflateEnd(&s->zstream);
+    if (s->slices) {
+        int i;
+
+        for (i = 0; i < s->nb_slices; i++) {
+            PNGEncSlice *sl = &s->slices[i];
+
+            if (sl->zstream_inited)
+                deflateEnd(&sl->zstream);
+            av_freep(&sl->crow_base);
+            av_freep(&sl->dict);
+        }
+        av_freep(&s->slices);
+    }
+    av_freep(&s->slice_buf);
     av_frame_free(&s->last_frame);
     av_frame_free(&s->prev_frame);
     av_freep(&s->last_frame_packet);
@@ -1146,7 +1374,8 @@ AVCodec ff_png_encoder = {
     .init           = png_enc_init,
     .close          = png_enc_close,
     .encode2        = encode_png,
-    .capabilities   = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_INTRA_ONLY,
+    .capabilities   = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS |
+                      AV_CODEC_CAP_INTRA_ONLY,
     .pix_fmts       = (const enum AVPixelFormat[]) {
         AV_PIX_FMT_RGB24, AV_PIX_FMT_RGBA,
         AV_PIX_FMT_RGB48BE, AV_PIX_FMT_RGBA64BE,
@@ -21,6 +21,7 @@
 #include <inttypes.h>
 #include <string.h>
 #include "libavcodec/avcodec.h"
+#include "libavutil/common.h"
 #include "libavutil/error.h"
 
 
@@ -80,6 +81,67 @@ static int initializations(AVPacket* avpkt)
     return ret;
 }
 
+static int test_packet_pool(const AVPacket *src)
+{
+    AVPacketPool *pool = av_packet_pool_alloc();
+    AVPacket *pkt, *first, *pkts[4];
+    uint8_t *sd;
+    int i, sd_size, ret = 0;
+
+    if (!pool)
+        return 1;
+
+    /* a pool packet behaves like av_packet_alloc() */
+    pkt = av_packet_pool_get(pool);
+    if (!pkt || pkt->pts != AV_NOPTS_VALUE || pkt->data || pkt->size ||
+        pkt->buf || pkt->side_data_elems) {
+        printf("av_packet_pool_get() returned a packet not set to defaults\n");
+        ret = 1;
+    }
+    first = pkt;
+    av_packet_pool_release(&pkt);
+    if (pkt) {
+        printf("av_packet_pool_release() did not reset the pointer\n");
+        ret = 1;
+    }
+
+    /* the released packet is handed out again, here as a clone of src */
+    for (i = 0; i < FF_ARRAY_ELEMS(pkts); i++) {
+        pkts[i] = av_packet_pool_clone(pool, src);
+        if (!pkts[i]) {
+            printf("av_packet_pool_clone() failed\n");
+            return 1;
+        }
+        sd = av_packet_get_side_data(pkts[i], AV_PKT_DATA_NEW_EXTRADATA, &sd_size);
+        if (pkts[i]->pts != src->pts || pkts[i]->dts != src->dts ||
+            pkts[i]->size != src->size || memcmp(pkts[i]->data, src->data, src->size) ||
+            pkts[i]->duration != src->duration || pkts[i]->flags != src->flags ||
+            !pkts[i]->buf || !sd || sd_size != src->side_data[0].size ||
+            memcmp(sd, src->side_data[0].data, sd_size)) {
+            printf("av_packet_pool_clone() #%d does not match its source\n", i);
+            ret = 1;
+        }
+    }
+    if (pkts[0] != first) {
+        printf("av_packet_pool_clone() did not reuse the released packet\n");
+        ret = 1;
+    }
+    /* src is not refcounted, but clones of a refcounted packet share its buffer */
+    pkt = av_packet_pool_clone(pool, pkts[0]);
+    if (!pkt || pkt->buf->buffer != pkts[0]->buf->buffer || pkt->data != pkts[0]->data) {
+        printf("av_packet_pool_clone() copied refcounted data\n");
+        ret = 1;
+    }
+    av_packet_pool_release(&pkt);
+
+    /* packets outlive the pool */
+    av_packet_pool_free(&pool);
+    for (i = 0; i < FF_ARRAY_ELEMS(pkts); i++)
+        av_packet_pool_release(&pkts[i]);
+
+    return ret;
+}
+
 int main(void)
 {
     AVPacket avpkt;
@@ -119,6 +181,10 @@ int main(void)
                 "when \"size\" parameter is too large.\n" );
         ret = 1;
     }
+    /* test the packet pool */
+    if (test_packet_pool(&avpkt))
+        ret = 1;
+
     /*clean up*/
     av_packet_free(&avpkt_clone);
     av_packet_unref(&avpkt);
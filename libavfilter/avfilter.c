@@ -190,7 +190,15 @@ int avfilter_link_get_channels(AVFilterLink *link)
 
 void ff_filter_set_ready(AVFilterContext *filter, unsigned priority)
 {
-    filter->ready = FFMAX(filter->ready, priority);
+    AVFilterGraphInternal *gi = filter->graph ? filter->graph->internal : NULL;
+
+    if (gi && gi->parallel_run) {
+        ff_mutex_lock(&gi->sched_lock);
+        filter->ready = FFMAX(filter->ready, priority);
+        ff_mutex_unlock(&gi->sched_lock);
+    } else {
+        filter->ready = FFMAX(filter->ready, priority);
+    }
 }
 
 /**
@@ -199,10 +207,16 @@ void ff_filter_set_ready(AVFilterContext *filter, unsigned priority)
  */
 static void filter_unblock(AVFilterContext *filter)
 {
+    AVFilterGraphInternal *gi = filter->graph ? filter->graph->internal : NULL;
+    int locked = gi && gi->parallel_run;
     unsigned i;
 
+    if (locked)
+        ff_mutex_lock(&gi->sched_lock);
     for (i = 0; i < filter->nb_outputs; i++)
         filter->outputs[i]->frame_blocked_in = 0;
+    if (locked)
+        ff_mutex_unlock(&gi->sched_lock);
 }
 
 
@@ -525,13 +539,20 @@ static int set_enable_expr(AVFilterContext *ctx, const char *expr)
 
 void ff_update_link_current_pts(AVFilterLink *link, int64_t pts)
 {
+    AVFilterGraphInternal *gi = link->graph ? link->graph->internal : NULL;
+    int locked = gi && gi->parallel_run;
+
     if (pts == AV_NOPTS_VALUE)
         return;
+    if (locked)
+        ff_mutex_lock(&gi->sched_lock);
     link->current_pts = pts;
     link->current_pts_us = av_rescale_q(pts, link->time_base, AV_TIME_BASE_Q);
     /* TODO use duration */
     if (link->graph && link->age_index >= 0)
         ff_avfilter_graph_update_heap(link->graph, link);
+    if (locked)
+        ff_mutex_unlock(&gi->sched_lock);
 }
 
 int avfilter_process_command(AVFilterContext *filter, const char *cmd, const char *arg, char *res, int res_len, int flags)
@@ -316,6 +316,11 @@ typedef struct AVFilter {
  * Process multiple parts of the frame concurrently.
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
+/**
+ * Activate filters of independent branches of the graph concurrently.
+ * Only meaningful for AVFilterGraph.thread_type.
+ */
+#define AVFILTER_THREAD_GRAPH (1 << 1)
 
 typedef struct AVFilterInternal AVFilterInternal;
 
@@ -47,6 +47,7 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, FLAGS, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = FLAGS, .unit = "thread_type" },
+        { "graph", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_GRAPH }, .flags = FLAGS, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads),
         AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, FLAGS },
     {"scale_sws_opts"       , "default scale filter options"        , OFFSET(scale_sws_opts)        ,
@@ -89,6 +90,12 @@ AVFilterGraph *avfilter_graph_alloc(void)
         return NULL;
     }
 
+    if (ff_mutex_init(&ret->internal->sched_lock, NULL)) {
+        av_freep(&ret->internal);
+        av_freep(&ret);
+        return NULL;
+    }
+
     ret->av_class = &filtergraph_class;
     av_opt_set_defaults(ret);
     ff_framequeue_global_init(&ret->internal->frame_queues);
@@ -132,6 +139,7 @@ void avfilter_graph_free(AVFilterGraph **graph)
     av_freep(&(*graph)->resample_lavr_opts);
 #endif
     av_freep(&(*graph)->filters);
+    ff_mutex_destroy(&(*graph)->internal->sched_lock);
     av_freep(&(*graph)->internal);
     av_freep(graph);
 }
@@ -1434,6 +1442,69 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
     return 0;
 }
 
+#define MAX_PARALLEL_FILTERS 32
+
+static int filters_linked(AVFilterContext *a, AVFilterContext *b)
+{
+    unsigned i;
+
+    for (i = 0; i < a->nb_inputs; i++)
+        if (a->inputs[i] && a->inputs[i]->src == b)
+            return 1;
+    for (i = 0; i < a->nb_outputs; i++)
+        if (a->outputs[i] && a->outputs[i]->dst == b)
+            return 1;
+    return 0;
+}
+
+static int activate_filter_job(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    AVFilterContext **filters = arg;
+
+    return ff_filter_activate(filters[jobnr]);
+}
+
+/**
+ * Activate filter together with the other ready filters that are not
+ * directly linked to any filter of the batch, on the graph thread pool.
+ *
+ * Filters that share no link only touch each other's scheduling state
+ * (ready priority, blocked flags of a common neighbour, sink heap), which
+ * is protected by sched_lock for the duration of the batch.
+ */
+static int graph_run_parallel(AVFilterGraph *graph, AVFilterContext *filter)
+{
+    AVFilterContext *batch[MAX_PARALLEL_FILTERS];
+    int rets[MAX_PARALLEL_FILTERS];
+    int nb_batch = 1, max_batch = FFMIN(graph->nb_threads, MAX_PARALLEL_FILTERS);
+    unsigned i;
+    int j;
+
+    batch[0] = filter;
+    for (i = 0; i < graph->nb_filters && nb_batch < max_batch; i++) {
+        AVFilterContext *f = graph->filters[i];
+
+        if (!f->ready || f == filter)
+            continue;
+        for (j = 0; j < nb_batch; j++)
+            if (filters_linked(f, batch[j]))
+                break;
+        if (j == nb_batch)
+            batch[nb_batch++] = f;
+    }
+    if (nb_batch == 1)
+        return ff_filter_activate(filter);
+
+    graph->internal->parallel_run = 1;
+    graph->internal->thread_execute(filter, activate_filter_job, batch, rets, nb_batch);
+    graph->internal->parallel_run = 0;
+
+    for (j = 0; j < nb_batch; j++)
+        if (rets[j] < 0)
+            return rets[j];
+    return 0;
+}
+
 int ff_filter_graph_run_once(AVFilterGraph *graph)
 {
     AVFilterContext *filter;
@@ -1446,5 +1517,7 @@ int ff_filter_graph_run_once(AVFilterGraph *graph)
             filter = graph->filters[i];
     if (!filter->ready)
         return AVERROR(EAGAIN);
+    if (graph->thread_type & AVFILTER_THREAD_GRAPH && graph->internal->thread)
+        return graph_run_parallel(graph, filter);
     return ff_filter_activate(filter);
 }
@@ -25,6 +25,7 @@
  */
 
 #include "libavutil/internal.h"
+#include "libavutil/thread.h"
 #include "avfilter.h"
 #include "formats.h"
 #include "framepool.h"
@@ -44,6 +45,8 @@ typedef struct AVFilterCommand {
 
 /**
  * Update the position of a link in the age heap.
+ * The heap compares the current_pts of all the sink links, so while the graph
+ * runs filters in parallel the caller must hold sched_lock.
  */
 void ff_avfilter_graph_update_heap(AVFilterGraph *graph, AVFilterLink *link);
 
@@ -148,6 +151,13 @@ struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
+    /**
+     * Set while ff_filter_graph_run_once() activates several filters
+     * concurrently; the scheduling state shared between neighbouring
+     * filters is then only modified with sched_lock held.
+     */
+    int parallel_run;
+    AVMutex sched_lock;
 };
 
 struct AVFilterInternal {
@@ -38,6 +38,9 @@ typedef struct ThreadContext {
     AVSliceThread *thread;
     avfilter_action_func *func;
 
+    /* set while the workers are running jobs */
+    int running;
+
     /* per-execute parameters */
     AVFilterContext *ctx;
     void *arg;
@@ -64,12 +67,28 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
 
     if (nb_jobs <= 0)
         return 0;
+
+    /* A filter activated by a parallel graph run is already executing on
+     * the pool: run its slices in the calling thread. */
+    if (c->running) {
+        int i;
+
+        for (i = 0; i < nb_jobs; i++) {
+            int r = func(ctx, arg, i, nb_jobs);
+            if (ret)
+                ret[i] = r;
+        }
+        return 0;
+    }
+
     c->ctx         = ctx;
     c->arg         = arg;
     c->func        = func;
     c->rets        = ret;
 
+    c->running = 1;
     avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+    c->running = 0;
     return 0;
 }
 
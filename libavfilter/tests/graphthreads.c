@@ -0,0 +1,136 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Run a graph with independent branches once on a single thread and once
+ * with graph threading, and check that every sink gets the same frames.
+ */
+
+#include <stdio.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/frame.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/pixdesc.h"
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+
+#define NB_SINKS 3
+
+static const char *graph_desc =
+    "testsrc2=d=2:s=176x144:r=25,split=3[a][b][c];"
+    "[a]hflip,edgedetect,buffersink@out0;"
+    "[b]vflip,negate,buffersink@out1;"
+    "[c]transpose,gradfun,buffersink@out2";
+
+typedef struct SinkResult {
+    int nb_frames;
+    unsigned long checksum;
+} SinkResult;
+
+static void checksum_frame(SinkResult *res, const AVFrame *frame)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    int p, y;
+
+    for (p = 0; p < 4 && frame->data[p]; p++) {
+        int h = p == 1 || p == 2 ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h)
+                                 : frame->height;
+        int w = av_image_get_linesize(frame->format, frame->width, p);
+
+        for (y = 0; y < h; y++)
+            res->checksum = av_adler32_update(res->checksum,
+                                              frame->data[p] + y * frame->linesize[p], w);
+    }
+    res->nb_frames++;
+}
+
+static int run_graph(int thread_type, int nb_threads, SinkResult *res)
+{
+    AVFilterGraph *graph = avfilter_graph_alloc();
+    AVFilterContext *sinks[NB_SINKS];
+    AVFrame *frame = av_frame_alloc();
+    int i, ret;
+
+    if (!graph || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    graph->thread_type = thread_type;
+    graph->nb_threads  = nb_threads;
+
+    if ((ret = avfilter_graph_parse_ptr(graph, graph_desc, NULL, NULL, NULL)) < 0 ||
+        (ret = avfilter_graph_config(graph, NULL)) < 0)
+        goto end;
+
+    for (i = 0; i < NB_SINKS; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "buffersink@out%d", i);
+        sinks[i] = avfilter_graph_get_filter(graph, name);
+        if (!sinks[i]) {
+            ret = AVERROR_BUG;
+            goto end;
+        }
+        res[i].nb_frames = 0;
+        res[i].checksum  = 1;
+    }
+
+    do {
+        ret = avfilter_graph_request_oldest(graph);
+        for (i = 0; i < NB_SINKS; i++) {
+            while (av_buffersink_get_frame(sinks[i], frame) >= 0) {
+                checksum_frame(&res[i], frame);
+                av_frame_unref(frame);
+            }
+        }
+    } while (ret >= 0 || ret == AVERROR(EAGAIN));
+    if (ret == AVERROR_EOF)
+        ret = 0;
+
+end:
+    av_frame_free(&frame);
+    avfilter_graph_free(&graph);
+    return ret;
+}
+
+int main(void)
+{
+    SinkResult ref[NB_SINKS], res[NB_SINKS];
+    int i, ret, mismatch = 0;
+
+    avfilter_register_all();
+
+    if ((ret = run_graph(0, 1, ref)) < 0) {
+        fprintf(stderr, "single-threaded run failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+    if ((ret = run_graph(AVFILTER_THREAD_SLICE | AVFILTER_THREAD_GRAPH, 4, res)) < 0) {
+        fprintf(stderr, "threaded run failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+
+    for (i = 0; i < NB_SINKS; i++) {
+        int same = ref[i].nb_frames == res[i].nb_frames &&
+                   ref[i].checksum  == res[i].checksum;
+        printf("out%d: %d frames, %s\n", i, res[i].nb_frames,
+               same ? "identical" : "MISMATCH");
+        mismatch |= !same;
+    }
+
+    return mismatch;
+}
@@ -39,6 +39,7 @@
 #include "dualinput.h"
 #include "drawutils.h"
 #include "video.h"
+#include "vf_overlay.h"
 
 static const char *const var_names[] = {
     "main_w",    "W", ///< width  of the main    video
@@ -135,9 +136,16 @@ typedef struct OverlayContext {
 
     AVExpr *x_pexpr, *y_pexpr;
 
-    void (*blend_image)(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y);
+    OverlayDSPContext dsp;
+
+    int (*blend_slice)(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs);
 } OverlayContext;
 
+typedef struct ThreadData {
+    AVFrame *dst;
+    const AVFrame *src;
+} ThreadData;
+
 static av_cold void uninit(AVFilterContext *ctx)
 {
     OverlayContext *s = ctx->priv;
@@ -410,13 +418,56 @@ static int config_output(AVFilterLink *outlink)
 // ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)) is a faster version of: 255 * (x + y)
 #define UNPREMULTIPLY_ALPHA(x, y) ((((x) << 16) - ((x) << 9) + (x)) / ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)))
 
+static int blend_row_444_c(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                           int w, ptrdiff_t alinesize)
+{
+    int k;
+
+    for (k = 0; k < w; k++)
+        d[k] = FAST_DIV255(d[k] * (255 - a[k]) + s[k] * a[k]);
+    return w;
+}
+
+static int blend_row_422_c(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                           int w, ptrdiff_t alinesize)
+{
+    int k;
+
+    for (k = 0; k < w; k++) {
+        int alpha = (a[2*k] + ((a[2*k] + a[2*k+1]) >> 1)) >> 1;
+        d[k] = FAST_DIV255(d[k] * (255 - alpha) + s[k] * alpha);
+    }
+    return w;
+}
+
+static int blend_row_420_c(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                           int w, ptrdiff_t alinesize)
+{
+    int k;
+
+    for (k = 0; k < w; k++) {
+        int alpha = (a[2*k]             + a[2*k+1] +
+                     a[2*k + alinesize] + a[2*k+1 + alinesize]) >> 2;
+        d[k] = FAST_DIV255(d[k] * (255 - alpha) + s[k] * alpha);
+    }
+    return w;
+}
+
+av_cold void ff_overlay_dsp_init(OverlayDSPContext *dsp)
+{
+    dsp->blend_row[OVERLAY_ROW_444] = blend_row_444_c;
+    dsp->blend_row[OVERLAY_ROW_422] = blend_row_422_c;
+    dsp->blend_row[OVERLAY_ROW_420] = blend_row_420_c;
+}
+
 /**
  * Blend image in src to destination buffer dst at position (x, y).
  */
 
 static void blend_image_packed_rgb(AVFilterContext *ctx,
                                    AVFrame *dst, const AVFrame *src,
-                                   int main_has_alpha, int x, int y)
+                                   int main_has_alpha, int x, int y,
+                                   int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
     int i, imax, j, jmax;
@@ -436,12 +487,17 @@ static void blend_image_packed_rgb(AVFilterContext *ctx,
     const int sa = s->overlay_rgba_map[A];
     const int sstep = s->overlay_pix_step[0];
     uint8_t *S, *sp, *d, *dp;
+    int slice_start, slice_end;
+
+    i    = FFMAX(-y, 0);
+    imax = FFMIN(-y + dst_h, src_h);
+    slice_start = i + (imax - i) *  jobnr      / nb_jobs;
+    slice_end   = i + (imax - i) * (jobnr + 1) / nb_jobs;
 
-    i = FFMAX(-y, 0);
-    sp = src->data[0] + i     * src->linesize[0];
-    dp = dst->data[0] + (y+i) * dst->linesize[0];
+    sp = src->data[0] + slice_start     * src->linesize[0];
+    dp = dst->data[0] + (y+slice_start) * dst->linesize[0];
 
-    for (imax = FFMIN(-y + dst_h, src_h); i < imax; i++) {
+    for (i = slice_start; i < slice_end; i++) {
         j = FFMAX(-x, 0);
         S = sp + j     * sstep;
         d = dp + (x+j) * dstep;
@@ -500,8 +556,10 @@ static av_always_inline void blend_plane(AVFilterContext *ctx,
                                          int main_has_alpha,
                                          int dst_plane,
                                          int dst_offset,
-                                         int dst_step)
+                                         int dst_step,
+                                         int jobnr, int nb_jobs)
 {
+    OverlayContext *octx = ctx->priv;
     int src_wp = AV_CEIL_RSHIFT(src_w, hsub);
     int src_hp = AV_CEIL_RSHIFT(src_h, vsub);
     int dst_wp = AV_CEIL_RSHIFT(dst_w, hsub);
@@ -510,21 +568,44 @@ static av_always_inline void blend_plane(AVFilterContext *ctx,
     int xp = x>>hsub;
     uint8_t *s, *sp, *d, *dp, *a, *ap;
     int jmax, j, k, kmax;
+    int slice_start, slice_end;
+
+    j    = FFMAX(-yp, 0);
+    jmax = FFMIN(-yp + dst_hp, src_hp);
+    slice_start = j + (jmax - j) *  jobnr      / nb_jobs;
+    slice_end   = j + (jmax - j) * (jobnr + 1) / nb_jobs;
 
-    j = FFMAX(-yp, 0);
-    sp = src->data[i] + j         * src->linesize[i];
+    sp = src->data[i] + slice_start         * src->linesize[i];
     dp = dst->data[dst_plane]
-                      + (yp+j)    * dst->linesize[dst_plane]
+                      + (yp+slice_start)    * dst->linesize[dst_plane]
                       + dst_offset;
-    ap = src->data[3] + (j<<vsub) * src->linesize[3];
+    ap = src->data[3] + (slice_start<<vsub) * src->linesize[3];
 
-    for (jmax = FFMIN(-yp + dst_hp, src_hp); j < jmax; j++) {
+    for (j = slice_start; j < slice_end; j++) {
         k = FFMAX(-xp, 0);
         d = dp + (xp+k) * dst_step;
         s = sp + k;
         a = ap + (k<<hsub);
+        kmax = FFMIN(-xp + dst_wp, src_wp);
+
+        // the optimized rows handle the pixels with all their alpha
+        // neighbours available, the edges are blended below
+        if (!main_has_alpha && dst_step == 1 && (hsub || !vsub)) {
+            int type = !hsub                       ? OVERLAY_ROW_444 :
+                       vsub && j+1 < src_hp        ? OVERLAY_ROW_420 :
+                                                     OVERLAY_ROW_422;
+            int w = kmax - k - (hsub && kmax == src_wp);
+
+            if (w > 0) {
+                int c = octx->dsp.blend_row[type](d, s, a, w, src->linesize[3]);
+                k += c;
+                d += c;
+                s += c;
+                a += c << hsub;
+            }
+        }
 
-        for (kmax = FFMIN(-xp + dst_wp, src_wp); k < kmax; k++) {
+        for (; k < kmax; k++) {
             int alpha_v, alpha_h, alpha;
 
             // average alpha for color components, improve quality
@@ -571,17 +652,23 @@ static av_always_inline void blend_plane(AVFilterContext *ctx,
 static inline void alpha_composite(const AVFrame *src, const AVFrame *dst,
                                    int src_w, int src_h,
                                    int dst_w, int dst_h,
-                                   int x, int y)
+                                   int x, int y,
+                                   int jobnr, int nb_jobs)
 {
     uint8_t alpha;          ///< the amount of overlay to blend on to main
     uint8_t *s, *sa, *d, *da;
     int i, imax, j, jmax;
+    int slice_start, slice_end;
+
+    i    = FFMAX(-y, 0);
+    imax = FFMIN(-y + dst_h, src_h);
+    slice_start = i + (imax - i) *  jobnr      / nb_jobs;
+    slice_end   = i + (imax - i) * (jobnr + 1) / nb_jobs;
 
-    i = FFMAX(-y, 0);
-    sa = src->data[3] + i     * src->linesize[3];
-    da = dst->data[3] + (y+i) * dst->linesize[3];
+    sa = src->data[3] + slice_start     * src->linesize[3];
+    da = dst->data[3] + (y+slice_start) * dst->linesize[3];
 
-    for (imax = FFMIN(-y + dst_h, src_h); i < imax; i++) {
+    for (i = slice_start; i < slice_end; i++) {
         j = FFMAX(-x, 0);
         s = sa + j;
         d = da + x+j;
@@ -614,7 +701,8 @@ static av_always_inline void blend_image_yuv(AVFilterContext *ctx,
                                              AVFrame *dst, const AVFrame *src,
                                              int hsub, int vsub,
                                              int main_has_alpha,
-                                             int x, int y)
+                                             int x, int y,
+                                             int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
     const int src_w = src->width;
@@ -623,21 +711,25 @@ static av_always_inline void blend_image_yuv(AVFilterContext *ctx,
     const int dst_h = dst->height;
 
     if (main_has_alpha)
-        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y);
+        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y, jobnr, nb_jobs);
 
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 0, 0,       0, x, y, main_has_alpha,
-                s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step);
+                s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step,
+                jobnr, nb_jobs);
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 1, hsub, vsub, x, y, main_has_alpha,
-                s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step);
+                s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step,
+                jobnr, nb_jobs);
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 2, hsub, vsub, x, y, main_has_alpha,
-                s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step);
+                s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step,
+                jobnr, nb_jobs);
 }
 
 static av_always_inline void blend_image_planar_rgb(AVFilterContext *ctx,
                                                     AVFrame *dst, const AVFrame *src,
                                                     int hsub, int vsub,
                                                     int main_has_alpha,
-                                                    int x, int y)
+                                                    int x, int y,
+                                                    int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
     const int src_w = src->width;
@@ -646,64 +738,97 @@ static av_always_inline void blend_image_planar_rgb(AVFilterContext *ctx,
     const int dst_h = dst->height;
 
     if (main_has_alpha)
-        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y);
+        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y, jobnr, nb_jobs);
 
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 0, 0,       0, x, y, main_has_alpha,
-                s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step);
+                s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step,
+                jobnr, nb_jobs);
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 1, hsub, vsub, x, y, main_has_alpha,
-                s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step);
+                s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step,
+                jobnr, nb_jobs);
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 2, hsub, vsub, x, y, main_has_alpha,
-                s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step);
+                s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step,
+                jobnr, nb_jobs);
 }
 
-static void blend_image_yuv420(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static int blend_slice_yuv420(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 1, 1, 0, x, y);
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+    blend_image_yuv(ctx, td->dst, td->src, 1, 1, 0, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
-static void blend_image_yuva420(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static int blend_slice_yuva420(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 1, 1, 1, x, y);
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+    blend_image_yuv(ctx, td->dst, td->src, 1, 1, 1, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
-static void blend_image_yuv422(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static int blend_slice_yuv422(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 1, 0, 0, x, y);
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+    blend_image_yuv(ctx, td->dst, td->src, 1, 0, 0, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
-static void blend_image_yuva422(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static int blend_slice_yuva422(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 1, 0, 1, x, y);
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+    blend_image_yuv(ctx, td->dst, td->src, 1, 0, 1, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
-static void blend_image_yuv444(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static int blend_slice_yuv444(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 0, 0, 0, x, y);
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+    blend_image_yuv(ctx, td->dst, td->src, 0, 0, 0, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
-static void blend_image_yuva444(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static int blend_slice_yuva444(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 0, 0, 1, x, y);
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+    blend_image_yuv(ctx, td->dst, td->src, 0, 0, 1, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
-static void blend_image_gbrp(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static int blend_slice_gbrp(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    blend_image_planar_rgb(ctx, dst, src, 0, 0, 0, x, y);
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+    blend_image_planar_rgb(ctx, td->dst, td->src, 0, 0, 0, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
-static void blend_image_gbrap(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static int blend_slice_gbrap(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    blend_image_planar_rgb(ctx, dst, src, 0, 0, 1, x, y);
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+    blend_image_planar_rgb(ctx, td->dst, td->src, 0, 0, 1, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
-static void blend_image_rgb(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static int blend_slice_rgb(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    blend_image_packed_rgb(ctx, dst, src, 0, x, y);
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+    blend_image_packed_rgb(ctx, td->dst, td->src, 0, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
-static void blend_image_rgba(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static int blend_slice_rgba(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    blend_image_packed_rgb(ctx, dst, src, 1, x, y);
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+    blend_image_packed_rgb(ctx, td->dst, td->src, 1, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
 static int config_input_main(AVFilterLink *inlink)
@@ -723,39 +848,39 @@ static int config_input_main(AVFilterLink *inlink)
     s->main_has_alpha = ff_fmt_is_in(inlink->format, alpha_pix_fmts);
     switch (s->format) {
     case OVERLAY_FORMAT_YUV420:
-        s->blend_image = s->main_has_alpha ? blend_image_yuva420 : blend_image_yuv420;
+        s->blend_slice = s->main_has_alpha ? blend_slice_yuva420 : blend_slice_yuv420;
         break;
     case OVERLAY_FORMAT_YUV422:
-        s->blend_image = s->main_has_alpha ? blend_image_yuva422 : blend_image_yuv422;
+        s->blend_slice = s->main_has_alpha ? blend_slice_yuva422 : blend_slice_yuv422;
         break;
     case OVERLAY_FORMAT_YUV444:
-        s->blend_image = s->main_has_alpha ? blend_image_yuva444 : blend_image_yuv444;
+        s->blend_slice = s->main_has_alpha ? blend_slice_yuva444 : blend_slice_yuv444;
         break;
     case OVERLAY_FORMAT_RGB:
-        s->blend_image = s->main_has_alpha ? blend_image_rgba : blend_image_rgb;
+        s->blend_slice = s->main_has_alpha ? blend_slice_rgba : blend_slice_rgb;
         break;
     case OVERLAY_FORMAT_GBRP:
-        s->blend_image = s->main_has_alpha ? blend_image_gbrap : blend_image_gbrp;
+        s->blend_slice = s->main_has_alpha ? blend_slice_gbrap : blend_slice_gbrp;
         break;
     case OVERLAY_FORMAT_AUTO:
         switch (inlink->format) {
         case AV_PIX_FMT_YUVA420P:
-            s->blend_image = blend_image_yuva420;
+            s->blend_slice = blend_slice_yuva420;
             break;
         case AV_PIX_FMT_YUVA422P:
-            s->blend_image = blend_image_yuva422;
+            s->blend_slice = blend_slice_yuva422;
             break;
         case AV_PIX_FMT_YUVA444P:
-            s->blend_image = blend_image_yuva444;
+            s->blend_slice = blend_slice_yuva444;
             break;
         case AV_PIX_FMT_ARGB:
         case AV_PIX_FMT_RGBA:
         case AV_PIX_FMT_BGRA:
         case AV_PIX_FMT_ABGR:
-            s->blend_image = blend_image_rgba;
+            s->blend_slice = blend_slice_rgba;
             break;
         case AV_PIX_FMT_GBRAP:
-            s->blend_image = blend_image_gbrap;
+            s->blend_slice = blend_slice_gbrap;
             break;
         default:
             av_assert0(0);
@@ -793,8 +918,17 @@ static AVFrame *do_blend(AVFilterContext *ctx, AVFrame *mainpic,
     }
 
     if (s->x < mainpic->width  && s->x + second->width  >= 0 ||
-        s->y < mainpic->height && s->y + second->height >= 0)
-        s->blend_image(ctx, mainpic, second, s->x, s->y);
+        s->y < mainpic->height && s->y + second->height >= 0) {
+        ThreadData td = { .dst = mainpic, .src = second };
+        int nb_jobs = FFMAX(1, FFMIN(second->height, ff_filter_get_nb_threads(ctx)));
+
+        /* the un-premultiplied alpha of vertically subsampled chroma is
+         * averaged over two rows of the main picture */
+        if (s->main_has_alpha && s->vsub)
+            nb_jobs = 1;
+
+        ctx->internal->execute(ctx, s->blend_slice, &td, NULL, nb_jobs);
+    }
     return mainpic;
 }
 
@@ -825,6 +959,7 @@ static av_cold int init(AVFilterContext *ctx)
     }
 
     s->dinput.process = do_blend;
+    ff_overlay_dsp_init(&s->dsp);
     return 0;
 }
 
@@ -895,5 +1030,6 @@ AVFilter ff_vf_overlay = {
     .process_command = process_command,
     .inputs        = avfilter_vf_overlay_inputs,
     .outputs       = avfilter_vf_overlay_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL |
+                     AVFILTER_FLAG_SLICE_THREADS,
 };
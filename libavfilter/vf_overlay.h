@@ -0,0 +1,55 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_OVERLAY_H
+#define AVFILTER_OVERLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum OverlayRowType {
+    OVERLAY_ROW_444,            ///< alpha plane has the same size as the plane
+    OVERLAY_ROW_422,            ///< alpha plane is horizontally subsampled by 2
+    OVERLAY_ROW_420,            ///< alpha plane is subsampled by 2 in both directions
+    OVERLAY_ROW_NB
+};
+
+typedef struct OverlayDSPContext {
+    /**
+     * Blend one row of an 8-bit plane of the overlay onto the main picture,
+     * using a straight (non premultiplied) alpha:
+     * d = (d * (255 - alpha) + s * alpha) / 255
+     *
+     * @param d         destination row, the main picture
+     * @param s         source row, the overlay
+     * @param a         alpha row, at the full overlay resolution; for
+     *                  subsampled planes it is averaged over the 2 or 4
+     *                  luma positions of each chroma pixel
+     * @param w         number of pixels to blend
+     * @param alinesize line size of the alpha plane
+     * @return the number of pixels which were blended from the start of the
+     *         row, the caller must blend the remaining ones
+     */
+    int (*blend_row[OVERLAY_ROW_NB])(uint8_t *d, const uint8_t *s,
+                                     const uint8_t *a, int w,
+                                     ptrdiff_t alinesize);
+} OverlayDSPContext;
+
+void ff_overlay_dsp_init(OverlayDSPContext *dsp);
+
+#endif /* AVFILTER_OVERLAY_H */
@@ -1241,6 +1241,17 @@ typedef struct AVStream {
      * - muxing: filled by the caller before avformat_write_header()
      */
     AVCodecParameters *codecpar;
+
+    /**
+     * Number of packets and bytes of this stream read by
+     * avformat_find_stream_info() until the codec parameters of the stream
+     * were complete. If they never were, all the packets read are counted.
+     *
+     * - demuxing: set by avformat_find_stream_info()
+     * - muxing: unused
+     */
+    int     info_nb_packets;
+    int64_t info_nb_bytes;
 } AVStream;
 
 AVRational av_stream_get_r_frame_rate(const AVStream *s);
@@ -1917,6 +1928,23 @@ typedef struct AVFormatContext {
      * - decoding: set by user
      */
     int max_streams;
+
+    /**
+     * Number of threads used by avformat_find_stream_info() to decode the
+     * packets of different streams at the same time.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    int info_threads;
+
+    /**
+     * Directory storing the results of format probing and
+     * avformat_find_stream_info() for each input, so that opening the same
+     * input again skips them.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    char *probe_cache_dir;
 } AVFormatContext;
 
 /**
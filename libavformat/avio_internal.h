@@ -105,6 +105,15 @@ int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size);
 
 int ffio_limit(AVIOContext *s, int size);
 
+/**
+ * Consume size bytes from s and return them as a reference to the storage
+ * of the underlying protocol, see ffurl_get_buffer_ref().
+ *
+ * @return size on success, AVERROR(ENOSYS) if s or its protocol does not
+ *         support it, another negative error code on failure
+ */
+int ffio_read_buffer_ref(AVIOContext *s, int size, AVBufferRef **buf, uint8_t **data);
+
 void ffio_init_checksum(AVIOContext *s,
                         unsigned long (*update_checksum)(unsigned long c, const uint8_t *p, unsigned int len),
                         unsigned long checksum);
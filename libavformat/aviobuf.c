@@ -22,16 +22,22 @@
 #include "libavutil/bprint.h"
 #include "libavutil/crc.h"
 #include "libavutil/dict.h"
+#include "libavutil/fifo.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
 #include "libavutil/avassert.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
 #include "avformat.h"
 #include "avio.h"
 #include "avio_internal.h"
 #include "internal.h"
 #include "url.h"
 #include <stdarg.h>
+#if HAVE_THREADS
+#include <stdatomic.h>
+#endif
 
 #define IO_BUFFER_SIZE 32768
 
@@ -44,6 +50,8 @@
 
 typedef struct AVIOInternal {
     URLContext *h;
+    struct ReadAhead *ra;
+    struct ReadAheadInterrupt *interrupt;
 } AVIOInternal;
 
 static void *ff_avio_child_next(void *obj, void *prev)
@@ -906,6 +914,334 @@ static int64_t io_read_seek(void *opaque, int stream_index, int64_t timestamp, i
     return internal->h->prot->url_read_seek(internal->h, stream_index, timestamp, flags);
 }
 
+#if HAVE_THREADS
+/* Read-ahead: a thread reads from the protocol into a FIFO ahead of the
+ * consumer, keeping about READAHEAD_SECONDS of data buffered based on the
+ * observed consumption rate, and more when the consumer had to wait. */
+
+#define READAHEAD_BLOCK_SIZE  (32 * 1024)
+#define READAHEAD_MIN_WINDOW  (64 * 1024)
+#define READAHEAD_RATE_PERIOD 250000
+#define READAHEAD_SECONDS     1
+
+typedef struct ReadAhead {
+    URLContext *h;
+    AVFifoBuffer *fifo;
+    uint8_t *block;
+    int size;                ///< maximum amount of data read ahead
+    int window;              ///< amount of data currently read ahead
+    int64_t pos;             ///< stream position of the first byte in the fifo
+    int64_t file_size;
+    int short_seek;
+    int eof;
+    int error;
+
+    int seek_request;
+    int64_t seek_pos;
+    int64_t seek_ret;
+    int abort_request;
+
+    int64_t consumed;
+    int64_t rate;            ///< consumption rate in bytes per second
+    int64_t rate_time;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} ReadAhead;
+
+/* Interrupt callback of the URLContexts opened by ffio_open_whitelist(), so
+ * that the read-ahead thread can be stopped while blocked in the protocol.
+ * Nested protocols copy the callback when they are opened, so it has to be
+ * installed before the URLContext is opened. */
+typedef struct ReadAheadInterrupt {
+    AVIOInterruptCB cb;      ///< callback of the caller
+    atomic_int quit;
+} ReadAheadInterrupt;
+
+static int readahead_interrupt_cb(void *opaque)
+{
+    ReadAheadInterrupt *ri = opaque;
+    return atomic_load(&ri->quit) || ff_check_interrupt(&ri->cb);
+}
+
+static void *readahead_thread(void *arg)
+{
+    ReadAhead *ra = arg;
+
+    pthread_mutex_lock(&ra->lock);
+    while (!ra->abort_request) {
+        int64_t ret;
+        int to_read;
+
+        if (ra->seek_request) {
+            int64_t pos = ra->seek_pos;
+
+            pthread_mutex_unlock(&ra->lock);
+            ret = ffurl_seek(ra->h, pos, SEEK_SET);
+            pthread_mutex_lock(&ra->lock);
+
+            /* on failure the fifo still follows ra->pos and is kept */
+            if (ret >= 0) {
+                av_fifo_reset(ra->fifo);
+                ra->pos   = ret;
+                ra->eof   = 0;
+                ra->error = 0;
+            }
+            ra->seek_ret     = ret;
+            ra->seek_request = 0;
+            pthread_cond_broadcast(&ra->cond);
+            continue;
+        }
+
+        /* refill in whole blocks rather than after every consumer read */
+        to_read = ra->window - av_fifo_size(ra->fifo);
+        if (ra->eof || ra->error || to_read <= 0 ||
+            to_read < FFMIN(READAHEAD_BLOCK_SIZE, ra->window / 2)) {
+            pthread_cond_wait(&ra->cond, &ra->lock);
+            continue;
+        }
+        to_read = FFMIN(to_read, READAHEAD_BLOCK_SIZE);
+
+        pthread_mutex_unlock(&ra->lock);
+        ret = ffurl_read(ra->h, ra->block, to_read);
+        pthread_mutex_lock(&ra->lock);
+
+        /* a seek requested in the meantime is only performed on the next
+         * iteration, so the data read is always stored first */
+        if (ret == 0 || ret == AVERROR_EOF)
+            ra->eof = 1;
+        else if (ret < 0)
+            ra->error = ret;
+        else
+            av_fifo_generic_write(ra->fifo, ra->block, ret, NULL);
+        pthread_cond_broadcast(&ra->cond);
+    }
+    pthread_mutex_unlock(&ra->lock);
+
+    return NULL;
+}
+
+static void readahead_update_window(ReadAhead *ra, int stalled)
+{
+    int64_t now = av_gettime_relative();
+    int64_t window = ra->window;
+
+    if (stalled)
+        window *= 2;
+
+    if (now - ra->rate_time >= READAHEAD_RATE_PERIOD) {
+        int64_t rate = ra->consumed * 1000000 / (now - ra->rate_time);
+        ra->rate      = (3 * ra->rate + rate) / 4;
+        ra->consumed  = 0;
+        ra->rate_time = now;
+        /* follow the rate up at once, but shrink slowly */
+        window = FFMAX(ra->rate * READAHEAD_SECONDS, window - window / 8);
+    }
+
+    ra->window = av_clip64(window, FFMIN(READAHEAD_MIN_WINDOW, ra->size), ra->size);
+}
+
+static int readahead_read(void *opaque, uint8_t *buf, int size)
+{
+    AVIOInternal *internal = opaque;
+    ReadAhead *ra = internal->ra;
+    int stalled = 0;
+    int ret;
+
+    pthread_mutex_lock(&ra->lock);
+    while (!(ret = av_fifo_size(ra->fifo)) && !ra->eof && !ra->error) {
+        int64_t t = av_gettime() + 100000;
+        struct timespec tv = { .tv_sec  =  t / 1000000,
+                               .tv_nsec = (t % 1000000) * 1000 };
+        if (ff_check_interrupt(&internal->interrupt->cb)) {
+            pthread_mutex_unlock(&ra->lock);
+            return AVERROR_EXIT;
+        }
+        stalled = 1;
+        pthread_cond_timedwait(&ra->cond, &ra->lock, &tv);
+    }
+    if (ret) {
+        ret = FFMIN(ret, size);
+        av_fifo_generic_read(ra->fifo, buf, ret, NULL);
+        ra->pos      += ret;
+        ra->consumed += ret;
+    } else {
+        ret = ra->error ? ra->error : AVERROR_EOF;
+    }
+    readahead_update_window(ra, stalled);
+    pthread_cond_broadcast(&ra->cond);
+    pthread_mutex_unlock(&ra->lock);
+
+    return ret;
+}
+
+static int64_t readahead_seek(void *opaque, int64_t offset, int whence)
+{
+    AVIOInternal *internal = opaque;
+    ReadAhead *ra = internal->ra;
+    int64_t ret;
+
+    if (whence == AVSEEK_SIZE)
+        return ra->file_size;
+    if (whence == SEEK_END && ra->file_size >= 0)
+        offset += ra->file_size;
+    else if (whence != SEEK_SET)
+        return AVERROR(EINVAL);
+
+    pthread_mutex_lock(&ra->lock);
+    if (offset >= ra->pos && offset - ra->pos <= av_fifo_size(ra->fifo)) {
+        /* already read ahead, no need to touch the protocol */
+        av_fifo_drain(ra->fifo, offset - ra->pos);
+        ra->pos = offset;
+        ret     = offset;
+    } else {
+        ra->seek_request = 1;
+        ra->seek_pos     = offset;
+        pthread_cond_broadcast(&ra->cond);
+        while (ra->seek_request)
+            pthread_cond_wait(&ra->cond, &ra->lock);
+        ret = ra->seek_ret;
+    }
+    pthread_cond_broadcast(&ra->cond);
+    pthread_mutex_unlock(&ra->lock);
+
+    return ret;
+}
+
+static int readahead_short_seek(void *opaque)
+{
+    AVIOInternal *internal = opaque;
+    return internal->ra->short_seek;
+}
+
+static void readahead_free(AVIOInternal *internal)
+{
+    ReadAhead *ra = internal->ra;
+
+    if (!ra)
+        return;
+
+    pthread_mutex_lock(&ra->lock);
+    ra->abort_request = 1;
+    pthread_cond_broadcast(&ra->cond);
+    pthread_mutex_unlock(&ra->lock);
+    /* interrupt a read or seek the thread is blocked in */
+    atomic_store(&internal->interrupt->quit, 1);
+    pthread_join(ra->thread, NULL);
+
+    pthread_cond_destroy(&ra->cond);
+    pthread_mutex_destroy(&ra->lock);
+    av_fifo_freep(&ra->fifo);
+    av_freep(&ra->block);
+    av_freep(&internal->ra);
+}
+
+static int readahead_init(AVIOInternal *internal)
+{
+    URLContext *h = internal->h;
+    ReadAhead *ra;
+    int ret;
+
+    ra = av_mallocz(sizeof(*ra));
+    if (!ra)
+        return AVERROR(ENOMEM);
+
+    ra->h          = h;
+    ra->size       = FFMAX(h->readahead_size, READAHEAD_BLOCK_SIZE);
+    ra->window     = FFMIN(4 * READAHEAD_MIN_WINDOW, ra->size);
+    ra->file_size  = ffurl_size(h);
+    ra->short_seek = ffurl_get_short_seek(h);
+    ra->pos        = ffurl_seek(h, 0, SEEK_CUR);
+    ra->rate_time  = av_gettime_relative();
+    if (ra->pos < 0)
+        ra->pos = 0;
+
+    ra->fifo  = av_fifo_alloc(ra->size);
+    ra->block = av_malloc(READAHEAD_BLOCK_SIZE);
+    if (!ra->fifo || !ra->block) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    if ((ret = pthread_mutex_init(&ra->lock, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&ra->cond, NULL))) {
+        pthread_mutex_destroy(&ra->lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_create(&ra->thread, NULL, readahead_thread, ra))) {
+        pthread_cond_destroy(&ra->cond);
+        pthread_mutex_destroy(&ra->lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    internal->ra = ra;
+    return 0;
+fail:
+    av_fifo_freep(&ra->fifo);
+    av_freep(&ra->block);
+    av_free(ra);
+    return ret;
+}
+
+static void readahead_start(AVIOContext *s, ReadAheadInterrupt *ri)
+{
+    AVIOInternal *internal = s->opaque;
+    URLContext *h = internal->h;
+    int ret;
+
+    internal->interrupt = ri;
+    if (h->readahead_size <= 0 || (h->flags & AVIO_FLAG_WRITE) ||
+        h->prot->url_read_pause || h->prot->url_read_seek)
+        return;
+
+    ret = readahead_init(internal);
+    if (ret < 0) {
+        av_log(h, AV_LOG_WARNING, "Could not start read-ahead: %s\n", av_err2str(ret));
+        return;
+    }
+    s->read_packet    = readahead_read;
+    s->seek           = readahead_seek;
+    s->short_seek_get = readahead_short_seek;
+}
+#endif /* HAVE_THREADS */
+
+int ffio_read_buffer_ref(AVIOContext *s, int size, AVBufferRef **buf, uint8_t **data)
+{
+    AVIOInternal *internal = s->opaque;
+    int available = s->buf_end - s->buf_ptr;
+    int64_t pos = avio_tell(s);
+    int64_t ret;
+
+    if (s->read_packet != io_read_packet || s->write_flag ||
+        s->update_checksum || size <= 0 || pos < 0)
+        return AVERROR(ENOSYS);
+
+    ret = ffurl_get_buffer_ref(internal->h, pos, size, buf, data);
+    if (ret < 0)
+        return ret;
+
+    if (size <= available) {
+        s->buf_ptr += size;
+    } else {
+        if ((ret = s->seek(s->opaque, pos + size, SEEK_SET)) < 0) {
+            av_buffer_unref(buf);
+            return ret;
+        }
+        s->buf_end =
+        s->buf_ptr = s->buf_ptr_max = s->buffer;
+        s->pos = pos + size;
+        s->eof_reached = 0;
+        s->bytes_read += size - available;
+    }
+    return size;
+}
+
 int ffio_fdopen(AVIOContext **s, URLContext *h)
 {
     AVIOInternal *internal = NULL;
@@ -957,6 +1293,7 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
     }
     (*s)->short_seek_get = io_short_seek;
     (*s)->av_class = &ff_avio_class;
+
     return 0;
 fail:
     av_freep(&internal);
@@ -1078,16 +1415,41 @@ int ffio_open_whitelist(AVIOContext **s, const char *filename, int flags,
 {
     URLContext *h;
     int err;
+#if HAVE_THREADS
+    ReadAheadInterrupt *ri = NULL;
+    AVIOInterruptCB readahead_cb;
+
+    if (!(flags & AVIO_FLAG_WRITE)) {
+        ri = av_mallocz(sizeof(*ri));
+        if (!ri)
+            return AVERROR(ENOMEM);
+        if (int_cb)
+            ri->cb = *int_cb;
+        atomic_init(&ri->quit, 0);
+        readahead_cb.callback = readahead_interrupt_cb;
+        readahead_cb.opaque   = ri;
+        int_cb = &readahead_cb;
+    }
+#endif
 
     err = ffurl_open_whitelist(&h, filename, flags, int_cb, options, whitelist, blacklist, NULL);
     if (err < 0)
-        return err;
+        goto fail;
     err = ffio_fdopen(s, h);
     if (err < 0) {
         ffurl_close(h);
-        return err;
+        goto fail;
     }
+#if HAVE_THREADS
+    if (ri)
+        readahead_start(*s, ri);
+#endif
     return 0;
+fail:
+#if HAVE_THREADS
+    av_free(ri);
+#endif
+    return err;
 }
 
 int avio_open2(AVIOContext **s, const char *filename, int flags,
@@ -1106,14 +1468,20 @@ int avio_close(AVIOContext *s)
 {
     AVIOInternal *internal;
     URLContext *h;
+    struct ReadAheadInterrupt *interrupt;
+    int ret;
 
     if (!s)
         return 0;
 
     avio_flush(s);
-    internal = s->opaque;
-    h        = internal->h;
+    internal  = s->opaque;
+    h         = internal->h;
+    interrupt = internal->interrupt;
 
+#if HAVE_THREADS
+    readahead_free(internal);
+#endif
     av_freep(&s->opaque);
     av_freep(&s->buffer);
     if (s->write_flag)
@@ -1122,7 +1490,10 @@ int avio_close(AVIOContext *s)
         av_log(s, AV_LOG_DEBUG, "Statistics: %"PRId64" bytes read, %d seeks\n", s->bytes_read, s->seek_count);
     av_opt_free(s);
     av_free(s);
-    return ffurl_close(h);
+    /* the URLContext and its nested protocols use the interrupt callback */
+    ret = ffurl_close(h);
+    av_free(interrupt);
+    return ret;
 }
 
 int avio_closep(AVIOContext **s)
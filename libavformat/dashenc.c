@@ -76,6 +76,13 @@ typedef struct OutputStream {
     char bandwidth_str[64];
 
     char codec_str[100];
+
+    /* The segment being written */
+    char segfile[1024], full_path[1024], temp_path[1024];
+    int64_t seg_start_pos;
+    /* Chunks of the segment already written out, in chunked mode */
+    int chunks_written;
+    int64_t chunk_start_pts;
 } OutputStream;
 
 typedef struct DASHContext {
@@ -83,6 +90,7 @@ typedef struct DASHContext {
     int window_size;
     int extra_window_size;
     int min_seg_duration;
+    int64_t chunk_duration;
     int remove_at_exit;
     int use_template;
     int use_timeline;
@@ -99,8 +107,15 @@ typedef struct DASHContext {
     AVRational min_frame_rate, max_frame_rate;
     int ambiguous_frame_rate;
     const char *utc_timing_url;
+    int http_persistent;
 } DASHContext;
 
+static void set_http_options(AVDictionary **options, DASHContext *c)
+{
+    if (c->http_persistent)
+        av_dict_set_int(options, "connection_pool", 1, 0);
+}
+
 static int dash_write(void *opaque, uint8_t *buf, int buf_size)
 {
     OutputStream *os = opaque;
@@ -197,7 +212,21 @@ static void dash_free(AVFormatContext *s)
     av_freep(&c->streams);
 }
 
-static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext *c)
+/* In chunked mode, segments may be requested as soon as their first chunk
+ * is written. */
+static void write_availability_offset(AVIOContext *out, DASHContext *c, int final)
+{
+    int64_t offset;
+
+    if (!c->chunk_duration || final)
+        return;
+    offset = FFMAX(FFMAX(c->last_duration, c->min_seg_duration) - c->chunk_duration, 0);
+    avio_printf(out, "availabilityTimeOffset=\"%.3f\" availabilityTimeComplete=\"false\" ",
+                offset / (double)AV_TIME_BASE);
+}
+
+static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext *c,
+                                int final)
 {
     int i, start_index = 0, start_number = 1;
     if (c->window_size) {
@@ -210,6 +239,7 @@ static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext
         avio_printf(out, "\t\t\t\t<SegmentTemplate timescale=\"%d\" ", timescale);
         if (!c->use_timeline)
             avio_printf(out, "duration=\"%"PRId64"\" ", c->last_duration);
+        write_availability_offset(out, c, final);
         avio_printf(out, "initialization=\"%s\" media=\"%s\" startNumber=\"%d\">\n", c->init_seg_name, c->media_seg_name, c->use_timeline ? start_number : 1);
         if (c->use_timeline) {
             int64_t cur_time = 0;
@@ -249,7 +279,9 @@ static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext
         }
         avio_printf(out, "\t\t\t\t</SegmentList>\n");
     } else {
-        avio_printf(out, "\t\t\t\t<SegmentList timescale=\"%d\" duration=\"%"PRId64"\" startNumber=\"%d\">\n", AV_TIME_BASE, c->last_duration, start_number);
+        avio_printf(out, "\t\t\t\t<SegmentList timescale=\"%d\" duration=\"%"PRId64"\" ", AV_TIME_BASE, c->last_duration);
+        write_availability_offset(out, c, final);
+        avio_printf(out, "startNumber=\"%d\">\n", start_number);
         avio_printf(out, "\t\t\t\t\t<Initialization sourceURL=\"%s\" />\n", os->initfile);
         for (i = start_index; i < os->nb_segments; i++) {
             Segment *seg = os->segments[i];
@@ -443,6 +475,7 @@ static int write_manifest(AVFormatContext *s, int final)
 {
     DASHContext *c = s->priv_data;
     AVIOContext *out;
+    AVDictionary *opts = NULL;
     char temp_filename[1024];
     int ret, i, as_id = 0;
     const char *proto = avio_find_protocol_name(s->filename);
@@ -454,7 +487,9 @@ static int write_manifest(AVFormatContext *s, int final)
         av_log(s, AV_LOG_ERROR, "Cannot use rename on non file protocol, this may lead to races and temporary partial files\n");
 
     snprintf(temp_filename, sizeof(temp_filename), use_rename ? "%s.tmp" : "%s", s->filename);
-    ret = s->io_open(s, &out, temp_filename, AVIO_FLAG_WRITE, NULL);
+    set_http_options(&opts, c);
+    ret = s->io_open(s, &out, temp_filename, AVIO_FLAG_WRITE, &opts);
+    av_dict_free(&opts);
     if (ret < 0) {
         av_log(s, AV_LOG_ERROR, "Unable to open %s for writing\n", temp_filename);
         return ret;
@@ -533,7 +568,7 @@ static int write_manifest(AVFormatContext *s, int final)
                 avio_printf(out, " frameRate=\"%d/%d\"", st->avg_frame_rate.num, st->avg_frame_rate.den);
             avio_printf(out, ">\n");
 
-            output_segment_list(&c->streams[i], out, c);
+            output_segment_list(&c->streams[i], out, c, final);
             avio_printf(out, "\t\t\t</Representation>\n");
         }
         avio_printf(out, "\t\t</AdaptationSet>\n");
@@ -549,7 +584,7 @@ static int write_manifest(AVFormatContext *s, int final)
 
             avio_printf(out, "\t\t\t<Representation id=\"%d\" mimeType=\"audio/mp4\" codecs=\"%s\"%s audioSamplingRate=\"%d\">\n", i, os->codec_str, os->bandwidth_str, st->codecpar->sample_rate);
             avio_printf(out, "\t\t\t\t<AudioChannelConfiguration schemeIdUri=\"urn:mpeg:dash:23003:3:audio_channel_configuration:2011\" value=\"%d\" />\n", st->codecpar->channels);
-            output_segment_list(&c->streams[i], out, c);
+            output_segment_list(&c->streams[i], out, c, final);
             avio_printf(out, "\t\t\t</Representation>\n");
         }
         avio_printf(out, "\t\t</AdaptationSet>\n");
@@ -601,6 +636,10 @@ static int dash_init(AVFormatContext *s)
         c->single_file = 1;
     if (c->single_file)
         c->use_template = 0;
+    if (c->single_file && c->chunk_duration) {
+        av_log(s, AV_LOG_WARNING, "Chunked segments are not supported with single_file, disabling\n");
+        c->chunk_duration = 0;
+    }
     c->ambiguous_frame_rate = 0;
 
     av_strlcpy(c->dirname, s->filename, sizeof(c->dirname));
@@ -667,7 +706,9 @@ static int dash_init(AVFormatContext *s)
             dash_fill_tmpl_params(os->initfile, sizeof(os->initfile), c->init_seg_name, i, 0, os->bit_rate, 0);
         }
         snprintf(filename, sizeof(filename), "%s%s", c->dirname, os->initfile);
-        ret = s->io_open(s, &os->out, filename, AVIO_FLAG_WRITE, NULL);
+        set_http_options(&opts, c);
+        ret = s->io_open(s, &os->out, filename, AVIO_FLAG_WRITE, &opts);
+        av_dict_free(&opts);
         if (ret < 0)
             return ret;
         os->init_start_pos = 0;
@@ -822,13 +863,81 @@ static int update_stream_extradata(AVFormatContext *s, OutputStream *os,
     return 0;
 }
 
+static void write_init_segment(AVFormatContext *s, OutputStream *os)
+{
+    DASHContext *c = s->priv_data;
+
+    av_write_frame(os->ctx, NULL);
+    os->init_range_length = avio_tell(os->ctx->pb);
+    if (!c->single_file)
+        ff_format_io_close(s, &os->out);
+}
+
+static int start_segment(AVFormatContext *s, OutputStream *os, int i, int use_rename)
+{
+    DASHContext *c = s->priv_data;
+    AVDictionary *opts = NULL;
+    int ret;
+
+    os->seg_start_pos = avio_tell(os->ctx->pb);
+    if (c->single_file) {
+        os->segfile[0] = '\0';
+        if (snprintf(os->full_path, sizeof(os->full_path), "%s%s",
+                     c->dirname, os->initfile) >= sizeof(os->full_path))
+            goto too_long;
+        return 0;
+    }
+
+    dash_fill_tmpl_params(os->segfile, sizeof(os->segfile), c->media_seg_name, i, os->segment_index, os->bit_rate, os->start_pts);
+    if (snprintf(os->full_path, sizeof(os->full_path), "%s%s",
+                 c->dirname, os->segfile) >= sizeof(os->full_path) ||
+        snprintf(os->temp_path, sizeof(os->temp_path), use_rename ? "%s.tmp" : "%s",
+                 os->full_path) >= sizeof(os->temp_path))
+        goto too_long;
+    set_http_options(&opts, c);
+    ret = s->io_open(s, &os->out, os->temp_path, AVIO_FLAG_WRITE, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+    write_styp(os->ctx->pb);
+    return 0;
+
+too_long:
+    av_log(s, AV_LOG_ERROR, "Segment path too long in representation %d\n", i);
+    return AVERROR(EINVAL);
+}
+
+/**
+ * Write the packets of the current segment buffered so far as a fragment,
+ * and push it to the segment output right away.
+ */
+static int write_chunk(AVFormatContext *s, int i)
+{
+    OutputStream *os = &((DASHContext *)s->priv_data)->streams[i];
+    int ret;
+
+    if (!os->init_range_length)
+        write_init_segment(s, os);
+
+    /* The segment is written under its final name, so that it can be read
+     * while it is being produced. */
+    if (!os->chunks_written && (ret = start_segment(s, os, i, 0)) < 0)
+        return ret;
+
+    av_write_frame(os->ctx, NULL);
+    avio_flush(os->ctx->pb);
+    avio_flush(os->out);
+    os->chunks_written++;
+    return 0;
+}
+
 static int dash_flush(AVFormatContext *s, int final, int stream)
 {
     DASHContext *c = s->priv_data;
     int i, ret = 0;
 
     const char *proto = avio_find_protocol_name(s->filename);
-    int use_rename = proto && !strcmp(proto, "file");
+    int use_rename = proto && !strcmp(proto, "file") && !c->chunk_duration;
 
     int cur_flush_segment_index = 0;
     if (stream >= 0)
@@ -836,8 +945,6 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
 
     for (i = 0; i < s->nb_streams; i++) {
         OutputStream *os = &c->streams[i];
-        char filename[1024] = "", full_path[1024], temp_path[1024];
-        int64_t start_pos;
         int range_length, index_length = 0;
 
         if (!os->packets_written)
@@ -855,45 +962,31 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
                 continue;
         }
 
-        if (!os->init_range_length) {
-            av_write_frame(os->ctx, NULL);
-            os->init_range_length = avio_tell(os->ctx->pb);
-            if (!c->single_file)
-                ff_format_io_close(s, &os->out);
-        }
-
-        start_pos = avio_tell(os->ctx->pb);
+        if (!os->init_range_length)
+            write_init_segment(s, os);
 
-        if (!c->single_file) {
-            dash_fill_tmpl_params(filename, sizeof(filename), c->media_seg_name, i, os->segment_index, os->bit_rate, os->start_pts);
-            snprintf(full_path, sizeof(full_path), "%s%s", c->dirname, filename);
-            snprintf(temp_path, sizeof(temp_path), use_rename ? "%s.tmp" : "%s", full_path);
-            ret = s->io_open(s, &os->out, temp_path, AVIO_FLAG_WRITE, NULL);
-            if (ret < 0)
-                break;
-            write_styp(os->ctx->pb);
-        } else {
-            snprintf(full_path, sizeof(full_path), "%s%s", c->dirname, os->initfile);
-        }
+        if (!os->chunks_written && (ret = start_segment(s, os, i, use_rename)) < 0)
+            break;
 
         av_write_frame(os->ctx, NULL);
         avio_flush(os->ctx->pb);
         os->packets_written = 0;
+        os->chunks_written  = 0;
 
-        range_length = avio_tell(os->ctx->pb) - start_pos;
+        range_length = avio_tell(os->ctx->pb) - os->seg_start_pos;
         if (c->single_file) {
-            find_index_range(s, full_path, start_pos, &index_length);
+            find_index_range(s, os->full_path, os->seg_start_pos, &index_length);
         } else {
             ff_format_io_close(s, &os->out);
 
             if (use_rename) {
-                ret = avpriv_io_move(temp_path, full_path);
+                ret = avpriv_io_move(os->temp_path, os->full_path);
                 if (ret < 0)
                     break;
             }
         }
-        add_segment(os, filename, os->start_pts, os->max_pts - os->start_pts, start_pos, range_length, index_length);
-        av_log(s, AV_LOG_VERBOSE, "Representation %d media segment %d written to: %s\n", i, os->segment_index, full_path);
+        add_segment(os, os->segfile, os->start_pts, os->max_pts - os->start_pts, os->seg_start_pos, range_length, index_length);
+        av_log(s, AV_LOG_VERBOSE, "Representation %d media segment %d written to: %s\n", i, os->segment_index, os->full_path);
     }
 
     if (c->window_size || (final && c->remove_at_exit)) {
@@ -987,6 +1080,13 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
             os->start_pts = os->max_pts;
         else
             os->start_pts = pkt->pts;
+        os->chunk_start_pts = pkt->pts;
+    } else if (c->chunk_duration &&
+               av_compare_ts(pkt->pts - os->chunk_start_pts, st->time_base,
+                             c->chunk_duration, AV_TIME_BASE_Q) >= 0) {
+        if ((ret = write_chunk(s, pkt->stream_index)) < 0)
+            return ret;
+        os->chunk_start_pts = pkt->pts;
     }
     if (os->max_pts == AV_NOPTS_VALUE)
         os->max_pts = pkt->pts + pkt->duration;
@@ -1059,6 +1159,7 @@ static const AVOption options[] = {
     { "window_size", "number of segments kept in the manifest", OFFSET(window_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, E },
     { "extra_window_size", "number of segments kept outside of the manifest before removing from disk", OFFSET(extra_window_size), AV_OPT_TYPE_INT, { .i64 = 5 }, 0, INT_MAX, E },
     { "min_seg_duration", "minimum segment duration (in microseconds)", OFFSET(min_seg_duration), AV_OPT_TYPE_INT64, { .i64 = 5000000 }, 0, INT_MAX, E },
+    { "seg_chunk_duration", "write segments out in chunks of this duration (in microseconds) while they are produced", OFFSET(chunk_duration), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E },
     { "remove_at_exit", "remove all segments when finished", OFFSET(remove_at_exit), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     { "use_template", "Use SegmentTemplate instead of SegmentList", OFFSET(use_template), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, E },
     { "use_timeline", "Use SegmentTimeline in SegmentTemplate", OFFSET(use_timeline), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, E },
@@ -1067,6 +1168,7 @@ static const AVOption options[] = {
     { "init_seg_name", "DASH-templated name to used for the initialization segment", OFFSET(init_seg_name), AV_OPT_TYPE_STRING, {.str = "init-stream$RepresentationID$.m4s"}, 0, 0, E },
     { "media_seg_name", "DASH-templated name to used for the media segments", OFFSET(media_seg_name), AV_OPT_TYPE_STRING, {.str = "chunk-stream$RepresentationID$-$Number%05d$.m4s"}, 0, 0, E },
     { "utc_timing_url", "URL of the page that will return the UTC timestamp in ISO format", OFFSET(utc_timing_url), AV_OPT_TYPE_STRING, { 0 }, 0, 0, E },
+    { "http_persistent", "Use persistent HTTP connections shared between segment uploads", OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
     { NULL },
 };
 
@@ -35,6 +35,9 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include "os_support.h"
 #include "url.h"
 
@@ -67,12 +70,22 @@
 
 /* standard file protocol */
 
+/* Files are mapped in windows of this size, aligned to FILE_MAP_ALIGN */
+#define FILE_MAP_SIZE  (64 << 20)
+#define FILE_MAP_ALIGN (1 << 20)
+
 typedef struct FileContext {
     const AVClass *class;
     int fd;
     int trunc;
     int blocksize;
     int follow;
+    int use_mmap;
+    AVBufferRef *map;   ///< currently mapped window of the file
+    int64_t map_pos;    ///< file offset of the window
+    int64_t map_file_size;  ///< size of the file when the window was mapped
+    int64_t map_file_mtime; ///< modification time of the file when the window was mapped
+    int nb_map_refs;    ///< number of references to the mapping handed out
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
@@ -82,6 +95,7 @@ static const AVOption file_options[] = {
     { "truncate", "truncate existing files on write", offsetof(FileContext, trunc), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, AV_OPT_FLAG_ENCODING_PARAM },
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "mmap", "Return packet payloads from a memory mapping of the file", offsetof(FileContext, use_mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -126,6 +140,90 @@ static int file_write(URLContext *h, const unsigned char *buf, int size)
     return (ret == -1) ? AVERROR(errno) : ret;
 }
 
+#if HAVE_MMAP
+static void file_unmap(void *opaque, uint8_t *data)
+{
+    munmap(data, (size_t)(uintptr_t)opaque);
+}
+
+/**
+ * Map the window of the file containing the bytes from pos to end.
+ * The file is only checked here, once per window: touching pages past the
+ * end of a file that was truncated meanwhile would raise SIGBUS, so mapping
+ * is given up for good as soon as a change is seen.
+ */
+static int file_map(URLContext *h, int64_t pos, int64_t end)
+{
+    FileContext *c = h->priv_data;
+    int64_t start = pos & ~(int64_t)(FILE_MAP_ALIGN - 1);
+    AVBufferRef *map;
+    struct stat st;
+    int64_t size;
+    void *data;
+
+    if (fstat(c->fd, &st) < 0 || !S_ISREG(st.st_mode) || end > st.st_size)
+        return AVERROR(ENOSYS);
+    if (c->map && (st.st_size  != c->map_file_size ||
+                   st.st_mtime != c->map_file_mtime)) {
+        av_log(h, AV_LOG_VERBOSE, "File changed while mapped, reading it instead\n");
+        av_buffer_unref(&c->map);
+        c->use_mmap = 0;
+        return AVERROR(ENOSYS);
+    }
+    size = FFMIN(FFMAX(FILE_MAP_SIZE, end - start), st.st_size - start);
+    if (size > INT_MAX || (size_t)size != size)
+        return AVERROR(ENOSYS);
+
+    data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, c->fd, start);
+    if (data == MAP_FAILED)
+        return AVERROR(errno);
+    map = av_buffer_create(data, size, file_unmap, (void *)(uintptr_t)size,
+                           AV_BUFFER_FLAG_READONLY);
+    if (!map) {
+        munmap(data, size);
+        return AVERROR(ENOMEM);
+    }
+
+    /* packets still referencing the previous window keep it mapped */
+    av_buffer_unref(&c->map);
+    c->map            = map;
+    c->map_pos        = start;
+    c->map_file_size  = st.st_size;
+    c->map_file_mtime = st.st_mtime;
+    return 0;
+}
+
+static int file_get_buffer_ref(URLContext *h, int64_t pos, int size,
+                               AVBufferRef **buf, uint8_t **data)
+{
+    FileContext *c = h->priv_data;
+    int64_t end = pos + size;
+    int ret;
+
+    if (!c->use_mmap || c->follow || (h->flags & AVIO_FLAG_WRITE) ||
+        pos < 0 || size <= 0)
+        return AVERROR(ENOSYS);
+
+    if (!c->map || pos < c->map_pos || end > c->map_pos + c->map->size) {
+        if ((ret = file_map(h, pos, end)) < 0)
+            return ret;
+    }
+
+    /* the padding is made of the following bytes of the window; when it
+     * does not hold them all, e.g. at the end of the file, the caller has
+     * to make a padded copy */
+    if (end + AV_INPUT_BUFFER_PADDING_SIZE > c->map_pos + c->map->size)
+        return AVERROR(ENOSYS);
+
+    *buf = av_buffer_ref(c->map);
+    if (!*buf)
+        return AVERROR(ENOMEM);
+    *data = c->map->data + (pos - c->map_pos);
+    c->nb_map_refs++;
+    return 0;
+}
+#endif
+
 static int file_get_handle(URLContext *h)
 {
     FileContext *c = h->priv_data;
@@ -257,6 +355,10 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
+    if (c->nb_map_refs)
+        av_log(h, AV_LOG_VERBOSE, "%d packets referenced the mapping\n",
+               c->nb_map_refs);
+    av_buffer_unref(&c->map);
     return close(c->fd);
 }
 
@@ -360,7 +462,10 @@ const URLProtocol ff_file_protocol = {
     .url_open_dir        = file_open_dir,
     .url_read_dir        = file_read_dir,
     .url_close_dir       = file_close_dir,
-    .default_whitelist   = "file,crypto"
+    .default_whitelist   = "file,crypto",
+#if HAVE_MMAP
+    .url_get_buffer_ref  = file_get_buffer_ref,
+#endif
 };
 
 #endif /* CONFIG_FILE_PROTOCOL */
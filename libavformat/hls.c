@@ -28,10 +28,12 @@
 
 #include "libavutil/avstring.h"
 #include "libavutil/avassert.h"
+#include "libavutil/bprint.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/dict.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "avformat.h"
 #include "internal.h"
@@ -39,6 +41,8 @@
 #include "id3v2.h"
 
 #define INITIAL_BUFFER_SIZE 32768
+#define PREFETCH_BLOCK_SIZE 32768
+#define MAX_PLAYLIST_SIZE (1024 * 1024)
 
 #define MAX_FIELD_LEN 64
 #define MAX_CHARACTERISTICS_LEN 512
@@ -77,6 +81,8 @@ struct segment {
 };
 
 struct rendition;
+struct prefetcher;
+struct prefetch_slot;
 
 enum PlaylistType {
     PLS_TYPE_UNSPECIFIED,
@@ -153,6 +159,13 @@ struct playlist {
      * playlist, if any. */
     int n_init_sections;
     struct segment **init_sections;
+
+    /* Background download of the next segments and of the playlist,
+     * if enabled. The current segment is read from prefetch_cur instead
+     * of input when it was prefetched. */
+    struct prefetcher *prefetch;
+    struct prefetch_slot *prefetch_cur;
+    unsigned int prefetch_pos;
 };
 
 /*
@@ -205,6 +218,8 @@ typedef struct HLSContext {
     AVDictionary *avio_opts;
     int strict_std_compliance;
     char *allowed_extensions;
+    int prefetch_segments;
+    int64_t prefetch_max_size;
 } HLSContext;
 
 static int read_chomp_line(AVIOContext *s, char *buf, int maxlen)
@@ -238,11 +253,14 @@ static void free_init_section_list(struct playlist *pls)
     pls->n_init_sections = 0;
 }
 
+static void prefetch_free(struct playlist *pls);
+
 static void free_playlist_list(HLSContext *c)
 {
     int i;
     for (i = 0; i < c->n_playlists; i++) {
         struct playlist *pls = c->playlists[i];
+        prefetch_free(pls);
         free_segment_list(pls);
         free_init_section_list(pls);
         av_freep(&pls->main_streams);
@@ -596,16 +614,15 @@ static void update_options(char **dest, const char *name, void *src)
         av_freep(dest);
 }
 
-static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
-                    AVDictionary *opts, AVDictionary *opts2, int *is_http)
+/**
+ * Check that url uses one of the protocols allowed for playlist items.
+ * @param is_http set to whether the url is a HTTP(S) one, may be NULL
+ * @return 0 if the url may be opened, a negative error code otherwise
+ */
+static int check_url(AVFormatContext *s, const char *url, int *is_http)
 {
     HLSContext *c = s->priv_data;
-    AVDictionary *tmp = NULL;
     const char *proto_name = NULL;
-    int ret;
-
-    av_dict_copy(&tmp, opts, 0);
-    av_dict_copy(&tmp, opts2, 0);
 
     if (av_strstart(url, "crypto", NULL)) {
         if (url[6] == '+' || url[6] == ':')
@@ -639,6 +656,26 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     else if (strcmp(proto_name, "file") || !strncmp(url, "file,", 5))
         return AVERROR_INVALIDDATA;
 
+    if (is_http)
+        *is_http = av_strstart(proto_name, "http", NULL);
+
+    return 0;
+}
+
+static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
+                    AVDictionary *opts, AVDictionary *opts2, int *is_http)
+{
+    HLSContext *c = s->priv_data;
+    AVDictionary *tmp = NULL;
+    int ret;
+
+    ret = check_url(s, url, is_http);
+    if (ret < 0)
+        return ret;
+
+    av_dict_copy(&tmp, opts, 0);
+    av_dict_copy(&tmp, opts2, 0);
+
     ret = s->io_open(s, pb, url, AVIO_FLAG_READ, &tmp);
     if (ret >= 0) {
         // update cookies on http response with setcookies.
@@ -657,12 +694,21 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
 
     av_dict_free(&tmp);
 
-    if (is_http)
-        *is_http = av_strstart(proto_name, "http", NULL);
-
     return ret;
 }
 
+static void set_playlist_options(HLSContext *c, AVDictionary **opts)
+{
+    /* Some HLS servers don't like being sent the range header */
+    av_dict_set(opts, "seekable", "0", 0);
+
+    // broker prior HTTP options that should be consistent across requests
+    av_dict_set(opts, "user_agent", c->user_agent, 0);
+    av_dict_set(opts, "cookies", c->cookies, 0);
+    av_dict_set(opts, "headers", c->headers, 0);
+    av_dict_set(opts, "http_proxy", c->http_proxy, 0);
+}
+
 static int parse_playlist(HLSContext *c, const char *url,
                           struct playlist *pls, AVIOContext *in)
 {
@@ -686,14 +732,7 @@ static int parse_playlist(HLSContext *c, const char *url,
 #if 1
         AVDictionary *opts = NULL;
         close_in = 1;
-        /* Some HLS servers don't like being sent the range header */
-        av_dict_set(&opts, "seekable", "0", 0);
-
-        // broker prior HTTP options that should be consistent across requests
-        av_dict_set(&opts, "user_agent", c->user_agent, 0);
-        av_dict_set(&opts, "cookies", c->cookies, 0);
-        av_dict_set(&opts, "headers", c->headers, 0);
-        av_dict_set(&opts, "http_proxy", c->http_proxy, 0);
+        set_playlist_options(c, &opts);
 
         ret = c->ctx->io_open(c->ctx, &in, url, AVIO_FLAG_READ, &opts);
         av_dict_free(&opts);
@@ -872,6 +911,692 @@ static struct segment *current_segment(struct playlist *pls)
     return pls->segments[pls->cur_seq_no - pls->start_seq_no];
 }
 
+static void set_segment_options(HLSContext *c, struct segment *seg,
+                                AVDictionary **opts)
+{
+    // broker prior HTTP options that should be consistent across requests
+    av_dict_set(opts, "user_agent", c->user_agent, 0);
+    av_dict_set(opts, "cookies", c->cookies, 0);
+    av_dict_set(opts, "headers", c->headers, 0);
+    av_dict_set(opts, "http_proxy", c->http_proxy, 0);
+    av_dict_set(opts, "seekable", "0", 0);
+
+    if (seg->size >= 0) {
+        /* try to restrict the HTTP request to the part we want
+         * (if this is in fact a HTTP request) */
+        av_dict_set_int(opts, "offset", seg->url_offset, 0);
+        av_dict_set_int(opts, "end_offset", seg->url_offset + seg->size, 0);
+    }
+}
+
+static int64_t default_reload_interval(struct playlist *pls)
+{
+    return pls->n_segments > 0 ?
+                          pls->segments[pls->n_segments - 1]->duration :
+                          pls->target_duration;
+}
+
+#if HAVE_THREADS
+/*
+ * Segment prefetching: a pool of prefetch_segments threads per playlist
+ * downloads the current and the following segments into memory, so that
+ * no request round trip is needed at segment boundaries. For live
+ * playlists, another thread reloads the playlist on its own schedule and
+ * read_data() only parses the latest copy.
+ *
+ * All fields below are protected by the prefetcher lock; a slot in the
+ * PREFETCH_RUNNING state is only modified by its worker, apart from the
+ * cancel flag.
+ */
+enum PrefetchState {
+    PREFETCH_FREE,
+    PREFETCH_PENDING,
+    PREFETCH_RUNNING,
+    PREFETCH_DONE,
+};
+
+struct prefetch_slot {
+    struct prefetcher *p;
+    enum PrefetchState state;
+    int cancel;
+    int seq_no;
+    char *url;
+    int64_t url_offset;
+    int64_t size;
+    int is_http;
+    AVDictionary *opts;
+    uint8_t *data;
+    unsigned int data_size;
+    unsigned int data_len;
+    int error;
+    AVIOInterruptCB interrupt_callback;
+};
+
+struct prefetcher {
+    HLSContext *c;
+    struct playlist *pls;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int quit;
+
+    pthread_t *threads;
+    int nb_threads;
+    struct prefetch_slot *slots;
+    int nb_slots;
+    int64_t buffered;
+    int cur_seq_no;
+
+    pthread_t reload_thread;
+    int reload_thread_started;
+    int live;
+    int64_t reload_interval;
+    int64_t target_duration;
+    AVDictionary *playlist_opts;
+    char *playlist_data;
+    char *playlist_location;
+    unsigned int playlist_len;
+    int64_t playlist_time;
+    AVIOInterruptCB reload_interrupt_callback;
+    char *cookies;              ///< set by a response, not yet applied to the HLSContext
+};
+
+static int prefetch_interrupt_cb(void *opaque)
+{
+    struct prefetch_slot *slot = opaque;
+    struct prefetcher *p = slot->p;
+    return slot->cancel || p->quit ||
+           ff_check_interrupt(&p->c->ctx->interrupt_callback);
+}
+
+static int prefetch_reload_interrupt_cb(void *opaque)
+{
+    struct prefetcher *p = opaque;
+    return p->quit || ff_check_interrupt(&p->c->ctx->interrupt_callback);
+}
+
+/* Keep the cookies set by a response, as open_url() does. */
+static void prefetch_update_cookies(struct prefetcher *p, AVIOContext *in)
+{
+    char *new_cookies = NULL;
+
+    if (p->c->ctx->flags & AVFMT_FLAG_CUSTOM_IO)
+        return;
+    av_opt_get(in, "cookies", AV_OPT_SEARCH_CHILDREN, (uint8_t**)&new_cookies);
+    if (!new_cookies)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    av_free(p->cookies);
+    p->cookies = new_cookies;
+    av_dict_set(&p->playlist_opts, "cookies", new_cookies, 0);
+    pthread_mutex_unlock(&p->lock);
+}
+
+/* Must be called with the lock held, from the demuxer thread. */
+static void prefetch_apply_cookies(struct prefetcher *p)
+{
+    HLSContext *c = p->c;
+
+    if (!p->cookies)
+        return;
+    av_free(c->cookies);
+    c->cookies = p->cookies;
+    p->cookies = NULL;
+    av_dict_set(&p->playlist_opts, "cookies", c->cookies, 0);
+}
+
+static void prefetch_reset_slot(struct prefetcher *p, struct prefetch_slot *slot)
+{
+    p->buffered -= slot->data_len;
+    av_freep(&slot->data);
+    av_freep(&slot->url);
+    av_dict_free(&slot->opts);
+    slot->data_size = slot->data_len = 0;
+    slot->state  = PREFETCH_FREE;
+    slot->cancel = 0;
+    slot->error  = 0;
+    slot->seq_no = -1;
+}
+
+/* Must be called with the lock held. */
+static void prefetch_release_slot(struct prefetcher *p, struct prefetch_slot *slot)
+{
+    if (slot->state == PREFETCH_RUNNING)
+        slot->cancel = 1;
+    else if (slot->state != PREFETCH_FREE)
+        prefetch_reset_slot(p, slot);
+}
+
+static int prefetch_fetch(struct prefetcher *p, struct prefetch_slot *slot,
+                          uint8_t *block)
+{
+    AVFormatContext *s = p->c->ctx;
+    AVIOContext *in = NULL;
+    int64_t got = 0;
+    int ret;
+
+    av_log(s, AV_LOG_VERBOSE, "HLS prefetch of url '%s', offset %"PRId64", playlist %d\n",
+           slot->url, slot->url_offset, p->pls->index);
+
+    ret = ffio_open_whitelist(&in, slot->url, AVIO_FLAG_READ,
+                              &slot->interrupt_callback, &slot->opts,
+                              s->protocol_whitelist, s->protocol_blacklist);
+    if (ret < 0)
+        return ret;
+    prefetch_update_cookies(p, in);
+
+    /* see open_input() */
+    if (!slot->is_http && slot->url_offset) {
+        int64_t seekret = avio_seek(in, slot->url_offset, SEEK_SET);
+        if (seekret < 0) {
+            avio_closep(&in);
+            return seekret;
+        }
+    }
+
+    for (;;) {
+        int len = PREFETCH_BLOCK_SIZE;
+
+        if (slot->size >= 0)
+            len = FFMIN(len, slot->size - got);
+        if (len <= 0) {
+            ret = AVERROR_EOF;
+            break;
+        }
+        ret = avio_read(in, block, len);
+        if (ret <= 0) {
+            if (!ret)
+                ret = AVERROR_EOF;
+            break;
+        }
+        got += ret;
+
+        pthread_mutex_lock(&p->lock);
+        /* Bound the memory used; the segment the reader waits for is always
+         * allowed to proceed. */
+        while (!slot->cancel && !p->quit && slot->seq_no != p->cur_seq_no &&
+               p->buffered + ret > p->c->prefetch_max_size)
+            pthread_cond_wait(&p->cond, &p->lock);
+        if (slot->cancel || p->quit) {
+            pthread_mutex_unlock(&p->lock);
+            ret = AVERROR_EXIT;
+            break;
+        }
+        if (slot->data_len + (int64_t)ret > slot->data_size) {
+            int64_t new_size = FFMAX(slot->data_len + (int64_t)ret, 2LL * slot->data_size);
+            uint8_t *data;
+            if (slot->size >= 0)
+                new_size = FFMAX(FFMIN(new_size, slot->size), slot->data_len + (int64_t)ret);
+            data = new_size <= UINT_MAX ? av_realloc(slot->data, new_size) : NULL;
+            if (!data) {
+                pthread_mutex_unlock(&p->lock);
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            slot->data      = data;
+            slot->data_size = new_size;
+        }
+        memcpy(slot->data + slot->data_len, block, ret);
+        slot->data_len += ret;
+        p->buffered    += ret;
+        pthread_cond_broadcast(&p->cond);
+        pthread_mutex_unlock(&p->lock);
+    }
+
+    avio_closep(&in);
+    return ret;
+}
+
+static void *prefetch_worker(void *arg)
+{
+    struct prefetcher *p = arg;
+    uint8_t *block = av_malloc(PREFETCH_BLOCK_SIZE);
+
+    pthread_mutex_lock(&p->lock);
+    while (!p->quit) {
+        struct prefetch_slot *slot = NULL;
+        int i, ret;
+
+        /* fetch the earliest pending segment first */
+        for (i = 0; i < p->nb_slots; i++)
+            if (p->slots[i].state == PREFETCH_PENDING &&
+                (!slot || p->slots[i].seq_no < slot->seq_no))
+                slot = &p->slots[i];
+        if (!slot) {
+            pthread_cond_wait(&p->cond, &p->lock);
+            continue;
+        }
+
+        slot->state = PREFETCH_RUNNING;
+        pthread_mutex_unlock(&p->lock);
+        ret = block ? prefetch_fetch(p, slot, block) : AVERROR(ENOMEM);
+        pthread_mutex_lock(&p->lock);
+
+        if (slot->cancel) {
+            prefetch_reset_slot(p, slot);
+        } else {
+            slot->error = ret;
+            slot->state = PREFETCH_DONE;
+        }
+        pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    av_free(block);
+    return NULL;
+}
+
+static void *prefetch_reloader(void *arg)
+{
+    struct prefetcher *p = arg;
+    AVFormatContext *s = p->c->ctx;
+    int64_t next_reload = av_gettime_relative() + p->reload_interval;
+
+    pthread_mutex_lock(&p->lock);
+    while (!p->quit) {
+        AVDictionary *opts = NULL;
+        AVIOContext *in = NULL;
+        uint8_t *location = NULL;
+        AVBPrint bp;
+        int64_t now = av_gettime_relative();
+        int ret;
+
+        if (!p->live) {
+            pthread_cond_wait(&p->cond, &p->lock);
+            continue;
+        }
+        if (now < next_reload) {
+            int64_t t = av_gettime() + next_reload - now;
+            struct timespec tv = { .tv_sec  =  t / 1000000,
+                                   .tv_nsec = (t % 1000000) * 1000 };
+            pthread_cond_timedwait(&p->cond, &p->lock, &tv);
+            continue;
+        }
+
+        av_dict_copy(&opts, p->playlist_opts, 0);
+        pthread_mutex_unlock(&p->lock);
+
+        av_bprint_init(&bp, 0, MAX_PLAYLIST_SIZE);
+        ret = ffio_open_whitelist(&in, p->pls->url, AVIO_FLAG_READ,
+                                  &p->reload_interrupt_callback, &opts,
+                                  s->protocol_whitelist, s->protocol_blacklist);
+        if (ret >= 0) {
+            prefetch_update_cookies(p, in);
+            av_opt_get(in, "location", AV_OPT_SEARCH_CHILDREN, &location);
+            ret = avio_read_to_bprint(in, &bp, MAX_PLAYLIST_SIZE);
+            avio_closep(&in);
+        }
+        av_dict_free(&opts);
+
+        pthread_mutex_lock(&p->lock);
+        if (ret >= 0 && av_bprint_is_complete(&bp)) {
+            /* Unchanged playlist: retry sooner, as read_data() would. */
+            int same = p->playlist_data && p->playlist_len == bp.len &&
+                       !memcmp(p->playlist_data, bp.str, bp.len);
+            av_freep(&p->playlist_data);
+            av_freep(&p->playlist_location);
+            av_bprint_finalize(&bp, &p->playlist_data);
+            p->playlist_location = location;
+            location = NULL;
+            p->playlist_len  = bp.len;
+            p->playlist_time = now;
+            next_reload = now + (same ? p->target_duration / 2 : p->reload_interval);
+            pthread_cond_broadcast(&p->cond);
+        } else {
+            av_bprint_finalize(&bp, NULL);
+            av_log(s, AV_LOG_WARNING, "Failed to reload playlist %d in the background\n",
+                   p->pls->index);
+            next_reload = now + p->target_duration / 2;
+        }
+        av_free(location);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+
+static void prefetch_free(struct playlist *pls)
+{
+    struct prefetcher *p = pls->prefetch;
+    int i;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    p->quit = 1;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+
+    for (i = 0; i < p->nb_threads; i++)
+        pthread_join(p->threads[i], NULL);
+    if (p->reload_thread_started)
+        pthread_join(p->reload_thread, NULL);
+    prefetch_apply_cookies(p);
+
+    for (i = 0; i < p->nb_slots; i++)
+        prefetch_reset_slot(p, &p->slots[i]);
+    av_freep(&p->slots);
+    av_freep(&p->threads);
+    av_dict_free(&p->playlist_opts);
+    av_freep(&p->playlist_data);
+    av_freep(&p->playlist_location);
+    av_freep(&p->cookies);
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->lock);
+    av_freep(&pls->prefetch);
+    pls->prefetch_cur = NULL;
+}
+
+static int prefetch_init(HLSContext *c, struct playlist *pls)
+{
+    struct prefetcher *p;
+    int i, ret;
+
+    p = pls->prefetch = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+    p->c    = c;
+    p->pls  = pls;
+    p->live = !pls->finished;
+    p->reload_interval = default_reload_interval(pls);
+    p->target_duration = pls->target_duration;
+    p->reload_interrupt_callback.callback = prefetch_reload_interrupt_cb;
+    p->reload_interrupt_callback.opaque   = p;
+    set_playlist_options(c, &p->playlist_opts);
+
+    if ((ret = pthread_mutex_init(&p->lock, NULL))) {
+        av_freep(&pls->prefetch);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&p->cond, NULL))) {
+        pthread_mutex_destroy(&p->lock);
+        av_freep(&pls->prefetch);
+        return AVERROR(ret);
+    }
+
+    p->slots   = av_mallocz_array(c->prefetch_segments, sizeof(*p->slots));
+    p->threads = av_mallocz_array(c->prefetch_segments, sizeof(*p->threads));
+    if (!p->slots || !p->threads) {
+        prefetch_free(pls);
+        return AVERROR(ENOMEM);
+    }
+    p->nb_slots = c->prefetch_segments;
+    for (i = 0; i < p->nb_slots; i++) {
+        p->slots[i].p      = p;
+        p->slots[i].seq_no = -1;
+        p->slots[i].interrupt_callback.callback = prefetch_interrupt_cb;
+        p->slots[i].interrupt_callback.opaque   = &p->slots[i];
+    }
+
+    for (; p->nb_threads < p->nb_slots; p->nb_threads++) {
+        ret = pthread_create(&p->threads[p->nb_threads], NULL, prefetch_worker, p);
+        if (ret) {
+            prefetch_free(pls);
+            return AVERROR(ret);
+        }
+    }
+    if (!pls->finished) {
+        ret = pthread_create(&p->reload_thread, NULL, prefetch_reloader, p);
+        if (ret) {
+            prefetch_free(pls);
+            return AVERROR(ret);
+        }
+        p->reload_thread_started = 1;
+    }
+    return 0;
+}
+
+/**
+ * Queue the current segment and the following ones for download and drop
+ * the slots that are not needed anymore.
+ */
+static void prefetch_schedule(HLSContext *c, struct playlist *pls)
+{
+    struct prefetcher *p = pls->prefetch;
+    int i, seq_no;
+
+    pthread_mutex_lock(&p->lock);
+    p->cur_seq_no = pls->cur_seq_no;
+    prefetch_apply_cookies(p);
+
+    for (i = 0; i < p->nb_slots; i++) {
+        struct prefetch_slot *slot = &p->slots[i];
+        int idx = slot->seq_no - pls->start_seq_no;
+        if (slot->state == PREFETCH_FREE || slot->cancel)
+            continue;
+        if (slot->seq_no < pls->cur_seq_no ||
+            slot->seq_no >= pls->cur_seq_no + p->nb_slots ||
+            idx < 0 || idx >= pls->n_segments ||
+            strcmp(slot->url, pls->segments[idx]->url))
+            prefetch_release_slot(p, slot);
+    }
+
+    for (seq_no = pls->cur_seq_no; seq_no < pls->cur_seq_no + p->nb_slots; seq_no++) {
+        struct prefetch_slot *slot = NULL;
+        struct segment *seg;
+        int idx = seq_no - pls->start_seq_no;
+
+        if (idx < 0 || idx >= pls->n_segments)
+            break;
+        seg = pls->segments[idx];
+        if (seg->key_type != KEY_NONE)
+            continue;
+
+        for (i = 0; i < p->nb_slots; i++)
+            if (p->slots[i].seq_no == seq_no && !p->slots[i].cancel)
+                break;
+        if (i < p->nb_slots)
+            continue;
+        for (i = 0; i < p->nb_slots; i++)
+            if (p->slots[i].state == PREFETCH_FREE)
+                break;
+        if (i == p->nb_slots)
+            break;
+        slot = &p->slots[i];
+
+        if (check_url(c->ctx, seg->url, &slot->is_http) < 0 ||
+            !(slot->url = av_strdup(seg->url)))
+            continue;
+        av_dict_copy(&slot->opts, c->avio_opts, 0);
+        set_segment_options(c, seg, &slot->opts);
+        slot->seq_no     = seq_no;
+        slot->url_offset = seg->url_offset;
+        slot->size       = seg->size;
+        slot->state      = PREFETCH_PENDING;
+    }
+
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+}
+
+/**
+ * Start reading the current segment from its prefetch slot.
+ * @return 0 on success, AVERROR(ENOENT) if the segment is not being
+ *         prefetched, another negative error code if fetching it failed
+ */
+static int prefetch_open(HLSContext *c, struct playlist *pls)
+{
+    struct prefetcher *p = pls->prefetch;
+    struct prefetch_slot *slot = NULL;
+    int i, ret = 0;
+
+    prefetch_schedule(c, pls);
+
+    pthread_mutex_lock(&p->lock);
+    for (i = 0; i < p->nb_slots; i++)
+        if (p->slots[i].seq_no == pls->cur_seq_no && !p->slots[i].cancel &&
+            p->slots[i].state != PREFETCH_FREE)
+            slot = &p->slots[i];
+    if (!slot) {
+        pthread_mutex_unlock(&p->lock);
+        return AVERROR(ENOENT);
+    }
+
+    /* wait until the request got answered */
+    while (!slot->data_len && slot->state != PREFETCH_DONE) {
+        int64_t t = av_gettime() + 100000;
+        struct timespec tv = { .tv_sec  =  t / 1000000,
+                               .tv_nsec = (t % 1000000) * 1000 };
+        if (ff_check_interrupt(c->interrupt_callback)) {
+            pthread_mutex_unlock(&p->lock);
+            return AVERROR_EXIT;
+        }
+        pthread_cond_timedwait(&p->cond, &p->lock, &tv);
+    }
+    if (!slot->data_len && slot->error < 0 && slot->error != AVERROR_EOF) {
+        ret = slot->error;
+        prefetch_reset_slot(p, slot);
+    } else {
+        pls->prefetch_cur = slot;
+        pls->prefetch_pos = 0;
+        pls->cur_seg_offset = 0;
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return ret;
+}
+
+static int prefetch_read(struct playlist *pls, uint8_t *buf, int buf_size,
+                         int complete)
+{
+    struct prefetcher *p = pls->prefetch;
+    struct prefetch_slot *slot = pls->prefetch_cur;
+    int copied = 0;
+
+    pthread_mutex_lock(&p->lock);
+    while (copied < buf_size) {
+        int len = FFMIN(slot->data_len - pls->prefetch_pos, buf_size - copied);
+
+        if (len > 0) {
+            memcpy(buf + copied, slot->data + pls->prefetch_pos, len);
+            pls->prefetch_pos += len;
+            copied += len;
+            if (!complete)
+                break;
+        } else if (slot->state == PREFETCH_DONE) {
+            break;
+        } else {
+            int64_t t = av_gettime() + 100000;
+            struct timespec tv = { .tv_sec  =  t / 1000000,
+                                   .tv_nsec = (t % 1000000) * 1000 };
+            if (ff_check_interrupt(&pls->parent->interrupt_callback)) {
+                pthread_mutex_unlock(&p->lock);
+                return copied ? copied : AVERROR_EXIT;
+            }
+            pthread_cond_timedwait(&p->cond, &p->lock, &tv);
+        }
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    if (copied)
+        return copied;
+    return slot->error < 0 ? slot->error : AVERROR_EOF;
+}
+
+/* Stop reading from the current prefetch slot and drop its data. */
+static void prefetch_close(struct playlist *pls)
+{
+    struct prefetcher *p = pls->prefetch;
+
+    if (!pls->prefetch_cur)
+        return;
+    pthread_mutex_lock(&p->lock);
+    prefetch_release_slot(p, pls->prefetch_cur);
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    pls->prefetch_cur = NULL;
+}
+
+/* Drop all prefetched segments, e.g. after seeking. */
+static void prefetch_flush(struct playlist *pls)
+{
+    struct prefetcher *p = pls->prefetch;
+    int i;
+
+    if (!p)
+        return;
+    prefetch_close(pls);
+    pthread_mutex_lock(&p->lock);
+    for (i = 0; i < p->nb_slots; i++)
+        prefetch_release_slot(p, &p->slots[i]);
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+}
+
+/**
+ * Parse the playlist last downloaded by the reload thread if it is newer
+ * than the one in use.
+ * @param wait if no newer copy is available, wait up to 100ms for one
+ * @return 1 if the playlist was updated, 0 if no newer copy was available,
+ *         a negative error code on failure
+ */
+static int prefetch_reload_playlist(HLSContext *c, struct playlist *pls, int wait)
+{
+    struct prefetcher *p = pls->prefetch;
+    AVIOContext in = { 0 };
+    char *data = NULL, *location = NULL;
+    unsigned int len = 0;
+    int64_t load_time = 0;
+    int ret;
+
+    pthread_mutex_lock(&p->lock);
+    if (wait && !(p->playlist_data && p->playlist_time > pls->last_load_time)) {
+        int64_t t = av_gettime() + 100000;
+        struct timespec tv = { .tv_sec  =  t / 1000000,
+                               .tv_nsec = (t % 1000000) * 1000 };
+        if (ff_check_interrupt(c->interrupt_callback)) {
+            pthread_mutex_unlock(&p->lock);
+            return AVERROR_EXIT;
+        }
+        pthread_cond_timedwait(&p->cond, &p->lock, &tv);
+    }
+    if (p->playlist_data && p->playlist_time > pls->last_load_time) {
+        data = p->playlist_data;
+        len  = p->playlist_len;
+        location  = p->playlist_location;
+        load_time = p->playlist_time;
+        p->playlist_data     = NULL;
+        p->playlist_location = NULL;
+    }
+    pthread_mutex_unlock(&p->lock);
+    if (!data)
+        return 0;
+
+    ffio_init_context(&in, data, len, 0, NULL, NULL, NULL, NULL);
+    ret = parse_playlist(c, location ? location : pls->url, pls, &in);
+    av_free(location);
+    av_free(data);
+    if (ret < 0)
+        return ret;
+    pls->last_load_time = load_time;
+
+    pthread_mutex_lock(&p->lock);
+    prefetch_apply_cookies(p);
+    p->live = !pls->finished;
+    p->reload_interval = default_reload_interval(pls);
+    p->target_duration = pls->target_duration;
+    av_dict_free(&p->playlist_opts);
+    set_playlist_options(c, &p->playlist_opts);
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+
+    return 1;
+}
+#else
+static void prefetch_free(struct playlist *pls)
+{
+}
+
+static void prefetch_close(struct playlist *pls)
+{
+}
+
+static void prefetch_flush(struct playlist *pls)
+{
+}
+#endif /* HAVE_THREADS */
+
 enum ReadFromURLMode {
     READ_NORMAL,
     READ_COMPLETE,
@@ -887,12 +1612,14 @@ static int read_from_url(struct playlist *pls, struct segment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
 
-    if (mode == READ_COMPLETE) {
-        ret = avio_read(pls->input, buf, buf_size);
-        if (ret != buf_size)
-            av_log(NULL, AV_LOG_ERROR, "Could not read complete segment.\n");
-    } else
+#if HAVE_THREADS
+    if (pls->prefetch_cur)
+        ret = prefetch_read(pls, buf, buf_size, mode == READ_COMPLETE);
+    else
+#endif
         ret = avio_read(pls->input, buf, buf_size);
+    if (mode == READ_COMPLETE && ret != buf_size)
+        av_log(NULL, AV_LOG_ERROR, "Could not read complete segment.\n");
 
     if (ret > 0)
         pls->cur_seg_offset += ret;
@@ -1103,19 +1830,7 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
     int ret;
     int is_http = 0;
 
-    // broker prior HTTP options that should be consistent across requests
-    av_dict_set(&opts, "user_agent", c->user_agent, 0);
-    av_dict_set(&opts, "cookies", c->cookies, 0);
-    av_dict_set(&opts, "headers", c->headers, 0);
-    av_dict_set(&opts, "http_proxy", c->http_proxy, 0);
-    av_dict_set(&opts, "seekable", "0", 0);
-
-    if (seg->size >= 0) {
-        /* try to restrict the HTTP request to the part we want
-         * (if this is in fact a HTTP request) */
-        av_dict_set_int(&opts, "offset", seg->url_offset, 0);
-        av_dict_set_int(&opts, "end_offset", seg->url_offset + seg->size, 0);
-    }
+    set_segment_options(c, seg, &opts);
 
     av_log(pls->parent, AV_LOG_VERBOSE, "HLS request for url '%s', offset %"PRId64", playlist %d\n",
            seg->url, seg->url_offset, pls->index);
@@ -1250,13 +1965,6 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
     return 0;
 }
 
-static int64_t default_reload_interval(struct playlist *pls)
-{
-    return pls->n_segments > 0 ?
-                          pls->segments[pls->n_segments - 1]->duration :
-                          pls->target_duration;
-}
-
 static int read_data(void *opaque, uint8_t *buf, int buf_size)
 {
     struct playlist *v = opaque;
@@ -1268,7 +1976,7 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input) {
+    if (!v->input && !v->prefetch_cur) {
         int64_t reload_interval;
         struct segment *seg;
 
@@ -1286,9 +1994,16 @@ restart:
         if (!v->needed) {
             av_log(v->parent, AV_LOG_INFO, "No longer receiving playlist %d\n",
                 v->index);
+            prefetch_free(v);
             return AVERROR_EOF;
         }
 
+#if HAVE_THREADS
+        if (c->prefetch_segments && !v->prefetch &&
+            (ret = prefetch_init(c, v)) < 0)
+            return ret;
+#endif
+
         /* If this is a live stream and the reload interval has elapsed since
          * the last playlist reload, reload the playlists now. */
         reload_interval = default_reload_interval(v);
@@ -1296,7 +2011,14 @@ restart:
 reload:
         if (!v->finished &&
             av_gettime_relative() - v->last_load_time >= reload_interval) {
-            if ((ret = parse_playlist(c, v->url, v, NULL)) < 0) {
+#if HAVE_THREADS
+            if (v->prefetch && v->prefetch->reload_thread_started)
+                ret = prefetch_reload_playlist(c, v,
+                          v->cur_seq_no >= v->start_seq_no + v->n_segments);
+            else
+#endif
+                ret = parse_playlist(c, v->url, v, NULL);
+            if (ret < 0) {
                 av_log(v->parent, AV_LOG_WARNING, "Failed to reload playlist %d\n",
                        v->index);
                 return ret;
@@ -1331,7 +2053,13 @@ reload:
         if (ret)
             return ret;
 
-        ret = open_input(c, v, seg);
+#if HAVE_THREADS
+        ret = AVERROR(ENOENT);
+        if (v->prefetch)
+            ret = prefetch_open(c, v);
+        if (ret == AVERROR(ENOENT))
+#endif
+            ret = open_input(c, v, seg);
         if (ret < 0) {
             if (ff_check_interrupt(c->interrupt_callback))
                 return AVERROR_EXIT;
@@ -1362,6 +2090,7 @@ reload:
         return ret;
     }
     ff_format_io_close(v->parent, &v->input);
+    prefetch_close(v);
     v->cur_seq_no++;
 
     c->cur_seq_no = v->cur_seq_no;
@@ -1494,7 +2223,8 @@ static int save_avio_options(AVFormatContext *s)
 {
     HLSContext *c = s->priv_data;
     static const char *opts[] = {
-        "headers", "http_proxy", "user_agent", "user-agent", "cookies", NULL };
+        "headers", "http_proxy", "user_agent", "user-agent", "cookies",
+        "connection_pool", "pool_max_idle", "pool_idle_timeout", NULL };
     const char **opt = opts;
     uint8_t *buf;
     int ret = 0;
@@ -1655,6 +2385,14 @@ static int hls_read_header(AVFormatContext *s)
         update_options(&c->http_proxy, "http_proxy", u);
     }
 
+    /* The prefetch threads open urls themselves, which is only equivalent
+     * to going through io_open if it was not overridden. */
+    if (c->prefetch_segments && !ff_format_io_open_is_default(s)) {
+        av_log(s, AV_LOG_WARNING, "Segment prefetching is not supported "
+               "with a custom io_open callback, disabling it\n");
+        c->prefetch_segments = 0;
+    }
+
     if ((ret = parse_playlist(c, s->filename, NULL, s->pb)) < 0)
         goto fail;
 
@@ -1864,6 +2602,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
         } else if (first && !pls->cur_needed && pls->needed) {
             if (pls->input)
                 ff_format_io_close(pls->parent, &pls->input);
+            prefetch_free(pls);
             pls->needed = 0;
             changed = 1;
             av_log(s, AV_LOG_INFO, "No longer receiving playlist %d\n", i);
@@ -2098,6 +2837,7 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
         struct playlist *pls = c->playlists[i];
         if (pls->input)
             ff_format_io_close(pls->parent, &pls->input);
+        prefetch_flush(pls);
         av_packet_unref(&pls->pkt);
         reset_packet(&pls->pkt);
         pls->pb.eof_reached = 0;
@@ -2150,6 +2890,10 @@ static const AVOption hls_options[] = {
         OFFSET(allowed_extensions), AV_OPT_TYPE_STRING,
         {.str = "3gp,aac,avi,flac,mkv,m3u8,m4a,m4s,m4v,mpg,mov,mp2,mp3,mp4,mpeg,mpegts,ogg,ogv,oga,ts,vob,wav"},
         INT_MIN, INT_MAX, FLAGS},
+    {"prefetch_segments", "number of segments to download ahead of the one being read",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 16, FLAGS},
+    {"prefetch_max_size", "maximum amount of prefetched data per playlist",
+        OFFSET(prefetch_max_size), AV_OPT_TYPE_INT64, {.i64 = 32 << 20}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
@@ -113,6 +113,7 @@ typedef struct HLSContext {
 
     float time;            // Set by a private option.
     float init_time;       // Set by a private option.
+    float chunk_time;      // Set by a private option.
     int max_nb_segments;   // Set by a private option.
 #if FF_API_HLS_WRAP
     int  wrap;             // Set by a private option.
@@ -134,6 +135,7 @@ typedef struct HLSContext {
     double dpp;           // duration per packet
     int64_t start_pts;
     int64_t end_pts;
+    int64_t chunk_start_pts; // pts of the first packet of the current chunk
     double duration;      // last segment duration computed so far, in seconds
     int64_t start_pos;    // last segment starting position
     int64_t size;         // last segment size
@@ -169,6 +171,7 @@ typedef struct HLSContext {
     AVDictionary *vtt_format_options;
 
     char *method;
+    int http_persistent;
 
     double initial_prog_date_time;
     char current_segment_final_filename_fmt[1024]; // when renaming segments
@@ -967,6 +970,8 @@ static void set_http_options(AVFormatContext *s, AVDictionary **options, HLSCont
         av_log(c, AV_LOG_WARNING, "No HTTP method set, hls muxer defaulting to method PUT.\n");
         av_dict_set(options, "method", "PUT", 0);
     }
+    if (c->http_persistent)
+        av_dict_set_int(options, "connection_pool", 1, 0);
 }
 
 static void write_m3u8_head_block(HLSContext *hls, AVIOContext *out, int version,
@@ -1101,6 +1106,17 @@ static int hls_window(AVFormatContext *s, int last)
         avio_printf(out, "%s\n", en->filename);
     }
 
+    /* In chunked mode the segment being written is already available, so
+     * that players may download it while it is produced. */
+    if (!last && hls->chunk_time > 0 && hls->avf && hls->avf->pb &&
+        !byterange_mode && !hls->encrypt && !hls->key_info_file &&
+        !(hls->flags & (HLS_TEMP_FILE | HLS_SECOND_LEVEL_SEGMENT_SIZE |
+                        HLS_SECOND_LEVEL_SEGMENT_DURATION))) {
+        const char *filename = hls->use_localtime_mkdir ? hls->avf->filename :
+                                                          av_basename(hls->avf->filename);
+        avio_printf(out, "#EXT-X-PREFETCH:%s%s\n", hls->baseurl ? hls->baseurl : "", filename);
+    }
+
     if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
         avio_printf(out, "#EXT-X-ENDLIST\n");
 
@@ -1334,6 +1350,7 @@ static int hls_write_header(AVFormatContext *s)
     hls->sequence       = hls->start_sequence;
     hls->recording_time = (hls->init_time ? hls->init_time : hls->time) * AV_TIME_BASE;
     hls->start_pts      = AV_NOPTS_VALUE;
+    hls->chunk_start_pts = AV_NOPTS_VALUE;
     hls->current_segment_final_filename_fmt[0] = '\0';
 
     if (hls->flags & HLS_PROGRAM_DATE_TIME) {
@@ -1617,6 +1634,7 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
 
         hls->end_pts = pkt->pts;
         hls->duration = 0;
+        hls->chunk_start_pts = pkt->pts;
 
         hls->fmp4_init_mode = 0;
         if (hls->flags & HLS_SINGLE_FILE) {
@@ -1647,6 +1665,19 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         }
     }
 
+    /* Write out what was buffered for the segment so far as one chunk,
+     * so that it reaches the output before the segment is complete. */
+    if (hls->chunk_time > 0 && is_ref_pkt && oc == hls->avf) {
+        if (hls->chunk_start_pts == AV_NOPTS_VALUE)
+            hls->chunk_start_pts = pkt->pts;
+        if (av_compare_ts(pkt->pts - hls->chunk_start_pts, st->time_base,
+                          hls->chunk_time * AV_TIME_BASE, AV_TIME_BASE_Q) >= 0) {
+            av_write_frame(oc, NULL);
+            avio_flush(oc->pb);
+            hls->chunk_start_pts = pkt->pts;
+        }
+    }
+
     ret = ff_write_chained(oc, stream_index, pkt, s, 0);
 
     return ret;
@@ -1709,6 +1740,7 @@ static int hls_write_trailer(struct AVFormatContext *s)
 static const AVOption options[] = {
     {"start_number",  "set first number in the sequence",        OFFSET(start_sequence),AV_OPT_TYPE_INT64,  {.i64 = 0},     0, INT64_MAX, E},
     {"hls_time",      "set segment length in seconds",           OFFSET(time),    AV_OPT_TYPE_FLOAT,  {.dbl = 2},     0, FLT_MAX, E},
+    {"hls_chunk_time", "set the length in seconds of the chunks written out while a segment is produced", OFFSET(chunk_time), AV_OPT_TYPE_FLOAT, {.dbl = 0}, 0, FLT_MAX, E},
     {"hls_init_time", "set segment length in seconds at init list",           OFFSET(init_time),    AV_OPT_TYPE_FLOAT,  {.dbl = 0},     0, FLT_MAX, E},
     {"hls_list_size", "set maximum number of playlist entries",  OFFSET(max_nb_segments),    AV_OPT_TYPE_INT,    {.i64 = 5},     0, INT_MAX, E},
     {"hls_ts_options","set hls mpegts list of options for the container format used for hls", OFFSET(format_options_str), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
@@ -1749,6 +1781,7 @@ static const AVOption options[] = {
     {"event", "EVENT playlist", 0, AV_OPT_TYPE_CONST, {.i64 = PLAYLIST_TYPE_EVENT }, INT_MIN, INT_MAX, E, "pl_type" },
     {"vod", "VOD playlist", 0, AV_OPT_TYPE_CONST, {.i64 = PLAYLIST_TYPE_VOD }, INT_MIN, INT_MAX, E, "pl_type" },
     {"method", "set the HTTP method(default: PUT)", OFFSET(method), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
+    {"http_persistent", "use persistent HTTP connections shared between segment uploads", OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
     {"hls_start_number_source", "set source of first number in sequence", OFFSET(start_sequence_source_type), AV_OPT_TYPE_INT, {.i64 = HLS_START_SEQUENCE_AS_START_NUMBER }, 0, HLS_START_SEQUENCE_AS_FORMATTED_DATETIME, E, "start_sequence_source_type" },
     {"generic", "start_number value (default)", 0, AV_OPT_TYPE_CONST, {.i64 = HLS_START_SEQUENCE_AS_START_NUMBER }, INT_MIN, INT_MAX, E, "start_sequence_source_type" },
     {"epoch", "seconds since epoch", 0, AV_OPT_TYPE_CONST, {.i64 = HLS_START_SEQUENCE_AS_SECONDS_SINCE_EPOCH }, INT_MIN, INT_MAX, E, "start_sequence_source_type" },
@@ -27,8 +27,10 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
 #include "libavutil/opt.h"
 #include "libavutil/time.h"
+#include "libavutil/thread.h"
 #include "libavutil/parseutils.h"
 
 #include "avformat.h"
@@ -50,6 +52,10 @@
 #define HTTP_SINGLE   1
 #define HTTP_MUTLI    2
 #define MAX_EXPIRY    19
+/* Maximum number of idle connections kept in the pool, for all hosts */
+#define POOL_MAX_SIZE 64
+/* Maximum amount of unread response body drained to reuse a connection */
+#define POOL_MAX_DRAIN 65536
 #define WHITESPACES " \n\t\r"
 typedef enum {
     LOWER_PROTO,
@@ -58,6 +64,25 @@ typedef enum {
     FINISH
 }HandshakeState;
 
+/**
+ * A connection to a server which may be shared by several HTTP contexts
+ * one after the other.
+ */
+typedef struct HTTPPoolConnection {
+    URLContext *hd;
+    /* The lower protocol url hd was opened with, e.g. tcp://host:80, followed
+     * by the proxy and TLS options it was opened with, see pool_make_key() */
+    char *key;
+    int is_tls;
+    /* hd is opened with int_cb, which forwards to the interrupt callback of
+     * the HTTP context currently using the connection. */
+    AVIOInterruptCB owner_cb;
+    AVIOInterruptCB int_cb;
+    /* Time after which an idle connection is dropped */
+    int64_t expiry;
+    struct HTTPPoolConnection *next;
+} HTTPPoolConnection;
+
 typedef struct HTTPContext {
     const AVClass *class;
     URLContext *hd;
@@ -123,6 +148,21 @@ typedef struct HTTPContext {
     int is_multi_client;
     HandshakeState handshake_step;
     int is_connected_server;
+    /* Share idle persistent connections with other HTTP contexts. */
+    int connection_pool;
+    int pool_max_idle;
+    int pool_idle_timeout;
+    /* Set if hd belongs to a (possibly reused) pool connection */
+    HTTPPoolConnection *pool_conn;
+    int pool_reused;
+    /* Length of the current response body, UINT64_MAX if unknown */
+    uint64_t content_length;
+    /* Value of off at the start of the current response body */
+    uint64_t body_start;
+    /* Set once the last chunk of a chunked response has been read */
+    int chunk_end;
+    /* Keep-Alive timeout announced by the server in seconds, 0 if none */
+    int keepalive_timeout;
 } HTTPContext;
 
 #define OFFSET(x) offsetof(HTTPContext, x)
@@ -163,6 +203,9 @@ static const AVOption options[] = {
     { "listen", "listen on HTTP", OFFSET(listen), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 2, D | E },
     { "resource", "The resource requested by a client", OFFSET(resource), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
     { "reply_code", "The http status code to return to a client", OFFSET(reply_code), AV_OPT_TYPE_INT, { .i64 = 200}, INT_MIN, 599, E},
+    { "connection_pool", "share idle persistent connections with other HTTP contexts", OFFSET(connection_pool), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D | E },
+    { "pool_max_idle", "maximum number of idle pooled connections per server", OFFSET(pool_max_idle), AV_OPT_TYPE_INT, { .i64 = 4 }, 0, POOL_MAX_SIZE, D | E },
+    { "pool_idle_timeout", "time in seconds after which idle pooled connections are closed", OFFSET(pool_idle_timeout), AV_OPT_TYPE_INT, { .i64 = 30 }, 0, INT_MAX, D | E },
     { NULL }
 };
 
@@ -181,6 +224,232 @@ void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
            sizeof(HTTPAuthState));
 }
 
+static AVMutex pool_lock;
+static AVOnce pool_init_once = AV_ONCE_INIT;
+/* Idle connections, most recently used first */
+static HTTPPoolConnection *pool;
+static int pool_size;
+
+static void pool_init(void)
+{
+    ff_mutex_init(&pool_lock, NULL);
+}
+
+static int pool_interrupt_cb(void *opaque)
+{
+    HTTPPoolConnection *conn = opaque;
+    return ff_check_interrupt(&conn->owner_cb);
+}
+
+static void pool_conn_free(HTTPPoolConnection **pconn)
+{
+    HTTPPoolConnection *conn = *pconn;
+
+    if (!conn)
+        return;
+    ffurl_closep(&conn->hd);
+    av_freep(&conn->key);
+    av_freep(pconn);
+}
+
+/*
+ * Options of the lower protocol that change what a connection is, so that
+ * connections opened with different values must not be shared.
+ */
+static const char *const pool_key_options[] = {
+    "tls_verify", "ca_file", "cafile", "cert_file", "key_file", "verifyhost",
+};
+
+/**
+ * Build the key identifying the connections usable for a request: the lower
+ * protocol url, the proxy in use if any, and the TLS options.
+ *
+ * @return the key, or NULL on allocation failure
+ */
+static char *pool_make_key(const char *lower_url, const char *proxy,
+                           AVDictionary *options)
+{
+    AVBPrint bp;
+    char *key;
+    int i;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&bp, "%s\nproxy=%s", lower_url, proxy ? proxy : "");
+    if (av_strstart(lower_url, "tls:", NULL)) {
+        for (i = 0; i < FF_ARRAY_ELEMS(pool_key_options); i++) {
+            AVDictionaryEntry *e = av_dict_get(options, pool_key_options[i], NULL, 0);
+            av_bprintf(&bp, "\n%s=%s", pool_key_options[i], e ? e->value : "");
+        }
+    }
+    if (av_bprint_finalize(&bp, &key) < 0)
+        return NULL;
+    return key;
+}
+
+void ff_http_pool_close(void)
+{
+    HTTPPoolConnection *conn;
+
+    ff_thread_once(&pool_init_once, pool_init);
+
+    ff_mutex_lock(&pool_lock);
+    conn      = pool;
+    pool      = NULL;
+    pool_size = 0;
+    ff_mutex_unlock(&pool_lock);
+
+    while (conn) {
+        HTTPPoolConnection *next = conn->next;
+        pool_conn_free(&conn);
+        conn = next;
+    }
+}
+
+/**
+ * Check that the server did not close an idle connection.
+ * An idle connection must not have anything to read, but TLS connections
+ * may carry protocol messages, so only a hangup is conclusive for them.
+ */
+static int pool_conn_is_alive(HTTPPoolConnection *conn)
+{
+    struct pollfd p = { .events = POLLIN };
+    int ret;
+
+    p.fd = ffurl_get_file_handle(conn->hd);
+    if (p.fd < 0)
+        return 1;
+    ret = poll(&p, 1, 0);
+    if (ret < 0 || (p.revents & (POLLHUP | POLLERR)))
+        return 0;
+    return conn->is_tls || !(p.revents & POLLIN);
+}
+
+/**
+ * Take an idle connection opened with the given lower protocol url out of
+ * the pool, dropping expired and closed connections on the way.
+ */
+static HTTPPoolConnection *pool_get(const char *key)
+{
+    HTTPPoolConnection *conn = NULL, *expired = NULL, **p;
+    int64_t now = av_gettime_relative();
+
+    ff_thread_once(&pool_init_once, pool_init);
+
+    ff_mutex_lock(&pool_lock);
+    for (p = &pool; *p;) {
+        HTTPPoolConnection *c = *p;
+        if (c->expiry <= now || (!conn && !strcmp(c->key, key))) {
+            *p = c->next;
+            pool_size--;
+            if (c->expiry <= now) {
+                c->next = expired;
+                expired = c;
+            } else {
+                conn = c;
+            }
+        } else {
+            p = &c->next;
+        }
+    }
+    ff_mutex_unlock(&pool_lock);
+
+    while (expired) {
+        HTTPPoolConnection *next = expired->next;
+        pool_conn_free(&expired);
+        expired = next;
+    }
+
+    if (conn && !pool_conn_is_alive(conn)) {
+        pool_conn_free(&conn);
+        return pool_get(key);
+    }
+    return conn;
+}
+
+/* Put a connection back into the pool, or close it if the pool is full. */
+static void pool_put(HTTPPoolConnection *conn, int max_idle)
+{
+    HTTPPoolConnection *c;
+    int n = 0;
+
+    ff_thread_once(&pool_init_once, pool_init);
+
+    memset(&conn->owner_cb, 0, sizeof(conn->owner_cb));
+
+    ff_mutex_lock(&pool_lock);
+    for (c = pool; c; c = c->next)
+        n += !strcmp(c->key, conn->key);
+    if (n < max_idle && pool_size < POOL_MAX_SIZE) {
+        conn->next = pool;
+        pool       = conn;
+        pool_size++;
+        conn       = NULL;
+    }
+    ff_mutex_unlock(&pool_lock);
+
+    pool_conn_free(&conn);
+}
+
+/**
+ * Open the connection to the server, reusing an idle one from the pool
+ * if allowed.
+ */
+static int http_pool_open(URLContext *h, const char *lower_url, const char *proxy,
+                          AVDictionary **options, int reuse)
+{
+    HTTPContext *s = h->priv_data;
+    HTTPPoolConnection *conn = NULL;
+    char *key;
+    int err;
+
+    key = pool_make_key(lower_url, proxy, options ? *options : NULL);
+    if (!key)
+        return AVERROR(ENOMEM);
+    if (reuse)
+        conn = pool_get(key);
+
+    if (conn) {
+        av_log(h, AV_LOG_DEBUG, "Reusing connection %s\n", lower_url);
+        s->pool_reused = 1;
+        av_free(key);
+    } else {
+        conn = av_mallocz(sizeof(*conn));
+        if (!conn) {
+            av_free(key);
+            return AVERROR(ENOMEM);
+        }
+        conn->key             = key;
+        conn->is_tls          = av_strstart(lower_url, "tls:", NULL);
+        conn->int_cb.callback = pool_interrupt_cb;
+        conn->int_cb.opaque   = conn;
+        conn->owner_cb        = h->interrupt_callback;
+        err = ffurl_open_whitelist(&conn->hd, lower_url, AVIO_FLAG_READ_WRITE,
+                                   &conn->int_cb, options,
+                                   h->protocol_whitelist, h->protocol_blacklist, h);
+        if (err < 0) {
+            av_free(conn->key);
+            av_free(conn);
+            return err;
+        }
+        s->pool_reused = 0;
+    }
+    conn->owner_cb = h->interrupt_callback;
+    s->pool_conn   = conn;
+    s->hd          = conn->hd;
+    return 0;
+}
+
+/* Close the connection to the server. */
+static void http_close_hd(HTTPContext *s)
+{
+    if (s->pool_conn) {
+        pool_conn_free(&s->pool_conn);
+        s->hd = NULL;
+    } else {
+        ffurl_closep(&s->hd);
+    }
+}
+
 static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 {
     const char *path, *proxy_path, *lower_proto = "tcp", *local_path;
@@ -227,15 +496,30 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
     ff_url_join(buf, sizeof(buf), lower_proto, NULL, hostname, port, NULL);
 
     if (!s->hd) {
-        err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
-                                   &h->interrupt_callback, options,
-                                   h->protocol_whitelist, h->protocol_blacklist, h);
+        if (s->connection_pool)
+            err = http_pool_open(h, buf, use_proxy ? proxy_path : NULL, options, 1);
+        else
+            err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
+                                       &h->interrupt_callback, options,
+                                       h->protocol_whitelist, h->protocol_blacklist, h);
         if (err < 0)
             return err;
     }
 
+    s->line_count = 0;
     err = http_connect(h, path, local_path, hoststr,
                        auth, proxyauth, &location_changed);
+    if (err < 0 && s->pool_reused && !s->line_count &&
+        !(h->flags & AVIO_FLAG_WRITE) && !s->post_data) {
+        /* The server may have closed the idle connection in the meantime,
+         * retry the request on a new one. */
+        av_log(h, AV_LOG_VERBOSE, "Reused connection failed, reconnecting\n");
+        http_close_hd(s);
+        if ((err = http_pool_open(h, buf, use_proxy ? proxy_path : NULL, options, 0)) < 0)
+            return err;
+        err = http_connect(h, path, local_path, hoststr,
+                           auth, proxyauth, &location_changed);
+    }
     if (err < 0)
         return err;
 
@@ -262,7 +546,7 @@ redo:
     if (s->http_code == 401) {
         if ((cur_auth_type == HTTP_AUTH_NONE || s->auth_state.stale) &&
             s->auth_state.auth_type != HTTP_AUTH_NONE && attempts < 4) {
-            ffurl_closep(&s->hd);
+            http_close_hd(s);
             goto redo;
         } else
             goto fail;
@@ -270,7 +554,7 @@ redo:
     if (s->http_code == 407) {
         if ((cur_proxy_auth_type == HTTP_AUTH_NONE || s->proxy_auth_state.stale) &&
             s->proxy_auth_state.auth_type != HTTP_AUTH_NONE && attempts < 4) {
-            ffurl_closep(&s->hd);
+            http_close_hd(s);
             goto redo;
         } else
             goto fail;
@@ -279,7 +563,7 @@ redo:
          s->http_code == 303 || s->http_code == 307) &&
         location_changed == 1) {
         /* url moved, get next */
-        ffurl_closep(&s->hd);
+        http_close_hd(s);
         if (redirects++ >= MAX_REDIRECTS)
             return AVERROR(EIO);
         /* Restart the authentication process with the new target, which
@@ -293,7 +577,7 @@ redo:
 
 fail:
     if (s->hd)
-        ffurl_closep(&s->hd);
+        http_close_hd(s);
     if (location_changed < 0)
         return location_changed;
     return ff_http_averror(s->http_code, AVERROR(EIO));
@@ -913,9 +1197,10 @@ static int process_line(URLContext *h, char *line, int line_count,
             if ((ret = parse_location(s, p)) < 0)
                 return ret;
             *new_location = 1;
-        } else if (!av_strcasecmp(tag, "Content-Length") &&
-                   s->filesize == UINT64_MAX) {
-            s->filesize = strtoull(p, NULL, 10);
+        } else if (!av_strcasecmp(tag, "Content-Length")) {
+            s->content_length = strtoull(p, NULL, 10);
+            if (s->filesize == UINT64_MAX)
+                s->filesize = s->content_length;
         } else if (!av_strcasecmp(tag, "Content-Range")) {
             parse_content_range(h, p);
         } else if (!av_strcasecmp(tag, "Accept-Ranges") &&
@@ -935,6 +1220,10 @@ static int process_line(URLContext *h, char *line, int line_count,
         } else if (!av_strcasecmp(tag, "Connection")) {
             if (!strcmp(p, "close"))
                 s->willclose = 1;
+        } else if (!av_strcasecmp(tag, "Keep-Alive")) {
+            const char *timeout = av_stristr(p, "timeout=");
+            if (timeout)
+                s->keepalive_timeout = strtol(timeout + 8, NULL, 10);
         } else if (!av_strcasecmp(tag, "Server")) {
             if (!av_strcasecmp(p, "AkamaiGHost")) {
                 s->is_akamai = 1;
@@ -1072,7 +1361,10 @@ static int http_read_header(URLContext *h, int *new_location)
     char line[MAX_URL_SIZE];
     int err = 0;
 
-    s->chunksize = UINT64_MAX;
+    s->chunksize         = UINT64_MAX;
+    s->chunk_end         = 0;
+    s->content_length    = UINT64_MAX;
+    s->keepalive_timeout = 0;
 
     for (;;) {
         if ((err = http_get_line(s, line, sizeof(line))) < 0)
@@ -1095,6 +1387,8 @@ static int http_read_header(URLContext *h, int *new_location)
     cookie_string(s->cookie_dict, &s->cookies);
     av_dict_free(&s->cookie_dict);
 
+    s->body_start = s->off;
+
     return err;
 }
 
@@ -1173,7 +1467,7 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
                            "Expect: 100-continue\r\n");
 
     if (!has_header(s->headers, "\r\nConnection: ")) {
-        if (s->multiple_requests)
+        if (s->multiple_requests || s->connection_pool)
             len += av_strlcpy(headers + len, "Connection: keep-alive\r\n",
                               sizeof(headers) - len);
         else
@@ -1278,6 +1572,8 @@ static int http_buf_read(URLContext *h, uint8_t *buf, int size)
     int len;
 
     if (s->chunksize != UINT64_MAX) {
+        if (s->chunk_end)
+            return 0;
         if (!s->chunksize) {
             char line[32];
             int err;
@@ -1293,9 +1589,10 @@ static int http_buf_read(URLContext *h, uint8_t *buf, int size)
                    "Chunked encoding data size: %"PRIu64"'\n",
                     s->chunksize);
 
-            if (!s->chunksize)
+            if (!s->chunksize) {
+                s->chunk_end = 1;
                 return 0;
-            else if (s->chunksize == UINT64_MAX) {
+            } else if (s->chunksize == UINT64_MAX) {
                 av_log(h, AV_LOG_ERROR, "Invalid chunk size %"PRIu64"\n",
                        s->chunksize);
                 return AVERROR(EINVAL);
@@ -1550,6 +1847,78 @@ static int http_shutdown(URLContext *h, int flags)
     return ret;
 }
 
+/**
+ * Read the rest of the current response, so that the connection may be
+ * used for another request.
+ * @return 1 if the connection can be reused, 0 otherwise
+ */
+static int http_finish_response(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    uint8_t buf[1024];
+    uint64_t drained = 0;
+    int new_location, ret;
+
+    if (h->flags & AVIO_FLAG_WRITE) {
+        /* the request body must have been terminated */
+        if (!s->chunked_post || !s->end_chunked_post)
+            return 0;
+        if (!s->end_header && http_read_header(h, &new_location) < 0)
+            return 0;
+    }
+    if (s->willclose || !s->end_header)
+        return 0;
+
+    if (s->chunksize != UINT64_MAX) {
+        char line[MAX_URL_SIZE];
+        while (!s->chunk_end) {
+            ret = http_buf_read(h, buf, sizeof(buf));
+            if (ret < 0 || (drained += ret) > POOL_MAX_DRAIN)
+                return 0;
+        }
+        /* skip the trailer */
+        do {
+            if (http_get_line(s, line, sizeof(line)) < 0)
+                return 0;
+        } while (*line);
+    } else if (s->content_length != UINT64_MAX) {
+        uint64_t end = s->body_start + s->content_length;
+        if (end - s->off > POOL_MAX_DRAIN)
+            return 0;
+        while (s->off < end) {
+            ret = http_buf_read(h, buf, FFMIN(sizeof(buf), end - s->off));
+            if (ret <= 0)
+                return 0;
+        }
+    } else if (s->http_code != 204 && s->http_code != 304) {
+        /* the body is delimited by the end of the connection */
+        return 0;
+    }
+
+    /* nothing else may have been sent */
+    return s->buf_ptr == s->buf_end;
+}
+
+/* Return the connection to the pool if another request may use it. */
+static void http_pool_release(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    HTTPPoolConnection *conn = s->pool_conn;
+    int timeout = s->pool_idle_timeout;
+
+    if (!http_finish_response(h)) {
+        http_close_hd(s);
+        return;
+    }
+    if (s->keepalive_timeout > 0)
+        timeout = FFMIN(timeout, s->keepalive_timeout - 1);
+
+    s->pool_conn = NULL;
+    s->hd        = NULL;
+    conn->expiry = av_gettime_relative() + timeout * 1000000LL;
+    pool_put(conn, s->pool_max_idle);
+}
+
 static int http_close(URLContext *h)
 {
     int ret = 0;
@@ -1564,8 +1933,10 @@ static int http_close(URLContext *h)
         /* Close the write direction by sending the end of chunked encoding. */
         ret = http_shutdown(h, h->flags);
 
-    if (s->hd)
-        ffurl_closep(&s->hd);
+    if (s->pool_conn && ret >= 0)
+        http_pool_release(h);
+    else if (s->hd)
+        http_close_hd(s);
     av_dict_free(&s->chained_options);
     return ret;
 }
@@ -1574,6 +1945,7 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
 {
     HTTPContext *s = h->priv_data;
     URLContext *old_hd = s->hd;
+    HTTPPoolConnection *old_conn = s->pool_conn;
     uint64_t old_off = s->off;
     uint8_t old_buf[BUFFER_SIZE];
     int old_buf_size, ret;
@@ -1604,7 +1976,8 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
     /* we save the old context in case the seek fails */
     old_buf_size = s->buf_end - s->buf_ptr;
     memcpy(old_buf, s->buf_ptr, old_buf_size);
-    s->hd = NULL;
+    s->hd        = NULL;
+    s->pool_conn = NULL;
 
     /* if it fails, continue on old connection */
     if ((ret = http_open_cnx(h, &options)) < 0) {
@@ -1612,12 +1985,18 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
         memcpy(s->buffer, old_buf, old_buf_size);
         s->buf_ptr = s->buffer;
         s->buf_end = s->buffer + old_buf_size;
-        s->hd      = old_hd;
-        s->off     = old_off;
+        if (s->pool_conn)
+            http_close_hd(s);
+        s->hd        = old_hd;
+        s->pool_conn = old_conn;
+        s->off       = old_off;
         return ret;
     }
     av_dict_free(&options);
-    ffurl_close(old_hd);
+    if (old_conn)
+        pool_conn_free(&old_conn);
+    else
+        ffurl_close(old_hd);
     return off;
 }
 
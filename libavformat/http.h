@@ -49,4 +49,9 @@ int ff_http_do_new_request(URLContext *h, const char *uri);
 
 int ff_http_averror(int status_code, int default_averror);
 
+/**
+ * Close the idle connections kept by the connection_pool option.
+ */
+void ff_http_pool_close(void);
+
 #endif /* AVFORMAT_HTTP_H */
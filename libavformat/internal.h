@@ -150,6 +150,17 @@ struct AVFormatInternal {
      * Prefer the codec framerate for avg_frame_rate computation.
      */
     int prefer_codec_framerate;
+
+    /**
+     * Packets waiting to be decoded by avformat_find_stream_info(), only
+     * used with more than one info thread.
+     */
+    struct InfoDecodeQueue *info_queue;
+
+    /**
+     * Probe cache entry of the input, see AVFormatContext.probe_cache_dir.
+     */
+    struct ProbeCache *probe_cache;
 };
 
 struct AVStreamInternal {
@@ -196,6 +207,16 @@ struct AVStreamInternal {
      * Whether the internal avctx needs to be updated from codecpar (after a late change to codecpar)
      */
     int need_context_update;
+
+    /**
+     * 1 if a packet of this stream waits in the info decode queue
+     */
+    int info_queued;
+
+    /**
+     * 1 once avformat_find_stream_info() found the codec parameters
+     */
+    int info_complete;
 };
 
 #ifdef __GNUC__
@@ -351,6 +372,23 @@ int ff_add_index_entry(AVIndexEntry **index_entries,
 
 void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance);
 
+/**
+ * Check whether the I/O buffers of an input should be configured for its
+ * interleaving, i.e. whether it is not read from a local file.
+ */
+int ff_configure_buffers_needed(AVFormatContext *s);
+
+/**
+ * Configure the I/O buffer size and short seek threshold of an input, as
+ * ff_configure_buffers_for_index() does, for demuxers which do not keep
+ * all their samples in AVStream.index_entries.
+ *
+ * @param pos_delta largest distance between the positions of packets of
+ *                  different streams that are within the time tolerance
+ * @param skip      largest packet size
+ */
+void ff_configure_buffers(AVFormatContext *s, int64_t pos_delta, int64_t skip);
+
 /**
  * Add a new chapter.
  *
@@ -622,6 +660,13 @@ int ff_format_output_open(AVFormatContext *s, const char *url, AVDictionary **op
  */
 void ff_format_io_close(AVFormatContext *s, AVIOContext **pb);
 
+/**
+ * Check whether AVFormatContext.io_open is still the default callback,
+ * i.e. whether opening a url is the same as calling ffio_open_whitelist()
+ * with the context's whitelists and may thus be done from any thread.
+ */
+int ff_format_io_open_is_default(const AVFormatContext *s);
+
 /**
  * Parse creation_time in AVFormatContext metadata if exists and warn if the
  * parsing fails.
@@ -669,6 +714,16 @@ int ff_reshuffle_raw_rgb(AVFormatContext *s, AVPacket **ppkt, AVCodecParameters
  */
 int ff_get_packet_palette(AVFormatContext *s, AVPacket *pkt, int ret, uint32_t *palette);
 
+/**
+ * Like av_get_packet(), but the packet may reference the storage of the
+ * protocol directly instead of a copy, e.g. a memory mapped file.
+ * The packet data is then read-only, so only use this where the payload is
+ * not modified in place. The padding of such a packet holds the bytes
+ * following the payload in the storage instead of zeros; a padded copy is
+ * only made where the storage does not extend that far.
+ */
+int ff_get_packet_ref(AVIOContext *s, AVPacket *pkt, int size);
+
 /**
  * Finalize buf into extradata and set its size appropriately.
  */
@@ -685,4 +740,34 @@ int ff_bprint_to_codecpar_extradata(AVCodecParameters *par, struct AVBPrint *buf
 int ff_interleaved_peek(AVFormatContext *s, int stream,
                         AVPacket *pkt, int add_offset);
 
+/**
+ * Find the probe cache entry of the input opened in s->pb and load it.
+ * If s->iformat is not set yet, set it to the cached input format.
+ *
+ * @return the cached probe score if s->iformat was set, 0 otherwise
+ */
+int ff_probe_cache_lookup(AVFormatContext *s, const char *url);
+
+/**
+ * Set the stream parameters from the loaded probe cache entry, if it
+ * matches the streams created by the demuxer.
+ *
+ * @return 1 if the entry was applied, 0 if not, a negative error code on
+ *         failure
+ */
+int ff_probe_cache_apply(AVFormatContext *s);
+
+/**
+ * Forget that the probe cache entry was applied, so that it is written
+ * again by ff_probe_cache_store().
+ */
+void ff_probe_cache_reject(AVFormatContext *s);
+
+/**
+ * Write the probe cache entry of the input, unless it was used.
+ */
+void ff_probe_cache_store(AVFormatContext *s);
+
+void ff_probe_cache_free(AVFormatContext *s);
+
 #endif /* AVFORMAT_INTERNAL_H */
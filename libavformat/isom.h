@@ -202,6 +202,29 @@ typedef struct MOVStreamContext {
     uint32_t format;
 
     int has_sidx;  // If there is an sidx entry for this stream.
+
+    /**
+     * Compact index: samples are looked up in the sample tables on demand
+     * instead of being expanded into st->index_entries.
+     */
+    struct {
+        int enabled;
+        unsigned int nb_samples;
+        int64_t start_dts;    ///< dts of the first sample
+        int key_off;          ///< 1 if stss/stps sample numbers are 1-based
+        int all_sync;         ///< all samples are sync samples if no table says otherwise
+        unsigned int sample;  ///< sample the cursor points to
+        unsigned int chunk;
+        unsigned int chunk_sample;
+        unsigned int stsc_index;
+        unsigned int stts_index;
+        unsigned int stts_sample;
+        unsigned int rap_group_index;
+        unsigned int rap_group_sample;
+        unsigned int sync_index;  ///< first sync table entry at or after the sample
+        AVIndexEntry entry;   ///< entry of the sample the cursor points to
+    } compact;
+
     struct {
         int use_subsamples;
         uint8_t* auxiliary_info;
@@ -265,6 +288,7 @@ typedef struct MOVContext {
     int decryption_key_len;
     int enable_drefs;
     int32_t movie_display_matrix[3][3]; ///< display matrix from mvhd
+    int compact_index;
 } MOVContext;
 
 int ff_mp4_read_descr_len(AVIOContext *pb);
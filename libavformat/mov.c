@@ -2969,10 +2969,285 @@ static int64_t add_ctts_entry(MOVStts** ctts_data, unsigned int* ctts_count, uns
     return *ctts_count;
 }
 
+/* Sync sample table used by the compact index: stss, or stps for open-gop
+ * files without stss. */
+static unsigned int mov_compact_sync_count(MOVStreamContext *sc)
+{
+    return !sc->keyframe_absent ? sc->keyframe_count : sc->stps_count;
+}
+
+static int64_t mov_compact_sync_entry(MOVStreamContext *sc, unsigned int i)
+{
+    return !sc->keyframe_absent ? sc->keyframes[i] : sc->stps_data[i];
+}
+
+/* Index of the first sync table entry at or after the given sample. */
+static unsigned int mov_compact_sync_lower_bound(MOVStreamContext *sc, int64_t sample)
+{
+    unsigned int lo = 0, hi = mov_compact_sync_count(sc);
+
+    while (lo < hi) {
+        unsigned int mid = (lo + hi) >> 1;
+        if (mov_compact_sync_entry(sc, mid) < sample + sc->compact.key_off)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void mov_compact_update_entry(MOVStreamContext *sc)
+{
+    AVIndexEntry *e = &sc->compact.entry;
+    unsigned int sample = sc->compact.sample;
+    unsigned int count = mov_compact_sync_count(sc);
+    int keyframe = 0;
+
+    e->size = sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[sample];
+    e->min_distance = 0;
+
+    if (count) {
+        unsigned int i = sc->compact.sync_index;
+        keyframe = i < count &&
+                   mov_compact_sync_entry(sc, i) == sample + sc->compact.key_off;
+    } else if (!sc->keyframe_absent) {
+        keyframe = 1;
+    }
+    if (sc->rap_group_count && sc->rap_group) {
+        if (sc->compact.rap_group_index < sc->rap_group_count &&
+            sc->rap_group[sc->compact.rap_group_index].index > 0)
+            keyframe = 1;
+    } else if (!count && sc->keyframe_absent) {
+        keyframe = sc->compact.all_sync || !sample;
+    }
+    e->flags = keyframe ? AVINDEX_KEYFRAME : 0;
+}
+
+/**
+ * Position the compact index cursor on the given sample.
+ * This walks the stts, stsc and sbgp runs, sums the sizes of the
+ * preceding samples of the chunk and binary-searches the sync table.
+ */
+static void mov_compact_seek(MOVStreamContext *sc, unsigned int sample)
+{
+    AVIndexEntry *e = &sc->compact.entry;
+    uint64_t first = 0;
+    int64_t pos;
+    unsigned int i, j;
+
+    sc->compact.sample = sample;
+    if (sample >= sc->compact.nb_samples)
+        return;
+
+    e->timestamp = sc->compact.start_dts;
+    for (i = 0; i + 1 < sc->stts_count && sample - first >= sc->stts_data[i].count; i++) {
+        e->timestamp += (int64_t)sc->stts_data[i].count * sc->stts_data[i].duration;
+        first        += sc->stts_data[i].count;
+    }
+    sc->compact.stts_index  = i;
+    sc->compact.stts_sample = sample - first;
+    e->timestamp += (int64_t)sc->compact.stts_sample * sc->stts_data[i].duration;
+
+    first = 0;
+    for (i = 0; ; i++) {
+        unsigned int start = sc->stsc_data[i].first - 1;
+        unsigned int end   = mov_stsc_index_valid(i, sc->stsc_count) ?
+                             sc->stsc_data[i + 1].first - 1 : sc->chunk_count;
+        uint64_t samples   = (uint64_t)(FFMIN(end, sc->chunk_count) - FFMIN(start, sc->chunk_count)) *
+                             sc->stsc_data[i].count;
+        if (!mov_stsc_index_valid(i, sc->stsc_count) || sample - first < samples) {
+            sc->compact.chunk        = start + (sample - first) / sc->stsc_data[i].count;
+            sc->compact.chunk_sample = (sample - first) % sc->stsc_data[i].count;
+            break;
+        }
+        first += samples;
+    }
+    sc->compact.stsc_index = i;
+
+    pos = sc->chunk_offsets[sc->compact.chunk];
+    if (sc->stsz_sample_size > 0) {
+        pos += (int64_t)sc->compact.chunk_sample * sc->stsz_sample_size;
+    } else {
+        for (j = sample - sc->compact.chunk_sample; j < sample; j++)
+            pos += sc->sample_sizes[j];
+    }
+    e->pos = pos;
+
+    first = 0;
+    for (i = 0; i < sc->rap_group_count && sample - first >= sc->rap_group[i].count; i++)
+        first += sc->rap_group[i].count;
+    sc->compact.rap_group_index  = i;
+    sc->compact.rap_group_sample = sample - first;
+
+    sc->compact.sync_index = mov_compact_sync_lower_bound(sc, sample);
+
+    mov_compact_update_entry(sc);
+}
+
+/* Advance the compact index cursor by one sample. */
+static void mov_compact_next(MOVStreamContext *sc)
+{
+    AVIndexEntry *e = &sc->compact.entry;
+
+    if (sc->compact.sample >= sc->compact.nb_samples) {
+        sc->compact.sample++;
+        return;
+    }
+
+    e->pos       += e->size;
+    e->timestamp += sc->stts_data[sc->compact.stts_index].duration;
+    sc->compact.stts_sample++;
+    if (sc->compact.stts_index + 1 < sc->stts_count &&
+        sc->compact.stts_sample == sc->stts_data[sc->compact.stts_index].count) {
+        sc->compact.stts_sample = 0;
+        sc->compact.stts_index++;
+    }
+    if (sc->compact.rap_group_index < sc->rap_group_count &&
+        ++sc->compact.rap_group_sample == sc->rap_group[sc->compact.rap_group_index].count) {
+        sc->compact.rap_group_sample = 0;
+        sc->compact.rap_group_index++;
+    }
+
+    if (++sc->compact.sample >= sc->compact.nb_samples)
+        return;
+
+    if (sc->compact.sync_index < mov_compact_sync_count(sc) &&
+        mov_compact_sync_entry(sc, sc->compact.sync_index) < sc->compact.sample + sc->compact.key_off)
+        sc->compact.sync_index++;
+
+    if (++sc->compact.chunk_sample >= sc->stsc_data[sc->compact.stsc_index].count) {
+        sc->compact.chunk_sample = 0;
+        do {
+            sc->compact.chunk++;
+            while (mov_stsc_index_valid(sc->compact.stsc_index, sc->stsc_count) &&
+                   sc->compact.chunk + 1 == sc->stsc_data[sc->compact.stsc_index + 1].first)
+                sc->compact.stsc_index++;
+        } while (!sc->stsc_data[sc->compact.stsc_index].count);
+        e->pos = sc->chunk_offsets[sc->compact.chunk];
+    }
+    mov_compact_update_entry(sc);
+}
+
+/* Index of the first sample with a dts at or after the wanted one. */
+static unsigned int mov_compact_search_dts(MOVStreamContext *sc, int64_t wanted)
+{
+    int64_t dts = sc->compact.start_dts;
+    unsigned int sample = 0, i;
+
+    for (i = 0; i < sc->stts_count && sample < sc->compact.nb_samples; i++) {
+        unsigned int count = sc->compact.nb_samples - sample;
+        int duration = sc->stts_data[i].duration;
+
+        if (i + 1 < sc->stts_count)
+            count = FFMIN(count, sc->stts_data[i].count);
+        if (dts + (int64_t)(count - 1) * duration >= wanted) {
+            if (dts >= wanted)
+                return sample;
+            return sample + (wanted - dts + duration - 1) / duration;
+        }
+        dts    += (int64_t)count * duration;
+        sample += count;
+    }
+    return sc->compact.nb_samples;
+}
+
+/* Last sync sample at or before (backward) or first one at or after the
+ * given sample, -1 or nb_samples if there is none. */
+static int64_t mov_compact_find_keyframe(MOVStreamContext *sc, int64_t sample, int backward)
+{
+    unsigned int count = mov_compact_sync_count(sc);
+
+    if (sc->rap_group_count && sc->rap_group) {
+        /* sample groups are run length coded, walk the samples */
+        if (!backward) {
+            mov_compact_seek(sc, sample);
+            while (sc->compact.sample < sc->compact.nb_samples &&
+                   !(sc->compact.entry.flags & AVINDEX_KEYFRAME))
+                mov_compact_next(sc);
+            return sc->compact.sample;
+        }
+        for (; sample >= 0; sample--) {
+            mov_compact_seek(sc, sample);
+            if (sc->compact.entry.flags & AVINDEX_KEYFRAME)
+                break;
+        }
+        return sample;
+    }
+    if (count) {
+        unsigned int i = mov_compact_sync_lower_bound(sc, sample);
+        if (backward) {
+            if (i < count && mov_compact_sync_entry(sc, i) == sample + sc->compact.key_off)
+                return sample;
+            return i ? mov_compact_sync_entry(sc, i - 1) - sc->compact.key_off : -1;
+        }
+        return i < count ? FFMIN(mov_compact_sync_entry(sc, i) - sc->compact.key_off,
+                                 sc->compact.nb_samples) : sc->compact.nb_samples;
+    }
+    if (!sc->keyframe_absent || sc->compact.all_sync)
+        return sample;
+    /* only the first sample is a sync sample */
+    return backward || !sample ? 0 : sc->compact.nb_samples;
+}
+
+/* Compact index counterpart of av_index_search_timestamp(). */
+static int mov_compact_search_timestamp(MOVStreamContext *sc, int64_t wanted, int flags)
+{
+    int backward = flags & AVSEEK_FLAG_BACKWARD;
+    int64_t sample;
+
+    if (backward)
+        sample = wanted == INT64_MAX ? sc->compact.nb_samples - 1 :
+                 (int64_t)mov_compact_search_dts(sc, wanted + 1) - 1;
+    else
+        sample = mov_compact_search_dts(sc, wanted);
+
+    if (!(flags & AVSEEK_FLAG_ANY) && sample >= 0 && sample < sc->compact.nb_samples)
+        sample = mov_compact_find_keyframe(sc, sample, backward);
+
+    if (sample >= sc->compact.nb_samples)
+        return -1;
+    return sample;
+}
+
+/**
+ * Expand a compact index into st->index_entries, for code which needs
+ * random access to the entries or appends to them.
+ */
+static int mov_compact_index_expand(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    unsigned int distance = 0, i;
+
+    if (!sc->compact.enabled)
+        return 0;
+
+    if (av_reallocp_array(&st->index_entries, sc->compact.nb_samples,
+                          sizeof(*st->index_entries)) < 0) {
+        st->nb_index_entries = 0;
+        return AVERROR(ENOMEM);
+    }
+    st->index_entries_allocated_size = sc->compact.nb_samples * sizeof(*st->index_entries);
+
+    mov_compact_seek(sc, 0);
+    for (i = 0; i < sc->compact.nb_samples; i++) {
+        AVIndexEntry *e = &st->index_entries[i];
+        *e = sc->compact.entry;
+        if (e->flags & AVINDEX_KEYFRAME)
+            distance = 0;
+        e->min_distance = distance++;
+        mov_compact_next(sc);
+    }
+    st->nb_index_entries = sc->compact.nb_samples;
+    sc->compact.enabled = 0;
+    return 0;
+}
+
 static void mov_current_sample_inc(MOVStreamContext *sc)
 {
     sc->current_sample++;
     sc->current_index++;
+    if (sc->compact.enabled)
+        mov_compact_next(sc);
     if (sc->index_ranges &&
         sc->current_index >= sc->current_index_range->end &&
         sc->current_index_range->end) {
@@ -2985,6 +3260,8 @@ static void mov_current_sample_dec(MOVStreamContext *sc)
 {
     sc->current_sample--;
     sc->current_index--;
+    if (sc->compact.enabled)
+        mov_compact_seek(sc, sc->current_sample);
     if (sc->index_ranges &&
         sc->current_index < sc->current_index_range->start &&
         sc->current_index_range > sc->index_ranges) {
@@ -2999,6 +3276,8 @@ static void mov_current_sample_set(MOVStreamContext *sc, int current_sample)
 
     sc->current_sample = current_sample;
     sc->current_index = current_sample;
+    if (sc->compact.enabled)
+        mov_compact_seek(sc, current_sample);
     if (!sc->index_ranges) {
         return;
     }
@@ -3329,6 +3608,105 @@ static void mov_fix_index(MOVContext *mov, AVStream *st)
     msc->current_index = msc->index_ranges[0].start;
 }
 
+/**
+ * Set up the compact index of a stream, when its sample tables can be
+ * walked without the corrections mov_build_index() applies to odd files.
+ * @return 1 if the stream uses the compact index, 0 otherwise
+ */
+static int mov_compact_index_init(MOVContext *mov, AVStream *st, int64_t start_dts)
+{
+    MOVStreamContext *sc = st->priv_data;
+    uint64_t stream_size = 0, total = 0;
+    unsigned int stsc_index = 0, i;
+
+    if (!mov->compact_index ||
+        (st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO &&
+         st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO))
+        return 0;
+    if (sc->elst_count && mov->advanced_editlist && !mov->ignore_editlist)
+        return 0;
+    if (!sc->chunk_count || !sc->stts_count || !sc->stsc_count ||
+        sc->stsc_data[0].first != 1 || !sc->stsc_data[0].count)
+        return 0;
+    if (sc->stsz_sample_size > 0 && sc->stsz_sample_size < sc->sample_size)
+        return 0;
+    if (!sc->stsz_sample_size && !sc->sample_sizes)
+        return 0;
+
+    /* the cursor relies on well-formed, monotonic tables */
+    for (i = 0; i < sc->stsc_count; i++)
+        if ((i && sc->stsc_data[i].first <= sc->stsc_data[i - 1].first) ||
+            (sc->pseudo_stream_id != -1 &&
+             sc->stsc_data[i].id - 1 != sc->pseudo_stream_id))
+            return 0;
+    for (i = 0; i < sc->stts_count; i++)
+        if (sc->stts_data[i].duration < 0 ||
+            (!sc->stts_data[i].count && i + 1 < sc->stts_count))
+            return 0;
+    if (sc->keyframe_count && sc->stps_count)
+        return 0;
+    if (sc->keyframe_count && sc->keyframes[0] < 0)
+        return 0;
+    for (i = 1; i < sc->keyframe_count; i++)
+        if (sc->keyframes[i] <= sc->keyframes[i - 1])
+            return 0;
+    for (i = 1; i < sc->stps_count; i++)
+        if (sc->stps_data[i] <= sc->stps_data[i - 1])
+            return 0;
+    for (i = 0; i < sc->rap_group_count; i++)
+        if (!sc->rap_group[i].count)
+            return 0;
+
+    for (i = 0; i < sc->chunk_count; i++) {
+        int64_t next_offset = i+1 < sc->chunk_count ? sc->chunk_offsets[i+1] : INT64_MAX;
+        int64_t current_offset = sc->chunk_offsets[i];
+        while (mov_stsc_index_valid(stsc_index, sc->stsc_count) &&
+            i + 1 == sc->stsc_data[stsc_index + 1].first)
+            stsc_index++;
+        if (next_offset > current_offset && sc->sample_size>0 && sc->sample_size < sc->stsz_sample_size &&
+            sc->stsc_data[stsc_index].count * (int64_t)sc->stsz_sample_size > next_offset - current_offset)
+            return 0;
+        total += sc->stsc_data[stsc_index].count;
+    }
+    if (total > sc->sample_count)
+        return 0;
+
+    if (sc->stsz_sample_size > 0) {
+        if (sc->stsz_sample_size > 0x3FFFFFFF)
+            return 0;
+        stream_size = total * sc->stsz_sample_size;
+    } else {
+        for (i = 0; i < total; i++) {
+            if ((unsigned)sc->sample_sizes[i] > 0x3FFFFFFF)
+                return 0;
+            stream_size += (unsigned)sc->sample_sizes[i];
+        }
+    }
+
+    sc->compact.enabled    = 1;
+    sc->compact.nb_samples = total;
+    sc->compact.start_dts  = start_dts;
+    sc->compact.key_off    = (sc->keyframe_count && sc->keyframes[0] > 0) ||
+                             (sc->stps_count && sc->stps_data[0] > 0);
+    sc->compact.all_sync   = st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO;
+
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+        mov_compact_seek(sc, 0);
+        for (i = 0; i < total && i < 99; i++) {
+            ff_rfps_add_frame(mov->fc, st, sc->compact.entry.timestamp);
+            mov_compact_next(sc);
+        }
+    }
+    mov_compact_seek(sc, 0);
+
+    av_log(mov->fc, AV_LOG_TRACE, "stream %d: compact index, %u samples\n",
+           st->index, sc->compact.nb_samples);
+
+    if (st->duration > 0)
+        st->codecpar->bit_rate = stream_size*8*sc->time_scale/st->duration;
+    return 1;
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -3398,6 +3776,8 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
 
         if (!sc->sample_count || st->nb_index_entries)
             return;
+        if (mov_compact_index_init(mov, st, current_dts))
+            return;
         if (sc->sample_count >= UINT_MAX / sizeof(*st->index_entries) - st->nb_index_entries)
             return;
         if (av_reallocp_array(&st->index_entries,
@@ -3831,14 +4211,16 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         && sc->time_scale == st->codecpar->sample_rate) {
             st->need_parsing = AVSTREAM_PARSE_FULL;
     }
-    /* Do not need those anymore. */
-    av_freep(&sc->chunk_offsets);
-    av_freep(&sc->sample_sizes);
-    av_freep(&sc->keyframes);
-    av_freep(&sc->stts_data);
-    av_freep(&sc->stps_data);
+    /* Do not need those anymore, unless the compact index reads them. */
+    if (!sc->compact.enabled) {
+        av_freep(&sc->chunk_offsets);
+        av_freep(&sc->sample_sizes);
+        av_freep(&sc->keyframes);
+        av_freep(&sc->stts_data);
+        av_freep(&sc->stps_data);
+        av_freep(&sc->rap_group);
+    }
     av_freep(&sc->elst_data);
-    av_freep(&sc->rap_group);
 
     return 0;
 }
@@ -4274,6 +4656,8 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     sc = st->priv_data;
     if (sc->pseudo_stream_id+1 != frag->stsd_id && sc->pseudo_stream_id != -1)
         return 0;
+    if ((err = mov_compact_index_expand(st)) < 0)
+        return err;
     avio_r8(pb); /* version */
     flags = avio_rb24(pb);
     entries = avio_rb32(pb);
@@ -5778,6 +6162,7 @@ static void mov_read_chapters(AVFormatContext *s)
 
         sc = st->priv_data;
         cur_pos = avio_tell(sc->pb);
+        mov_compact_index_expand(st);
 
         if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
             st->disposition |= AV_DISPOSITION_ATTACHED_PIC | AV_DISPOSITION_TIMED_THUMBNAILS;
@@ -6142,6 +6527,83 @@ fail:
     return ret;
 }
 
+/* Entry i of the index of a stream; compact indexes are walked with their
+ * cursor, so consecutive lookups are O(1). */
+static const AVIndexEntry *mov_index_entry(AVStream *st, unsigned int i)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    if (!sc->compact.enabled)
+        return &st->index_entries[i];
+    if (i == sc->compact.sample + 1)
+        mov_compact_next(sc);
+    else if (i != sc->compact.sample)
+        mov_compact_seek(sc, i);
+    return &sc->compact.entry;
+}
+
+static unsigned int mov_index_count(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    return sc->compact.enabled ? sc->compact.nb_samples : st->nb_index_entries;
+}
+
+/**
+ * Same as ff_configure_buffers_for_index(), but also walks the samples of
+ * streams using the compact index.
+ */
+static void mov_configure_buffers(AVFormatContext *s, int64_t time_tolerance)
+{
+    int64_t pos_delta = 0, skip = 0;
+    int ist1, ist2, compact = 0;
+
+    for (ist1 = 0; ist1 < s->nb_streams; ist1++) {
+        MOVStreamContext *sc = s->streams[ist1]->priv_data;
+        compact |= sc->compact.enabled;
+    }
+    if (!compact) {
+        ff_configure_buffers_for_index(s, time_tolerance);
+        return;
+    }
+    if (!ff_configure_buffers_needed(s))
+        return;
+
+    for (ist1 = 0; ist1 < s->nb_streams; ist1++) {
+        AVStream *st1 = s->streams[ist1];
+        for (ist2 = 0; ist2 < s->nb_streams; ist2++) {
+            AVStream *st2 = s->streams[ist2];
+            unsigned int i1, i2;
+
+            if (ist1 == ist2)
+                continue;
+
+            for (i1 = i2 = 0; i1 < mov_index_count(st1); i1++) {
+                const AVIndexEntry *e1 = mov_index_entry(st1, i1);
+                int64_t e1_pts = av_rescale_q(e1->timestamp, st1->time_base, AV_TIME_BASE_Q);
+
+                skip = FFMAX(skip, e1->size);
+                for (; i2 < mov_index_count(st2); i2++) {
+                    const AVIndexEntry *e2 = mov_index_entry(st2, i2);
+                    int64_t e2_pts = av_rescale_q(e2->timestamp, st2->time_base, AV_TIME_BASE_Q);
+                    if (e2_pts - e1_pts < time_tolerance)
+                        continue;
+                    pos_delta = FFMAX(pos_delta, e1->pos - e2->pos);
+                    break;
+                }
+            }
+        }
+    }
+
+    for (ist1 = 0; ist1 < s->nb_streams; ist1++) {
+        MOVStreamContext *sc = s->streams[ist1]->priv_data;
+        if (sc->compact.enabled)
+            mov_compact_seek(sc, sc->current_sample);
+    }
+
+    ff_configure_buffers(s, pos_delta, skip);
+}
+
 static int mov_read_header(AVFormatContext *s)
 {
     MOVContext *mov = s->priv_data;
@@ -6343,11 +6805,22 @@ static int mov_read_header(AVFormatContext *s)
             break;
         }
     }
-    ff_configure_buffers_for_index(s, AV_TIME_BASE);
+    mov_configure_buffers(s, AV_TIME_BASE);
 
     return 0;
 }
 
+static AVIndexEntry *mov_current_entry(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    if (sc->compact.enabled)
+        return (unsigned)sc->current_sample < sc->compact.nb_samples ?
+               &sc->compact.entry : NULL;
+    return sc->current_sample < st->nb_index_entries ?
+           &st->index_entries[sc->current_sample] : NULL;
+}
+
 static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
 {
     AVIndexEntry *sample = NULL;
@@ -6356,8 +6829,8 @@ static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
         MOVStreamContext *msc = avst->priv_data;
-        if (msc->pb && msc->current_sample < avst->nb_index_entries) {
-            AVIndexEntry *current_sample = &avst->index_entries[msc->current_sample];
+        AVIndexEntry *current_sample = mov_current_entry(avst);
+        if (msc->pb && current_sample) {
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
             av_log(s, AV_LOG_TRACE, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, dts);
             if (!sample || (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL) && current_sample->pos < sample->pos) ||
@@ -6454,7 +6927,7 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MOVContext *mov = s->priv_data;
     MOVStreamContext *sc;
-    AVIndexEntry *sample;
+    AVIndexEntry *sample, compact_sample;
     AVStream *st = NULL;
     int64_t current_index;
     int ret;
@@ -6469,6 +6942,11 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         goto retry;
     }
     sc = st->priv_data;
+    if (sc->compact.enabled) {
+        /* the cursor moves on to the next sample below */
+        compact_sample = *sample;
+        sample = &compact_sample;
+    }
     /* must be done just before reading, to avoid infinite loop on sample */
     current_index = sc->current_index;
     mov_current_sample_inc(sc);
@@ -6494,7 +6972,11 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             goto retry;
         }
 
-        ret = av_get_packet(sc->pb, pkt, sample->size);
+        /* aax, cenc and dv audio rewrite the payload in place */
+        if (mov->aax_mode || sc->cenc.aes_ctr || (mov->dv_demux && sc->dv_audio_container))
+            ret = av_get_packet(sc->pb, pkt, sample->size);
+        else
+            ret = ff_get_packet_ref(sc->pb, pkt, sample->size);
         if (ret < 0) {
             if (should_retry(sc->pb, ret)) {
                 mov_current_sample_dec(sc);
@@ -6543,8 +7025,8 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             sc->ctts_sample = 0;
         }
     } else {
-        int64_t next_dts = (sc->current_sample < st->nb_index_entries) ?
-            st->index_entries[sc->current_sample].timestamp : st->duration;
+        AVIndexEntry *next = mov_current_entry(st);
+        int64_t next_dts = next ? next->timestamp : st->duration;
         pkt->duration = next_dts - pkt->dts;
         pkt->pts = pkt->dts;
     }
@@ -6621,10 +7103,17 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     if (ret < 0)
         return ret;
 
-    sample = av_index_search_timestamp(st, timestamp, flags);
-    av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
-    if (sample < 0 && st->nb_index_entries && timestamp < st->index_entries[0].timestamp)
-        sample = 0;
+    if (sc->compact.enabled) {
+        sample = mov_compact_search_timestamp(sc, timestamp, flags);
+        av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
+        if (sample < 0 && timestamp < sc->compact.start_dts)
+            sample = 0;
+    } else {
+        sample = av_index_search_timestamp(st, timestamp, flags);
+        av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
+        if (sample < 0 && st->nb_index_entries && timestamp < st->index_entries[0].timestamp)
+            sample = 0;
+    }
     if (sample < 0) /* not sure what to do */
         return AVERROR_INVALIDDATA;
     mov_current_sample_set(sc, sample);
@@ -6675,7 +7164,7 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
 
     if (mc->seek_individually) {
         /* adjust seek timestamp to found sample timestamp */
-        int64_t seek_timestamp = st->index_entries[sample].timestamp;
+        int64_t seek_timestamp = mov_current_entry(st)->timestamp;
 
         for (i = 0; i < s->nb_streams; i++) {
             int64_t timestamp;
@@ -6723,6 +7212,10 @@ static const AVOption mov_options[] = {
         0, 1, FLAGS},
     {"ignore_editlist", "Ignore the edit list atom.", OFFSET(ignore_editlist), AV_OPT_TYPE_BOOL, {.i64 = 0},
         0, 1, FLAGS},
+    {"compact_index",
+        "look up samples in the sample tables instead of building a full index",
+        OFFSET(compact_index), AV_OPT_TYPE_BOOL, {.i64 = 0},
+        0, 1, FLAGS},
     {"advanced_editlist",
         "Modify the AVIndex according to the editlists. Use this option to decode in the order specified by the edits.",
         OFFSET(advanced_editlist), AV_OPT_TYPE_BOOL, {.i64 = 1},
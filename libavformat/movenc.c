@@ -59,7 +59,7 @@
 static const AVOption options[] = {
     { "movflags", "MOV muxer flags", offsetof(MOVMuxContext, flags), AV_OPT_TYPE_FLAGS, {.i64 = 0}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "rtphint", "Add RTP hint tracks", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_RTP_HINT}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
-    { "moov_size", "maximum moov size so it can be placed at the begin", offsetof(MOVMuxContext, reserved_moov_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, 0 },
+    { "moov_size", "maximum moov size so it can be placed at the begin, -1 to estimate it with faststart", offsetof(MOVMuxContext, reserved_moov_size), AV_OPT_TYPE_INT, {.i64 = 0}, -1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, 0 },
     { "empty_moov", "Make the initial moov atom empty", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_EMPTY_MOOV}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "frag_keyframe", "Fragment at video keyframes", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_KEYFRAME}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "separate_moof", "Write separate moof/mdat atoms for each track", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_SEPARATE_MOOF}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
@@ -5701,6 +5701,52 @@ static int mov_create_dvd_sub_decoder_specific_info(MOVTrack *track,
     return 0;
 }
 
+/**
+ * Estimate the size of the moov atom from the stream durations, for
+ * reserving space for it in front of the mdat.
+ *
+ * Each sample is counted with the largest table entries it can need: a stsz
+ * entry, a co64 and a stsc entry as if every sample started a chunk, a stts
+ * entry as if the frame rate was variable, and for video a ctts and a stss
+ * entry. The number of samples is derived from the duration and frame rate,
+ * which may be inexact, so a quarter is added on top.
+ *
+ * @return the estimated size or 0 if some duration is unknown
+ */
+static int64_t estimate_moov_size(AVFormatContext *s)
+{
+    int64_t size = 4096;
+    int i;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        AVCodecParameters *par = st->codecpar;
+        double rate, samples;
+        int entry_size = 4 + 8 + 12 + 8;
+
+        if (st->duration <= 0 || st->duration == AV_NOPTS_VALUE)
+            return 0;
+
+        if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+            if (st->avg_frame_rate.num > 0 && st->avg_frame_rate.den > 0)
+                rate = av_q2d(st->avg_frame_rate);
+            else
+                rate = 1 / av_q2d(st->time_base);
+            entry_size += 8 + 4;
+        } else if (par->codec_type == AVMEDIA_TYPE_AUDIO) {
+            rate = (double)par->sample_rate / (par->frame_size > 0 ? par->frame_size : 1024);
+        } else {
+            rate = 1;
+        }
+
+        samples = st->duration * av_q2d(st->time_base) * rate;
+        size += 1024 + par->extradata_size +
+                entry_size * (int64_t)FFMIN(samples, INT_MAX);
+    }
+
+    return size + size / 4;
+}
+
 static int mov_init(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -5747,7 +5793,16 @@ static int mov_init(AVFormatContext *s)
     }
 
     if (mov->flags & FF_MOV_FLAG_FASTSTART) {
-        mov->reserved_moov_size = -1;
+        /* the reserved space holds a free atom until the trailer */
+        if (mov->flags & FF_MOV_FLAG_FRAGMENT)
+            mov->reserved_moov_size = 0;
+        else if (mov->reserved_moov_size < 0)
+            mov->reserved_moov_size = FFMIN(estimate_moov_size(s), INT_MAX);
+        else if (mov->reserved_moov_size > 0)
+            mov->reserved_moov_size = FFMAX(mov->reserved_moov_size, 8);
+    } else if (mov->reserved_moov_size < 0) {
+        av_log(s, AV_LOG_ERROR, "moov_size -1 requires the faststart flag\n");
+        return AVERROR(EINVAL);
     }
 
     if (mov->use_editlist < 0) {
@@ -6079,9 +6134,17 @@ static int mov_write_header(AVFormatContext *s)
             return ret;
     }
 
-    if (mov->reserved_moov_size){
+    if (mov->reserved_moov_size || mov->flags & FF_MOV_FLAG_FASTSTART) {
         mov->reserved_header_pos = avio_tell(pb);
-        if (mov->reserved_moov_size > 0)
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && !(mov->flags & FF_MOV_FLAG_FRAGMENT)) {
+            /* free atom the moov overwrites in the trailer if it fits, or
+             * that is shifted along with the mdat otherwise */
+            if (mov->reserved_moov_size > 0) {
+                avio_wb32(pb, mov->reserved_moov_size);
+                ffio_wfourcc(pb, "free");
+                ffio_fill(pb, 0, mov->reserved_moov_size - 8);
+            }
+        } else if (mov->reserved_moov_size > 0)
             avio_skip(pb, mov->reserved_moov_size);
     }
 
@@ -6092,8 +6155,6 @@ static int mov_write_header(AVFormatContext *s)
             !mov->max_fragment_duration && !mov->max_fragment_size)
             mov->flags |= FF_MOV_FLAG_FRAG_KEYFRAME;
     } else {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
-            mov->reserved_header_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
 
@@ -6356,7 +6417,29 @@ static int mov_write_trailer(AVFormatContext *s)
             ffio_wfourcc(pb, "mdat");
             avio_wb64(pb, mov->mdat_size + 16);
         }
-        avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
+        /* with faststart, the second pass shifts the data up to moov_pos */
+        avio_seek(pb, mov->reserved_moov_size > 0 && !(mov->flags & FF_MOV_FLAG_FASTSTART) ?
+                      mov->reserved_header_pos : moov_pos, SEEK_SET);
+
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size > 0) {
+            int moov_size = get_moov_size(s);
+            if (moov_size < 0)
+                return moov_size;
+            if (moov_size == mov->reserved_moov_size || moov_size + 8 <= mov->reserved_moov_size) {
+                avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
+                if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
+                    return res;
+                if (moov_size < mov->reserved_moov_size) {
+                    avio_wb32(pb, mov->reserved_moov_size - moov_size);
+                    ffio_wfourcc(pb, "free");
+                }
+                avio_seek(pb, moov_pos, SEEK_SET);
+                return 0;
+            }
+            av_log(s, AV_LOG_WARNING, "moov_size is too small, needed %d bytes "
+                   "but only %d were reserved, starting a second pass\n",
+                   moov_size, mov->reserved_moov_size);
+        }
 
         if (mov->flags & FF_MOV_FLAG_FASTSTART) {
             av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
@@ -194,7 +194,7 @@ typedef struct MOVMuxContext {
 
     int video_track_timescale;
 
-    int reserved_moov_size; ///< 0 for disabled, -1 for automatic, size otherwise
+    int reserved_moov_size; ///< 0 for disabled, -1 to estimate with faststart, size otherwise
     int64_t reserved_header_pos;
 
     char *major_brand;
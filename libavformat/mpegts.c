@@ -159,6 +159,14 @@ struct MpegTSContext {
     /** filters for various streams specified by PMT + for the PAT and PMT */
     MpegTSFilter *pids[NB_PID_MAX];
     int current_pid;
+
+    /** cached discard_pid() results: 0 unknown, 1 keep, 2 discard */
+    uint8_t discard_cache[NB_PID_MAX];
+    /** the program lists changed, discard_cache must be reset */
+    int discard_cache_dirty;
+    /** AVDISCARD_ALL state of the AVPrograms the cache was built for */
+    uint8_t *discard_programs;
+    unsigned int nb_discard_programs;
 };
 
 #define MPEGTS_OPTIONS \
@@ -281,12 +289,14 @@ static void clear_program(MpegTSContext *ts, unsigned int programid)
             ts->prg[i].nb_pids = 0;
             ts->prg[i].pmt_found = 0;
         }
+    ts->discard_cache_dirty = 1;
 }
 
 static void clear_programs(MpegTSContext *ts)
 {
     av_freep(&ts->prg);
     ts->nb_prg = 0;
+    ts->discard_cache_dirty = 1;
 }
 
 static void add_pat_entry(MpegTSContext *ts, unsigned int programid)
@@ -301,6 +311,7 @@ static void add_pat_entry(MpegTSContext *ts, unsigned int programid)
     p->nb_pids = 0;
     p->pmt_found = 0;
     ts->nb_prg++;
+    ts->discard_cache_dirty = 1;
 }
 
 static void add_pid_to_pmt(MpegTSContext *ts, unsigned int programid,
@@ -319,6 +330,7 @@ static void add_pid_to_pmt(MpegTSContext *ts, unsigned int programid,
             return;
 
     p->pids[p->nb_pids++] = pid;
+    ts->discard_cache_dirty = 1;
 }
 
 static void set_pmt_found(MpegTSContext *ts, unsigned int programid)
@@ -383,6 +395,45 @@ static int discard_pid(MpegTSContext *ts, unsigned int pid)
     return !used && discarded;
 }
 
+/**
+ * Invalidate the discard cache if the caller changed the discard field of
+ * any AVProgram since the last call.
+ */
+static void check_discard_programs(MpegTSContext *ts)
+{
+    AVFormatContext *s = ts->stream;
+    int k;
+
+    if (ts->nb_discard_programs != s->nb_programs) {
+        if (av_reallocp_array(&ts->discard_programs, s->nb_programs,
+                              sizeof(*ts->discard_programs)) < 0) {
+            ts->nb_discard_programs = 0;
+            ts->discard_cache_dirty = 1;
+            return;
+        }
+        ts->nb_discard_programs = s->nb_programs;
+        ts->discard_cache_dirty = 1;
+    }
+    for (k = 0; k < s->nb_programs; k++) {
+        uint8_t discard = s->programs[k]->discard == AVDISCARD_ALL;
+        if (ts->discard_programs[k] != discard) {
+            ts->discard_programs[k] = discard;
+            ts->discard_cache_dirty = 1;
+        }
+    }
+}
+
+static int discard_pid_cached(MpegTSContext *ts, unsigned int pid)
+{
+    if (ts->discard_cache_dirty) {
+        memset(ts->discard_cache, 0, sizeof(ts->discard_cache));
+        ts->discard_cache_dirty = 0;
+    }
+    if (!ts->discard_cache[pid])
+        ts->discard_cache[pid] = 1 + discard_pid(ts, pid);
+    return ts->discard_cache[pid] - 1;
+}
+
 /**
  *  Assemble PES packets out of TS packets, and then call the "section_cb"
  *  function when they are complete.
@@ -2256,7 +2307,7 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
     int64_t pos;
 
     pid = AV_RB16(packet + 1) & 0x1fff;
-    if (pid && discard_pid(ts, pid))
+    if (pid && discard_pid_cached(ts, pid))
         return 0;
     is_start = packet[1] & 0x40;
     tss = ts->pids[pid];
@@ -2477,12 +2528,37 @@ static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
         avio_skip(pb, skip);
 }
 
+/**
+ * Count the packets at the start of buf which are completely inside it and
+ * start with a sync byte.
+ */
+static int count_sync_packets(const uint8_t *buf, int size, int raw_packet_size)
+{
+    int nb_packets = size / raw_packet_size;
+    int i = 0;
+
+    for (; i + 4 <= nb_packets; i += 4) {
+        const uint8_t *p = buf + i * raw_packet_size;
+        if ((p[0]                   ^ 0x47) |
+            (p[raw_packet_size]     ^ 0x47) |
+            (p[2 * raw_packet_size] ^ 0x47) |
+            (p[3 * raw_packet_size] ^ 0x47))
+            break;
+    }
+    for (; i < nb_packets; i++)
+        if (buf[i * raw_packet_size] != 0x47)
+            break;
+    return i;
+}
+
 static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
 {
     AVFormatContext *s = ts->stream;
+    AVIOContext *pb = s->pb;
     uint8_t packet[TS_PACKET_SIZE + AV_INPUT_BUFFER_PADDING_SIZE];
     const uint8_t *data;
     int64_t packet_num;
+    int nb_buffered = 0, raw_packet_size = ts->raw_packet_size;
     int ret = 0;
 
     if (avio_tell(s->pb) != ts->last_pos) {
@@ -2505,6 +2581,8 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         }
     }
 
+    check_discard_programs(ts);
+
     ts->stop_parse = 0;
     packet_num = 0;
     memset(packet + TS_PACKET_SIZE, 0, AV_INPUT_BUFFER_PADDING_SIZE);
@@ -2518,11 +2596,30 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ts->stop_parse > 0)
             break;
 
-        ret = read_packet(s, packet, ts->raw_packet_size, &data);
-        if (ret != 0)
-            break;
-        ret = handle_packet(ts, data);
-        finished_reading_packet(s, ts->raw_packet_size);
+        /* Validate the sync bytes of all packets already in the I/O buffer
+         * at once and parse them in place; fall back to read_packet() for
+         * partial packets and resynchronization. */
+        if (!nb_buffered && !pb->write_flag) {
+            raw_packet_size = ts->raw_packet_size;
+            nb_buffered = count_sync_packets(pb->buf_ptr,
+                                             pb->buf_end - pb->buf_ptr,
+                                             raw_packet_size);
+        }
+        if (nb_buffered) {
+            nb_buffered--;
+            data = pb->buf_ptr;
+            pb->buf_ptr += TS_PACKET_SIZE;
+            ret = handle_packet(ts, data);
+            pb->buf_ptr += raw_packet_size - TS_PACKET_SIZE;
+            if (ts->raw_packet_size != raw_packet_size)
+                nb_buffered = 0;
+        } else {
+            ret = read_packet(s, packet, ts->raw_packet_size, &data);
+            if (ret != 0)
+                break;
+            ret = handle_packet(ts, data);
+            finished_reading_packet(s, ts->raw_packet_size);
+        }
         if (ret != 0)
             break;
     }
@@ -2800,6 +2897,8 @@ static void mpegts_free(MpegTSContext *ts)
     int i;
 
     clear_programs(ts);
+    av_freep(&ts->discard_programs);
+    ts->nb_discard_programs = 0;
 
     for (i = 0; i < NB_PID_MAX; i++)
         if (ts->pids[i])
@@ -0,0 +1,491 @@
+/*
+ * Persistent cache of probing and stream information results
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Cache of the results of input format probing and
+ * avformat_find_stream_info(), stored in one file per input.
+ *
+ * The file name is the MD5 of the input URL, its size, its modification
+ * time when it is a local file, and its first bytes. An entry is only used
+ * when the demuxer creates the same streams as when it was written.
+ */
+
+#include <sys/stat.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/md5.h"
+#include "libavutil/mem.h"
+#include "libavutil/random_seed.h"
+
+#include "avformat.h"
+#include "avio_internal.h"
+#include "internal.h"
+#include "os_support.h"
+
+#define CACHE_TAG     MKBETAG('F', 'F', 'P', 'C')
+#define CACHE_VERSION 1
+#define HEADER_SIZE   4096
+
+typedef struct ProbeCacheStream {
+    int id;
+    AVRational time_base;
+    AVRational r_frame_rate;
+    AVRational avg_frame_rate;
+    AVRational sample_aspect_ratio;
+    int64_t start_time;
+    int64_t duration;
+    int64_t nb_frames;
+    AVCodecParameters *par;
+    AVIndexEntry *index_entries;
+    int nb_index_entries;
+} ProbeCacheStream;
+
+typedef struct ProbeCache {
+    char *path;
+    int applied;
+    char format[64];
+    int score;
+    int64_t start_time;
+    int64_t duration;
+    int64_t bit_rate;
+    ProbeCacheStream *streams;
+    int nb_streams;
+} ProbeCache;
+
+static void free_entry(ProbeCache *pc)
+{
+    int i;
+
+    for (i = 0; i < pc->nb_streams; i++) {
+        avcodec_parameters_free(&pc->streams[i].par);
+        av_freep(&pc->streams[i].index_entries);
+    }
+    av_freep(&pc->streams);
+    pc->nb_streams = 0;
+    pc->format[0]  = 0;
+}
+
+void ff_probe_cache_free(AVFormatContext *s)
+{
+    ProbeCache *pc = s->internal->probe_cache;
+
+    if (!pc)
+        return;
+
+    free_entry(pc);
+    av_freep(&pc->path);
+    av_freep(&s->internal->probe_cache);
+}
+
+static int64_t get_mtime(const char *url)
+{
+    const char *proto = avio_find_protocol_name(url);
+    struct stat st;
+
+    if (!proto || strcmp(proto, "file"))
+        return 0;
+
+    av_strstart(url, "file:", &url);
+    if (stat(url, &st) < 0)
+        return 0;
+    return st.st_mtime;
+}
+
+static int make_path(AVFormatContext *s, const char *url, ProbeCache *pc)
+{
+    uint8_t header[HEADER_SIZE], md5[16], tmp[8];
+    char key[33];
+    int64_t size = avio_size(s->pb);
+    int len, i;
+    struct AVMD5 *ctx;
+
+    if ((len = ffio_ensure_seekback(s->pb, HEADER_SIZE)) < 0)
+        return len;
+    len = avio_read(s->pb, header, HEADER_SIZE);
+    if (len < 0)
+        return len;
+    if (avio_seek(s->pb, -len, SEEK_CUR) < 0)
+        return AVERROR(EIO);
+
+    ctx = av_md5_alloc();
+    if (!ctx)
+        return AVERROR(ENOMEM);
+    av_md5_init(ctx);
+    av_md5_update(ctx, url, strlen(url));
+    AV_WB64(tmp, size);
+    av_md5_update(ctx, tmp, 8);
+    AV_WB64(tmp, get_mtime(url));
+    av_md5_update(ctx, tmp, 8);
+    av_md5_update(ctx, header, len);
+    av_md5_final(ctx, md5);
+    av_free(ctx);
+
+    for (i = 0; i < 16; i++)
+        snprintf(key + 2 * i, 3, "%02x", md5[i]);
+
+    pc->path = av_asprintf("%s/%s.ffpc", s->probe_cache_dir, key);
+    return pc->path ? 0 : AVERROR(ENOMEM);
+}
+
+static AVRational read_rational(AVIOContext *pb)
+{
+    AVRational q;
+
+    q.num = avio_rb32(pb);
+    q.den = avio_rb32(pb);
+    return q;
+}
+
+static void write_rational(AVIOContext *pb, AVRational q)
+{
+    avio_wb32(pb, q.num);
+    avio_wb32(pb, q.den);
+}
+
+static int read_codecpar(AVIOContext *pb, AVCodecParameters *par)
+{
+    int size;
+
+    par->codec_type            = avio_rb32(pb);
+    par->codec_id              = avio_rb32(pb);
+    par->codec_tag             = avio_rb32(pb);
+    par->format                = avio_rb32(pb);
+    par->bit_rate              = avio_rb64(pb);
+    par->bits_per_coded_sample = avio_rb32(pb);
+    par->bits_per_raw_sample   = avio_rb32(pb);
+    par->profile               = avio_rb32(pb);
+    par->level                 = avio_rb32(pb);
+    par->width                 = avio_rb32(pb);
+    par->height                = avio_rb32(pb);
+    par->sample_aspect_ratio   = read_rational(pb);
+    par->field_order           = avio_rb32(pb);
+    par->color_range           = avio_rb32(pb);
+    par->color_primaries       = avio_rb32(pb);
+    par->color_trc             = avio_rb32(pb);
+    par->color_space           = avio_rb32(pb);
+    par->chroma_location       = avio_rb32(pb);
+    par->video_delay           = avio_rb32(pb);
+    par->channel_layout        = avio_rb64(pb);
+    par->channels              = avio_rb32(pb);
+    par->sample_rate           = avio_rb32(pb);
+    par->block_align           = avio_rb32(pb);
+    par->frame_size            = avio_rb32(pb);
+    par->initial_padding       = avio_rb32(pb);
+    par->trailing_padding      = avio_rb32(pb);
+    par->seek_preroll          = avio_rb32(pb);
+
+    size = avio_rb32(pb);
+    if (size < 0 || size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        return AVERROR_INVALIDDATA;
+    if (size) {
+        int ret = ff_get_extradata(NULL, par, pb, size);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static void write_codecpar(AVIOContext *pb, const AVCodecParameters *par)
+{
+    avio_wb32(pb, par->codec_type);
+    avio_wb32(pb, par->codec_id);
+    avio_wb32(pb, par->codec_tag);
+    avio_wb32(pb, par->format);
+    avio_wb64(pb, par->bit_rate);
+    avio_wb32(pb, par->bits_per_coded_sample);
+    avio_wb32(pb, par->bits_per_raw_sample);
+    avio_wb32(pb, par->profile);
+    avio_wb32(pb, par->level);
+    avio_wb32(pb, par->width);
+    avio_wb32(pb, par->height);
+    write_rational(pb, par->sample_aspect_ratio);
+    avio_wb32(pb, par->field_order);
+    avio_wb32(pb, par->color_range);
+    avio_wb32(pb, par->color_primaries);
+    avio_wb32(pb, par->color_trc);
+    avio_wb32(pb, par->color_space);
+    avio_wb32(pb, par->chroma_location);
+    avio_wb32(pb, par->video_delay);
+    avio_wb64(pb, par->channel_layout);
+    avio_wb32(pb, par->channels);
+    avio_wb32(pb, par->sample_rate);
+    avio_wb32(pb, par->block_align);
+    avio_wb32(pb, par->frame_size);
+    avio_wb32(pb, par->initial_padding);
+    avio_wb32(pb, par->trailing_padding);
+    avio_wb32(pb, par->seek_preroll);
+    avio_wb32(pb, par->extradata_size);
+    avio_write(pb, par->extradata, par->extradata_size);
+}
+
+static int read_entry(AVIOContext *pb, ProbeCache *pc)
+{
+    int i, j, ret;
+
+    if (avio_rb32(pb) != CACHE_TAG || avio_rb32(pb) != CACHE_VERSION)
+        return AVERROR_INVALIDDATA;
+
+    avio_get_str(pb, INT_MAX, pc->format, sizeof(pc->format));
+    pc->score      = avio_rb32(pb);
+    pc->start_time = avio_rb64(pb);
+    pc->duration   = avio_rb64(pb);
+    pc->bit_rate   = avio_rb64(pb);
+
+    pc->nb_streams = avio_rb32(pb);
+    if (pc->nb_streams < 0 || pc->nb_streams > INT_MAX / sizeof(*pc->streams)) {
+        pc->nb_streams = 0;
+        return AVERROR_INVALIDDATA;
+    }
+    pc->streams = av_mallocz_array(pc->nb_streams, sizeof(*pc->streams));
+    if (!pc->streams) {
+        pc->nb_streams = 0;
+        return AVERROR(ENOMEM);
+    }
+
+    for (i = 0; i < pc->nb_streams; i++) {
+        ProbeCacheStream *cst = &pc->streams[i];
+
+        cst->id                  = avio_rb32(pb);
+        cst->time_base           = read_rational(pb);
+        cst->r_frame_rate        = read_rational(pb);
+        cst->avg_frame_rate      = read_rational(pb);
+        cst->sample_aspect_ratio = read_rational(pb);
+        cst->start_time          = avio_rb64(pb);
+        cst->duration            = avio_rb64(pb);
+        cst->nb_frames           = avio_rb64(pb);
+
+        cst->par = avcodec_parameters_alloc();
+        if (!cst->par)
+            return AVERROR(ENOMEM);
+        if ((ret = read_codecpar(pb, cst->par)) < 0)
+            return ret;
+
+        cst->nb_index_entries = avio_rb32(pb);
+        if (cst->nb_index_entries < 0 ||
+            cst->nb_index_entries > INT_MAX / sizeof(*cst->index_entries)) {
+            cst->nb_index_entries = 0;
+            return AVERROR_INVALIDDATA;
+        }
+        if (!cst->nb_index_entries)
+            continue;
+        cst->index_entries = av_malloc_array(cst->nb_index_entries,
+                                             sizeof(*cst->index_entries));
+        if (!cst->index_entries) {
+            cst->nb_index_entries = 0;
+            return AVERROR(ENOMEM);
+        }
+        for (j = 0; j < cst->nb_index_entries; j++) {
+            AVIndexEntry *e = &cst->index_entries[j];
+
+            e->pos          = avio_rb64(pb);
+            e->timestamp    = avio_rb64(pb);
+            e->flags        = avio_rb32(pb) & 3;
+            e->size         = avio_rb32(pb) & 0x3FFFFFFF;
+            e->min_distance = avio_rb32(pb);
+            if (pb->eof_reached)
+                return AVERROR_INVALIDDATA;
+        }
+    }
+
+    if (pb->eof_reached || pb->error)
+        return AVERROR_INVALIDDATA;
+    return 0;
+}
+
+int ff_probe_cache_lookup(AVFormatContext *s, const char *url)
+{
+    ProbeCache *pc;
+    AVIOContext *pb = NULL;
+    AVInputFormat *fmt;
+    int ret;
+
+    if (s->iformat && s->iformat->flags & AVFMT_NOFILE)
+        return 0;
+
+    pc = s->internal->probe_cache = av_mallocz(sizeof(*pc));
+    if (!pc)
+        return AVERROR(ENOMEM);
+
+    if ((ret = make_path(s, url, pc)) < 0) {
+        av_log(s, AV_LOG_WARNING, "Not using the probe cache: %s\n", av_err2str(ret));
+        ff_probe_cache_free(s);
+        return 0;
+    }
+
+    if (avio_open2(&pb, pc->path, AVIO_FLAG_READ, &s->interrupt_callback, NULL) < 0)
+        return 0;
+    ret = read_entry(pb, pc);
+    avio_closep(&pb);
+    if (ret < 0) {
+        av_log(s, AV_LOG_WARNING, "Ignoring invalid probe cache entry %s\n", pc->path);
+        free_entry(pc);
+        return 0;
+    }
+
+    av_log(s, AV_LOG_VERBOSE, "Using probe cache entry %s\n", pc->path);
+
+    if (s->iformat)
+        return 0;
+    fmt = av_find_input_format(pc->format);
+    if (!fmt || fmt->flags & AVFMT_NOFILE || pc->score <= 0)
+        return 0;
+    s->iformat = fmt;
+    return pc->score;
+}
+
+int ff_probe_cache_apply(AVFormatContext *s)
+{
+    ProbeCache *pc = s->internal->probe_cache;
+    int i, j, ret;
+
+    if (!pc || !pc->streams)
+        return 0;
+
+    if (strcmp(pc->format, s->iformat->name) || pc->nb_streams != s->nb_streams)
+        goto mismatch;
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        ProbeCacheStream *cst = &pc->streams[i];
+
+        if (st->id != cst->id || av_cmp_q(st->time_base, cst->time_base) ||
+            (st->codecpar->codec_id != AV_CODEC_ID_NONE &&
+             st->codecpar->codec_id != cst->par->codec_id))
+            goto mismatch;
+    }
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        ProbeCacheStream *cst = &pc->streams[i];
+
+        if ((ret = avcodec_parameters_copy(st->codecpar, cst->par)) < 0)
+            return ret;
+#if FF_API_LAVF_AVCTX
+FF_DISABLE_DEPRECATION_WARNINGS
+        st->codec->codec_id   = st->codecpar->codec_id;
+        st->codec->codec_type = st->codecpar->codec_type;
+FF_ENABLE_DEPRECATION_WARNINGS
+#endif
+        st->internal->orig_codec_id = st->codecpar->codec_id;
+        st->request_probe       = 0;
+        st->r_frame_rate        = cst->r_frame_rate;
+        st->avg_frame_rate      = cst->avg_frame_rate;
+        st->sample_aspect_ratio = cst->sample_aspect_ratio;
+        st->start_time          = cst->start_time;
+        st->duration            = cst->duration;
+        st->nb_frames           = cst->nb_frames;
+
+        if (!st->nb_index_entries) {
+            for (j = 0; j < cst->nb_index_entries; j++) {
+                AVIndexEntry *e = &cst->index_entries[j];
+                av_add_index_entry(st, e->pos, e->timestamp, e->size,
+                                   e->min_distance, e->flags);
+            }
+        }
+    }
+    s->start_time = pc->start_time;
+    s->duration   = pc->duration;
+    s->bit_rate   = pc->bit_rate;
+
+    free_entry(pc);
+    pc->applied = 1;
+    return 1;
+mismatch:
+    av_log(s, AV_LOG_VERBOSE, "Probe cache entry %s does not match the streams\n", pc->path);
+    free_entry(pc);
+    return 0;
+}
+
+void ff_probe_cache_reject(AVFormatContext *s)
+{
+    ProbeCache *pc = s->internal->probe_cache;
+
+    if (pc && pc->applied) {
+        av_log(s, AV_LOG_VERBOSE, "Probe cache entry %s rejected by the decoders\n", pc->path);
+        pc->applied = 0;
+    }
+}
+
+void ff_probe_cache_store(AVFormatContext *s)
+{
+    ProbeCache *pc = s->internal->probe_cache;
+    AVIOContext *pb = NULL;
+    char *tmp;
+    int i, j, ret;
+
+    if (!pc || pc->applied)
+        return;
+
+    /* Several processes may probe the same input at the same time, each
+     * writes its own file and renames it over the entry. */
+    tmp = av_asprintf("%s.%08x%08x.tmp", pc->path,
+                      av_get_random_seed(), av_get_random_seed());
+    if (!tmp)
+        return;
+    if ((ret = avio_open2(&pb, tmp, AVIO_FLAG_WRITE, &s->interrupt_callback, NULL)) < 0) {
+        av_log(s, AV_LOG_WARNING, "Could not write the probe cache entry %s\n", tmp);
+        av_free(tmp);
+        return;
+    }
+
+    avio_wb32(pb, CACHE_TAG);
+    avio_wb32(pb, CACHE_VERSION);
+    avio_put_str(pb, s->iformat->name);
+    avio_wb32(pb, s->probe_score);
+    avio_wb64(pb, s->start_time);
+    avio_wb64(pb, s->duration);
+    avio_wb64(pb, s->bit_rate);
+    avio_wb32(pb, s->nb_streams);
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+
+        avio_wb32(pb, st->id);
+        write_rational(pb, st->time_base);
+        write_rational(pb, st->r_frame_rate);
+        write_rational(pb, st->avg_frame_rate);
+        write_rational(pb, st->sample_aspect_ratio);
+        avio_wb64(pb, st->start_time);
+        avio_wb64(pb, st->duration);
+        avio_wb64(pb, st->nb_frames);
+        write_codecpar(pb, st->codecpar);
+
+        avio_wb32(pb, st->nb_index_entries);
+        for (j = 0; j < st->nb_index_entries; j++) {
+            AVIndexEntry *e = &st->index_entries[j];
+
+            avio_wb64(pb, e->pos);
+            avio_wb64(pb, e->timestamp);
+            avio_wb32(pb, e->flags);
+            avio_wb32(pb, e->size);
+            avio_wb32(pb, e->min_distance);
+        }
+    }
+
+    avio_flush(pb);
+    ret = pb->error;
+    avio_closep(&pb);
+    if (ret >= 0)
+        ret = ff_rename(tmp, pc->path, s);
+    if (ret < 0)
+        avpriv_io_delete(tmp);
+    av_free(tmp);
+}
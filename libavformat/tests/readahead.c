@@ -0,0 +1,130 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavutil/common.h"
+#include "libavutil/dict.h"
+#include "libavutil/time.h"
+#include "libavformat/avio.h"
+
+#define FILE_SIZE (4 * 1024 * 1024)
+#define READ_SIZE 4096
+
+static uint8_t byte_at(int64_t pos)
+{
+    return (pos * 7 + (pos >> 12)) & 0xff;
+}
+
+static int write_file(const char *filename)
+{
+    AVIOContext *pb;
+    int64_t pos;
+    int ret;
+
+    if ((ret = avio_open(&pb, filename, AVIO_FLAG_WRITE)) < 0)
+        return ret;
+    for (pos = 0; pos < FILE_SIZE; pos++)
+        avio_w8(pb, byte_at(pos));
+    return avio_closep(&pb);
+}
+
+static int check_read(AVIOContext *pb, int64_t pos, int size)
+{
+    uint8_t buf[READ_SIZE];
+    int i, ret;
+
+    ret = avio_read(pb, buf, size);
+    if (ret != FFMIN(size, FILE_SIZE - pos)) {
+        printf("read of %d bytes at %"PRId64" returned %d\n", size, pos, ret);
+        return 1;
+    }
+    for (i = 0; i < ret; i++) {
+        if (buf[i] != byte_at(pos + i)) {
+            printf("wrong data at %"PRId64"\n", pos + i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int check_seek(AVIOContext *pb, int64_t pos, const char *what)
+{
+    int64_t ret = avio_seek(pb, pos, SEEK_SET);
+
+    printf("seek to %"PRId64" %s: ", pos, what);
+    if (ret != pos) {
+        printf("returned %"PRId64"\n", ret);
+        return 1;
+    }
+    if (check_read(pb, pos, READ_SIZE))
+        return 1;
+    printf("ok\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    AVDictionary *opts = NULL;
+    AVIOContext *pb;
+    int64_t pos;
+    int ret, err = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <temporary file>\n", argv[0]);
+        return 1;
+    }
+
+    if ((ret = write_file(argv[1])) < 0) {
+        fprintf(stderr, "cannot write %s\n", argv[1]);
+        return 1;
+    }
+
+    av_dict_set(&opts, "readahead_size", "1048576", 0);
+    ret = avio_open2(&pb, argv[1], AVIO_FLAG_READ, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    err |= check_read(pb, 0, 1000);
+
+    /* give the thread time to fill its window, so that the short forward
+     * seeks are served from it; the data is checked either way */
+    av_usleep(100000);
+    err |= check_seek(pb,  100000, "forward inside the window");
+    err |= check_seek(pb,  150000, "forward inside the window");
+    err |= check_seek(pb,      10, "backward");
+    err |= check_seek(pb, 3000000, "forward past the window");
+    av_usleep(100000);
+    err |= check_seek(pb, 3100000, "forward inside the window");
+    err |= check_seek(pb, FILE_SIZE - 100, "near the end");
+    err |= check_seek(pb,  500000, "backward");
+
+    printf("size: %"PRId64"\n", avio_size(pb));
+
+    for (pos = 500000 + READ_SIZE; pos < FILE_SIZE && !err; pos += READ_SIZE)
+        err |= check_read(pb, pos, READ_SIZE);
+    if (!err)
+        printf("sequential read: ok\n");
+
+    avio_closep(&pb);
+    avpriv_io_delete(argv[1]);
+    return err;
+}
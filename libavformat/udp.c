@@ -26,6 +26,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() and sendmmsg() */
 
 #include "avformat.h"
 #include "avio_internal.h"
@@ -62,6 +63,11 @@
 
 #if HAVE_PTHREAD_CANCEL
 #include <pthread.h>
+#include <stdatomic.h>
+#endif
+
+#if HAVE_RECVMMSG
+#include <netinet/udp.h>
 #endif
 
 #ifndef HAVE_PTHREAD_CANCEL
@@ -76,6 +82,8 @@
 #define UDP_TX_BUF_SIZE 32768
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_MAX_RECV_BATCH 64
+#define UDP_MAX_SEND_BATCH 64
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -105,7 +113,32 @@ typedef struct UDPContext {
     pthread_mutex_t mutex;
     pthread_cond_t cond;
     int thread_started;
+    /* receive ring filled by circular_buffer_task_rx(), which only
+     * advances rx_head, while udp_read() only advances rx_tail */
+    uint8_t *rx_ring;
+    unsigned rx_ring_size;
+    atomic_uint rx_head;
+    atomic_uint rx_tail;
+    atomic_uint rx_overrun_count;
+    atomic_uint rx_drop_count;
+    uint8_t *rx_batch;
 #endif
+    int recv_batch;
+    int gro;
+    int64_t rx_overruns;
+    int64_t rx_drops;
+    int send_batch;
+    /* transmit statistics, updated by circular_buffer_task_tx() under the
+     * mutex and exported by udp_write() */
+    struct {
+        int64_t late_sum, late_count, late_max;
+        int64_t resyncs;
+        int batch_max;
+    } tx_stats;
+    int64_t tx_jitter_max;
+    int64_t tx_jitter_avg;
+    int tx_batch_max;
+    int64_t tx_resyncs;
     uint8_t tmp[UDP_MAX_PKT_SIZE+4];
     int remaining_in_dg;
     char *localaddr;
@@ -134,6 +167,15 @@ static const AVOption options[] = {
     { "connect",        "set if connect() should be called on socket",     OFFSET(is_connected),   AV_OPT_TYPE_BOOL,   { .i64 =  0 },     0, 1,       .flags = D|E },
     { "fifo_size",      "set the UDP receiving circular buffer size, expressed as a number of packets with size of 188 bytes", OFFSET(circular_buffer_size), AV_OPT_TYPE_INT, {.i64 = 7*4096}, 0, INT_MAX, D },
     { "overrun_nonfatal", "survive in case of UDP receiving circular buffer overrun", OFFSET(overrun_nonfatal), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1,    D },
+    { "recv_batch",     "maximum number of datagrams received per system call", OFFSET(recv_batch), AV_OPT_TYPE_INT, { .i64 = 32 },  1, UDP_MAX_RECV_BATCH, D },
+    { "gro",            "enable generic receive offload",                  OFFSET(gro),            AV_OPT_TYPE_BOOL,   { .i64 = 0 },      0, 1,       D },
+    { "rx_overruns",    "number of datagrams dropped on circular buffer overrun", OFFSET(rx_overruns), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D|AV_OPT_FLAG_EXPORT|AV_OPT_FLAG_READONLY },
+    { "send_batch",     "maximum number of datagrams sent per system call when catching up with bitrate", OFFSET(send_batch), AV_OPT_TYPE_INT, { .i64 = 32 }, 1, UDP_MAX_SEND_BATCH, E },
+    { "tx_jitter_max",  "largest delay of a datagram behind its bitrate schedule, in microseconds", OFFSET(tx_jitter_max), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E|AV_OPT_FLAG_EXPORT|AV_OPT_FLAG_READONLY },
+    { "tx_jitter_avg",  "average delay of the datagrams behind their bitrate schedule, in microseconds", OFFSET(tx_jitter_avg), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E|AV_OPT_FLAG_EXPORT|AV_OPT_FLAG_READONLY },
+    { "tx_batch_max",   "largest number of datagrams sent back to back",   OFFSET(tx_batch_max),   AV_OPT_TYPE_INT,    { .i64 = 0 },      0, INT_MAX, E|AV_OPT_FLAG_EXPORT|AV_OPT_FLAG_READONLY },
+    { "tx_resyncs",     "number of times the bitrate schedule was restarted", OFFSET(tx_resyncs), AV_OPT_TYPE_INT64,  { .i64 = 0 },      0, INT64_MAX, E|AV_OPT_FLAG_EXPORT|AV_OPT_FLAG_READONLY },
+    { "rx_drops",       "number of datagrams dropped by the system",       OFFSET(rx_drops),       AV_OPT_TYPE_INT64,  { .i64 = 0 },      0, INT64_MAX, D|AV_OPT_FLAG_EXPORT|AV_OPT_FLAG_READONLY },
     { "timeout",        "set raise error timeout (only in read mode)",     OFFSET(timeout),        AV_OPT_TYPE_INT,    { .i64 = 0 },      0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
@@ -496,63 +538,275 @@ static int udp_get_file_handle(URLContext *h)
 }
 
 #if HAVE_PTHREAD_CANCEL
+static void rx_ring_write_data(UDPContext *s, unsigned pos,
+                               const uint8_t *src, int size)
+{
+    unsigned offset = pos & (s->rx_ring_size - 1);
+    int len = FFMIN(size, s->rx_ring_size - offset);
+
+    memcpy(s->rx_ring + offset, src, len);
+    memcpy(s->rx_ring, src + len, size - len);
+}
+
+static void rx_ring_read_data(UDPContext *s, unsigned pos,
+                              uint8_t *dst, int size)
+{
+    unsigned offset = pos & (s->rx_ring_size - 1);
+    int len = FFMIN(size, s->rx_ring_size - offset);
+
+    memcpy(dst, s->rx_ring + offset, len);
+    memcpy(dst + len, s->rx_ring, size - len);
+}
+
+/**
+ * Append a datagram to the receive ring. Only called by the receiving
+ * thread.
+ * @return 0 on success, AVERROR(ENOSPC) if the ring is full
+ */
+static int rx_ring_write(UDPContext *s, const uint8_t *buf, int len)
+{
+    unsigned head = atomic_load_explicit(&s->rx_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&s->rx_tail, memory_order_acquire);
+    uint8_t tmp[4];
+
+    if (s->rx_ring_size - (head - tail) < len + 4)
+        return AVERROR(ENOSPC);
+
+    AV_WL32(tmp, len);
+    rx_ring_write_data(s, head, tmp, 4);
+    rx_ring_write_data(s, head + 4, buf, len);
+    atomic_store_explicit(&s->rx_head, head + 4 + len, memory_order_release);
+    return 0;
+}
+
+/**
+ * Receive up to recv_batch datagrams into rx_batch, each one in a slot of
+ * UDP_MAX_PKT_SIZE bytes.
+ * @param lens      filled with the size of each received datagram
+ * @param seg_sizes filled with the segment size of datagrams coalesced by
+ *                  GRO, 0 for plain datagrams
+ * @return the number of datagrams received or a negative error code
+ */
+static int udp_recv_batch(UDPContext *s, int *lens, int *seg_sizes)
+{
+#if HAVE_RECVMMSG
+    struct mmsghdr msgs[UDP_MAX_RECV_BATCH];
+    struct iovec iov[UDP_MAX_RECV_BATCH];
+    union {
+        struct cmsghdr align;
+        uint8_t buf[CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(int))];
+    } control[UDP_MAX_RECV_BATCH];
+    int i, n;
+
+    memset(msgs, 0, s->recv_batch * sizeof(*msgs));
+    for (i = 0; i < s->recv_batch; i++) {
+        iov[i].iov_base = s->rx_batch + i * UDP_MAX_PKT_SIZE;
+        iov[i].iov_len  = UDP_MAX_PKT_SIZE;
+        msgs[i].msg_hdr.msg_iov        = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen     = 1;
+        msgs[i].msg_hdr.msg_control    = control[i].buf;
+        msgs[i].msg_hdr.msg_controllen = sizeof(control[i].buf);
+    }
+
+    n = recvmmsg(s->udp_fd, msgs, s->recv_batch, MSG_WAITFORONE, NULL);
+    if (n < 0)
+        return ff_neterrno();
+
+    for (i = 0; i < n; i++) {
+        struct cmsghdr *cmsg;
+
+        lens[i]      = msgs[i].msg_len;
+        seg_sizes[i] = 0;
+        for (cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg;
+             cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg)) {
+#ifdef SO_RXQ_OVFL
+            if (cmsg->cmsg_level == SOL_SOCKET &&
+                cmsg->cmsg_type  == SO_RXQ_OVFL) {
+                uint32_t drops;
+                memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+                atomic_store(&s->rx_drop_count, drops);
+            }
+#endif
+#ifdef UDP_GRO
+            if (cmsg->cmsg_level == IPPROTO_UDP &&
+                cmsg->cmsg_type  == UDP_GRO)
+                memcpy(&seg_sizes[i], CMSG_DATA(cmsg), sizeof(int));
+#endif
+        }
+    }
+    return n;
+#else
+    int len = recv(s->udp_fd, s->rx_batch, UDP_MAX_PKT_SIZE, 0);
+    if (len < 0)
+        return ff_neterrno();
+    lens[0]      = len;
+    seg_sizes[0] = 0;
+    return 1;
+#endif
+}
+
 static void *circular_buffer_task_rx( void *_URLContext)
 {
     URLContext *h = _URLContext;
     UDPContext *s = h->priv_data;
+    int lens[UDP_MAX_RECV_BATCH], seg_sizes[UDP_MAX_RECV_BATCH];
     int old_cancelstate;
+    int err = 0;
 
     pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
-    pthread_mutex_lock(&s->mutex);
     if (ff_socket_nonblock(s->udp_fd, 0) < 0) {
         av_log(h, AV_LOG_ERROR, "Failed to set blocking mode");
-        s->circular_buffer_error = AVERROR(EIO);
+        err = AVERROR(EIO);
         goto end;
     }
     while(1) {
-        int len;
+        int i, n;
 
-        pthread_mutex_unlock(&s->mutex);
         /* Blocking operations are always cancellation points;
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
-        len = recv(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0);
+        n = udp_recv_batch(s, lens, seg_sizes);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
-        pthread_mutex_lock(&s->mutex);
-        if (len < 0) {
-            if (ff_neterrno() != AVERROR(EAGAIN) && ff_neterrno() != AVERROR(EINTR)) {
-                s->circular_buffer_error = ff_neterrno();
+        if (n < 0) {
+            if (n != AVERROR(EAGAIN) && n != AVERROR(EINTR)) {
+                err = n;
                 goto end;
             }
             continue;
         }
-        AV_WL32(s->tmp, len);
-
-        if(av_fifo_space(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
-                continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
-            }
+
+        for (i = 0; i < n; i++) {
+            const uint8_t *buf = s->rx_batch + i * UDP_MAX_PKT_SIZE;
+            int seg_size = seg_sizes[i] > 0 ? seg_sizes[i] : lens[i];
+            int pos = 0;
+
+            /* GRO coalesced datagrams are split back into segments */
+            do {
+                int len = FFMIN(seg_size, lens[i] - pos);
+
+                if (rx_ring_write(s, buf + pos, len) < 0) {
+                    /* No Space left */
+                    atomic_fetch_add(&s->rx_overrun_count, 1);
+                    if (s->overrun_nonfatal) {
+                        av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                                "Surviving due to overrun_nonfatal option\n");
+                    } else {
+                        av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                                "To avoid, increase fifo_size URL option. "
+                                "To survive in such case, use overrun_nonfatal option\n");
+                        err = AVERROR(EIO);
+                        goto end;
+                    }
+                }
+                pos += len;
+            } while (pos < lens[i]);
         }
-        av_fifo_generic_write(s->fifo, s->tmp, len+4, NULL);
+
+        /* the reader only sleeps on the condition when the ring is empty */
+        pthread_mutex_lock(&s->mutex);
         pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
     }
 
 end:
+    pthread_mutex_lock(&s->mutex);
+    s->circular_buffer_error = err;
     pthread_cond_signal(&s->cond);
     pthread_mutex_unlock(&s->mutex);
     return NULL;
 }
 
+/**
+ * Send nb datagrams stored back to back in buf with a single system call
+ * where possible.
+ * @return 0 on success or a negative error code
+ */
+static int udp_send_batch(UDPContext *s, const uint8_t *buf, const int *lens, int nb)
+{
+#if HAVE_SENDMMSG
+    struct mmsghdr msgs[UDP_MAX_SEND_BATCH];
+    struct iovec iov[UDP_MAX_SEND_BATCH];
+    int i, sent = 0;
+
+    memset(msgs, 0, nb * sizeof(*msgs));
+    for (i = 0; i < nb; i++) {
+        iov[i].iov_base = (uint8_t *)buf;
+        iov[i].iov_len  = lens[i];
+        buf += lens[i];
+        msgs[i].msg_hdr.msg_iov    = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        if (!s->is_connected) {
+            msgs[i].msg_hdr.msg_name    = &s->dest_addr;
+            msgs[i].msg_hdr.msg_namelen = s->dest_addr_len;
+        }
+    }
+    while (sent < nb) {
+        int ret = sendmmsg(s->udp_fd, msgs + sent, nb - sent, 0);
+        if (ret >= 0) {
+            sent += ret;
+        } else {
+            ret = ff_neterrno();
+            if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                return ret;
+        }
+    }
+#else
+    int i;
+
+    for (i = 0; i < nb; i++) {
+        const uint8_t *p = buf;
+        int len = lens[i];
+
+        buf += lens[i];
+        while (len) {
+            int ret;
+            av_assert0(len > 0);
+            if (!s->is_connected) {
+                ret = sendto (s->udp_fd, p, len, 0,
+                            (struct sockaddr *) &s->dest_addr,
+                            s->dest_addr_len);
+            } else
+                ret = send(s->udp_fd, p, len, 0);
+            if (ret >= 0) {
+                len -= ret;
+                p   += ret;
+            } else {
+                ret = ff_neterrno();
+                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                    return ret;
+            }
+        }
+    }
+#endif
+    return 0;
+}
+
+/**
+ * Read the next datagram from the fifo into buf if it fits in size bytes.
+ * Must be called with the mutex held.
+ * @return the datagram size or a negative value if none was read
+ */
+static int tx_fifo_read(UDPContext *s, uint8_t *buf, int size)
+{
+    uint8_t tmp[4];
+    int len;
+
+    if (av_fifo_size(s->fifo) < 4)
+        return -1;
+    av_fifo_generic_peek(s->fifo, tmp, 4, NULL);
+    len = AV_RL32(tmp);
+
+    av_assert0(len >= 0);
+    av_assert0(len <= sizeof(s->tmp));
+
+    if (len > size)
+        return -1;
+    av_fifo_drain(s->fifo, 4);
+    av_fifo_generic_read(s->fifo, buf, len, NULL);
+    return len;
+}
+
 static void *circular_buffer_task_tx( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -574,29 +828,20 @@ static void *circular_buffer_task_tx( void *_URLContext)
     }
 
     for(;;) {
-        int len;
-        const uint8_t *p;
-        uint8_t tmp[4];
+        int len, ret, size, nb = 0, resync = 0;
+        int lens[UDP_MAX_SEND_BATCH];
         int64_t timestamp;
 
-        len=av_fifo_size(s->fifo);
-
-        while (len<4) {
+        while (av_fifo_size(s->fifo) < 4) {
             if (s->close_req)
                 goto end;
             if (pthread_cond_wait(&s->cond, &s->mutex) < 0) {
                 goto end;
             }
-            len=av_fifo_size(s->fifo);
         }
 
-        av_fifo_generic_read(s->fifo, tmp, 4, NULL);
-        len=AV_RL32(tmp);
-
-        av_assert0(len >= 0);
-        av_assert0(len <= sizeof(s->tmp));
-
-        av_fifo_generic_read(s->fifo, s->tmp, len, NULL);
+        len = tx_fifo_read(s, s->tmp, sizeof(s->tmp));
+        size = len;
 
         pthread_mutex_unlock(&s->mutex);
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
@@ -609,40 +854,56 @@ static void *circular_buffer_task_tx( void *_URLContext)
                     delay = max_delay;
                     start_timestamp = timestamp + delay;
                     sent_bits = 0;
+                    target_timestamp = start_timestamp;
+                    resync = 1;
                 }
                 av_usleep(delay);
+                timestamp = av_gettime_relative();
             } else {
                 if (timestamp - burst_interval > target_timestamp) {
                     start_timestamp = timestamp - burst_interval;
                     sent_bits = 0;
+                    resync = 1;
                 }
             }
-            sent_bits += len * 8;
-            target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
         }
 
-        p = s->tmp;
-        while (len) {
-            int ret;
-            av_assert0(len > 0);
-            if (!s->is_connected) {
-                ret = sendto (s->udp_fd, p, len, 0,
-                            (struct sockaddr *) &s->dest_addr,
-                            s->dest_addr_len);
-            } else
-                ret = send(s->udp_fd, p, len, 0);
-            if (ret >= 0) {
-                len -= ret;
-                p   += ret;
-            } else {
-                ret = ff_neterrno();
-                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
-                    pthread_mutex_lock(&s->mutex);
-                    s->circular_buffer_error = ret;
-                    pthread_mutex_unlock(&s->mutex);
-                    return NULL;
-                }
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
+        pthread_mutex_lock(&s->mutex);
+
+        s->tx_stats.resyncs += resync;
+
+        /* Datagrams which are already due by the schedule are sent together
+         * with this one; the others wait for their own slot. */
+        for (;;) {
+            if (s->bitrate) {
+                int64_t late = FFMAX(timestamp - target_timestamp, 0);
+                s->tx_stats.late_sum += late;
+                s->tx_stats.late_count++;
+                s->tx_stats.late_max = FFMAX(s->tx_stats.late_max, late);
+                sent_bits += len * 8;
+                target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
             }
+            lens[nb++] = len;
+            if (nb >= s->send_batch ||
+                s->bitrate && target_timestamp > timestamp)
+                break;
+            len = tx_fifo_read(s, s->tmp + size, sizeof(s->tmp) - size);
+            if (len < 0)
+                break;
+            size += len;
+        }
+        s->tx_stats.batch_max = FFMAX(s->tx_stats.batch_max, nb);
+
+        pthread_mutex_unlock(&s->mutex);
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
+
+        ret = udp_send_batch(s, s->tmp, lens, nb);
+        if (ret < 0) {
+            pthread_mutex_lock(&s->mutex);
+            s->circular_buffer_error = ret;
+            pthread_mutex_unlock(&s->mutex);
+            return NULL;
         }
 
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
@@ -788,6 +1049,12 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         }
         if (!is_output && av_find_info_tag(buf, sizeof(buf), "timeout", p))
             s->timeout = strtol(buf, NULL, 10);
+        if (!is_output && av_find_info_tag(buf, sizeof(buf), "recv_batch", p))
+            s->recv_batch = av_clip(strtol(buf, NULL, 10), 1, UDP_MAX_RECV_BATCH);
+        if (!is_output && av_find_info_tag(buf, sizeof(buf), "gro", p))
+            s->gro = strtol(buf, NULL, 10);
+        if (is_output && av_find_info_tag(buf, sizeof(buf), "send_batch", p))
+            s->send_batch = av_clip(strtol(buf, NULL, 10), 1, UDP_MAX_SEND_BATCH);
         if (is_output && av_find_info_tag(buf, sizeof(buf), "broadcast", p))
             s->is_broadcast = strtol(buf, NULL, 10);
     }
@@ -967,7 +1234,34 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         int ret;
 
         /* start the task going */
-        s->fifo = av_fifo_alloc(s->circular_buffer_size);
+        if (is_output) {
+            s->fifo = av_fifo_alloc(s->circular_buffer_size);
+        } else {
+            s->rx_ring_size = 1U << FFMIN(av_log2(FFMAX(s->circular_buffer_size, 2) - 1) + 1, 30);
+            s->rx_ring  = av_malloc(s->rx_ring_size);
+            s->rx_batch = av_malloc_array(s->recv_batch, UDP_MAX_PKT_SIZE);
+            if (!s->rx_ring || !s->rx_batch)
+                goto fail;
+            atomic_init(&s->rx_head, 0);
+            atomic_init(&s->rx_tail, 0);
+            atomic_init(&s->rx_overrun_count, 0);
+            atomic_init(&s->rx_drop_count, 0);
+#ifdef SO_RXQ_OVFL
+            tmp = 1;
+            if (setsockopt(udp_fd, SOL_SOCKET, SO_RXQ_OVFL, &tmp, sizeof(tmp)) < 0)
+                log_net_error(h, AV_LOG_DEBUG, "setsockopt(SO_RXQ_OVFL)");
+#endif
+            if (s->gro) {
+#if HAVE_RECVMMSG && defined(UDP_GRO)
+                tmp = 1;
+                if (setsockopt(udp_fd, IPPROTO_UDP, UDP_GRO, &tmp, sizeof(tmp)) < 0)
+                    log_net_error(h, AV_LOG_WARNING, "setsockopt(UDP_GRO)");
+#else
+                av_log(h, AV_LOG_WARNING, "'gro' option was set but it is not "
+                       "supported on this system\n");
+#endif
+            }
+        }
         ret = pthread_mutex_init(&s->mutex, NULL);
         if (ret != 0) {
             av_log(h, AV_LOG_ERROR, "pthread_mutex_init failed : %s\n", strerror(ret));
@@ -998,6 +1292,10 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (udp_fd >= 0)
         closesocket(udp_fd);
     av_fifo_freep(&s->fifo);
+#if HAVE_PTHREAD_CANCEL
+    av_freep(&s->rx_ring);
+    av_freep(&s->rx_batch);
+#endif
     for (i = 0; i < num_include_sources; i++)
         av_freep(&include_sources[i]);
     for (i = 0; i < num_exclude_sources; i++)
@@ -1022,24 +1320,32 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
 #if HAVE_PTHREAD_CANCEL
     int avail, nonblock = h->flags & AVIO_FLAG_NONBLOCK;
 
-    if (s->fifo) {
-        pthread_mutex_lock(&s->mutex);
+    if (s->rx_ring) {
+        s->rx_overruns = atomic_load(&s->rx_overrun_count);
+        s->rx_drops    = atomic_load(&s->rx_drop_count);
         do {
-            avail = av_fifo_size(s->fifo);
-            if (avail) { // >=size) {
+            unsigned tail = atomic_load_explicit(&s->rx_tail, memory_order_relaxed);
+            unsigned head = atomic_load_explicit(&s->rx_head, memory_order_acquire);
+
+            if (head != tail) {
                 uint8_t tmp[4];
+                int len;
 
-                av_fifo_generic_read(s->fifo, tmp, 4, NULL);
-                avail= AV_RL32(tmp);
+                rx_ring_read_data(s, tail, tmp, 4);
+                len = avail = AV_RL32(tmp);
                 if(avail > size){
                     av_log(h, AV_LOG_WARNING, "Part of datagram lost due to insufficient buffer size\n");
                     avail= size;
                 }
 
-                av_fifo_generic_read(s->fifo, buf, avail, NULL);
-                av_fifo_drain(s->fifo, AV_RL32(tmp) - avail);
-                pthread_mutex_unlock(&s->mutex);
+                rx_ring_read_data(s, tail + 4, buf, avail);
+                atomic_store_explicit(&s->rx_tail, tail + 4 + len, memory_order_release);
                 return avail;
+            }
+
+            pthread_mutex_lock(&s->mutex);
+            if ((unsigned)atomic_load(&s->rx_head) != head) {
+                pthread_mutex_unlock(&s->mutex);
             } else if(s->circular_buffer_error){
                 int err = s->circular_buffer_error;
                 pthread_mutex_unlock(&s->mutex);
@@ -1054,10 +1360,8 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
                 int64_t t = av_gettime() + 100000;
                 struct timespec tv = { .tv_sec  =  t / 1000000,
                                        .tv_nsec = (t % 1000000) * 1000 };
-                if (pthread_cond_timedwait(&s->cond, &s->mutex, &tv) < 0) {
-                    pthread_mutex_unlock(&s->mutex);
-                    return AVERROR(errno == ETIMEDOUT ? EAGAIN : errno);
-                }
+                pthread_cond_timedwait(&s->cond, &s->mutex, &tv);
+                pthread_mutex_unlock(&s->mutex);
                 nonblock = 1;
             }
         } while( 1);
@@ -1095,6 +1399,12 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
             return err;
         }
 
+        s->tx_jitter_max = s->tx_stats.late_max;
+        s->tx_jitter_avg = s->tx_stats.late_count ?
+                           s->tx_stats.late_sum / s->tx_stats.late_count : 0;
+        s->tx_batch_max  = s->tx_stats.batch_max;
+        s->tx_resyncs    = s->tx_stats.resyncs;
+
         if(av_fifo_space(s->fifo) < size + 4) {
             /* What about a partial packet tx ? */
             pthread_mutex_unlock(&s->mutex);
@@ -1155,6 +1465,10 @@ static int udp_close(URLContext *h)
 #endif
     closesocket(s->udp_fd);
     av_fifo_freep(&s->fifo);
+#if HAVE_PTHREAD_CANCEL
+    av_freep(&s->rx_ring);
+    av_freep(&s->rx_batch);
+#endif
     return 0;
 }
 
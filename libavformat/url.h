@@ -27,6 +27,7 @@
 #include "avio.h"
 #include "libavformat/version.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
 
@@ -49,6 +50,7 @@ typedef struct URLContext {
     const char *protocol_whitelist;
     const char *protocol_blacklist;
     int min_packet_size;        /**< if non zero, the stream is packetized with this min packet size */
+    int readahead_size;         /**< maximum amount of data the AVIOContext reads ahead in a thread, 0 to disable */
 } URLContext;
 
 typedef struct URLProtocol {
@@ -97,6 +99,8 @@ typedef struct URLProtocol {
     int (*url_delete)(URLContext *h);
     int (*url_move)(URLContext *h_src, URLContext *h_dst);
     const char *default_whitelist;
+    int (*url_get_buffer_ref)(URLContext *h, int64_t pos, int size,
+                              AVBufferRef **buf, uint8_t **data);
 } URLProtocol;
 
 /**
@@ -257,6 +261,21 @@ int ffurl_get_multi_file_handle(URLContext *h, int **handles, int *numhandles);
  */
 int ffurl_get_short_seek(URLContext *h);
 
+/**
+ * Get a reference to size bytes of the resource starting at pos, without
+ * reading them, e.g. from a memory mapped file.
+ *
+ * On success *buf is a new read-only reference, *data points to the
+ * requested bytes in it and they are followed by AV_INPUT_BUFFER_PADDING_SIZE
+ * readable bytes, which are the following bytes of the resource rather than
+ * zeros.
+ *
+ * @return 0 on success, AVERROR(ENOSYS) if the bytes are not available
+ *         this way, another negative error code on failure
+ */
+int ffurl_get_buffer_ref(URLContext *h, int64_t pos, int size,
+                         AVBufferRef **buf, uint8_t **data);
+
 /**
  * Signal the URLContext that we are done reading or writing the stream.
  *
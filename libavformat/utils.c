@@ -32,6 +32,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/time.h"
 #include "libavutil/time_internal.h"
 #include "libavutil/timestamp.h"
@@ -47,6 +48,7 @@
 #include "internal.h"
 #include "metadata.h"
 #if CONFIG_NETWORK
+#include "http.h"
 #include "network.h"
 #endif
 #include "riff.h"
@@ -296,6 +298,23 @@ int av_get_packet(AVIOContext *s, AVPacket *pkt, int size)
     return append_packet_chunked(s, pkt, size);
 }
 
+int ff_get_packet_ref(AVIOContext *s, AVPacket *pkt, int size)
+{
+    int64_t pos = avio_tell(s);
+    AVBufferRef *buf;
+    uint8_t *data;
+
+    if (ffio_read_buffer_ref(s, size, &buf, &data) < 0)
+        return av_get_packet(s, pkt, size);
+
+    av_init_packet(pkt);
+    pkt->buf  = buf;
+    pkt->data = data;
+    pkt->size = size;
+    pkt->pos  = pos;
+    return size;
+}
+
 int av_append_packet(AVIOContext *s, AVPacket *pkt, int size)
 {
     if (!pkt->size)
@@ -400,6 +419,8 @@ static int init_input(AVFormatContext *s, const char *filename,
 
     if (s->pb) {
         s->flags |= AVFMT_FLAG_CUSTOM_IO;
+        if (s->probe_cache_dir && (ret = ff_probe_cache_lookup(s, filename)))
+            return ret;
         if (!s->iformat)
             return av_probe_input_buffer2(s->pb, &s->iformat, filename,
                                          s, 0, s->format_probesize);
@@ -416,6 +437,9 @@ static int init_input(AVFormatContext *s, const char *filename,
     if ((ret = s->io_open(s, &s->pb, filename, AVIO_FLAG_READ | s->avio_flags, options)) < 0)
         return ret;
 
+    if (s->probe_cache_dir && (ret = ff_probe_cache_lookup(s, filename)))
+        return ret;
+
     if (s->iformat)
         return 0;
     return av_probe_input_buffer2(s->pb, &s->iformat, filename,
@@ -1503,6 +1527,8 @@ static int64_t ts_to_samples(AVStream *st, int64_t ts)
     return av_rescale(ts, st->time_base.num * st->codecpar->sample_rate, st->time_base.den);
 }
 
+static void info_decode_flush(AVFormatContext *ic);
+
 static int read_frame_internal(AVFormatContext *s, AVPacket *pkt)
 {
     int ret = 0, i, got_packet = 0;
@@ -1520,6 +1546,7 @@ static int read_frame_internal(AVFormatContext *s, AVPacket *pkt)
             if (ret == AVERROR(EAGAIN))
                 return ret;
             /* flush the parsers */
+            info_decode_flush(s);
             for (i = 0; i < s->nb_streams; i++) {
                 st = s->streams[i];
                 if (st->parser && st->need_parsing)
@@ -1532,6 +1559,10 @@ static int read_frame_internal(AVFormatContext *s, AVPacket *pkt)
         ret = 0;
         st  = s->streams[cur_pkt.stream_index];
 
+        /* the parser and timestamp code below use the codec context */
+        if (st->internal->info_queued)
+            info_decode_flush(s);
+
         /* update context if required */
         if (st->internal->need_context_update) {
             if (avcodec_is_open(st->internal->avctx)) {
@@ -2029,11 +2060,8 @@ int ff_index_search_timestamp(const AVIndexEntry *entries, int nb_entries,
     return m;
 }
 
-void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
+int ff_configure_buffers_needed(AVFormatContext *s)
 {
-    int ist1, ist2;
-    int64_t pos_delta = 0;
-    int64_t skip = 0;
     //We could use URLProtocol flags here but as many user applications do not use URLProtocols this would be unreliable
     const char *proto = avio_find_protocol_name(s->filename);
 
@@ -2044,7 +2072,31 @@ void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
                "optimally without knowing the protocol\n");
     }
 
-    if (proto && !(strcmp(proto, "file") && strcmp(proto, "pipe") && strcmp(proto, "cache")))
+    return !proto || (strcmp(proto, "file") && strcmp(proto, "pipe") && strcmp(proto, "cache"));
+}
+
+void ff_configure_buffers(AVFormatContext *s, int64_t pos_delta, int64_t skip)
+{
+    pos_delta *= 2;
+    /* XXX This could be adjusted depending on protocol*/
+    if (s->pb->buffer_size < pos_delta && pos_delta < (1<<24)) {
+        av_log(s, AV_LOG_VERBOSE, "Reconfiguring buffers to size %"PRId64"\n", pos_delta);
+        ffio_set_buf_size(s->pb, pos_delta);
+        s->pb->short_seek_threshold = FFMAX(s->pb->short_seek_threshold, pos_delta/2);
+    }
+
+    if (skip < (1<<23)) {
+        s->pb->short_seek_threshold = FFMAX(s->pb->short_seek_threshold, skip);
+    }
+}
+
+void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
+{
+    int ist1, ist2;
+    int64_t pos_delta = 0;
+    int64_t skip = 0;
+
+    if (!ff_configure_buffers_needed(s))
         return;
 
     for (ist1 = 0; ist1 < s->nb_streams; ist1++) {
@@ -2073,17 +2125,7 @@ void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
         }
     }
 
-    pos_delta *= 2;
-    /* XXX This could be adjusted depending on protocol*/
-    if (s->pb->buffer_size < pos_delta && pos_delta < (1<<24)) {
-        av_log(s, AV_LOG_VERBOSE, "Reconfiguring buffers to size %"PRId64"\n", pos_delta);
-        ffio_set_buf_size(s->pb, pos_delta);
-        s->pb->short_seek_threshold = FFMAX(s->pb->short_seek_threshold, pos_delta/2);
-    }
-
-    if (skip < (1<<23)) {
-        s->pb->short_seek_threshold = FFMAX(s->pb->short_seek_threshold, skip);
-    }
+    ff_configure_buffers(s, pos_delta, skip);
 }
 
 int av_index_search_timestamp(AVStream *st, int64_t wanted_timestamp, int flags)
@@ -3037,6 +3079,128 @@ fail:
     return ret;
 }
 
+typedef struct InfoDecodeJob {
+    AVStream *st;
+    AVPacket pkt;
+    AVDictionary **options;
+    int unref;
+} InfoDecodeJob;
+
+/**
+ * Packets of distinct streams queued by avformat_find_stream_info() and
+ * decoded together. The queue is flushed before anything else uses the
+ * codec context of a queued stream.
+ */
+typedef struct InfoDecodeQueue {
+    AVFormatContext *ic;
+    AVSliceThread *thread;
+    InfoDecodeJob *jobs;
+    int nb_jobs;
+    int max_jobs;
+} InfoDecodeQueue;
+
+static void info_decode_done(AVStream *st)
+{
+    st->codec_info_nb_frames++;
+    if (!st->internal->info_complete && has_codec_parameters(st, NULL))
+        st->internal->info_complete = 1;
+}
+
+static void info_decode_worker(void *priv, int jobnr, int threadnr,
+                               int nb_jobs, int nb_threads)
+{
+    InfoDecodeQueue *q  = priv;
+    InfoDecodeJob   *job = &q->jobs[jobnr];
+
+    try_decode_frame(q->ic, job->st, &job->pkt, job->options);
+}
+
+static void info_decode_flush(AVFormatContext *ic)
+{
+    InfoDecodeQueue *q = ic->internal->info_queue;
+    int i;
+
+    if (!q || !q->nb_jobs)
+        return;
+
+    avpriv_slicethread_execute(q->thread, q->nb_jobs, 0);
+
+    for (i = 0; i < q->nb_jobs; i++) {
+        InfoDecodeJob *job = &q->jobs[i];
+
+        if (job->unref)
+            av_packet_unref(&job->pkt);
+        job->st->internal->info_queued = 0;
+        info_decode_done(job->st);
+    }
+    q->nb_jobs = 0;
+}
+
+static void info_decode_queue(AVFormatContext *ic, AVStream *st, AVPacket *pkt,
+                              AVDictionary **options)
+{
+    InfoDecodeQueue *q  = ic->internal->info_queue;
+    InfoDecodeJob   *job = &q->jobs[q->nb_jobs++];
+
+    job->st      = st;
+    job->pkt     = *pkt;
+    job->options = options;
+    job->unref   = !!(ic->flags & AVFMT_FLAG_NOBUFFER);
+    st->internal->info_queued = 1;
+
+    if (q->nb_jobs == q->max_jobs)
+        info_decode_flush(ic);
+}
+
+static int info_decode_init(AVFormatContext *ic)
+{
+    InfoDecodeQueue *q;
+    int ret;
+
+    q = av_mallocz(sizeof(*q));
+    if (!q)
+        return AVERROR(ENOMEM);
+    q->ic = ic;
+
+    /* without threads, decode the packets as they are read */
+    ret = avpriv_slicethread_create(&q->thread, q, info_decode_worker,
+                                    NULL, ic->info_threads);
+    if (ret <= 1) {
+        avpriv_slicethread_free(&q->thread);
+        av_free(q);
+        return 0;
+    }
+
+    q->max_jobs = ret;
+    q->jobs     = av_malloc_array(q->max_jobs, sizeof(*q->jobs));
+    if (!q->jobs) {
+        avpriv_slicethread_free(&q->thread);
+        av_free(q);
+        return AVERROR(ENOMEM);
+    }
+
+    ic->internal->info_queue = q;
+    return 0;
+}
+
+static void info_decode_uninit(AVFormatContext *ic)
+{
+    InfoDecodeQueue *q = ic->internal->info_queue;
+    int i;
+
+    if (!q)
+        return;
+
+    for (i = 0; i < q->nb_jobs; i++) {
+        if (q->jobs[i].unref)
+            av_packet_unref(&q->jobs[i].pkt);
+        q->jobs[i].st->internal->info_queued = 0;
+    }
+    avpriv_slicethread_free(&q->thread);
+    av_freep(&q->jobs);
+    av_freep(&ic->internal->info_queue);
+}
+
 unsigned int ff_codec_get_tag(const AVCodecTag *tags, enum AVCodecID id)
 {
     while (tags->id != AV_CODEC_ID_NONE) {
@@ -3508,12 +3672,21 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     int64_t max_subtitle_analyze_duration;
     int64_t probesize = ic->probesize;
     int eof_reached = 0;
+    int cached;
     int *missing_streams = av_opt_ptr(ic->iformat->priv_class, ic->priv_data, "missing_streams");
 
     flush_codecs = probesize > 0;
 
     av_opt_set(ic, "skip_clear", "1", AV_OPT_SEARCH_CHILDREN);
 
+    /* With a probe cache entry, the decoders are still opened and checked
+     * below, but no packet is read. */
+    cached = ff_probe_cache_apply(ic);
+    if (cached < 0) {
+        ret = cached;
+        goto find_stream_info_err;
+    }
+
     max_stream_analyze_duration = max_analyze_duration;
     max_subtitle_analyze_duration = max_analyze_duration;
     if (!max_analyze_duration) {
@@ -3597,14 +3770,37 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
 
         // Try to just open decoders, in case this is enough to get parameters.
-        if (!has_codec_parameters(st, NULL) && st->request_probe <= 0) {
+        if ((cached || !has_codec_parameters(st, NULL)) && st->request_probe <= 0) {
             if (codec && !avctx->codec)
-                if (avcodec_open2(avctx, codec, options ? &options[i] : &thread_opt) < 0)
+                if (avcodec_open2(avctx, codec, options ? &options[i] : &thread_opt) < 0) {
                     av_log(ic, AV_LOG_WARNING,
                            "Failed to open codec in %s\n",__FUNCTION__);
+                    cached = 0;
+                }
         }
         if (!options)
             av_dict_free(&thread_opt);
+
+        st->internal->info_complete = has_codec_parameters(st, NULL);
+        if (!st->internal->info_complete)
+            cached = 0;
+        st->info_nb_packets = 0;
+        st->info_nb_bytes   = 0;
+    }
+
+    if (cached) {
+        for (i = 0; i < ic->nb_streams; i++)
+            avcodec_close(ic->streams[i]->internal->avctx);
+        goto stream_info_found;
+    }
+    /* If the decoders rejected the cached parameters, probe again and
+     * overwrite the entry. */
+    ff_probe_cache_reject(ic);
+
+    if (ic->info_threads > 1) {
+        ret = info_decode_init(ic);
+        if (ret < 0)
+            goto find_stream_info_err;
     }
 
     for (i = 0; i < ic->nb_streams; i++) {
@@ -3718,6 +3914,14 @@ FF_ENABLE_DEPRECATION_WARNINGS
         if (!(st->disposition & AV_DISPOSITION_ATTACHED_PIC))
             read_size += pkt->size;
 
+        if (st->internal->info_queued)
+            info_decode_flush(ic);
+
+        if (!st->internal->info_complete) {
+            st->info_nb_packets++;
+            st->info_nb_bytes += pkt->size;
+        }
+
         avctx = st->internal->avctx;
         if (!st->internal->avctx_inited) {
             ret = avcodec_parameters_to_context(avctx, st->codecpar);
@@ -3819,16 +4023,31 @@ FF_ENABLE_DEPRECATION_WARNINGS
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
          * the container. */
-        try_decode_frame(ic, st, pkt,
-                         (options && i < orig_nb_streams) ? &options[i] : NULL);
+        if (ic->internal->info_queue) {
+            info_decode_queue(ic, st, pkt,
+                              (options && st->index < orig_nb_streams) ? &options[st->index] : NULL);
+        } else {
+            try_decode_frame(ic, st, pkt,
+                             (options && st->index < orig_nb_streams) ? &options[st->index] : NULL);
 
-        if (ic->flags & AVFMT_FLAG_NOBUFFER)
-            av_packet_unref(pkt);
+            if (ic->flags & AVFMT_FLAG_NOBUFFER)
+                av_packet_unref(pkt);
 
-        st->codec_info_nb_frames++;
+            info_decode_done(st);
+        }
         count++;
     }
 
+    info_decode_flush(ic);
+    info_decode_uninit(ic);
+
+    for (i = 0; i < ic->nb_streams; i++) {
+        st = ic->streams[i];
+        av_log(ic, AV_LOG_DEBUG, "Stream #%d: %d packets, %"PRId64" bytes read%s\n",
+               i, st->info_nb_packets, st->info_nb_bytes,
+               st->internal->info_complete ? " until the parameters were found" : "");
+    }
+
     if (eof_reached) {
         int stream_index;
         for (stream_index = 0; stream_index < ic->nb_streams; stream_index++) {
@@ -3983,6 +4202,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
     if (probesize)
         estimate_timings(ic, old_offset);
 
+stream_info_found:
     av_opt_set(ic, "skip_clear", "0", AV_OPT_SEARCH_CHILDREN);
 
     if (ret >= 0 && ic->nb_streams)
@@ -4071,7 +4291,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
         st->internal->avctx_inited = 0;
     }
 
+    ff_probe_cache_store(ic);
+
 find_stream_info_err:
+    info_decode_uninit(ic);
     for (i = 0; i < ic->nb_streams; i++) {
         st = ic->streams[i];
         if (st->info)
@@ -4332,6 +4555,7 @@ void avformat_free_context(AVFormatContext *s)
     av_freep(&s->chapters);
     av_dict_free(&s->metadata);
     av_dict_free(&s->internal->id3v2_meta);
+    ff_probe_cache_free(s);
     av_freep(&s->streams);
     av_freep(&s->internal);
     flush_packet_queue(s);
@@ -4863,6 +5087,9 @@ int avformat_network_init(void)
 int avformat_network_deinit(void)
 {
 #if CONFIG_NETWORK
+#if CONFIG_HTTP_PROTOCOL
+    ff_http_pool_close();
+#endif
     ff_network_close();
     ff_tls_deinit();
     ff_network_inited_globally = 0;
@@ -22,6 +22,7 @@
 
 #include "buffer_internal.h"
 #include "common.h"
+#include "internal.h"
 #include "mem.h"
 #include "thread.h"
 
@@ -104,22 +105,61 @@ AVBufferRef *av_buffer_ref(AVBufferRef *buf)
     return ret;
 }
 
+void avpriv_buffer_ref_into(AVBufferRef *dst, const AVBufferRef *src)
+{
+    *dst = *src;
+
+    atomic_fetch_add_explicit(&src->buffer->refcount, 1, memory_order_relaxed);
+}
+
+/*
+ * Drop one reference to b. ref is the AVBufferRef struct that held it, which
+ * is freed (or given to the pool entry b belongs to), or NULL if the caller
+ * keeps the struct.
+ */
+static void buffer_release(AVBuffer *b, AVBufferRef *ref)
+{
+    if (atomic_fetch_add_explicit(&b->refcount, -1, memory_order_acq_rel) == 1) {
+        if (b->flags & BUFFER_FLAG_NO_FREE) {
+            /* the buffer belongs to a pool entry, which also keeps the last
+             * reference so that it can be reused by av_buffer_pool_get() */
+            BufferPoolEntry *entry = b->opaque;
+            entry->ref = ref;
+            b->free(b->opaque, b->data);
+            return;
+        }
+        b->free(b->opaque, b->data);
+        av_freep(&b);
+    }
+
+    av_freep(&ref);
+}
+
 static void buffer_replace(AVBufferRef **dst, AVBufferRef **src)
 {
     AVBuffer *b;
+    AVBufferRef *ref;
 
     b = (*dst)->buffer;
 
     if (src) {
         **dst = **src;
-        av_freep(src);
-    } else
-        av_freep(dst);
-
-    if (atomic_fetch_add_explicit(&b->refcount, -1, memory_order_acq_rel) == 1) {
-        b->free(b->opaque, b->data);
-        av_freep(&b);
+        ref   = *src;
+        *src  = NULL;
+    } else {
+        ref   = *dst;
+        *dst  = NULL;
     }
+
+    buffer_release(b, ref);
+}
+
+void avpriv_buffer_unref_keep(AVBufferRef *ref)
+{
+    AVBuffer *b = ref->buffer;
+
+    memset(ref, 0, sizeof(*ref));
+    buffer_release(b, NULL);
 }
 
 void av_buffer_unref(AVBufferRef **buf)
@@ -223,7 +263,10 @@ AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
     if (!pool)
         return NULL;
 
-    ff_mutex_init(&pool->mutex, NULL);
+    if (ff_mutex_init(&pool->mutex, NULL)) {
+        av_free(pool);
+        return NULL;
+    }
 
     pool->size      = size;
     pool->opaque    = opaque;
@@ -241,7 +284,10 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
     if (!pool)
         return NULL;
 
-    ff_mutex_init(&pool->mutex, NULL);
+    if (ff_mutex_init(&pool->mutex, NULL)) {
+        av_free(pool);
+        return NULL;
+    }
 
     pool->size     = size;
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
@@ -251,19 +297,33 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
     return pool;
 }
 
+/* the entry registered with the 1-based index idx */
+static BufferPoolEntry *pool_entry(AVBufferPool *pool, unsigned idx)
+{
+    unsigned n     = idx - 1;
+    int      chunk = av_log2(n / POOL_CHUNK_SIZE + 1);
+
+    return pool->chunks[chunk][n - POOL_CHUNK_SIZE * ((1U << chunk) - 1)];
+}
+
 /*
  * This function gets called when the pool has been uninited and
  * all the buffers returned to it.
  */
 static void buffer_pool_free(AVBufferPool *pool)
 {
-    while (pool->pool) {
-        BufferPoolEntry *buf = pool->pool;
-        pool->pool = buf->next;
+    unsigned i;
+
+    for (i = 1; i <= pool->nb_entries; i++) {
+        BufferPoolEntry *buf = pool_entry(pool, i);
 
         buf->free(buf->opaque, buf->data);
+        av_freep(&buf->ref);
         av_freep(&buf);
     }
+    for (i = 0; i < FF_ARRAY_ELEMS(pool->chunks); i++)
+        av_freep(&pool->chunks[i]);
+
     ff_mutex_destroy(&pool->mutex);
 
     if (pool->pool_free)
@@ -285,6 +345,74 @@ void av_buffer_pool_uninit(AVBufferPool **ppool)
         buffer_pool_free(pool);
 }
 
+/* the stack head following head, with the top entry idx */
+static intptr_t pool_next_head(intptr_t head, unsigned idx)
+{
+    return (((uintptr_t)head & ~POOL_INDEX_MASK) + POOL_INDEX_MASK + 1) | idx;
+}
+
+static void pool_push(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    intptr_t head = atomic_load_explicit(&pool->pool, memory_order_relaxed);
+
+    do {
+        atomic_store_explicit(&buf->next, head & POOL_INDEX_MASK,
+                              memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->pool, &head,
+                                                    pool_next_head(head, buf->index),
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+}
+
+/*
+ * Pop the top entry of the pool stack. Entries are only freed with the pool,
+ * so the next index of a head that another thread popped meanwhile can still
+ * be read; the tag in the head makes the exchange fail in that case.
+ */
+static BufferPoolEntry *pool_pop(AVBufferPool *pool)
+{
+    intptr_t head = atomic_load_explicit(&pool->pool, memory_order_acquire);
+    BufferPoolEntry *buf;
+    unsigned next;
+
+    do {
+        if (!(head & POOL_INDEX_MASK))
+            return NULL;
+        buf  = pool_entry(pool, head & POOL_INDEX_MASK);
+        next = atomic_load_explicit(&buf->next, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->pool, &head,
+                                                    pool_next_head(head, next),
+                                                    memory_order_acquire,
+                                                    memory_order_acquire));
+
+    return buf;
+}
+
+/* give buf an index in the pool, so that it can be put on the stack */
+static int pool_register_entry(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    unsigned n;
+    int chunk, ret = 0;
+
+    ff_mutex_lock(&pool->mutex);
+
+    n     = pool->nb_entries;
+    chunk = av_log2(n / POOL_CHUNK_SIZE + 1);
+    if (n >= POOL_INDEX_MASK) {
+        ret = AVERROR(ENOMEM);
+    } else if (!pool->chunks[chunk] &&
+               !(pool->chunks[chunk] = av_malloc_array(POOL_CHUNK_SIZE << chunk,
+                                                       sizeof(*pool->chunks[chunk])))) {
+        ret = AVERROR(ENOMEM);
+    } else {
+        pool->chunks[chunk][n - POOL_CHUNK_SIZE * ((1U << chunk) - 1)] = buf;
+        buf->index = ++pool->nb_entries;
+    }
+
+    ff_mutex_unlock(&pool->mutex);
+    return ret;
+}
+
 static void pool_release_buffer(void *opaque, uint8_t *data)
 {
     BufferPoolEntry *buf = opaque;
@@ -293,10 +421,7 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
     if(CONFIG_MEMORY_POISONING)
         memset(buf->data, FF_MEMORY_POISON, pool->size);
 
-    ff_mutex_lock(&pool->mutex);
-    buf->next = pool->pool;
-    pool->pool = buf;
-    ff_mutex_unlock(&pool->mutex);
+    pool_push(pool, buf);
 
     if (atomic_fetch_add_explicit(&pool->refcount, -1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -325,8 +450,25 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
     buf->free   = ret->buffer->free;
     buf->pool   = pool;
 
-    ret->buffer->opaque = buf;
-    ret->buffer->free   = pool_release_buffer;
+    /* replace the AVBuffer returned by the allocator with the one embedded
+     * in the entry, so it can be recycled along with the entry */
+    buf->buffer.data   = ret->buffer->data;
+    buf->buffer.size   = ret->buffer->size;
+    buf->buffer.opaque = buf;
+    buf->buffer.free   = pool_release_buffer;
+    buf->flags         = (ret->buffer->flags & ~BUFFER_FLAG_REALLOCATABLE) |
+                         BUFFER_FLAG_NO_FREE;
+    buf->buffer.flags  = buf->flags;
+    atomic_init(&buf->buffer.refcount, 1);
+
+    if (pool_register_entry(pool, buf) < 0) {
+        av_buffer_unref(&ret);
+        av_free(buf);
+        return NULL;
+    }
+
+    av_freep(&ret->buffer);
+    ret->buffer = &buf->buffer;
 
     return ret;
 }
@@ -336,19 +478,26 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
     AVBufferRef *ret;
     BufferPoolEntry *buf;
 
-    ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
+    buf = pool_pop(pool);
     if (buf) {
-        ret = av_buffer_create(buf->data, pool->size, pool_release_buffer,
-                               buf, 0);
-        if (ret) {
-            pool->pool = buf->next;
-            buf->next = NULL;
+        ret      = buf->ref;
+        buf->ref = NULL;
+        if (!ret && !(ret = av_malloc(sizeof(*ret)))) {
+            pool_push(pool, buf);
+            return NULL;
         }
+
+        buf->buffer.data  = buf->data;
+        buf->buffer.size  = pool->size;
+        buf->buffer.flags = buf->flags;
+        atomic_store_explicit(&buf->buffer.refcount, 1, memory_order_relaxed);
+
+        ret->buffer = &buf->buffer;
+        ret->data   = buf->data;
+        ret->size   = pool->size;
     } else {
         ret = pool_alloc_buffer(pool);
     }
-    ff_mutex_unlock(&pool->mutex);
 
     if (ret)
         atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
@@ -33,6 +33,11 @@
  * The buffer was av_realloc()ed, so it is reallocatable.
  */
 #define BUFFER_FLAG_REALLOCATABLE (1 << 1)
+/**
+ * The AVBuffer structure is embedded in a BufferPoolEntry and must not be
+ * freed; the last reference to it is handed back to the pool for reuse.
+ */
+#define BUFFER_FLAG_NO_FREE       (1 << 2)
 
 struct AVBuffer {
     uint8_t *data; /**< data described by this buffer */
@@ -70,12 +75,59 @@ typedef struct BufferPoolEntry {
     void (*free)(void *opaque, uint8_t *data);
 
     AVBufferPool *pool;
-    struct BufferPoolEntry *next;
+
+    /*
+     * Index of the entry in the pool, starting at 1, and index of the next
+     * entry on the pool stack, 0 for none.
+     */
+    unsigned index;
+    atomic_uint next;
+
+    /*
+     * Flags of the AVBuffer returned by the allocator, set again on every
+     * reuse of the entry.
+     */
+    int flags;
+
+    /*
+     * The AVBuffer handed out for this entry, recycled on every
+     * av_buffer_pool_get() so that no header needs to be allocated.
+     */
+    AVBuffer buffer;
+
+    /*
+     * The last AVBufferRef released for this entry, reused by the next
+     * av_buffer_pool_get(); NULL if none is cached.
+     */
+    AVBufferRef *ref;
 } BufferPoolEntry;
 
+/*
+ * The pool stack head holds the index of the top entry in its low half and a
+ * tag, incremented on every push and pop, in its high half.
+ */
+#define POOL_INDEX_BITS (sizeof(intptr_t) * 4)
+#define POOL_INDEX_MASK (((uintptr_t)1 << POOL_INDEX_BITS) - 1)
+/* number of entries in the first chunk, each next chunk is twice larger */
+#define POOL_CHUNK_SIZE 16
+
 struct AVBufferPool {
+    /*
+     * Lock-free stack of the available entries. Entries are pushed and
+     * popped one at a time with compare-and-swap on the head; the tag makes
+     * the exchange fail if the head was popped and pushed back meanwhile,
+     * which keeps the stack free of the ABA problem.
+     */
+    atomic_intptr_t pool;
+
+    /*
+     * All the entries of the pool, by index. Chunks are never moved, so
+     * entries can be looked up without locking; the mutex only protects
+     * the registration of new entries.
+     */
+    BufferPoolEntry **chunks[32];
+    unsigned nb_entries;
     AVMutex mutex;
-    BufferPoolEntry *pool;
 
     /*
      * This is used to track when the pool is to be freed.
@@ -23,11 +23,48 @@
 #include "dict.h"
 #include "frame.h"
 #include "imgutils.h"
+#include "internal.h"
 #include "mem.h"
 #include "samplefmt.h"
-
-
-static AVFrameSideData *frame_new_side_data(AVFrame *frame,
+#include "thread.h"
+
+typedef struct FramePoolEntry {
+    /* must be the first field, frames returned to the caller point to it */
+    AVFrame frame;
+
+    AVFramePool *pool;
+    struct FramePoolEntry *next;
+
+    /*
+     * Structs kept from earlier uses of the frame, reused instead of
+     * allocating new ones.
+     */
+    AVBufferRef     *spare_refs[16];
+    int           nb_spare_refs;
+    AVFrameSideData *spare_side_data[8];
+    int           nb_spare_side_data;
+
+    /*
+     * Side data array kept from earlier uses of the frame and the number of
+     * elements allocated in it. side_data_array is NULL while the array is
+     * owned by the frame.
+     */
+    AVFrameSideData **side_data_array;
+    int               side_data_array_size;
+} FramePoolEntry;
+
+struct AVFramePool {
+    AVMutex mutex;
+    FramePoolEntry *entries;
+
+    /*
+     * One reference for the caller and one per frame currently handed out,
+     * the pool is freed when it drops to zero.
+     */
+    int refcount;
+};
+
+static AVFrameSideData *frame_new_side_data(FramePoolEntry *e, AVFrame *frame,
                                             enum AVFrameSideDataType type,
                                             AVBufferRef *buf);
 
@@ -126,21 +163,62 @@ FF_ENABLE_DEPRECATION_WARNINGS
     frame->flags               = 0;
 }
 
-static void free_side_data(AVFrameSideData **ptr_sd)
+/*
+ * Reference and unreference buffers of a frame. With a pool entry, the
+ * AVBufferRef structs are taken from and returned to the entry spares.
+ */
+static AVBufferRef *frame_buffer_ref(FramePoolEntry *e, AVBufferRef *buf)
+{
+    AVBufferRef *ref;
+
+    if (!e || !e->nb_spare_refs)
+        return av_buffer_ref(buf);
+
+    ref = e->spare_refs[--e->nb_spare_refs];
+    avpriv_buffer_ref_into(ref, buf);
+
+    return ref;
+}
+
+static void frame_buffer_unref(FramePoolEntry *e, AVBufferRef **buf)
+{
+    if (!e || !*buf || e->nb_spare_refs == FF_ARRAY_ELEMS(e->spare_refs)) {
+        av_buffer_unref(buf);
+        return;
+    }
+
+    avpriv_buffer_unref_keep(*buf);
+    e->spare_refs[e->nb_spare_refs++] = *buf;
+    *buf = NULL;
+}
+
+static void free_side_data(FramePoolEntry *e, AVFrameSideData **ptr_sd)
 {
     AVFrameSideData *sd = *ptr_sd;
 
-    av_buffer_unref(&sd->buf);
+    frame_buffer_unref(e, &sd->buf);
     av_dict_free(&sd->metadata);
-    av_freep(ptr_sd);
+
+    if (e && e->nb_spare_side_data < FF_ARRAY_ELEMS(e->spare_side_data)) {
+        e->spare_side_data[e->nb_spare_side_data++] = sd;
+        *ptr_sd = NULL;
+    } else
+        av_freep(ptr_sd);
 }
 
-static void wipe_side_data(AVFrame *frame)
+static void wipe_side_data(FramePoolEntry *e, AVFrame *frame)
 {
     int i;
 
     for (i = 0; i < frame->nb_side_data; i++) {
-        free_side_data(&frame->side_data[i]);
+        free_side_data(e, &frame->side_data[i]);
+    }
+
+    if (e && frame->side_data && !e->side_data_array) {
+        /* the array holds at least as many elements as were in use */
+        e->side_data_array      = frame->side_data;
+        e->side_data_array_size = frame->nb_side_data;
+        frame->side_data        = NULL;
     }
     frame->nb_side_data = 0;
 
@@ -290,10 +368,26 @@ int av_frame_get_buffer(AVFrame *frame, int align)
     return AVERROR(EINVAL);
 }
 
-static int frame_copy_props(AVFrame *dst, const AVFrame *src, int force_copy)
+static int frame_copy_props(FramePoolEntry *e, AVFrame *dst, const AVFrame *src,
+                            int force_copy)
 {
     int i;
 
+    if (e && src->nb_side_data && !dst->side_data) {
+        /* hand the side data array kept by the entry over to the frame */
+        if (!e->side_data_array || e->side_data_array_size < src->nb_side_data) {
+            AVFrameSideData **tmp = av_realloc_array(e->side_data_array,
+                                                     src->nb_side_data,
+                                                     sizeof(*tmp));
+            if (!tmp)
+                return AVERROR(ENOMEM);
+            e->side_data_array      = tmp;
+            e->side_data_array_size = src->nb_side_data;
+        }
+        dst->side_data     = e->side_data_array;
+        e->side_data_array = NULL;
+    }
+
     dst->key_frame              = src->key_frame;
     dst->pict_type              = src->pict_type;
     dst->sample_aspect_ratio    = src->sample_aspect_ratio;
@@ -348,14 +442,15 @@ FF_ENABLE_DEPRECATION_WARNINGS
             sd_dst = av_frame_new_side_data(dst, sd_src->type,
                                             sd_src->size);
             if (!sd_dst) {
-                wipe_side_data(dst);
+                wipe_side_data(e, dst);
                 return AVERROR(ENOMEM);
             }
             memcpy(sd_dst->data, sd_src->data, sd_src->size);
         } else {
-            sd_dst = frame_new_side_data(dst, sd_src->type, av_buffer_ref(sd_src->buf));
+            sd_dst = frame_new_side_data(e, dst, sd_src->type,
+                                         frame_buffer_ref(e, sd_src->buf));
             if (!sd_dst) {
-                wipe_side_data(dst);
+                wipe_side_data(e, dst);
                 return AVERROR(ENOMEM);
             }
         }
@@ -367,9 +462,9 @@ FF_DISABLE_DEPRECATION_WARNINGS
     dst->qscale_table = NULL;
     dst->qstride      = 0;
     dst->qscale_type  = 0;
-    av_buffer_unref(&dst->qp_table_buf);
+    frame_buffer_unref(e, &dst->qp_table_buf);
     if (src->qp_table_buf) {
-        dst->qp_table_buf = av_buffer_ref(src->qp_table_buf);
+        dst->qp_table_buf = frame_buffer_ref(e, src->qp_table_buf);
         if (dst->qp_table_buf) {
             dst->qscale_table = dst->qp_table_buf->data;
             dst->qstride      = src->qstride;
@@ -379,9 +474,9 @@ FF_DISABLE_DEPRECATION_WARNINGS
 FF_ENABLE_DEPRECATION_WARNINGS
 #endif
 
-    av_buffer_unref(&dst->opaque_ref);
+    frame_buffer_unref(e, &dst->opaque_ref);
     if (src->opaque_ref) {
-        dst->opaque_ref = av_buffer_ref(src->opaque_ref);
+        dst->opaque_ref = frame_buffer_ref(e, src->opaque_ref);
         if (!dst->opaque_ref)
             return AVERROR(ENOMEM);
     }
@@ -389,7 +484,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
     return 0;
 }
 
-int av_frame_ref(AVFrame *dst, const AVFrame *src)
+static void frame_unref(FramePoolEntry *e, AVFrame *frame);
+
+static int frame_ref(FramePoolEntry *e, AVFrame *dst, const AVFrame *src)
 {
     int i, ret = 0;
 
@@ -403,7 +500,7 @@ int av_frame_ref(AVFrame *dst, const AVFrame *src)
     dst->channel_layout = src->channel_layout;
     dst->nb_samples     = src->nb_samples;
 
-    ret = frame_copy_props(dst, src, 0);
+    ret = frame_copy_props(e, dst, src, 0);
     if (ret < 0)
         return ret;
 
@@ -415,7 +512,7 @@ int av_frame_ref(AVFrame *dst, const AVFrame *src)
 
         ret = av_frame_copy(dst, src);
         if (ret < 0)
-            av_frame_unref(dst);
+            frame_unref(e, dst);
 
         return ret;
     }
@@ -424,7 +521,7 @@ int av_frame_ref(AVFrame *dst, const AVFrame *src)
     for (i = 0; i < FF_ARRAY_ELEMS(src->buf); i++) {
         if (!src->buf[i])
             continue;
-        dst->buf[i] = av_buffer_ref(src->buf[i]);
+        dst->buf[i] = frame_buffer_ref(e, src->buf[i]);
         if (!dst->buf[i]) {
             ret = AVERROR(ENOMEM);
             goto fail;
@@ -441,7 +538,7 @@ int av_frame_ref(AVFrame *dst, const AVFrame *src)
         dst->nb_extended_buf = src->nb_extended_buf;
 
         for (i = 0; i < src->nb_extended_buf; i++) {
-            dst->extended_buf[i] = av_buffer_ref(src->extended_buf[i]);
+            dst->extended_buf[i] = frame_buffer_ref(e, src->extended_buf[i]);
             if (!dst->extended_buf[i]) {
                 ret = AVERROR(ENOMEM);
                 goto fail;
@@ -450,7 +547,7 @@ int av_frame_ref(AVFrame *dst, const AVFrame *src)
     }
 
     if (src->hw_frames_ctx) {
-        dst->hw_frames_ctx = av_buffer_ref(src->hw_frames_ctx);
+        dst->hw_frames_ctx = frame_buffer_ref(e, src->hw_frames_ctx);
         if (!dst->hw_frames_ctx) {
             ret = AVERROR(ENOMEM);
             goto fail;
@@ -482,10 +579,15 @@ int av_frame_ref(AVFrame *dst, const AVFrame *src)
     return 0;
 
 fail:
-    av_frame_unref(dst);
+    frame_unref(e, dst);
     return ret;
 }
 
+int av_frame_ref(AVFrame *dst, const AVFrame *src)
+{
+    return frame_ref(NULL, dst, src);
+}
+
 AVFrame *av_frame_clone(const AVFrame *src)
 {
     AVFrame *ret = av_frame_alloc();
@@ -499,32 +601,148 @@ AVFrame *av_frame_clone(const AVFrame *src)
     return ret;
 }
 
-void av_frame_unref(AVFrame *frame)
+AVFramePool *av_frame_pool_alloc(void)
+{
+    AVFramePool *pool = av_mallocz(sizeof(*pool));
+    if (!pool)
+        return NULL;
+
+    ff_mutex_init(&pool->mutex, NULL);
+    pool->refcount = 1;
+
+    return pool;
+}
+
+static void frame_pool_entry_free(FramePoolEntry *e)
 {
     int i;
 
-    if (!frame)
+    for (i = 0; i < e->nb_spare_refs; i++)
+        av_freep(&e->spare_refs[i]);
+    for (i = 0; i < e->nb_spare_side_data; i++)
+        av_freep(&e->spare_side_data[i]);
+    av_freep(&e->side_data_array);
+    av_free(e);
+}
+
+/* drop one reference to the pool, pushing e to its free list if set */
+static void frame_pool_unref(AVFramePool *pool, FramePoolEntry *e)
+{
+    int refcount;
+
+    ff_mutex_lock(&pool->mutex);
+    if (e) {
+        e->next       = pool->entries;
+        pool->entries = e;
+    }
+    refcount = --pool->refcount;
+    ff_mutex_unlock(&pool->mutex);
+
+    if (refcount)
+        return;
+
+    while (pool->entries) {
+        e             = pool->entries;
+        pool->entries = e->next;
+        frame_pool_entry_free(e);
+    }
+    ff_mutex_destroy(&pool->mutex);
+    av_free(pool);
+}
+
+void av_frame_pool_free(AVFramePool **pool)
+{
+    if (!pool || !*pool)
         return;
 
-    wipe_side_data(frame);
+    frame_pool_unref(*pool, NULL);
+    *pool = NULL;
+}
+
+AVFrame *av_frame_pool_get(AVFramePool *pool)
+{
+    FramePoolEntry *e;
+
+    ff_mutex_lock(&pool->mutex);
+    e = pool->entries;
+    if (e)
+        pool->entries = e->next;
+    pool->refcount++;
+    ff_mutex_unlock(&pool->mutex);
+
+    if (!e) {
+        e = av_mallocz(sizeof(*e));
+        if (!e) {
+            frame_pool_unref(pool, NULL);
+            return NULL;
+        }
+        get_frame_defaults(&e->frame);
+    }
+
+    e->pool = pool;
+    e->next = NULL;
+
+    return &e->frame;
+}
+
+AVFrame *av_frame_pool_clone(AVFramePool *pool, const AVFrame *src)
+{
+    AVFrame *ret = av_frame_pool_get(pool);
+
+    if (!ret)
+        return NULL;
+
+    if (frame_ref((FramePoolEntry *)ret, ret, src) < 0)
+        av_frame_pool_release(&ret);
+
+    return ret;
+}
+
+void av_frame_pool_release(AVFrame **frame)
+{
+    FramePoolEntry *e;
+
+    if (!frame || !*frame)
+        return;
+
+    e = (FramePoolEntry *)*frame;
+    frame_unref(e, &e->frame);
+    *frame = NULL;
+
+    frame_pool_unref(e->pool, e);
+}
+
+static void frame_unref(FramePoolEntry *e, AVFrame *frame)
+{
+    int i;
+
+    wipe_side_data(e, frame);
 
     for (i = 0; i < FF_ARRAY_ELEMS(frame->buf); i++)
-        av_buffer_unref(&frame->buf[i]);
+        frame_buffer_unref(e, &frame->buf[i]);
     for (i = 0; i < frame->nb_extended_buf; i++)
-        av_buffer_unref(&frame->extended_buf[i]);
+        frame_buffer_unref(e, &frame->extended_buf[i]);
     av_freep(&frame->extended_buf);
     av_dict_free(&frame->metadata);
 #if FF_API_FRAME_QP
-    av_buffer_unref(&frame->qp_table_buf);
+    frame_buffer_unref(e, &frame->qp_table_buf);
 #endif
 
-    av_buffer_unref(&frame->hw_frames_ctx);
+    frame_buffer_unref(e, &frame->hw_frames_ctx);
 
-    av_buffer_unref(&frame->opaque_ref);
+    frame_buffer_unref(e, &frame->opaque_ref);
 
     get_frame_defaults(frame);
 }
 
+void av_frame_unref(AVFrame *frame)
+{
+    if (!frame)
+        return;
+
+    frame_unref(NULL, frame);
+}
+
 void av_frame_move_ref(AVFrame *dst, AVFrame *src)
 {
     av_assert1(dst->width == 0 && dst->height == 0);
@@ -599,7 +817,7 @@ int av_frame_make_writable(AVFrame *frame)
 
 int av_frame_copy_props(AVFrame *dst, const AVFrame *src)
 {
-    return frame_copy_props(dst, src, 1);
+    return frame_copy_props(NULL, dst, src, 1);
 }
 
 AVBufferRef *av_frame_get_plane_buffer(AVFrame *frame, int plane)
@@ -633,7 +851,7 @@ AVBufferRef *av_frame_get_plane_buffer(AVFrame *frame, int plane)
     return NULL;
 }
 
-static AVFrameSideData *frame_new_side_data(AVFrame *frame,
+static AVFrameSideData *frame_new_side_data(FramePoolEntry *e, AVFrame *frame,
                                             enum AVFrameSideDataType type,
                                             AVBufferRef *buf)
 {
@@ -645,15 +863,25 @@ static AVFrameSideData *frame_new_side_data(AVFrame *frame,
     if (frame->nb_side_data > INT_MAX / sizeof(*frame->side_data) - 1)
         goto fail;
 
-    tmp = av_realloc(frame->side_data,
-                     (frame->nb_side_data + 1) * sizeof(*frame->side_data));
-    if (!tmp)
-        goto fail;
-    frame->side_data = tmp;
+    /* with a pool entry, the array was already sized by frame_copy_props() */
+    if (!e || frame->nb_side_data >= e->side_data_array_size) {
+        tmp = av_realloc(frame->side_data,
+                         (frame->nb_side_data + 1) * sizeof(*frame->side_data));
+        if (!tmp)
+            goto fail;
+        frame->side_data = tmp;
+        if (e)
+            e->side_data_array_size = frame->nb_side_data + 1;
+    }
 
-    ret = av_mallocz(sizeof(*ret));
-    if (!ret)
-        goto fail;
+    if (e && e->nb_spare_side_data) {
+        ret = e->spare_side_data[--e->nb_spare_side_data];
+        memset(ret, 0, sizeof(*ret));
+    } else {
+        ret = av_mallocz(sizeof(*ret));
+        if (!ret)
+            goto fail;
+    }
 
     ret->buf = buf;
     ret->data = ret->buf->data;
@@ -664,7 +892,7 @@ static AVFrameSideData *frame_new_side_data(AVFrame *frame,
 
     return ret;
 fail:
-    av_buffer_unref(&buf);
+    frame_buffer_unref(e, &buf);
     return NULL;
 }
 
@@ -673,7 +901,7 @@ AVFrameSideData *av_frame_new_side_data(AVFrame *frame,
                                         int size)
 {
 
-    return frame_new_side_data(frame, type, av_buffer_alloc(size));
+    return frame_new_side_data(NULL, frame, type, av_buffer_alloc(size));
 }
 
 AVFrameSideData *av_frame_get_side_data(const AVFrame *frame,
@@ -754,7 +982,7 @@ void av_frame_remove_side_data(AVFrame *frame, enum AVFrameSideDataType type)
     for (i = 0; i < frame->nb_side_data; i++) {
         AVFrameSideData *sd = frame->side_data[i];
         if (sd->type == type) {
-            free_side_data(&frame->side_data[i]);
+            free_side_data(NULL, &frame->side_data[i]);
             frame->side_data[i] = frame->side_data[frame->nb_side_data - 1];
             frame->nb_side_data--;
         }
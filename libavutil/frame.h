@@ -657,6 +657,55 @@ void av_frame_unref(AVFrame *frame);
  */
 void av_frame_move_ref(AVFrame *dst, AVFrame *src);
 
+/**
+ * A pool of AVFrame structs. Frames taken from the pool are recycled when
+ * released, together with the AVBufferRef and side data structs and the side
+ * data array attached to them, so that a steady stream of frames going
+ * through the pool does not allocate.
+ *
+ * A pool may be used from several threads at once, and frames may be
+ * released from a different thread than the one that got them.
+ */
+typedef struct AVFramePool AVFramePool;
+
+/**
+ * Allocate a new frame pool.
+ *
+ * @return the new pool or NULL on failure
+ */
+AVFramePool *av_frame_pool_alloc(void);
+
+/**
+ * Free the pool and set *pool to NULL. Frames still taken from the pool stay
+ * valid; the pool is freed once they have all been released.
+ */
+void av_frame_pool_free(AVFramePool **pool);
+
+/**
+ * Get a frame from the pool, set to default values like a frame returned by
+ * av_frame_alloc().
+ *
+ * The frame can be used like any other frame, but must be released with
+ * av_frame_pool_release() instead of av_frame_free().
+ *
+ * @return a frame or NULL on failure
+ */
+AVFrame *av_frame_pool_get(AVFramePool *pool);
+
+/**
+ * Get a frame from the pool that references the same data as src, like
+ * av_frame_clone().
+ *
+ * @return a frame or NULL on failure
+ */
+AVFrame *av_frame_pool_clone(AVFramePool *pool, const AVFrame *src);
+
+/**
+ * Unreference a frame obtained from av_frame_pool_get() or
+ * av_frame_pool_clone() and return it to its pool. *frame is set to NULL.
+ */
+void av_frame_pool_release(AVFrame **frame);
+
 /**
  * Allocate new buffer(s) for audio or video data.
  *
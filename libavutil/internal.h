@@ -353,4 +353,20 @@ void ff_check_pixfmt_descriptors(void);
  */
 int avpriv_dict_set_timestamp(AVDictionary **dict, const char *key, int64_t timestamp);
 
+struct AVBufferRef;
+
+/**
+ * Make dst a new reference to the buffer referenced by src, like
+ * av_buffer_ref(), but use the caller-provided AVBufferRef struct instead of
+ * allocating one.
+ */
+void avpriv_buffer_ref_into(struct AVBufferRef *dst, const struct AVBufferRef *src);
+
+/**
+ * Drop the reference held by ref, like av_buffer_unref(), but do not free
+ * the AVBufferRef struct itself; it is zeroed and may be reused with
+ * avpriv_buffer_ref_into().
+ */
+void avpriv_buffer_unref_keep(struct AVBufferRef *ref);
+
 #endif /* AVUTIL_INTERNAL_H */
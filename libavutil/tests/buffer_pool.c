@@ -0,0 +1,157 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program hammers a buffer pool from several threads, checking
+ * that no buffer is handed out twice at the same time and that every
+ * buffer allocated for the pool is freed exactly once.
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#define NB_THREADS   4
+#define NB_HELD      4
+#define NB_LOOPS     20000
+#define BUFFER_SIZE  64
+
+static atomic_int nb_buffers;
+static atomic_int nb_pool_free;
+
+typedef struct ThreadContext {
+    AVBufferPool *pool;
+    int id;
+    int errors;
+    AVBufferRef *last;
+} ThreadContext;
+
+static void buffer_free(void *opaque, uint8_t *data)
+{
+    atomic_fetch_sub(&nb_buffers, 1);
+    av_free(data);
+}
+
+static AVBufferRef *buffer_alloc(void *opaque, int size)
+{
+    uint8_t *data = av_malloc(size);
+    AVBufferRef *ref;
+
+    if (!data)
+        return NULL;
+    ref = av_buffer_create(data, size, buffer_free, NULL, 0);
+    if (!ref) {
+        av_free(data);
+        return NULL;
+    }
+    atomic_fetch_add(&nb_buffers, 1);
+    return ref;
+}
+
+static void pool_free(void *opaque)
+{
+    atomic_fetch_add(&nb_pool_free, 1);
+}
+
+static void *thread_main(void *arg)
+{
+    ThreadContext *t = arg;
+    AVBufferRef *held[NB_HELD] = { NULL };
+    int i, j;
+
+    for (i = 0; i < NB_LOOPS; i++) {
+        int nb = 1 + (i + t->id) % NB_HELD;
+        uint8_t tag = t->id * NB_HELD + 1;
+
+        for (j = 0; j < nb; j++) {
+            held[j] = av_buffer_pool_get(t->pool);
+            if (!held[j]) {
+                t->errors++;
+                break;
+            }
+            memset(held[j]->data, tag + j, BUFFER_SIZE);
+        }
+        /* another thread getting one of these buffers would overwrite it */
+        for (j = 0; j < nb && held[j]; j++) {
+            int k;
+            for (k = 0; k < BUFFER_SIZE; k++) {
+                if (held[j]->data[k] != (uint8_t)(tag + j)) {
+                    t->errors++;
+                    break;
+                }
+            }
+        }
+        for (j = 0; j < nb; j++)
+            av_buffer_unref(&held[j]);
+    }
+
+    /* returned to the pool only after it has been uninitialized */
+    t->last = av_buffer_pool_get(t->pool);
+    if (!t->last)
+        t->errors++;
+    return NULL;
+}
+
+int main(void)
+{
+    ThreadContext threads[NB_THREADS];
+    pthread_t tid[NB_THREADS];
+    AVBufferPool *pool;
+    int i, ret, errors = 0;
+
+    pool = av_buffer_pool_init2(BUFFER_SIZE, NULL, buffer_alloc, pool_free);
+    if (!pool)
+        return 1;
+
+    for (i = 0; i < NB_THREADS; i++) {
+        threads[i].pool   = pool;
+        threads[i].id     = i;
+        threads[i].errors = 0;
+        threads[i].last   = NULL;
+        if ((ret = pthread_create(&tid[i], NULL, thread_main, &threads[i]))) {
+            fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+            return 1;
+        }
+    }
+    for (i = 0; i < NB_THREADS; i++) {
+        pthread_join(tid[i], NULL);
+        errors += threads[i].errors;
+    }
+
+    av_buffer_pool_uninit(&pool);
+    if (atomic_load(&nb_pool_free)) {
+        fprintf(stderr, "pool freed while buffers are in use\n");
+        errors++;
+    }
+    for (i = 0; i < NB_THREADS; i++)
+        av_buffer_unref(&threads[i].last);
+
+    if (errors)
+        fprintf(stderr, "%d buffers were corrupted or not allocated\n", errors);
+    if (atomic_load(&nb_pool_free) != 1 || atomic_load(&nb_buffers)) {
+        fprintf(stderr, "pool freed %d times, %d buffers leaked\n",
+                atomic_load(&nb_pool_free), atomic_load(&nb_buffers));
+        errors++;
+    }
+
+    return !!errors;
+}
@@ -0,0 +1,142 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/frame.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#define NB_FRAMES 4
+
+static int check_clone(const AVFrame *src, const AVFrame *dst)
+{
+    const AVFrameSideData *sd;
+    int i;
+
+    if (dst->width != src->width || dst->height != src->height ||
+        dst->format != src->format || dst->pts != src->pts)
+        return 1;
+    for (i = 0; i < AV_NUM_DATA_POINTERS; i++) {
+        if (dst->data[i] != src->data[i] || dst->linesize[i] != src->linesize[i])
+            return 1;
+        if (!!dst->buf[i] != !!src->buf[i] ||
+            (dst->buf[i] && dst->buf[i]->buffer != src->buf[i]->buffer))
+            return 1;
+    }
+    sd = av_frame_get_side_data(dst, AV_FRAME_DATA_A53_CC);
+    if (!sd || sd->size != 3 || memcmp(sd->data, "abc", 3))
+        return 1;
+    return 0;
+}
+
+static void *release_frames(void *arg)
+{
+    AVFrame **frames = arg;
+    int i;
+
+    for (i = 0; i < NB_FRAMES; i++)
+        av_frame_pool_release(&frames[i]);
+    return NULL;
+}
+
+int main(void)
+{
+    AVFramePool *pool = av_frame_pool_alloc();
+    AVFrame *src = av_frame_alloc();
+    AVFrame *frames[NB_FRAMES] = { NULL };
+    AVFrameSideData *sd;
+    AVFrame *frame, *first;
+    int i, ret = 0;
+
+    if (!pool || !src)
+        return 1;
+
+    src->width  = 64;
+    src->height = 48;
+    src->format = AV_PIX_FMT_YUV420P;
+    src->pts    = 42;
+    if (av_frame_get_buffer(src, 32) < 0 ||
+        !(sd = av_frame_new_side_data(src, AV_FRAME_DATA_A53_CC, 3)))
+        return 1;
+    memcpy(sd->data, "abc", 3);
+
+    /* a pool frame behaves like av_frame_alloc() */
+    frame = av_frame_pool_get(pool);
+    if (!frame || frame->pts != AV_NOPTS_VALUE || frame->format != -1 ||
+        frame->buf[0] || frame->nb_side_data) {
+        printf("av_frame_pool_get() returned a frame not set to defaults\n");
+        ret = 1;
+    }
+
+    /* clones share the buffers of src and copy its properties */
+    if (av_frame_ref(frame, src) < 0 || check_clone(src, frame)) {
+        printf("av_frame_ref() into a pool frame failed\n");
+        ret = 1;
+    }
+    first = frame;
+    av_frame_pool_release(&frame);
+    if (frame) {
+        printf("av_frame_pool_release() did not reset the pointer\n");
+        ret = 1;
+    }
+
+    /* the released frame is handed out again */
+    frame = av_frame_pool_clone(pool, src);
+    if (frame != first || check_clone(src, frame)) {
+        printf("av_frame_pool_clone() did not reuse the released frame\n");
+        ret = 1;
+    }
+    av_frame_pool_release(&frame);
+
+    for (i = 0; i < NB_FRAMES; i++) {
+        frames[i] = av_frame_pool_clone(pool, src);
+        if (!frames[i] || check_clone(src, frames[i])) {
+            printf("av_frame_pool_clone() #%d failed\n", i);
+            ret = 1;
+        }
+    }
+    if (av_buffer_get_ref_count(src->buf[0]) != NB_FRAMES + 1) {
+        printf("unexpected buffer refcount %d\n", av_buffer_get_ref_count(src->buf[0]));
+        ret = 1;
+    }
+
+    /* frames may be released from another thread, after the pool is freed */
+    av_frame_pool_free(&pool);
+#if HAVE_THREADS
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, release_frames, frames)) {
+            release_frames(frames);
+        } else {
+            pthread_join(thread, NULL);
+        }
+    }
+#else
+    release_frames(frames);
+#endif
+    if (av_buffer_get_ref_count(src->buf[0]) != 1) {
+        printf("frames still referenced after release\n");
+        ret = 1;
+    }
+
+    av_frame_free(&src);
+    return ret;
+}
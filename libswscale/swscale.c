@@ -257,6 +257,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     int should_dither                = isNBPS(c->srcFormat) ||
                                        is16BPS(c->srcFormat);
     int lastDstY;
+    int dstEnd                       = dstH;
 
     /* vars which will change and which we need to store back in the context */
     int dstY         = c->dstY;
@@ -342,6 +343,14 @@ static int swscale(SwsContext *c, const uint8_t *src[],
         lastInChrBuf = -1;
     }
 
+    /* Only output the requested destination lines; the source is complete,
+     * so the ring buffers are primed from the first line they need. */
+    if (c->dstSliceEnd) {
+        av_assert1(srcSliceY == 0 && srcSliceH == c->srcH);
+        dstY   = c->dstSliceStart;
+        dstEnd = c->dstSliceEnd;
+    }
+
     if (!should_dither) {
         c->chrDither8 = c->lumDither8 = sws_pb_64;
     }
@@ -369,7 +378,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
         hout_slice->width = dstW;
     }
 
-    for (; dstY < dstH; dstY++) {
+    for (; dstY < dstEnd; dstY++) {
         const int chrDstY = dstY >> c->chrDstVSubSample;
         int use_mmx_vfilter= c->use_mmx_vfilter;
 
@@ -746,6 +755,146 @@ static void rgb48Toxyz12(struct SwsContext *c, uint16_t *dst,
     }
 }
 
+static void update_palette(SwsContext *c, const uint32_t *pal)
+{
+    int i;
+
+    for (i = 0; i < 256; i++) {
+        int r, g, b, y, u, v, a = 0xff;
+        if (c->srcFormat == AV_PIX_FMT_PAL8) {
+            uint32_t p = pal[i];
+            a = (p >> 24) & 0xFF;
+            r = (p >> 16) & 0xFF;
+            g = (p >>  8) & 0xFF;
+            b =  p        & 0xFF;
+        } else if (c->srcFormat == AV_PIX_FMT_RGB8) {
+            r = ( i >> 5     ) * 36;
+            g = ((i >> 2) & 7) * 36;
+            b = ( i       & 3) * 85;
+        } else if (c->srcFormat == AV_PIX_FMT_BGR8) {
+            b = ( i >> 6     ) * 85;
+            g = ((i >> 3) & 7) * 36;
+            r = ( i       & 7) * 36;
+        } else if (c->srcFormat == AV_PIX_FMT_RGB4_BYTE) {
+            r = ( i >> 3     ) * 255;
+            g = ((i >> 1) & 3) * 85;
+            b = ( i       & 1) * 255;
+        } else if (c->srcFormat == AV_PIX_FMT_GRAY8 || c->srcFormat == AV_PIX_FMT_GRAY8A) {
+            r = g = b = i;
+        } else {
+            av_assert1(c->srcFormat == AV_PIX_FMT_BGR4_BYTE);
+            b = ( i >> 3     ) * 255;
+            g = ((i >> 1) & 3) * 85;
+            r = ( i       & 1) * 255;
+        }
+#define RGB2YUV_SHIFT 15
+#define BY ( (int) (0.114 * 219 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
+#define BV (-(int) (0.081 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
+#define BU ( (int) (0.500 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
+#define GY ( (int) (0.587 * 219 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
+#define GV (-(int) (0.419 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
+#define GU (-(int) (0.331 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
+#define RY ( (int) (0.299 * 219 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
+#define RV ( (int) (0.500 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
+#define RU (-(int) (0.169 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
+
+        y = av_clip_uint8((RY * r + GY * g + BY * b + ( 33 << (RGB2YUV_SHIFT - 1))) >> RGB2YUV_SHIFT);
+        u = av_clip_uint8((RU * r + GU * g + BU * b + (257 << (RGB2YUV_SHIFT - 1))) >> RGB2YUV_SHIFT);
+        v = av_clip_uint8((RV * r + GV * g + BV * b + (257 << (RGB2YUV_SHIFT - 1))) >> RGB2YUV_SHIFT);
+        c->pal_yuv[i]= y + (u<<8) + (v<<16) + ((unsigned)a<<24);
+
+        switch (c->dstFormat) {
+        case AV_PIX_FMT_BGR32:
+#if !HAVE_BIGENDIAN
+        case AV_PIX_FMT_RGB24:
+#endif
+            c->pal_rgb[i]=  r + (g<<8) + (b<<16) + ((unsigned)a<<24);
+            break;
+        case AV_PIX_FMT_BGR32_1:
+#if HAVE_BIGENDIAN
+        case AV_PIX_FMT_BGR24:
+#endif
+            c->pal_rgb[i]= a + (r<<8) + (g<<16) + ((unsigned)b<<24);
+            break;
+        case AV_PIX_FMT_RGB32_1:
+#if HAVE_BIGENDIAN
+        case AV_PIX_FMT_RGB24:
+#endif
+            c->pal_rgb[i]= a + (b<<8) + (g<<16) + ((unsigned)r<<24);
+            break;
+        case AV_PIX_FMT_RGB32:
+#if !HAVE_BIGENDIAN
+        case AV_PIX_FMT_BGR24:
+#endif
+        default:
+            c->pal_rgb[i]=  b + (g<<8) + (r<<16) + ((unsigned)a<<24);
+        }
+    }
+}
+
+/**
+ * Check if the conversion keeps no state between destination lines, so that
+ * any band of the destination can be computed independently.
+ */
+static int dst_slice_supported(SwsContext *c)
+{
+    enum AVPixelFormat dstFormat = c->dstFormat;
+
+    if (c->gamma_flag || c->cascaded_context[0] ||
+        c->srcXYZ || c->dstXYZ || c->src0Alpha || isBayer(c->srcFormat))
+        return 0;
+    /* error diffusion carries the error over to the next line */
+    if (c->dither == SWS_DITHER_ED)
+        return 0;
+    if ((c->flags & SWS_FULL_CHR_H_INT) &&
+        (dstFormat == AV_PIX_FMT_BGR4_BYTE || dstFormat == AV_PIX_FMT_RGB4_BYTE ||
+         dstFormat == AV_PIX_FMT_BGR8      || dstFormat == AV_PIX_FMT_RGB8))
+        return 0;
+    return 1;
+}
+
+void ff_sws_slice_worker(void *priv, int jobnr, int threadnr,
+                         int nb_jobs, int nb_threads)
+{
+    SwsContext *parent = priv;
+    SwsContext      *c = threadnr ? parent->slice_ctx[threadnr - 1] : parent;
+    const int nb_blocks = (parent->dstH + 15) >> 4;
+    const int start     = (nb_blocks *  jobnr      / nb_jobs) << 4;
+    const int end       = FFMIN((nb_blocks * (jobnr + 1) / nb_jobs) << 4, parent->dstH);
+    int ret;
+
+    ret = sws_scale_dst_slice(c, parent->frame_src, parent->frame_src_stride,
+                              parent->frame_dst, parent->frame_dst_stride,
+                              start, end - start);
+    parent->slice_err[jobnr] = ret < 0 ? ret : 0;
+}
+
+static int scale_threaded(SwsContext *c, const uint8_t *const src[],
+                          const int srcStride[], uint8_t *const dst[],
+                          const int dstStride[])
+{
+    const int nb_jobs = FFMIN(c->nb_threads, (c->dstH + 15) >> 4);
+    int i;
+
+    c->frame_src        = src;
+    c->frame_src_stride = srcStride;
+    c->frame_dst        = dst;
+    c->frame_dst_stride = dstStride;
+
+    avpriv_slicethread_execute(c->slicethread, nb_jobs, 0);
+
+    c->frame_src        = NULL;
+    c->frame_src_stride = NULL;
+    c->frame_dst        = NULL;
+    c->frame_dst_stride = NULL;
+
+    for (i = 0; i < nb_jobs; i++)
+        if (c->slice_err[i] < 0)
+            return c->slice_err[i];
+
+    return c->dstH;
+}
+
 /**
  * swscale wrapper, so we don't need to export the SwsContext.
  * Assumes planar YUV to be in YUV order instead of YVU.
@@ -841,83 +990,16 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
         av_log(c, AV_LOG_ERROR, "Slices start in the middle!\n");
         return 0;
     }
+    if (c->slicethread && c->sliceDir == 0 && srcSliceY == 0 &&
+        srcSliceH == c->srcH && dst_slice_supported(c))
+        return scale_threaded(c, srcSlice, srcStride, dst, dstStride);
+
     if (c->sliceDir == 0) {
         if (srcSliceY == 0) c->sliceDir = 1; else c->sliceDir = -1;
     }
 
-    if (usePal(c->srcFormat)) {
-        for (i = 0; i < 256; i++) {
-            int r, g, b, y, u, v, a = 0xff;
-            if (c->srcFormat == AV_PIX_FMT_PAL8) {
-                uint32_t p = ((const uint32_t *)(srcSlice[1]))[i];
-                a = (p >> 24) & 0xFF;
-                r = (p >> 16) & 0xFF;
-                g = (p >>  8) & 0xFF;
-                b =  p        & 0xFF;
-            } else if (c->srcFormat == AV_PIX_FMT_RGB8) {
-                r = ( i >> 5     ) * 36;
-                g = ((i >> 2) & 7) * 36;
-                b = ( i       & 3) * 85;
-            } else if (c->srcFormat == AV_PIX_FMT_BGR8) {
-                b = ( i >> 6     ) * 85;
-                g = ((i >> 3) & 7) * 36;
-                r = ( i       & 7) * 36;
-            } else if (c->srcFormat == AV_PIX_FMT_RGB4_BYTE) {
-                r = ( i >> 3     ) * 255;
-                g = ((i >> 1) & 3) * 85;
-                b = ( i       & 1) * 255;
-            } else if (c->srcFormat == AV_PIX_FMT_GRAY8 || c->srcFormat == AV_PIX_FMT_GRAY8A) {
-                r = g = b = i;
-            } else {
-                av_assert1(c->srcFormat == AV_PIX_FMT_BGR4_BYTE);
-                b = ( i >> 3     ) * 255;
-                g = ((i >> 1) & 3) * 85;
-                r = ( i       & 1) * 255;
-            }
-#define RGB2YUV_SHIFT 15
-#define BY ( (int) (0.114 * 219 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-#define BV (-(int) (0.081 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-#define BU ( (int) (0.500 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-#define GY ( (int) (0.587 * 219 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-#define GV (-(int) (0.419 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-#define GU (-(int) (0.331 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-#define RY ( (int) (0.299 * 219 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-#define RV ( (int) (0.500 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-#define RU (-(int) (0.169 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-
-            y = av_clip_uint8((RY * r + GY * g + BY * b + ( 33 << (RGB2YUV_SHIFT - 1))) >> RGB2YUV_SHIFT);
-            u = av_clip_uint8((RU * r + GU * g + BU * b + (257 << (RGB2YUV_SHIFT - 1))) >> RGB2YUV_SHIFT);
-            v = av_clip_uint8((RV * r + GV * g + BV * b + (257 << (RGB2YUV_SHIFT - 1))) >> RGB2YUV_SHIFT);
-            c->pal_yuv[i]= y + (u<<8) + (v<<16) + ((unsigned)a<<24);
-
-            switch (c->dstFormat) {
-            case AV_PIX_FMT_BGR32:
-#if !HAVE_BIGENDIAN
-            case AV_PIX_FMT_RGB24:
-#endif
-                c->pal_rgb[i]=  r + (g<<8) + (b<<16) + ((unsigned)a<<24);
-                break;
-            case AV_PIX_FMT_BGR32_1:
-#if HAVE_BIGENDIAN
-            case AV_PIX_FMT_BGR24:
-#endif
-                c->pal_rgb[i]= a + (r<<8) + (g<<16) + ((unsigned)b<<24);
-                break;
-            case AV_PIX_FMT_RGB32_1:
-#if HAVE_BIGENDIAN
-            case AV_PIX_FMT_RGB24:
-#endif
-                c->pal_rgb[i]= a + (b<<8) + (g<<16) + ((unsigned)r<<24);
-                break;
-            case AV_PIX_FMT_RGB32:
-#if !HAVE_BIGENDIAN
-            case AV_PIX_FMT_BGR24:
-#endif
-            default:
-                c->pal_rgb[i]=  b + (g<<8) + (r<<16) + ((unsigned)a<<24);
-            }
-        }
-    }
+    if (usePal(c->srcFormat))
+        update_palette(c, (const uint32_t *)srcSlice[1]);
 
     if (c->src0Alpha && !c->dst0Alpha && isALPHA(c->dstFormat)) {
         uint8_t *base;
@@ -994,3 +1076,77 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
     av_free(rgb0_tmp);
     return ret;
 }
+
+int attribute_align_arg sws_scale_dst_slice(struct SwsContext *c,
+                                            const uint8_t *const src[],
+                                            const int srcStride[],
+                                            uint8_t *const dst[],
+                                            const int dstStride[],
+                                            int dstSliceY, int dstSliceH)
+{
+    const uint8_t *src2[4];
+    uint8_t *dst2[4];
+    int srcStride2[4];
+    int dstStride2[4];
+    int i, ret;
+
+    if (dstSliceY < 0 || dstSliceH < 0 || dstSliceY + dstSliceH > c->dstH ||
+        (dstSliceY & 15) || ((dstSliceH & 15) && dstSliceY + dstSliceH != c->dstH)) {
+        av_log(c, AV_LOG_ERROR, "Destination slice parameters %d, %d are invalid\n",
+               dstSliceY, dstSliceH);
+        return AVERROR(EINVAL);
+    }
+    if (!dst_slice_supported(c))
+        return AVERROR(ENOSYS);
+    if (!dstSliceH)
+        return 0;
+
+    if (!src || !srcStride || !dst || !dstStride) {
+        av_log(c, AV_LOG_ERROR, "One of the input parameters to sws_scale_dst_slice() is NULL, please check the calling code\n");
+        return AVERROR(EINVAL);
+    }
+    if (!check_image_pointers(src, c->srcFormat, srcStride)) {
+        av_log(c, AV_LOG_ERROR, "bad src image pointers\n");
+        return AVERROR(EINVAL);
+    }
+    if (!check_image_pointers((const uint8_t* const*)dst, c->dstFormat, dstStride)) {
+        av_log(c, AV_LOG_ERROR, "bad dst image pointers\n");
+        return AVERROR(EINVAL);
+    }
+
+    for (i = 0; i < 4; i++) {
+        src2[i]       = src[i];
+        dst2[i]       = dst[i];
+        srcStride2[i] = srcStride[i];
+        dstStride2[i] = dstStride[i];
+    }
+
+    if (usePal(c->srcFormat))
+        update_palette(c, (const uint32_t *)src[1]);
+
+    if (c->swscale == swscale) {
+        reset_ptr(src2, c->srcFormat);
+        reset_ptr((void*)dst2, c->dstFormat);
+
+        c->dstSliceStart = dstSliceY;
+        c->dstSliceEnd   = dstSliceY + dstSliceH;
+        ret = swscale(c, src2, srcStride2, 0, c->srcH, dst2, dstStride2);
+        c->dstSliceStart = c->dstSliceEnd = 0;
+    } else {
+        /* unscaled conversion: the source slice matches the destination one */
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(c->srcFormat);
+
+        for (i = 0; i < 4; i++) {
+            int vsub = (i == 1 || i == 2) ? desc->log2_chroma_h : 0;
+            if (!src2[i] || (i == 1 && usePal(c->srcFormat)))
+                continue;
+            src2[i] += (dstSliceY >> vsub) * srcStride2[i];
+        }
+        reset_ptr(src2, c->srcFormat);
+        reset_ptr((void*)dst2, c->dstFormat);
+
+        ret = c->swscale(c, src2, srcStride2, dstSliceY, dstSliceH, dst2, dstStride2);
+    }
+
+    return ret;
+}
@@ -218,6 +218,37 @@ int sws_scale(struct SwsContext *c, const uint8_t *const srcSlice[],
               const int srcStride[], int srcSliceY, int srcSliceH,
               uint8_t *const dst[], const int dstStride[]);
 
+/**
+ * Scale the whole source image, but only compute and write the band of
+ * destination rows [dstSliceY, dstSliceY + dstSliceH).
+ *
+ * Unlike sws_scale(), the bands can be computed in any order, and several
+ * SwsContexts initialized with the same parameters can fill different bands
+ * of the same destination image concurrently.
+ *
+ * @param c          the scaling context previously created with
+ *                   sws_getContext()
+ * @param src        the array containing the pointers to the planes of
+ *                   the whole source image
+ * @param srcStride  the array containing the strides for each plane of
+ *                   the source image
+ * @param dst        the array containing the pointers to the planes of
+ *                   the whole destination image
+ * @param dstStride  the array containing the strides for each plane of
+ *                   the destination image
+ * @param dstSliceY  the first destination row to write, must be a multiple
+ *                   of 16
+ * @param dstSliceH  the number of destination rows to write, must be a
+ *                   multiple of 16 unless the band ends at the last row
+ * @return           the height of the output band, AVERROR(ENOSYS) if the
+ *                   conversion carries state between rows (e.g. error
+ *                   diffusion dithering) and cannot be split, or another
+ *                   negative error code on failure
+ */
+int sws_scale_dst_slice(struct SwsContext *c, const uint8_t *const src[],
+                        const int srcStride[], uint8_t *const dst[],
+                        const int dstStride[], int dstSliceY, int dstSliceH);
+
 /**
  * @param dstRange flag indicating the while-black range of the output (1=jpeg / 0=mpeg)
  * @param srcRange flag indicating the while-black range of the input (1=jpeg / 0=mpeg)
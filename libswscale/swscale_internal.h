@@ -32,6 +32,7 @@
 #include "libavutil/pixfmt.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/ppc/util_altivec.h"
+#include "libavutil/slicethread.h"
 
 #define STR(s) AV_TOSTRING(s) // AV_STRINGIFY is too long
 
@@ -315,6 +316,22 @@ typedef struct SwsContext {
      * downscaling factor that needs to be supported in one scaler.
      */
     struct SwsContext *cascaded_context[3];
+
+    /**
+     * Slice threading: frames are split in horizontal bands of the
+     * destination, each thread scales one band with its own context.
+     */
+    int nb_threads;                 ///< number of threads requested by the user, 0 for automatic
+    AVSliceThread *slicethread;
+    struct SwsContext **slice_ctx;  ///< contexts used by the threads other than the calling one
+    int *slice_err;
+    int nb_slice_ctx;
+    /* frame being scaled by the threads */
+    const uint8_t *const *frame_src;
+    const int *frame_src_stride;
+    uint8_t *const *frame_dst;
+    const int *frame_dst_stride;
+
     int cascaded_tmpStride[4];
     uint8_t *cascaded_tmp[4];
     int cascaded1_tmpStride[4];
@@ -392,6 +409,8 @@ typedef struct SwsContext {
     int warned_unuseable_bilinear;
 
     int dstY;                     ///< Last destination vertical line output from last slice.
+    int dstSliceStart;            ///< First destination line to output with sws_scale_dst_slice().
+    int dstSliceEnd;              ///< Line after the last one to output with sws_scale_dst_slice(), 0 otherwise.
     int flags;                    ///< Flags passed by the user to select scaler algorithm, optimizations, subsampling, etc...
     void *yuvTable;             // pointer to the yuv->rgb table start so it can be freed()
     // alignment ensures the offset can be added in a single
@@ -844,6 +863,13 @@ void ff_sws_init_swscale_x86(SwsContext *c);
 void ff_sws_init_swscale_aarch64(SwsContext *c);
 void ff_sws_init_swscale_arm(SwsContext *c);
 
+/**
+ * Slice thread callback, scales one band of the frame set in the
+ * frame_* fields of the SwsContext passed as priv.
+ */
+void ff_sws_slice_worker(void *priv, int jobnr, int threadnr,
+                         int nb_jobs, int nb_threads);
+
 void ff_hyscale_fast_c(SwsContext *c, int16_t *dst, int dstWidth,
                        const uint8_t *src, int srcW, int xInc);
 void ff_hcscale_fast_c(SwsContext *c, int16_t *dst1, int16_t *dst2,
@@ -0,0 +1,136 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Check that scaling whole frames with several threads gives the same
+ * output as a single-threaded context, for a few conversions.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+
+static const struct {
+    enum AVPixelFormat src_fmt, dst_fmt;
+    int src_w, src_h, dst_w, dst_h;
+    int flags;
+} tests[] = {
+    { AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV420P, 352, 288, 200, 150, SWS_BICUBIC  },
+    { AV_PIX_FMT_YUV420P, AV_PIX_FMT_RGB24,   352, 288, 500, 400, SWS_LANCZOS  },
+    { AV_PIX_FMT_RGB24,   AV_PIX_FMT_YUV422P, 320, 240, 320, 240, SWS_BILINEAR },
+    { AV_PIX_FMT_YUV444P, AV_PIX_FMT_GRAY8,   176, 144, 704, 576, SWS_POINT    },
+    { AV_PIX_FMT_BGRA,    AV_PIX_FMT_YUVA420P,256, 256, 123,  77, SWS_BICUBIC | SWS_ACCURATE_RND },
+};
+
+static struct SwsContext *alloc_context(int i, int threads)
+{
+    struct SwsContext *c = sws_alloc_context();
+
+    if (!c)
+        return NULL;
+    av_opt_set_int(c, "srcw",       tests[i].src_w,   0);
+    av_opt_set_int(c, "srch",       tests[i].src_h,   0);
+    av_opt_set_int(c, "src_format", tests[i].src_fmt, 0);
+    av_opt_set_int(c, "dstw",       tests[i].dst_w,   0);
+    av_opt_set_int(c, "dsth",       tests[i].dst_h,   0);
+    av_opt_set_int(c, "dst_format", tests[i].dst_fmt, 0);
+    av_opt_set_int(c, "sws_flags",  tests[i].flags | SWS_BITEXACT, 0);
+    av_opt_set_int(c, "threads",    threads,          0);
+    if (sws_init_context(c, NULL, NULL) < 0) {
+        sws_freeContext(c);
+        return NULL;
+    }
+    return c;
+}
+
+static int run_test(int i, AVLFG *lfg)
+{
+    uint8_t *src[4], *ref[4], *dst[4];
+    int src_stride[4], ref_stride[4], dst_stride[4];
+    struct SwsContext *c1 = NULL, *c4 = NULL;
+    int ret, size, j, p;
+
+    ret = av_image_alloc(src, src_stride, tests[i].src_w, tests[i].src_h,
+                         tests[i].src_fmt, 16);
+    if (ret < 0)
+        return ret;
+    for (j = 0; j < ret; j++)
+        src[0][j] = av_lfg_get(lfg);
+
+    if ((ret = av_image_alloc(ref, ref_stride, tests[i].dst_w, tests[i].dst_h,
+                              tests[i].dst_fmt, 16)) < 0)
+        goto free_src;
+    if ((size = av_image_alloc(dst, dst_stride, tests[i].dst_w, tests[i].dst_h,
+                               tests[i].dst_fmt, 16)) < 0) {
+        ret = size;
+        goto free_ref;
+    }
+    memset(ref[0], 0, size);
+    memset(dst[0], 0, size);
+
+    c1 = alloc_context(i, 1);
+    c4 = alloc_context(i, 4);
+    if (!c1 || !c4) {
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+
+    sws_scale(c1, (const uint8_t * const *)src, src_stride, 0, tests[i].src_h,
+              ref, ref_stride);
+    sws_scale(c4, (const uint8_t * const *)src, src_stride, 0, tests[i].src_h,
+              dst, dst_stride);
+
+    ret = !!memcmp(ref[0], dst[0], size);
+    for (p = 0; p < 4; p++)
+        ret |= ref_stride[p] != dst_stride[p];
+
+    printf("%s %dx%d -> %s %dx%d: %s\n",
+           av_get_pix_fmt_name(tests[i].src_fmt), tests[i].src_w, tests[i].src_h,
+           av_get_pix_fmt_name(tests[i].dst_fmt), tests[i].dst_w, tests[i].dst_h,
+           ret ? "MISMATCH" : "identical");
+
+end:
+    sws_freeContext(c1);
+    sws_freeContext(c4);
+    av_freep(&dst[0]);
+free_ref:
+    av_freep(&ref[0]);
+free_src:
+    av_freep(&src[0]);
+    return ret;
+}
+
+int main(void)
+{
+    AVLFG lfg;
+    int i, ret = 0;
+
+    av_lfg_init(&lfg, 0xdeadbeef);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(tests); i++)
+        ret |= run_test(i, &lfg) != 0;
+
+    return ret;
+}
@@ -850,6 +850,15 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
     const AVPixFmtDescriptor *desc_dst;
     const AVPixFmtDescriptor *desc_src;
     int need_reinit = 0;
+    int i;
+
+    for (i = 0; i < c->nb_slice_ctx; i++) {
+        int ret = sws_setColorspaceDetails(c->slice_ctx[i], inv_table, srcRange,
+                                           table, dstRange,
+                                           brightness, contrast, saturation);
+        if (ret < 0)
+            return ret;
+    }
 
     handle_formats(c);
     desc_dst = av_pix_fmt_desc_get(c->dstFormat);
@@ -1146,6 +1155,51 @@ static enum AVPixelFormat alphaless_fmt(enum AVPixelFormat fmt)
     }
 }
 
+static av_cold int context_init_threaded(SwsContext *c,
+                                        SwsFilter *src_filter, SwsFilter *dst_filter)
+{
+    int ret, i;
+
+    ret = avpriv_slicethread_create(&c->slicethread, (void*)c,
+                                    ff_sws_slice_worker, NULL,
+                                    c->nb_threads ? c->nb_threads : av_cpu_count());
+    if (ret == AVERROR(ENOSYS) || ret == AVERROR(EINVAL)) {
+        /* no threading support in this build */
+        c->nb_threads = 1;
+        return 0;
+    } else if (ret < 0)
+        return ret;
+
+    c->nb_threads = ret;
+    if (c->nb_threads == 1) {
+        avpriv_slicethread_free(&c->slicethread);
+        return 0;
+    }
+
+    c->slice_ctx = av_mallocz_array(c->nb_threads - 1, sizeof(*c->slice_ctx));
+    c->slice_err = av_mallocz_array(c->nb_threads,     sizeof(*c->slice_err));
+    if (!c->slice_ctx || !c->slice_err)
+        return AVERROR(ENOMEM);
+
+    /* the options are copied before this context modifies them in its
+     * own initialization */
+    for (i = 0; i < c->nb_threads - 1; i++) {
+        c->slice_ctx[i] = sws_alloc_context();
+        if (!c->slice_ctx[i])
+            return AVERROR(ENOMEM);
+        c->nb_slice_ctx++;
+
+        if ((ret = av_opt_copy(c->slice_ctx[i], c)) < 0)
+            return ret;
+        c->slice_ctx[i]->nb_threads = 1;
+
+        if ((ret = sws_init_context(c->slice_ctx[i], src_filter, dst_filter)) < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
 av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                              SwsFilter *dstFilter)
 {
@@ -1172,6 +1226,12 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
     if (!rgb15to16)
         ff_sws_rgb2rgb_init();
 
+    if (c->nb_threads != 1) {
+        ret = context_init_threaded(c, srcFilter, dstFilter);
+        if (ret < 0)
+            return ret;
+    }
+
     unscaled = (srcW == dstW && srcH == dstH);
 
     c->srcRange |= handle_jpeg(&c->srcFormat);
@@ -2279,6 +2339,12 @@ void sws_freeContext(SwsContext *c)
     if (!c)
         return;
 
+    avpriv_slicethread_free(&c->slicethread);
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        sws_freeContext(c->slice_ctx[i]);
+    av_freep(&c->slice_ctx);
+    av_freep(&c->slice_err);
+
     for (i = 0; i < 4; i++)
         av_freep(&c->dither_error[i]);
 
@@ -53,6 +53,35 @@ static void check_decorrelate(uint8_t **ref_dst, uint8_t **ref_src, uint8_t **ne
     bench_new(new_dst, (int32_t **)new_src, channels, BUF_SIZE / sizeof(int32_t), 8);
 }
 
+static void check_rice_sums(FLACDSPContext *h)
+{
+    LOCAL_ALIGNED_16(uint32_t, udata, [BUF_SIZE]);
+    uint64_t ref_sums[BUF_SIZE], new_sums[BUF_SIZE];
+    static const int psizes[] = { 1, 3, 4, 16, 37, 256 };
+    int i, j, k;
+
+    declare_func(void, uint64_t *sums, const uint32_t *udata, int psize,
+                 int parts, int k);
+
+    for (i = 0; i < BUF_SIZE; i++)
+        udata[i] = rnd();
+
+    for (i = 0; i < FF_ARRAY_ELEMS(psizes); i++) {
+        if (check_func(h->rice_sums, "flac_rice_sums_%d", psizes[i])) {
+            int parts = BUF_SIZE / psizes[i];
+            for (k = 0; k < 32; k += 5) {
+                for (j = 0; j < parts; j++)
+                    ref_sums[j] = new_sums[j] = 0;
+                call_ref(ref_sums, udata, psizes[i], parts, k);
+                call_new(new_sums, udata, psizes[i], parts, k);
+                if (memcmp(ref_sums, new_sums, parts * sizeof(*ref_sums)))
+                    fail();
+            }
+            bench_new(new_sums, udata, psizes[i], parts, 0);
+        }
+    }
+}
+
 void checkasm_check_flacdsp(void)
 {
     LOCAL_ALIGNED_16(uint8_t, ref_dst, [BUF_SIZE*MAX_CHANNELS]);
@@ -87,4 +116,8 @@ void checkasm_check_flacdsp(void)
     }
 
     report("decorrelate");
+
+    ff_flacdsp_init(&h, AV_SAMPLE_FMT_S16, 2, 16);
+    check_rice_sums(&h);
+    report("rice_sums");
 }
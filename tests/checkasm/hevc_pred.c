@@ -0,0 +1,152 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/intreadwrite.h"
+
+#include "libavcodec/hevcpred.h"
+
+#include "checkasm.h"
+
+#define EDGE_SIZE (2 * 32 + 16)
+#define BUF_SIZE  (32 * 32 * 2)
+
+#define randomize_edge(buf, bit_depth)                                  \
+    do {                                                                \
+        int j;                                                          \
+        for (j = 0; j < EDGE_SIZE; j++) {                               \
+            if (bit_depth == 8)                                         \
+                buf[j] = rnd();                                         \
+            else                                                        \
+                AV_WN16A(buf + 2 * j, rnd() & ((1 << bit_depth) - 1));  \
+        }                                                               \
+    } while (0)
+
+static void check_pred_planar(HEVCPredContext *h, uint8_t *dst0, uint8_t *dst1,
+                              const uint8_t *top, const uint8_t *left,
+                              int bit_depth)
+{
+    int i;
+
+    for (i = 2; i <= 5; i++) {
+        int block_size = 1 << i;
+        ptrdiff_t stride = 32; // in pixels
+        declare_func(void, uint8_t *src, const uint8_t *top,
+                     const uint8_t *left, ptrdiff_t stride);
+
+        if (check_func(h->pred_planar[i - 2], "hevc_pred_planar_%dx%d_%d",
+                       block_size, block_size, bit_depth)) {
+            memset(dst0, 0, BUF_SIZE);
+            memset(dst1, 0, BUF_SIZE);
+            call_ref(dst0, top, left, stride);
+            call_new(dst1, top, left, stride);
+            if (memcmp(dst0, dst1, BUF_SIZE))
+                fail();
+            bench_new(dst1, top, left, stride);
+        }
+    }
+}
+
+static void check_pred_dc(HEVCPredContext *h, uint8_t *dst0, uint8_t *dst1,
+                          const uint8_t *top, const uint8_t *left,
+                          int bit_depth)
+{
+    int i, c_idx;
+
+    for (i = 2; i <= 5; i++) {
+        int block_size = 1 << i;
+        ptrdiff_t stride = 32; // in pixels
+        declare_func(void, uint8_t *src, const uint8_t *top,
+                     const uint8_t *left, ptrdiff_t stride,
+                     int log2_size, int c_idx);
+
+        if (check_func(h->pred_dc, "hevc_pred_dc_%dx%d_%d",
+                       block_size, block_size, bit_depth)) {
+            for (c_idx = 0; c_idx < 2; c_idx++) {
+                memset(dst0, 0, BUF_SIZE);
+                memset(dst1, 0, BUF_SIZE);
+                call_ref(dst0, top, left, stride, i, c_idx);
+                call_new(dst1, top, left, stride, i, c_idx);
+                if (memcmp(dst0, dst1, BUF_SIZE))
+                    fail();
+            }
+            bench_new(dst1, top, left, stride, i, 0);
+        }
+    }
+}
+
+static void check_pred_angular(HEVCPredContext *h, uint8_t *dst0, uint8_t *dst1,
+                               const uint8_t *top, const uint8_t *left,
+                               int bit_depth)
+{
+    int i, c_idx, mode;
+
+    for (i = 2; i <= 5; i++) {
+        int block_size = 1 << i;
+        ptrdiff_t stride = 32; // in pixels
+        declare_func(void, uint8_t *src, const uint8_t *top,
+                     const uint8_t *left, ptrdiff_t stride,
+                     int c_idx, int mode);
+
+        if (check_func(h->pred_angular[i - 2], "hevc_pred_angular_%dx%d_%d",
+                       block_size, block_size, bit_depth)) {
+            for (mode = 2; mode <= 34; mode++) {
+                for (c_idx = 0; c_idx < 2; c_idx++) {
+                    memset(dst0, 0, BUF_SIZE);
+                    memset(dst1, 0, BUF_SIZE);
+                    call_ref(dst0, top, left, stride, c_idx, mode);
+                    call_new(dst1, top, left, stride, c_idx, mode);
+                    if (memcmp(dst0, dst1, BUF_SIZE))
+                        fail();
+                }
+            }
+            bench_new(dst1, top, left, stride, 0, 14);
+        }
+    }
+}
+
+void checkasm_check_hevc_pred(void)
+{
+    LOCAL_ALIGNED_32(uint8_t, top_buf,  [EDGE_SIZE * 2]);
+    LOCAL_ALIGNED_32(uint8_t, left_buf, [EDGE_SIZE * 2]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [BUF_SIZE]);
+    int bit_depth;
+
+    for (bit_depth = 8; bit_depth <= 10; bit_depth++) {
+        HEVCPredContext h;
+        /* top[-1] and left[-1] hold the corner sample */
+        int offset = 1 << (bit_depth > 8);
+        const uint8_t *top  = top_buf  + offset;
+        const uint8_t *left = left_buf + offset;
+
+        ff_hevc_pred_init(&h, bit_depth);
+        randomize_edge(top_buf,  bit_depth);
+        randomize_edge(left_buf, bit_depth);
+        if (bit_depth == 8)
+            left_buf[0] = top_buf[0];
+        else
+            AV_WN16A(left_buf, AV_RN16A(top_buf));
+
+        check_pred_planar(&h, dst0, dst1, top, left, bit_depth);
+        check_pred_dc(&h, dst0, dst1, top, left, bit_depth);
+        check_pred_angular(&h, dst0, dst1, top, left, bit_depth);
+    }
+    report("pred");
+}
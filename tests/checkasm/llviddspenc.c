@@ -0,0 +1,81 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+
+#include "libavcodec/lossless_videoencdsp.h"
+
+#include "checkasm.h"
+
+#define randomize_buffers(buf, size)     \
+    do {                                 \
+        int j;                           \
+        for (j = 0; j < size; j++)       \
+            buf[j] = rnd() & 0xFF;       \
+    } while (0)
+
+static void check_sub_paeth_pred(LLVidEncDSPContext c, int width)
+{
+    static const int bpps[] = { 1, 2, 3, 4, 6, 8 };
+    uint8_t *src  = av_malloc(width + 8);
+    uint8_t *top  = av_malloc(width + 8);
+    uint8_t *dst0 = av_mallocz(width);
+    uint8_t *dst1 = av_mallocz(width);
+    int i;
+    declare_func(void, uint8_t *dst, const uint8_t *src, const uint8_t *top,
+                 intptr_t w, int bpp);
+
+    if (!src || !top || !dst0 || !dst1)
+        fail();
+
+    for (i = 0; i < FF_ARRAY_ELEMS(bpps); i++) {
+        int bpp = bpps[i];
+
+        randomize_buffers(src, width + 8);
+        randomize_buffers(top, width + 8);
+
+        if (check_func(c.sub_paeth_pred, "sub_paeth_pred_%d", bpp)) {
+            call_ref(dst0, src + 8, top + 8, width, bpp);
+            call_new(dst1, src + 8, top + 8, width, bpp);
+            if (memcmp(dst0, dst1, width))
+                fail();
+            bench_new(dst1, src + 8, top + 8, width, bpp);
+        }
+    }
+
+    av_free(src);
+    av_free(top);
+    av_free(dst0);
+    av_free(dst1);
+}
+
+void checkasm_check_llviddspenc(void)
+{
+    LLVidEncDSPContext c;
+    int width = 16 * av_clip(rnd(), 16, 128);
+
+    ff_llvidencdsp_init(&c);
+
+    check_sub_paeth_pred(c, width);
+
+    report("sub_paeth_pred");
+}
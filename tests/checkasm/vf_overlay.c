@@ -0,0 +1,86 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/vf_overlay.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+
+#define WIDTH 255
+#define ALINESIZE (2 * WIDTH + 32)
+
+#define randomize_buffers(buf, size)      \
+    do {                                  \
+        int j;                            \
+        for (j = 0; j < size; j++)        \
+            buf[j] = rnd();               \
+    } while (0)
+
+static void check_blend_row(const OverlayDSPContext *dsp, int type,
+                            const char *name)
+{
+    LOCAL_ALIGNED_32(uint8_t, dst0, [WIDTH + 32]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [WIDTH + 32]);
+    LOCAL_ALIGNED_32(uint8_t, orig, [WIDTH + 32]);
+    LOCAL_ALIGNED_32(uint8_t, src,  [WIDTH + 32]);
+    LOCAL_ALIGNED_32(uint8_t, alpha, [2 * ALINESIZE]);
+    static const int widths[] = { 1, 7, 16, 33, WIDTH };
+    int i;
+
+    declare_func(int, uint8_t *d, const uint8_t *s, const uint8_t *a,
+                 int w, ptrdiff_t alinesize);
+
+    if (check_func(dsp->blend_row[type], "overlay_row_%s", name)) {
+        for (i = 0; i < FF_ARRAY_ELEMS(widths); i++) {
+            int w = widths[i], ret0, ret1;
+
+            randomize_buffers(orig, WIDTH + 32);
+            memcpy(dst0, orig, WIDTH + 32);
+            memcpy(dst1, orig, WIDTH + 32);
+            randomize_buffers(src, WIDTH + 32);
+            randomize_buffers(alpha, 2 * ALINESIZE);
+            /* make sure the fully transparent and opaque cases are tested */
+            alpha[0] = 0;
+            alpha[1] = 255;
+
+            ret0 = call_ref(dst0, src, alpha, w, ALINESIZE);
+            ret1 = call_new(dst1, src, alpha, w, ALINESIZE);
+            /* the optimized version may leave the last pixels to the caller,
+             * but must not touch them */
+            if (ret0 != w || ret1 < 0 || ret1 > w ||
+                memcmp(dst0, dst1, ret1) ||
+                memcmp(dst1 + ret1, orig + ret1, WIDTH + 32 - ret1))
+                fail();
+        }
+        bench_new(dst1, src, alpha, WIDTH, ALINESIZE);
+    }
+}
+
+void checkasm_check_overlay(void)
+{
+    OverlayDSPContext dsp;
+
+    ff_overlay_dsp_init(&dsp);
+
+    check_blend_row(&dsp, OVERLAY_ROW_444, "444");
+    check_blend_row(&dsp, OVERLAY_ROW_422, "422");
+    check_blend_row(&dsp, OVERLAY_ROW_420, "420");
+    report("blend_row");
+}
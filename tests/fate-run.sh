@@ -116,6 +116,38 @@ probegaplessinfo(){
     tail -n 9 "$framefile1"
 }
 
+probecache(){
+    cachedir="${outdir}/${test}.cache"
+    missfile="${outdir}/${test}.miss"
+    logfile="${outdir}/${test}.log"
+    cleanfiles="$cleanfiles $missfile $logfile"
+    rm -rf "$cachedir"
+    mkdir -p "$cachedir"
+    probe="ffprobe${PROGSUF} -bitexact -show_streams -show_format -probe_cache_dir $cachedir"
+    run $probe -v 0 "$@" > "$missfile"
+    run $probe -v verbose "$@" 2> "$logfile" | diff -u "$missfile" - || return
+    grep -q "Using probe cache entry" "$logfile" || echo "probe cache entry not used"
+    rm -rf "$cachedir"
+    cat "$missfile"
+}
+
+compact_index(){
+    src=$1
+    seek=$2
+    for mode in 0 1; do
+        out="${outdir}/${test}-${mode}"
+        cleanfiles="$cleanfiles ${out}.probe ${out}.crc ${out}.log"
+        run ffprobe${PROGSUF} -bitexact -show_packets -print_format compact -v trace \
+            -compact_index $mode $src > "${out}.probe" 2> "${out}.log" || return
+        ffmpeg -compact_index $mode -ss $seek -i $src -c copy -flags +bitexact -fflags +bitexact \
+            -f framecrc - >> "${out}.probe" || return
+    done
+    grep -q "compact index" "${outdir}/${test}-0.log" && echo "compact index used without compact_index"
+    grep -q "compact index" "${outdir}/${test}-1.log" || echo "compact index not used"
+    diff -u "${outdir}/${test}-0.probe" "${outdir}/${test}-1.probe" || return
+    cat "${outdir}/${test}-1.probe"
+}
+
 ffmpeg(){
     dec_opts="-hwaccel $hwaccel -threads $threads -thread_type $thread_type"
     ffmpeg_args="-nostdin -nostats -cpuflags $cpuflags"
@@ -222,6 +254,89 @@ transcode(){
         -f framecrc - || return
 }
 
+# Mux segments with and without chunk_opt, check that the chunked segments
+# carry the same packets, and print them.
+chunked_segments(){
+    seg_fmt=$1
+    chunk_opt=$2
+    shift 2
+    for mode in whole chunked; do
+        segdir="${outdir}/${test}-${mode}"
+        opts=
+        test $mode = chunked && opts=$chunk_opt
+        rm -rf "$segdir"
+        mkdir -p "$segdir"
+        case $seg_fmt in
+        dash)
+            ffmpeg "$@" $opts -f dash $(target_path $segdir)/out.mpd || return
+            segfile="${segdir}.mp4"
+            cat "$segdir"/init-stream0.m4s $(find "$segdir" -name 'chunk-stream0-*.m4s' | sort) > "$segfile"
+            ;;
+        hls)
+            ffmpeg "$@" $opts -hls_fmp4_init_filename $(target_path $segdir)/init.mp4 \
+                -f hls $(target_path $segdir)/out.m3u8 || return
+            segfile="${segdir}/out.m3u8"
+            if test -f "$segdir"/init.mp4; then
+                cat "$segdir"/init.mp4 $(find "$segdir" -name 'out*.ts' | sort) > "${segdir}.mp4"
+            fi
+            if test $mode = chunked; then
+                # every version of the playlist, written to a pipe, announces
+                # the segment being produced
+                ffmpeg "$@" $opts -hls_fmp4_init_filename $(target_path $segdir)/init.mp4 \
+                    -hls_segment_filename $(target_path $segdir)/prefetch%d.ts -f hls pipe:1 |
+                    grep '^#EXT-X-PREFETCH:' | sed 's,:.*/,:,' | uniq > "${segdir}.prefetch" || return
+                cleanfiles="$cleanfiles ${segdir}.prefetch"
+            fi
+            ;;
+        esac
+        ffmpeg -flags +bitexact -i $(target_path $segfile) -c copy -flags +bitexact -fflags +bitexact \
+            -f framecrc - | cut -d, -f4- > "${segdir}.crc" || return
+        cleanfiles="$cleanfiles ${segdir}.crc ${segdir}.mp4"
+    done
+    diff -u "${outdir}/${test}-whole.crc" "${outdir}/${test}-chunked.crc" || return
+    if test -f "${outdir}/${test}-whole.mp4"; then
+        echo "fragments: $(grep -a -o moof "${outdir}/${test}-whole.mp4" | wc -l)" \
+             "-> $(grep -a -o moof "${outdir}/${test}-chunked.mp4" | wc -l)"
+    fi
+    test $seg_fmt = hls && cat "${outdir}/${test}-chunked.prefetch"
+    cat "${outdir}/${test}-chunked.crc"
+    rm -rf "${outdir}/${test}-whole" "${outdir}/${test}-chunked"
+}
+
+slice_roundtrip(){
+    enc_fmt=$1
+    slice_opt=$2
+    shift 2
+    for mode in single sliced; do
+        encfile="${outdir}/${test}-${mode}.${enc_fmt}"
+        opts=
+        test $mode = sliced && opts=$slice_opt
+        ffmpeg "$@" $opts -f $enc_fmt -y $(target_path $encfile) || return
+        ffmpeg -flags +bitexact -i $(target_path $encfile) -flags +bitexact -fflags +bitexact \
+            -f framecrc - > "${outdir}/${test}-${mode}.crc" || return
+        cleanfiles="$cleanfiles $encfile ${outdir}/${test}-${mode}.crc"
+    done
+    cmp -s "${outdir}/${test}-single.${enc_fmt}" "${outdir}/${test}-sliced.${enc_fmt}" &&
+        { echo "slices were not used"; return 1; }
+    diff -u "${outdir}/${test}-single.crc" "${outdir}/${test}-sliced.crc" || return
+    cat "${outdir}/${test}-sliced.crc"
+}
+
+mmap_copy(){
+    srcfile=$1
+    shift
+    for mode in read mmap; do
+        opts=
+        test $mode = mmap && opts="-mmap 1"
+        ffmpeg -v verbose $opts -i $srcfile -c copy "$@" -f framecrc \
+            $(target_path ${outdir}/${test}-${mode}.crc) 2> "${outdir}/${test}-${mode}.log" || return
+        cleanfiles="$cleanfiles ${outdir}/${test}-${mode}.crc ${outdir}/${test}-${mode}.log"
+    done
+    diff -u "${outdir}/${test}-read.crc" "${outdir}/${test}-mmap.crc" || return
+    grep -o "[0-9]* packets referenced the mapping" "${outdir}/${test}-mmap.log" || return
+    cat "${outdir}/${test}-mmap.crc"
+}
+
 lavffatetest(){
     t="${test#lavf-fate-}"
     ref=${base}/ref/lavf-fate/$t
@@ -237,6 +237,14 @@ fate-aac-pred-encode: CMP_TARGET = 841
 fate-aac-pred-encode: FUZZ = 12
 fate-aac-pred-encode: SIZE_TOLERANCE = 3560
 
+# 5.1 encode, the element search must give the same output with any number of threads
+AAC_MULTICHANNEL_SRC = "aevalsrc=sin(440*2*PI*t)+0.3*random(0)|sin(660*2*PI*t)*0.5+0.2*random(1)|0.7*sin(220*2*PI*t)|0.4*random(2)|sin(1000*2*PI*t)*cos(3*t)|0.5*sin(55*2*PI*t):s=48000:d=3"
+FATE_AAC_ENCODE_LAVFI += fate-aac-multichannel-encode fate-aac-multichannel-encode-threads2 fate-aac-multichannel-encode-threads4
+fate-aac-multichannel-encode: CMD = md5 -f lavfi -i $(AAC_MULTICHANNEL_SRC) -c:a aac -threads 1 -flags +bitexact -fflags +bitexact -f adts
+fate-aac-multichannel-encode-threads2: CMD = md5 -f lavfi -i $(AAC_MULTICHANNEL_SRC) -c:a aac -threads 2 -flags +bitexact -fflags +bitexact -f adts
+fate-aac-multichannel-encode-threads4: CMD = md5 -f lavfi -i $(AAC_MULTICHANNEL_SRC) -c:a aac -threads 4 -flags +bitexact -fflags +bitexact -f adts
+fate-aac-multichannel-encode-threads%: REF = $(SRC_PATH)/tests/ref/fate/aac-multichannel-encode
+
 FATE_AAC_LATM += fate-aac-latm_000000001180bc60
 fate-aac-latm_000000001180bc60: CMD = pcm -i $(TARGET_SAMPLES)/aac/latm_000000001180bc60.mpg
 fate-aac-latm_000000001180bc60: REF = $(SAMPLES)/aac/latm_000000001180bc60.s16
@@ -260,9 +268,12 @@ $(FATE_AAC_ALL): FUZZ = 2
 
 FATE_AAC_ENCODE-$(call ENCMUX, AAC, ADTS) += $(FATE_AAC_ENCODE)
 
+FATE_AAC_ENCODE_LAVFI-$(call ALLYES, LAVFI_INDEV AEVALSRC_FILTER AAC_ENCODER ADTS_MUXER) += $(FATE_AAC_ENCODE_LAVFI)
+
 FATE_AAC_BSF-$(call ALLYES, AAC_DEMUXER AAC_ADTSTOASC_BSF MATROSKA_MUXER) += fate-aac-autobsf-adtstoasc
 
 FATE_SAMPLES_FFMPEG += $(FATE_AAC_ALL) $(FATE_AAC_ENCODE-yes) $(FATE_AAC_BSF-yes)
+FATE_FFMPEG += $(FATE_AAC_ENCODE_LAVFI-yes)
 
-fate-aac: $(FATE_AAC_ALL) $(FATE_AAC_ENCODE) $(FATE_AAC_BSF-yes)
+fate-aac: $(FATE_AAC_ALL) $(FATE_AAC_ENCODE) $(FATE_AAC_ENCODE_LAVFI-yes) $(FATE_AAC_BSF-yes)
 fate-aac-latm: $(FATE_AAC_LATM-yes)
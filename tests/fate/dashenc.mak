@@ -0,0 +1,8 @@
+# Chunks of 0.5s written out as separate fragments while the 2s segments are
+# produced.
+FATE_DASHENC-$(call ALLYES, DASH_MUXER MP4_MUXER MOV_DEMUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-dashenc-chunked
+fate-dashenc-chunked: CMD = chunked_segments dash "-seg_chunk_duration 500000" -f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t)::d=10" \
+                            -codec:a mp2fixed -flags +bitexact -fflags +bitexact -min_seg_duration 2000000
+
+FATE_FFMPEG += $(FATE_DASHENC-yes)
+fate-dashenc: $(FATE_DASHENC-yes)
@@ -10,6 +10,13 @@ FATE_MAPCHAN-$(CONFIG_CHANNELMAP_FILTER) += fate-mapchan-silent-mono
 fate-mapchan-silent-mono: tests/data/asynth-22050-1.wav
 fate-mapchan-silent-mono: CMD = md5 -i $(TARGET_PATH)/tests/data/asynth-22050-1.wav -map_channel -1 -map_channel 0.0.0 -fflags +bitexact -f wav
 
+# -threaded_encoding gives the same output, here with both outputs encoded
+# concurrently.
+FATE_MAPCHAN-$(CONFIG_CHANNELMAP_FILTER) += fate-mapchan-6ch-extract-2-threaded
+fate-mapchan-6ch-extract-2-threaded: tests/data/asynth-22050-6.wav
+fate-mapchan-6ch-extract-2-threaded: CMD = ffmpeg -threaded_encoding -i $(TARGET_PATH)/tests/data/asynth-22050-6.wav -map_channel 0.0.0 -fflags +bitexact -f wav md5: -map_channel 0.0.1 -fflags +bitexact -f wav md5:
+fate-mapchan-6ch-extract-2-threaded: REF = $(SRC_PATH)/tests/ref/fate/mapchan-6ch-extract-2
+
 FATE_MAPCHAN = $(FATE_MAPCHAN-yes)
 
 FATE_FFMPEG += $(FATE_MAPCHAN)
@@ -25,6 +32,10 @@ fate-ffmpeg-filter_colorkey: CMD = framecrc -idct simple -fflags +bitexact -flag
 FATE_FFMPEG-$(CONFIG_COLOR_FILTER) += fate-ffmpeg-lavfi
 fate-ffmpeg-lavfi: CMD = framecrc -lavfi color=d=1:r=5 -fflags +bitexact
 
+FATE_FFMPEG-$(CONFIG_COLOR_FILTER) += fate-ffmpeg-lavfi-threaded
+fate-ffmpeg-lavfi-threaded: CMD = framecrc -threaded_encoding -lavfi color=d=1:r=5 -fflags +bitexact
+fate-ffmpeg-lavfi-threaded: REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-lavfi
+
 FATE_SAMPLES_FFMPEG-$(CONFIG_RAWVIDEO_DEMUXER) += fate-force_key_frames
 fate-force_key_frames: tests/data/vsynth_lena.yuv
 fate-force_key_frames: CMD = enc_dec \
@@ -51,6 +62,13 @@ fate-unknown_layout-ac3: CMD = md5 \
   -guess_layout_max 0 -f s16le -ac 1 -ar 44100 -i $(TARGET_PATH)/$(AREF) \
   -f ac3 -flags +bitexact -c ac3_fixed
 
+FATE_FFMPEG-$(call ALLYES, PCM_S16LE_DEMUXER AC3_MUXER PCM_S16LE_DECODER AC3_FIXED_ENCODER) += fate-unknown_layout-ac3-threaded
+fate-unknown_layout-ac3-threaded: $(AREF)
+fate-unknown_layout-ac3-threaded: CMD = md5 -threaded_encoding \
+  -guess_layout_max 0 -f s16le -ac 1 -ar 44100 -i $(TARGET_PATH)/$(AREF) \
+  -f ac3 -flags +bitexact -c ac3_fixed
+fate-unknown_layout-ac3-threaded: REF = $(SRC_PATH)/tests/ref/fate/unknown_layout-ac3
+
 
 FATE_STREAMCOPY-$(call ALLYES, EAC3_DEMUXER MOV_MUXER) += fate-copy-trac3074
 fate-copy-trac3074: $(TARGET_SAMPLES)/eac3/csi_miami_stereo_128_spx.eac3
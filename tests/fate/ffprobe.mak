@@ -29,6 +29,17 @@ FATE_FFPROBE-$(CONFIG_AVDEVICE) += fate-ffprobe_xml
 fate-ffprobe_xml: $(FFPROBE_TEST_FILE)
 fate-ffprobe_xml: CMD = run $(FFPROBE_COMMAND) -of xml
 
+# The streams are decoded in parallel by avformat_find_stream_info(), the
+# output must be identical to the default.
+FATE_FFPROBE-$(CONFIG_AVDEVICE) += fate-ffprobe_info_threads
+fate-ffprobe_info_threads: $(FFPROBE_TEST_FILE)
+fate-ffprobe_info_threads: CMD = run $(FFPROBE_COMMAND) -of default -info_threads 4
+fate-ffprobe_info_threads: REF = $(SRC_PATH)/tests/ref/fate/ffprobe_default
+
+FATE_FFPROBE-$(CONFIG_AVDEVICE) += fate-ffprobe_probe_cache
+fate-ffprobe_probe_cache: $(FFPROBE_TEST_FILE)
+fate-ffprobe_probe_cache: CMD = probecache $(FFPROBE_TEST_FILE)
+
 FATE_FFPROBE += $(FATE_FFPROBE-yes)
 
 fate-ffprobe: $(FATE_FFPROBE)
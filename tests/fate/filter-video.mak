@@ -65,6 +65,10 @@ fate-filter-paletteuse-sierra2_4a: CMD = framecrc -i $(TARGET_SAMPLES)/filter/an
 fate-filter-paletteuse: $(FATE_FILTER_PALETTEUSE)
 FATE_FILTER_SAMPLES-$(call ALLYES, PALETTEUSE_FILTER MATROSKA_DEMUXER H264_DECODER IMAGE2_DEMUXER PNG_DECODER) += $(FATE_FILTER_PALETTEUSE)
 
+FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER SPLIT_FILTER HFLIP_FILTER VFLIP_FILTER EDGEDETECT_FILTER NEGATE_FILTER TRANSPOSE_FILTER GRADFUN_FILTER) += fate-filter-graph-threads
+fate-filter-graph-threads: libavfilter/tests/graphthreads$(EXESUF)
+fate-filter-graph-threads: CMD = run libavfilter/tests/graphthreads
+
 FATE_FILTER-$(call ALLYES, AVDEVICE LIFE_FILTER) += fate-filter-lavd-life
 fate-filter-lavd-life: CMD = framecrc -f lavfi -i life=s=40x40:r=5:seed=42:mold=64:ratio=0.1:death_color=red:life_color=green -t 2
 
@@ -616,6 +620,35 @@ fate-filter-pixfmts-pullup: CMD = pixfmts "" "telecine," 25
 FATE_FILTER_PIXFMTS-$(CONFIG_ROTATE_FILTER) += fate-filter-pixfmts-rotate
 fate-filter-pixfmts-rotate: CMD = pixfmts "2*PI*n/50"
 
+# The threaded scale tests share the reference of the single-threaded run,
+# the output of both must be identical.
+SCALE_THREADS_DOWN = scale=w=200:h=150:flags=bicubic+accurate_rnd+bitexact
+SCALE_THREADS_UP   = scale=w=500:h=400:flags=lanczos+accurate_rnd+bitexact,format=rgb24
+SCALE_THREADS_CMD  = framecrc -flags bitexact -s 352x288 -pix_fmt yuv420p -i tests/data/vsynth1.yuv -frames:v 5
+
+FATE_FILTER_VSYNTH-$(CONFIG_SCALE_FILTER) += fate-filter-scale-down fate-filter-scale-down-threads
+fate-filter-scale-down fate-filter-scale-down-threads: tests/data/vsynth1.yuv
+fate-filter-scale-down: CMD = $(SCALE_THREADS_CMD) -filter_threads 1 -vf $(SCALE_THREADS_DOWN)
+fate-filter-scale-down-threads: CMD = $(SCALE_THREADS_CMD) -filter_threads 4 -vf $(SCALE_THREADS_DOWN)
+fate-filter-scale-down-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-scale-down
+
+FATE_FILTER_VSYNTH-$(call ALLYES, SCALE_FILTER FORMAT_FILTER) += fate-filter-scale-up-rgb fate-filter-scale-up-rgb-threads
+fate-filter-scale-up-rgb fate-filter-scale-up-rgb-threads: tests/data/vsynth1.yuv
+fate-filter-scale-up-rgb: CMD = $(SCALE_THREADS_CMD) -filter_threads 1 -vf $(SCALE_THREADS_UP)
+fate-filter-scale-up-rgb-threads: CMD = $(SCALE_THREADS_CMD) -filter_threads 4 -vf $(SCALE_THREADS_UP)
+fate-filter-scale-up-rgb-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-scale-up-rgb
+
+# The branches of the graph run concurrently with graph threading, the output
+# must be identical to the serial run.
+GRAPH_THREADS_GRAPH = split[a][b];[a]hflip,avgblur=2[a1];[b]vflip,edgedetect[b1];[a1][b1]hstack
+GRAPH_THREADS_CMD   = framecrc -flags bitexact -s 352x288 -pix_fmt yuv420p -i tests/data/vsynth1.yuv -frames:v 5 -filter_complex_threads 4
+
+FATE_FILTER_VSYNTH-$(call ALLYES, SPLIT_FILTER HFLIP_FILTER AVGBLUR_FILTER VFLIP_FILTER EDGEDETECT_FILTER HSTACK_FILTER) += fate-filter-graph-threads-ffmpeg fate-filter-graph-threads-ffmpeg-serial
+fate-filter-graph-threads-ffmpeg fate-filter-graph-threads-ffmpeg-serial: tests/data/vsynth1.yuv
+fate-filter-graph-threads-ffmpeg-serial: CMD = $(GRAPH_THREADS_CMD) -filter_thread_type slice -filter_complex "$(GRAPH_THREADS_GRAPH)"
+fate-filter-graph-threads-ffmpeg: CMD = $(GRAPH_THREADS_CMD) -filter_thread_type slice+graph -filter_complex "$(GRAPH_THREADS_GRAPH)"
+fate-filter-graph-threads-ffmpeg: REF = $(SRC_PATH)/tests/ref/fate/filter-graph-threads-ffmpeg-serial
+
 FATE_FILTER_PIXFMTS-$(CONFIG_SCALE_FILTER) += fate-filter-pixfmts-scale
 fate-filter-pixfmts-scale: CMD = pixfmts "200:100"
 
@@ -225,6 +225,28 @@ $(foreach N,$(HEVC_SAMPLES_444_12BIT),$(eval $(call FATE_HEVC_TEST_444_12BIT,$(N
 fate-hevc-paramchange-yuv420p-yuv420p10: CMD = framecrc -vsync 0 -i $(TARGET_SAMPLES)/hevc/paramchange_yuv420p_yuv420p10.hevc -sws_flags area+accurate_rnd+bitexact
 FATE_HEVC += fate-hevc-paramchange-yuv420p-yuv420p10
 
+# Entry threads decoding the WPP rows and tiles inside frame threads give the
+# same output as the serial decoder.
+HEVC_SAMPLES_ENTRY_THREADS =    \
+    TILES_A_Cisco_2             \
+    TILES_B_Cisco_1             \
+    WPP_A_ericsson_MAIN_2       \
+    WPP_B_ericsson_MAIN_2       \
+    WPP_C_ericsson_MAIN_2       \
+    WPP_D_ericsson_MAIN_2       \
+    WPP_E_ericsson_MAIN_2       \
+    WPP_F_ericsson_MAIN_2       \
+
+define FATE_HEVC_ENTRY_THREADS_TEST
+FATE_HEVC += fate-hevc-entry-threads-$(1)
+fate-hevc-entry-threads-$(1): CMD = framecrc -flags unaligned -vsync drop -entry_threads 2 -i $(TARGET_SAMPLES)/hevc-conformance/$(1).bit
+fate-hevc-entry-threads-$(1): THREADS = 4
+fate-hevc-entry-threads-$(1): THREAD_TYPE = frame+slice
+fate-hevc-entry-threads-$(1): REF = $(SRC_PATH)/tests/ref/fate/hevc-conformance-$(1)
+endef
+
+$(foreach N,$(HEVC_SAMPLES_ENTRY_THREADS),$(eval $(call FATE_HEVC_ENTRY_THREADS_TEST,$(N))))
+
 tests/data/hevc-mp4.mov: TAG = GEN
 tests/data/hevc-mp4.mov: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
 	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
@@ -0,0 +1,38 @@
+# Two variants of 10 segments each, to exercise segment prefetching.
+tests/data/hls-prefetch.m3u8: TAG = GEN
+tests/data/hls-prefetch.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
+        -f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t)::d=20" -f hls -hls_time 2 -hls_list_size 0 -map 0 -flags +bitexact \
+        -codec:a mp2fixed -hls_segment_filename $(TARGET_PATH)/tests/data/hls-prefetch-a-%03d.ts \
+        $(TARGET_PATH)/tests/data/hls-prefetch-a.m3u8 2>/dev/null; \
+        $(TARGET_EXEC) $(TARGET_PATH)/$< \
+        -f lavfi -i "aevalsrc=sin(2*PI*(660-4*t)*t)::d=20" -f hls -hls_time 2 -hls_list_size 0 -map 0 -flags +bitexact \
+        -codec:a mp2fixed -hls_segment_filename $(TARGET_PATH)/tests/data/hls-prefetch-b-%03d.ts \
+        $(TARGET_PATH)/tests/data/hls-prefetch-b.m3u8 2>/dev/null; \
+        printf "#EXTM3U\n#EXT-X-STREAM-INF:BANDWIDTH=64000\nhls-prefetch-a.m3u8\n#EXT-X-STREAM-INF:BANDWIDTH=128000\nhls-prefetch-b.m3u8\n" > $(TARGET_PATH)/$@
+
+# The segments prefetched from the start are dropped by the seek.
+FATE_HLS += fate-hls-prefetch-seek
+fate-hls-prefetch-seek: CMD = framecrc -flags +bitexact -prefetch_segments 3 -ss 7 -i $(TARGET_PATH)/tests/data/hls-prefetch-a.m3u8
+
+# The first variant is prefetched while probing, then dropped as it is not mapped.
+FATE_HLS += fate-hls-prefetch-switch
+fate-hls-prefetch-switch: CMD = framecrc -flags +bitexact -prefetch_segments 3 -i $(TARGET_PATH)/tests/data/hls-prefetch.m3u8 -map 0:1
+
+$(FATE_HLS): tests/data/hls-prefetch.m3u8
+
+# Chunks of 0.5s written out while the 2s segments are produced.
+FATE_HLS += fate-hls-chunked
+fate-hls-chunked: CMD = chunked_segments hls "-hls_chunk_time 0.5" -f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t)::d=10" \
+                        -codec:a mp2fixed -flags +bitexact -fflags +bitexact -hls_time 2 -hls_list_size 0
+
+FATE_HLS-$(call ALLYES, HLS_DEMUXER HLS_MUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += $(FATE_HLS)
+
+# The same with fragmented mp4 segments, every chunk is written out as a
+# separate fragment.
+FATE_HLS-$(call ALLYES, HLS_DEMUXER HLS_MUXER MP4_MUXER MOV_DEMUXER TESTSRC_FILTER LAVFI_INDEV MPEG4_ENCODER) += fate-hls-chunked-fmp4
+fate-hls-chunked-fmp4: CMD = chunked_segments hls "-hls_chunk_time 0.5" -f lavfi -i "testsrc=s=176x144:r=25:d=10" \
+                             -codec:v mpeg4 -g 25 -flags +bitexact -fflags +bitexact -hls_time 2 -hls_list_size 0 -hls_segment_type fmp4
+
+FATE_FFMPEG += $(FATE_HLS-yes)
+fate-hls: $(FATE_HLS-yes)
@@ -319,6 +319,18 @@ $(foreach CLSP,$(PNG_COLORSPACES),$(eval $(call FATE_IMGSUITE_PNG,$(CLSP))))
 FATE_PNG += fate-png-int-rgb24
 fate-png-int-rgb24: CMD = framecrc -i $(TARGET_SAMPLES)/png1/lena-int_rgb24.png -sws_flags +accurate_rnd+bitexact -pix_fmt rgb24
 
+PNG_SLICES_SRC = -f rawvideo -s 352x288 -pix_fmt yuv420p -i tests/data/vsynth1.yuv -frames:v 3 -pix_fmt rgb24 -c:v
+
+FATE_PNG_SLICES-$(call ENCDEC, PNG, IMAGE2PIPE) += fate-png-slices
+fate-png-slices: CMD = slice_roundtrip image2pipe "-slices 4 -threads 4 -thread_type slice" $(PNG_SLICES_SRC) png
+
+FATE_PNG_SLICES-$(call ENCDEC, APNG, APNG) += fate-apng-slices
+fate-apng-slices: CMD = slice_roundtrip apng "-slices 4 -threads 4 -thread_type slice" $(PNG_SLICES_SRC) apng
+
+$(FATE_PNG_SLICES-yes): tests/data/vsynth1.yuv
+FATE_FFMPEG += $(FATE_PNG_SLICES-yes)
+fate-png: $(FATE_PNG_SLICES-yes)
+
 FATE_PNG-$(call DEMDEC, IMAGE2, PNG) += $(FATE_PNG)
 FATE_IMAGE += $(FATE_PNG-yes)
 fate-png: $(FATE_PNG-yes)
@@ -6,6 +6,10 @@ FATE_LIBAVFORMAT-$(CONFIG_NETWORK) += fate-noproxy
 fate-noproxy: libavformat/tests/noproxy$(EXESUF)
 fate-noproxy: CMD = run libavformat/tests/noproxy
 
+FATE_LIBAVFORMAT-$(CONFIG_FILE_PROTOCOL) += fate-readahead
+fate-readahead: libavformat/tests/readahead$(EXESUF)
+fate-readahead: CMD = run libavformat/tests/readahead $(TARGET_PATH)/tests/data/readahead.bin
+
 FATE_LIBAVFORMAT-$(CONFIG_FFRTMPCRYPT_PROTOCOL) += fate-rtmpdh
 fate-rtmpdh: libavformat/tests/rtmpdh$(EXESUF)
 fate-rtmpdh: CMD = run libavformat/tests/rtmpdh
@@ -13,10 +13,21 @@ FATE_MOV_FFPROBE = fate-mov-aac-2048-priming \
                    fate-mov-displaymatrix \
                    fate-mov-spherical-mono \
 
+FATE_MOV_FASTSTART = fate-mov-faststart-moov-size \
+                     fate-mov-faststart-moov-size-small \
+                     fate-mov-faststart-moov-size-auto \
+
 FATE_SAMPLES_AVCONV += $(FATE_MOV)
 FATE_SAMPLES_FFPROBE += $(FATE_MOV_FFPROBE)
+FATE_AVCONV-$(call ALLYES, RAWVIDEO_DEMUXER MPEG4_ENCODER MOV_MUXER MOV_DEMUXER) += $(FATE_MOV_FASTSTART)
+
+FATE_MOV_COMPACT_INDEX-$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER AEVALSRC_FILTER MPEG4_ENCODER MP2FIXED_ENCODER MP4_MUXER MOV_DEMUXER FRAMECRC_MUXER FFMPEG) += fate-mov-compact-index
+FATE_FFPROBE += $(FATE_MOV_COMPACT_INDEX-yes)
 
-fate-mov: $(FATE_MOV) $(FATE_MOV_FFPROBE)
+FATE_MOV_MMAP-$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER AEVALSRC_FILTER MPEG4_ENCODER MP2FIXED_ENCODER MP4_MUXER MOV_DEMUXER FRAMECRC_MUXER FFMPEG) += fate-mov-mmap-copy
+FATE_FFMPEG += $(FATE_MOV_MMAP-yes)
+
+fate-mov: $(FATE_MOV) $(FATE_MOV_FFPROBE) $(FATE_MOV_FASTSTART) $(FATE_MOV_COMPACT_INDEX-yes) $(FATE_MOV_MMAP-yes)
 
 # Make sure we handle edit lists correctly in normal cases.
 fate-mov-1elist-noctts: CMD = framemd5 -i $(TARGET_SAMPLES)/mov/mov-1elist-noctts.mov
@@ -47,3 +58,29 @@ fate-mov-init-nonkeyframe: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -show_packets -
 fate-mov-displaymatrix: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -show_entries stream=display_aspect_ratio,sample_aspect_ratio:stream_side_data_list -select_streams v -v 0 $(TARGET_SAMPLES)/mov/displaymatrix.mov
 
 fate-mov-spherical-mono: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -show_entries stream_side_data_list -select_streams v -v 0 $(TARGET_SAMPLES)/mov/spherical.mov
+
+MOV_FASTSTART_SRC = "rawvideo -s 352x288 -pix_fmt yuv420p" tests/data/vsynth1.yuv mov
+MOV_FASTSTART_OPT = -c:v mpeg4 -frames:v 10 -movflags +faststart
+$(FATE_MOV_FASTSTART): tests/data/vsynth1.yuv
+
+# The moov atom fits in the reserved space and is written in place.
+fate-mov-faststart-moov-size: CMD = transcode $(MOV_FASTSTART_SRC) "$(MOV_FASTSTART_OPT) -moov_size 4096" "-c copy"
+# The reserved space is too small, the muxer falls back to the second pass.
+fate-mov-faststart-moov-size-small: CMD = transcode $(MOV_FASTSTART_SRC) "$(MOV_FASTSTART_OPT) -moov_size 100" "-c copy"
+# The reserved space is estimated from the input duration.
+fate-mov-faststart-moov-size-auto: CMD = transcode $(MOV_FASTSTART_SRC) "$(MOV_FASTSTART_OPT) -moov_size -1" "-c copy"
+
+tests/data/mov-compact-index.mp4: TAG = GEN
+tests/data/mov-compact-index.mp4: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
+        -f lavfi -i "testsrc=s=176x144:r=25:d=2" -f lavfi -i "aevalsrc=sin(2*PI*440*t)::s=44100:d=2" \
+        -c:v mpeg4 -g 12 -bf 2 -c:a mp2fixed -use_editlist 0 -flags +bitexact -fflags +bitexact \
+        -y $(TARGET_PATH)/$@ 2>/dev/null
+
+# The compact index returns the same packets and seeks to the same samples as the full index.
+fate-mov-compact-index: tests/data/mov-compact-index.mp4
+fate-mov-compact-index: CMD = compact_index $(TARGET_PATH)/tests/data/mov-compact-index.mp4 1.3
+
+# Stream copy with -mmap 1 returns the same packets as the copying path.
+fate-mov-mmap-copy: tests/data/mov-compact-index.mp4
+fate-mov-mmap-copy: CMD = mmap_copy $(TARGET_PATH)/tests/data/mov-compact-index.mp4 -flags +bitexact -fflags +bitexact